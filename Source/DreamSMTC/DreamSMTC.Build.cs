@@ -40,6 +40,7 @@ public class DreamSMTC : ModuleRules
 			new string[]
 			{
 				"Core",
+				"InputCore",
 				// ... add other public dependencies that you statically link with here ...
 			}
 			);
@@ -50,8 +51,18 @@ public class DreamSMTC : ModuleRules
 			{
 				"CoreUObject",
 				"Engine",
+				"DeveloperSettings",
+				"RenderCore",
+				"RHI",
+				"ImageWrapper",
 				"Slate",
 				"SlateCore",
+				"Sockets",
+				"Networking",
+				"Json",
+				"EnhancedInput",
+				"LevelSequence",
+				"MovieScene",
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
@@ -0,0 +1,210 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCAsyncActions.h"
+
+#include "DreamSMTCSubsystem.h"
+#include "DreamSMTCPlaylistReader.h"
+#include "Async/Async.h"
+#include "Engine/GameInstance.h"
+#include "Kismet/GameplayStatics.h"
+
+UDreamSMTCSubsystem* UDreamSMTCAsyncActionBase::GetSubsystem() const
+{
+	const UGameInstance* GameInstance = UGameplayStatics::GetGameInstance(WorldContext.Get());
+	return GameInstance ? GameInstance->GetSubsystem<UDreamSMTCSubsystem>() : nullptr;
+}
+
+void UDreamSMTCAsyncActionBase::Finish(bool bSuccess, const FDreamSMTCAsyncTiming& Timing, const FString& Error)
+{
+	if (bSuccess)
+	{
+		OnCompleted.Broadcast(Timing, Error);
+	}
+	else
+	{
+		OnFailed.Broadcast(Timing, Error);
+	}
+	SetReadyToDestroy();
+}
+
+UDreamSMTCSetThumbnailAsyncAction* UDreamSMTCSetThumbnailAsyncAction::SetThumbnailAsync(
+	UObject* WorldContextObject, UTexture2D* Thumbnail)
+{
+	UDreamSMTCSetThumbnailAsyncAction* Action = NewObject<UDreamSMTCSetThumbnailAsyncAction>();
+	Action->WorldContext = WorldContextObject;
+	Action->Thumbnail = Thumbnail;
+	Action->RegisterWithGameInstance(WorldContextObject);
+	return Action;
+}
+
+void UDreamSMTCSetThumbnailAsyncAction::Activate()
+{
+	UDreamSMTCSubsystem* Subsystem = GetSubsystem();
+	if (!Subsystem)
+	{
+		Finish(false, FDreamSMTCAsyncTiming(), TEXT("DreamSMTC subsystem is not available."));
+		return;
+	}
+
+	Subsystem->SetThumbnailAsync(Thumbnail,
+		[WeakThis = TWeakObjectPtr<UDreamSMTCSetThumbnailAsyncAction>(this)](
+		bool bSuccess, const FDreamSMTCAsyncTiming& Timing, const FString& Error)
+		{
+			if (WeakThis.IsValid())
+			{
+				WeakThis->Finish(bSuccess, Timing, Error);
+			}
+		});
+}
+
+UDreamSMTCCommitAsyncAction* UDreamSMTCCommitAsyncAction::CommitMediaSessionAsync(UObject* WorldContextObject)
+{
+	UDreamSMTCCommitAsyncAction* Action = NewObject<UDreamSMTCCommitAsyncAction>();
+	Action->WorldContext = WorldContextObject;
+	Action->RegisterWithGameInstance(WorldContextObject);
+	return Action;
+}
+
+void UDreamSMTCCommitAsyncAction::Activate()
+{
+	UDreamSMTCSubsystem* Subsystem = GetSubsystem();
+	if (!Subsystem)
+	{
+		Finish(false, FDreamSMTCAsyncTiming(), TEXT("DreamSMTC subsystem is not available."));
+		return;
+	}
+
+	Subsystem->CommitAsync(
+		[WeakThis = TWeakObjectPtr<UDreamSMTCCommitAsyncAction>(this)](
+		bool bSuccess, const FDreamSMTCAsyncTiming& Timing, const FString& Error)
+		{
+			if (WeakThis.IsValid())
+			{
+				WeakThis->Finish(bSuccess, Timing, Error);
+			}
+		});
+}
+
+UDreamSMTCStreamPlaylistAsyncAction* UDreamSMTCStreamPlaylistAsyncAction::StreamPlaylistAsync(
+	UObject* WorldContextObject, const FString& FilePath, int32 BatchSize)
+{
+	UDreamSMTCStreamPlaylistAsyncAction* Action = NewObject<UDreamSMTCStreamPlaylistAsyncAction>();
+	Action->FilePath = FilePath;
+	Action->BatchSize = FMath::Max(BatchSize, 1);
+	Action->State = MakeShared<FStreamState, ESPMode::ThreadSafe>();
+	Action->State->Action = Action;
+	Action->State->BatchSize = Action->BatchSize;
+	Action->RegisterWithGameInstance(WorldContextObject);
+	return Action;
+}
+
+void UDreamSMTCStreamPlaylistAsyncAction::Activate()
+{
+	Async(EAsyncExecution::ThreadPool, [State = State.ToSharedRef(), Path = FilePath]()
+	{
+		if (!State->Reader.Open(Path))
+		{
+			Deliver(State, &UDreamSMTCStreamPlaylistAsyncAction::OnFailed, {}, 0,
+			        FString::Printf(TEXT("Could not read playlist %s"), *Path), true);
+			return;
+		}
+		ReadBatches(State);
+	});
+}
+
+void UDreamSMTCStreamPlaylistAsyncAction::ReadBatches(const FStreamStateRef& State)
+{
+	FDreamSMTCPlaylistEntry Entry;
+	while (!State->bCancelled)
+	{
+		// 游戏线程处理不过来时退出，不占用线程池；置位前送达的批次看不到暂停标记，所以置位后再检查一次
+		if (State->BatchesInFlight.load() >= MaxBatchesInFlight)
+		{
+			State->bPaused = true;
+			if (State->BatchesInFlight.load() >= MaxBatchesInFlight || !State->bPaused.exchange(false))
+			{
+				return;
+			}
+		}
+
+		if (!State->Reader.Next(Entry))
+		{
+			break;
+		}
+		State->Batch.Add(MoveTemp(Entry));
+		if (State->Batch.Num() < State->Limit)
+		{
+			continue;
+		}
+
+		const int32 Count = State->Batch.Num();
+		Deliver(State, &UDreamSMTCStreamPlaylistAsyncAction::OnEntries, MoveTemp(State->Batch), State->FirstIndex,
+		        FString(), false);
+		State->Batch.Reset(State->BatchSize);
+		State->FirstIndex += Count;
+		State->Limit = State->BatchSize;
+	}
+
+	// 读完或取消后释放文件映射，不必等到 Action 被回收
+	State->Reader.Close();
+	if (State->bCancelled)
+	{
+		return;
+	}
+
+	if (State->Batch.Num() > 0)
+	{
+		const int32 Count = State->Batch.Num();
+		Deliver(State, &UDreamSMTCStreamPlaylistAsyncAction::OnEntries, MoveTemp(State->Batch), State->FirstIndex,
+		        FString(), false);
+		State->FirstIndex += Count;
+	}
+	Deliver(State, &UDreamSMTCStreamPlaylistAsyncAction::OnCompleted, {}, State->FirstIndex, FString(), true);
+}
+
+void UDreamSMTCStreamPlaylistAsyncAction::Deliver(const FStreamStateRef& State, FPin Pin,
+                                                  TArray<FDreamSMTCPlaylistEntry>&& Entries, int32 FirstIndex,
+                                                  FString&& Error, bool bFinal)
+{
+	++State->BatchesInFlight;
+	AsyncTask(ENamedThreads::GameThread,
+		[State, Pin, Entries = MoveTemp(Entries), FirstIndex, Error = MoveTemp(Error), bFinal]()
+		{
+			--State->BatchesInFlight;
+			// 读取任务因批次堆积而退出时，由这里接着读取
+			if (State->bPaused.exchange(false) && !State->bCancelled)
+			{
+				Async(EAsyncExecution::ThreadPool, [State]() { ReadBatches(State); });
+			}
+
+			UDreamSMTCStreamPlaylistAsyncAction* Action = State->Action.Get();
+			if (!Action || State->bCancelled)
+			{
+				return;
+			}
+
+			(Action->*Pin).Broadcast(Entries, FirstIndex, Error);
+			if (bFinal)
+			{
+				Action->SetReadyToDestroy();
+			}
+		});
+}
+
+void UDreamSMTCStreamPlaylistAsyncAction::Cancel()
+{
+	if (State.IsValid())
+	{
+		State->bCancelled = true;
+	}
+	SetReadyToDestroy();
+}
+
+void UDreamSMTCStreamPlaylistAsyncAction::BeginDestroy()
+{
+	if (State.IsValid())
+	{
+		State->bCancelled = true;
+	}
+	Super::BeginDestroy();
+}
@@ -0,0 +1,119 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCButtonListeners.h"
+
+FDelegateHandle FDreamSMTCButtonListenerRegistry::Add(FDreamSMTCNativeButtonDelegate&& Delegate, uint32 ButtonMask,
+                                                      EDreamSMTCListenerThread Thread)
+{
+	if (!Delegate.IsBound() || ButtonMask == 0)
+	{
+		return FDelegateHandle();
+	}
+
+	FScopeLock Lock(&Mutex);
+
+	FListenerList NewList = Listeners.IsValid() ? *Listeners : FListenerList();
+	FListener& Listener = NewList.AddDefaulted_GetRef();
+	Listener.Handle = Delegate.GetHandle();
+	Listener.Delegate = MoveTemp(Delegate);
+	Listener.ButtonMask = ButtonMask;
+	Listener.Thread = Thread;
+
+	const FDelegateHandle Handle = Listener.Handle;
+	Publish(MoveTemp(NewList));
+	return Handle;
+}
+
+bool FDreamSMTCButtonListenerRegistry::Remove(FDelegateHandle Handle)
+{
+	FScopeLock Lock(&Mutex);
+	if (!Listeners.IsValid())
+	{
+		return false;
+	}
+
+	FListenerList NewList = *Listeners;
+	if (NewList.RemoveAll([Handle](const FListener& Listener) { return Listener.Handle == Handle; }) == 0)
+	{
+		return false;
+	}
+
+	Publish(MoveTemp(NewList));
+	return true;
+}
+
+void FDreamSMTCButtonListenerRegistry::RemoveAll(const void* UserObject)
+{
+	FScopeLock Lock(&Mutex);
+	if (!Listeners.IsValid())
+	{
+		return;
+	}
+
+	FListenerList NewList = *Listeners;
+	if (NewList.RemoveAll([UserObject](const FListener& Listener)
+	{
+		return Listener.Delegate.IsBoundToObject(UserObject);
+	}) > 0)
+	{
+		Publish(MoveTemp(NewList));
+	}
+}
+
+void FDreamSMTCButtonListenerRegistry::Reset()
+{
+	FScopeLock Lock(&Mutex);
+	Publish(FListenerList());
+}
+
+void FDreamSMTCButtonListenerRegistry::Dispatch(EDreamSMTCButtonEvent Button, EDreamSMTCListenerThread Thread) const
+{
+	if (!HasListeners(Button, Thread))
+	{
+		return;
+	}
+
+	const FListenerListPtr Snapshot = GetSnapshot();
+	if (!Snapshot.IsValid())
+	{
+		return;
+	}
+
+	const uint32 Bit = DreamSMTCButtonBit(Button);
+	for (const FListener& Listener : *Snapshot)
+	{
+		if (Listener.Thread == Thread && (Listener.ButtonMask & Bit) != 0)
+		{
+			Listener.Delegate.ExecuteIfBound(Button);
+		}
+	}
+}
+
+bool FDreamSMTCButtonListenerRegistry::HasListeners(EDreamSMTCButtonEvent Button, EDreamSMTCListenerThread Thread) const
+{
+	const std::atomic<uint32>& Mask = Thread == EDreamSMTCListenerThread::CallbackThread
+		                                  ? CallbackThreadMask
+		                                  : GameThreadMask;
+	return (Mask.load(std::memory_order_acquire) & DreamSMTCButtonBit(Button)) != 0;
+}
+
+FDreamSMTCButtonListenerRegistry::FListenerListPtr FDreamSMTCButtonListenerRegistry::GetSnapshot() const
+{
+	FScopeLock Lock(&Mutex);
+	return Listeners;
+}
+
+void FDreamSMTCButtonListenerRegistry::Publish(FListenerList&& NewList)
+{
+	uint32 NewGameThreadMask = 0;
+	uint32 NewCallbackThreadMask = 0;
+	for (const FListener& Listener : NewList)
+	{
+		(Listener.Thread == EDreamSMTCListenerThread::CallbackThread ? NewCallbackThreadMask : NewGameThreadMask) |=
+			Listener.ButtonMask;
+	}
+
+	Listeners = MakeShared<FListenerList, ESPMode::ThreadSafe>(MoveTemp(NewList));
+	GameThreadMask.store(NewGameThreadMask, std::memory_order_release);
+	CallbackThreadMask.store(NewCallbackThreadMask, std::memory_order_release);
+}
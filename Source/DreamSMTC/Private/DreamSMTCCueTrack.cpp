@@ -0,0 +1,229 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCCueTrack.h"
+
+#include "Algo/BinarySearch.h"
+#include "Algo/StableSort.h"
+#include "DreamSMTCLog.h"
+
+bool FDreamSMTCCueTrack::LoadLrc(const FString& Text)
+{
+	TArray<FString> Lines;
+	Text.ParseIntoArrayLines(Lines);
+
+	TArray<FDreamSMTCCue> Parsed;
+	Parsed.Reserve(Lines.Num());
+
+	FTimespan Offset = FTimespan::Zero();
+	TArray<FTimespan, TInlineAllocator<4>> LineTimes;
+	for (const FString& Line : Lines)
+	{
+		LineTimes.Reset();
+
+		// 一行可以带多个时间标签，例如 [00:12.00][01:30.50]歌词
+		int32 Cursor = 0;
+		while (Cursor < Line.Len() && Line[Cursor] == TEXT('['))
+		{
+			const int32 Close = Line.Find(TEXT("]"), ESearchCase::CaseSensitive, ESearchDir::FromStart, Cursor);
+			if (Close == INDEX_NONE)
+			{
+				break;
+			}
+
+			const FStringView Tag = FStringView(Line).Mid(Cursor + 1, Close - Cursor - 1);
+			FTimespan Time;
+			if (ParseTimestamp(Tag, Time))
+			{
+				LineTimes.Add(Time);
+			}
+			else if (Tag.StartsWith(TEXT("offset:"), ESearchCase::IgnoreCase))
+			{
+				// 正偏移表示歌词提前显示
+				Offset = FTimespan::FromMilliseconds(FCString::Atoi(*FString(Tag.RightChop(7))));
+			}
+			Cursor = Close + 1;
+		}
+
+		if (LineTimes.Num() == 0)
+		{
+			continue;
+		}
+
+		const FString Lyric = Line.Mid(Cursor).TrimStartAndEnd();
+		for (const FTimespan& Time : LineTimes)
+		{
+			Parsed.Emplace(Time, Lyric, FString());
+		}
+	}
+
+	for (FDreamSMTCCue& Cue : Parsed)
+	{
+		Cue.Time = FMath::Max(Cue.Time - Offset, FTimespan::Zero());
+	}
+
+	Build(MoveTemp(Parsed));
+	DSMTC_LOG(Verbose, TEXT("Loaded %d lyric cues."), Cues.Num());
+	return Cues.Num() > 0;
+}
+
+bool FDreamSMTCCueTrack::LoadChapters(const FString& Text)
+{
+	TArray<FString> Lines;
+	Text.ParseIntoArrayLines(Lines);
+
+	TArray<FDreamSMTCCue> Parsed;
+	Parsed.Reserve(Lines.Num());
+
+	for (const FString& RawLine : Lines)
+	{
+		const FString Line = RawLine.TrimStartAndEnd();
+
+		// 制表符分隔时标题可以包含空格，没有制表符时才在第一个空白处分开
+		int32 Separator = INDEX_NONE;
+		if (!Line.FindChar(TEXT('\t'), Separator))
+		{
+			for (int32 Index = 0; Index < Line.Len(); ++Index)
+			{
+				if (FChar::IsWhitespace(Line[Index]))
+				{
+					Separator = Index;
+					break;
+				}
+			}
+		}
+		if (Separator == INDEX_NONE)
+		{
+			continue;
+		}
+
+		FTimespan Time;
+		if (!ParseTimestamp(FStringView(Line).Left(Separator).TrimEnd(), Time))
+		{
+			continue;
+		}
+
+		FString Title = Line.Mid(Separator + 1).TrimStartAndEnd();
+		FString Subtitle;
+		if (Title.Split(TEXT(" - "), &Title, &Subtitle))
+		{
+			Title.TrimEndInline();
+			Subtitle.TrimStartInline();
+		}
+		Parsed.Emplace(Time, MoveTemp(Title), MoveTemp(Subtitle));
+	}
+
+	Build(MoveTemp(Parsed));
+	DSMTC_LOG(Verbose, TEXT("Loaded %d chapter cues."), Cues.Num());
+	return Cues.Num() > 0;
+}
+
+void FDreamSMTCCueTrack::SetCues(TArray<FDreamSMTCCue> InCues)
+{
+	Build(MoveTemp(InCues));
+}
+
+void FDreamSMTCCueTrack::Reset()
+{
+	CueTicks.Empty();
+	Cues.Empty();
+	Cursor = INDEX_NONE;
+}
+
+bool FDreamSMTCCueTrack::Seek(FTimespan Position)
+{
+	const int64 Ticks = Position.GetTicks();
+	const int32 Count = CueTicks.Num();
+
+	int32 NewCursor;
+	if (Cursor != INDEX_NONE && Ticks >= CueTicks[Cursor])
+	{
+		// 正常播放只会停留在当前条目或前进一条
+		if (Cursor + 1 >= Count || Ticks < CueTicks[Cursor + 1])
+		{
+			NewCursor = Cursor;
+		}
+		else if (Cursor + 2 >= Count || Ticks < CueTicks[Cursor + 2])
+		{
+			NewCursor = Cursor + 1;
+		}
+		else
+		{
+			NewCursor = Algo::UpperBound(CueTicks, Ticks) - 1;
+		}
+	}
+	else if (Count == 0 || Ticks < CueTicks[0])
+	{
+		NewCursor = INDEX_NONE;
+	}
+	else
+	{
+		NewCursor = Algo::UpperBound(CueTicks, Ticks) - 1;
+	}
+
+	if (NewCursor == Cursor)
+	{
+		return false;
+	}
+
+	Cursor = NewCursor;
+	return true;
+}
+
+SIZE_T FDreamSMTCCueTrack::GetAllocatedSize() const
+{
+	SIZE_T Size = CueTicks.GetAllocatedSize() + Cues.GetAllocatedSize();
+	for (const FDreamSMTCCue& Cue : Cues)
+	{
+		Size += Cue.Title.GetAllocatedSize() + Cue.Subtitle.GetAllocatedSize();
+	}
+	return Size;
+}
+
+void FDreamSMTCCueTrack::Build(TArray<FDreamSMTCCue>&& InCues)
+{
+	Cues = MoveTemp(InCues);
+	Algo::StableSortBy(Cues, [](const FDreamSMTCCue& Cue) { return Cue.Time.GetTicks(); });
+
+	CueTicks.Reset(Cues.Num());
+	for (const FDreamSMTCCue& Cue : Cues)
+	{
+		CueTicks.Add(Cue.Time.GetTicks());
+	}
+	Cursor = INDEX_NONE;
+}
+
+bool FDreamSMTCCueTrack::ParseTimestamp(FStringView Text, FTimespan& OutTime)
+{
+	// 支持 mm:ss、mm:ss.xx、hh:mm:ss.xxx
+	int32 Fields[2] = {0, 0};
+	int32 NumFields = 0;
+	int32 Start = 0;
+	for (int32 Index = 0; Index < Text.Len(); ++Index)
+	{
+		const TCHAR Char = Text[Index];
+		if (Char == TEXT(':'))
+		{
+			if (NumFields == 2 || Index == Start)
+			{
+				return false;
+			}
+			Fields[NumFields++] = FCString::Atoi(*FString(Text.Mid(Start, Index - Start)));
+			Start = Index + 1;
+		}
+		else if (!FChar::IsDigit(Char) && Char != TEXT('.'))
+		{
+			return false;
+		}
+	}
+
+	if (NumFields == 0 || Start >= Text.Len())
+	{
+		return false;
+	}
+
+	const double Seconds = FCString::Atod(*FString(Text.Mid(Start)));
+	const int32 Hours = NumFields == 2 ? Fields[0] : 0;
+	const int32 Minutes = NumFields == 2 ? Fields[1] : Fields[0];
+	OutTime = FTimespan::FromSeconds(Hours * 3600.0 + Minutes * 60.0 + Seconds);
+	return true;
+}
@@ -0,0 +1,237 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCDebugPanel.h"
+
+#include "DreamSMTCButtons.h"
+#include "DreamSMTCLog.h"
+#include "DreamSMTCSessionManager.h"
+#include "DreamSMTCSettings.h"
+#include "DreamSMTCSubsystem.h"
+#include "DreamSMTCTypes.h"
+#include "Framework/Application/SlateApplication.h"
+#include "HAL/IConsoleManager.h"
+#include "Styling/CoreStyle.h"
+#include "Widgets/SWindow.h"
+#include "Widgets/Layout/SBorder.h"
+#include "Widgets/Layout/SScrollBox.h"
+#include "Widgets/Text/STextBlock.h"
+
+#define LOCTEXT_NAMESPACE "DreamSMTCDebugPanel"
+
+// 游戏线程
+static TWeakPtr<SWindow> GDebugPanelWindow;
+
+namespace
+{
+	double Ratio(int64 Part, int64 Total)
+	{
+		return Total > 0 ? 100.0 * Part / Total : 0.0;
+	}
+
+	void AppendTimespan(FStringBuilderBase& Builder, FTimespan Time)
+	{
+		const int64 Seconds = FMath::Max<int64>(0, static_cast<int64>(Time.GetTotalSeconds()));
+		Builder.Appendf(TEXT("%02lld:%02lld"), Seconds / 60, Seconds % 60);
+	}
+}
+
+void SDreamSMTCDebugPanel::Construct(const FArguments& InArgs)
+{
+	ChildSlot
+	[
+		SNew(SBorder)
+		.Padding(8.0f)
+		[
+			SNew(SScrollBox)
+			+ SScrollBox::Slot()
+			[
+				SAssignNew(Text, STextBlock)
+				.Font(FCoreStyle::GetDefaultFontStyle("Mono", 9))
+			]
+		]
+	];
+
+	Refresh(0.0, 0.0f);
+	RegisterActiveTimer(1.0f / FMath::Clamp(InArgs._RefreshRate, 1.0f, 30.0f),
+	                    FWidgetActiveTimerDelegate::CreateSP(this, &SDreamSMTCDebugPanel::Refresh));
+}
+
+void SDreamSMTCDebugPanel::ToggleWindow()
+{
+	if (!FSlateApplication::IsInitialized())
+	{
+		DSMTC_LOG(Warning, TEXT("DreamSMTC.Debug needs Slate"));
+		return;
+	}
+
+	if (const TSharedPtr<SWindow> Window = GDebugPanelWindow.Pin())
+	{
+		Window->RequestDestroyWindow();
+		GDebugPanelWindow.Reset();
+		return;
+	}
+
+	const TSharedRef<SWindow> Window = SNew(SWindow)
+		.Title(LOCTEXT("Title", "DreamSMTC Debug"))
+		.ClientSize(FVector2D(640.0, 480.0))
+		.SupportsMaximize(false)
+		[
+			SNew(SDreamSMTCDebugPanel)
+			.RefreshRate(UDreamSMTCSettings::Get()->DebugPanelRefreshRate)
+		];
+	FSlateApplication::Get().AddWindow(Window);
+	GDebugPanelWindow = Window;
+}
+
+UDreamSMTCSubsystem* SDreamSMTCDebugPanel::FindSubsystem()
+{
+	FDreamSMTCSessionManager& Manager = FDreamSMTCSessionManager::Get();
+	if (UDreamSMTCSubsystem* Owner = Manager.GetOwner())
+	{
+		return Owner;
+	}
+
+	UDreamSMTCSubsystem* First = nullptr;
+	Manager.ForEachSession([&First](UDreamSMTCSubsystem& Subsystem)
+	{
+		First = First ? First : &Subsystem;
+	});
+	return First;
+}
+
+EActiveTimerReturnType SDreamSMTCDebugPanel::Refresh(double InCurrentTime, float InDeltaTime)
+{
+	const FDreamSMTCDebugStats& Stats = FDreamSMTCDebugStats::Get();
+	const double Now = FPlatformTime::Seconds();
+
+	const int64 BackendCalls = Stats.GetBackendCalls();
+	if (LastRefreshTime > 0.0 && Now > LastRefreshTime)
+	{
+		CallsPerSecond = (BackendCalls - LastBackendCalls) / (Now - LastRefreshTime);
+	}
+	LastBackendCalls = BackendCalls;
+	LastRefreshTime = Now;
+
+	TStringBuilder<4096> Builder;
+	if (const UDreamSMTCSubsystem* Subsystem = FindSubsystem())
+	{
+		Subsystem->GetDebugSnapshot(Snapshot);
+		AppendSession(Builder, Snapshot);
+	}
+	else
+	{
+		Builder.Append(TEXT("No DreamSMTC session\n"));
+		Snapshot = FDreamSMTCDebugSnapshot();
+	}
+
+	const FDreamSMTCUpdateSchedulerStats& Scheduler = Snapshot.Scheduler;
+	Builder.Appendf(TEXT("\nBackend   %.1f calls/s (budget %.0f)  %lld calls  %lld failed\n"), CallsPerSecond,
+	                UDreamSMTCSettings::Get()->MaxBackendCallsPerSecond, BackendCalls, Stats.GetBackendFailures());
+	Builder.Appendf(TEXT("Commits   %lld  throttled %lld  low priority merged %lld (%.0f%%)\n"), Scheduler.Commits,
+	                Scheduler.ThrottledCommits, Scheduler.MergedLowPriorityWrites,
+	                Ratio(Scheduler.MergedLowPriorityWrites, Scheduler.Commits));
+	Builder.Appendf(TEXT("Seeks     %lld requested  %lld coalesced (%.0f%%)\n"), Snapshot.SeekRequests,
+	                Snapshot.CoalescedSeekRequests, Ratio(Snapshot.CoalescedSeekRequests, Snapshot.SeekRequests));
+
+	// 对数分桶，显示的是所在桶的上界
+	const FDreamSMTCLatencyHistogram& Latency = Stats.GetButtonLatency();
+	Builder.Appendf(TEXT("Buttons   %lld presses  latency p50 <%.2f ms  p95 <%.2f ms  p99 <%.2f ms\n"), Latency.Num(),
+	                Latency.GetPercentile(0.5) * 1000.0, Latency.GetPercentile(0.95) * 1000.0,
+	                Latency.GetPercentile(0.99) * 1000.0);
+
+	const int64 Hits = Stats.GetPlaceholderHits();
+	const int64 Misses = Stats.GetPlaceholderMisses();
+	Builder.Appendf(TEXT("Thumbnail placeholder cache  %lld hits  %lld misses (%.0f%% hit)\n"), Hits, Misses,
+	                Ratio(Hits, Hits + Misses));
+
+	Stats.GetRecentErrors(Errors);
+	Builder.Appendf(TEXT("\nRecent errors (%d)\n"), Errors.Num());
+	for (const FDreamSMTCErrorRecord& Error : Errors)
+	{
+		Builder.Appendf(TEXT("  -%.1fs  %s  %s\n"), Now - Error.Time,
+		                Error.Verbosity == ELogVerbosity::Warning ? TEXT("Warning") : TEXT("Error"), Error.Message);
+	}
+
+	// 内容不变时不触发重新布局
+	if (FCString::Strcmp(*LastText, Builder.ToString()) != 0)
+	{
+		LastText = Builder.ToString();
+		Text->SetText(FText::FromString(LastText));
+	}
+	return EActiveTimerReturnType::Continue;
+}
+
+void SDreamSMTCDebugPanel::AppendSession(FStringBuilderBase& Builder, const FDreamSMTCDebugSnapshot& InSnapshot) const
+{
+	const FDreamSMTCSessionState& Session = InSnapshot.Session;
+	Builder.Appendf(TEXT("Session   %s  %s  %s\n"), InSnapshot.bOwner ? TEXT("owner") : TEXT("not owner"),
+	                InSnapshot.bIdle ? TEXT("idle") : TEXT("ticking"),
+	                Session.bEnabled ? TEXT("enabled") : TEXT("disabled"));
+
+	Builder.Appendf(TEXT("Status    %s x%.2f  %s\n"),
+	                *StaticEnum<EDreamSMTCMediaPlaybackStatus>()->GetNameStringByValue(
+		                static_cast<int64>(Session.PlaybackStatus)), Session.PlaybackRate,
+	                *StaticEnum<EDreamSMTCMediaPlaybackType>()->GetNameStringByValue(static_cast<int64>(Session.Type)));
+
+	switch (Session.Type)
+	{
+	case EDreamSMTCMediaPlaybackType::Music:
+		Builder.Appendf(TEXT("Display   %s - %s (%s)\n"), *Session.Music.Artist, *Session.Music.Title,
+		                *Session.Music.AlbumTitle);
+		break;
+	case EDreamSMTCMediaPlaybackType::Video:
+		Builder.Appendf(TEXT("Display   %s - %s\n"), *Session.Video.Title, *Session.Video.Subtitle);
+		break;
+	case EDreamSMTCMediaPlaybackType::Image:
+		Builder.Appendf(TEXT("Display   %s - %s\n"), *Session.Image.Title, *Session.Image.Subtitle);
+		break;
+	default:
+		break;
+	}
+
+	Builder.Append(TEXT("Timeline  "));
+	AppendTimespan(Builder, Session.Timeline.Position);
+	Builder.Append(TEXT(" / "));
+	AppendTimespan(Builder, Session.Timeline.EndTime);
+	Builder.Appendf(TEXT("  thumbnail %.1f KB\n"),
+	                Session.Thumbnail.IsValid() ? Session.Thumbnail->Num() / 1024.0 : 0.0);
+
+	Builder.Append(TEXT("Buttons  "));
+	for (int32 Index = 0; Index < DreamSMTCButtonCount; ++Index)
+	{
+		if (Session.EnabledButtons & (1u << Index))
+		{
+			Builder.Appendf(TEXT(" %s"), DreamSMTCButtonNames[Index]);
+		}
+	}
+
+	Builder.Append(TEXT("\nPending  "));
+	if (EnumHasAnyFlags(InSnapshot.PendingWrites, EDreamSMTCPendingWrite::Display))
+	{
+		Builder.Append(TEXT(" display"));
+	}
+	if (EnumHasAnyFlags(InSnapshot.PendingWrites, EDreamSMTCPendingWrite::Timeline))
+	{
+		Builder.Append(TEXT(" timeline"));
+	}
+	if (InSnapshot.bTimelineDeferred)
+	{
+		Builder.Append(TEXT(" deferred-timeline"));
+	}
+	if (InSnapshot.bSessionDirty)
+	{
+		Builder.Append(TEXT(" unsaved-session"));
+	}
+	if (InSnapshot.StagedSwitches > 0)
+	{
+		Builder.Appendf(TEXT(" staged-switches=%d"), InSnapshot.StagedSwitches);
+	}
+	Builder.Append(TEXT("\n"));
+}
+
+static FAutoConsoleCommand GDreamSMTCDebugCommand(
+	TEXT("DreamSMTC.Debug"),
+	TEXT("Opens or closes the DreamSMTC debug panel (session, pending writes, call rates, latency, errors)."),
+	FConsoleCommandDelegate::CreateStatic(&SDreamSMTCDebugPanel::ToggleWindow));
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,52 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Widgets/SCompoundWidget.h"
+#include "DreamSMTCDebugStats.h"
+
+class STextBlock;
+class UDreamSMTCSubsystem;
+
+/**
+ * Debug panel opened by DreamSMTC.Debug
+ * Shows the mirrored session of the owning subsystem, pending writes, backend calls per second, coalescing ratios,
+ * button latency percentiles, the thumbnail placeholder hit rate and recent LogDreamSMTC errors. Redraws from an
+ * active timer at DebugPanelRefreshRate and only when the text changed; there is no per-frame work.
+ */
+class SDreamSMTCDebugPanel : public SCompoundWidget
+{
+public:
+	SLATE_BEGIN_ARGS(SDreamSMTCDebugPanel)
+		: _RefreshRate(4.0f)
+		{
+		}
+
+		SLATE_ARGUMENT(float, RefreshRate)
+	SLATE_END_ARGS()
+
+	void Construct(const FArguments& InArgs);
+
+	/** Opens the panel in its own window, or closes the window if it is open. */
+	static void ToggleWindow();
+
+private:
+	EActiveTimerReturnType Refresh(double InCurrentTime, float InDeltaTime);
+
+	static UDreamSMTCSubsystem* FindSubsystem();
+	void AppendSession(FStringBuilderBase& Builder, const FDreamSMTCDebugSnapshot& Snapshot) const;
+
+private:
+	TSharedPtr<STextBlock> Text;
+	FString LastText;
+
+	// 两次刷新之间的调用数换算为每秒
+	int64 LastBackendCalls = 0;
+	double LastRefreshTime = 0.0;
+	double CallsPerSecond = 0.0;
+
+	// 在刷新之间复用，减少分配
+	FDreamSMTCDebugSnapshot Snapshot;
+	TArray<FDreamSMTCErrorRecord> Errors;
+};
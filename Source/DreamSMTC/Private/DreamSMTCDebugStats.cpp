@@ -0,0 +1,133 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCDebugStats.h"
+
+#include "DreamSMTCLog.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/OutputDeviceRedirector.h"
+
+FDreamSMTCLatencyHistogram::FDreamSMTCLatencyHistogram()
+{
+	Reset();
+}
+
+void FDreamSMTCLatencyHistogram::Record(double Seconds)
+{
+	const uint64 Microseconds = static_cast<uint64>(FMath::Max(Seconds, 0.0) * 1000000.0);
+	const int32 Bucket = FMath::Min(static_cast<int32>(64 - FMath::CountLeadingZeros64(Microseconds)), NumBuckets - 1);
+	Buckets[Bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+double FDreamSMTCLatencyHistogram::GetPercentile(double Fraction) const
+{
+	int64 Counts[NumBuckets];
+	int64 Total = 0;
+	for (int32 Index = 0; Index < NumBuckets; ++Index)
+	{
+		Counts[Index] = Buckets[Index].load(std::memory_order_relaxed);
+		Total += Counts[Index];
+	}
+	if (Total == 0)
+	{
+		return 0.0;
+	}
+
+	const int64 Target = FMath::Max<int64>(1, FMath::CeilToInt64(Total * FMath::Clamp(Fraction, 0.0, 1.0)));
+	int64 Seen = 0;
+	for (int32 Index = 0; Index < NumBuckets; ++Index)
+	{
+		Seen += Counts[Index];
+		if (Seen >= Target)
+		{
+			return static_cast<double>(1ull << Index) / 1000000.0;
+		}
+	}
+	return static_cast<double>(1ull << (NumBuckets - 1)) / 1000000.0;
+}
+
+int64 FDreamSMTCLatencyHistogram::Num() const
+{
+	int64 Total = 0;
+	for (const std::atomic<int64>& Bucket : Buckets)
+	{
+		Total += Bucket.load(std::memory_order_relaxed);
+	}
+	return Total;
+}
+
+void FDreamSMTCLatencyHistogram::Reset()
+{
+	for (std::atomic<int64>& Bucket : Buckets)
+	{
+		Bucket.store(0, std::memory_order_relaxed);
+	}
+}
+
+FDreamSMTCDebugStats& FDreamSMTCDebugStats::Get()
+{
+	static FDreamSMTCDebugStats Stats;
+	return Stats;
+}
+
+void FDreamSMTCDebugStats::Start()
+{
+	if (!bStarted && GLog)
+	{
+		GLog->AddOutputDevice(this);
+		bStarted = true;
+	}
+}
+
+void FDreamSMTCDebugStats::Stop()
+{
+	if (bStarted && GLog)
+	{
+		GLog->RemoveOutputDevice(this);
+	}
+	bStarted = false;
+}
+
+void FDreamSMTCDebugStats::Serialize(const TCHAR* V, ELogVerbosity::Type Verbosity, const FName& Category)
+{
+	const ELogVerbosity::Type Level = static_cast<ELogVerbosity::Type>(Verbosity & ELogVerbosity::VerbosityMask);
+	if (Category != LogDreamSMTC.GetCategoryName() || Level > ELogVerbosity::Warning)
+	{
+		return;
+	}
+
+	FDreamSMTCErrorRecord Record;
+	Record.Time = FPlatformTime::Seconds();
+	Record.Verbosity = Level;
+	FCString::Strncpy(Record.Message, V, UE_ARRAY_COUNT(Record.Message));
+
+	const uint64 Index = NextError.fetch_add(1, std::memory_order_relaxed);
+	Errors[Index % MaxRecentErrors].Write(Record);
+}
+
+void FDreamSMTCDebugStats::GetRecentErrors(TArray<FDreamSMTCErrorRecord>& OutErrors, int32 MaxErrors) const
+{
+	OutErrors.Reset();
+	const uint64 End = NextError.load(std::memory_order_relaxed);
+	const uint64 Count = FMath::Min<uint64>(End, FMath::Clamp(MaxErrors, 0, MaxRecentErrors));
+	for (uint64 Offset = 1; Offset <= Count; ++Offset)
+	{
+		Errors[(End - Offset) % MaxRecentErrors].Read(OutErrors.AddDefaulted_GetRef());
+	}
+}
+
+void FDreamSMTCDebugStats::Reset()
+{
+	BackendCalls = 0;
+	BackendFailures = 0;
+	PlaceholderHits = 0;
+	PlaceholderMisses = 0;
+	ButtonLatency.Reset();
+}
+
+static FAutoConsoleCommand GDreamSMTCDebugResetCommand(
+	TEXT("DreamSMTC.Debug.Reset"),
+	TEXT("Resets the backend call, thumbnail cache and button latency counters shown by DreamSMTC.Debug."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		FDreamSMTCDebugStats::Get().Reset();
+	}));
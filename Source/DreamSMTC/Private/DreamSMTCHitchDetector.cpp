@@ -0,0 +1,342 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCHitchDetector.h"
+
+#include "DreamSMTCDebugStats.h"
+#include "DreamSMTCLog.h"
+#include "DreamSMTCStateSink.h"
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTLS.h"
+#include "HAL/ThreadManager.h"
+#include "Misc/App.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+static TAutoConsoleVariable<float> CVarDreamSMTCHitchThresholdMs(
+	TEXT("DreamSMTC.HitchThresholdMs"),
+	20.0f,
+	TEXT("Backend operations slower than this write a hitch report to Saved/DreamSMTCHitches. 0 disables capture."),
+	ECVF_Default);
+
+// SetThumbnail 的 ArgB，区分文件与预先准备的流
+static constexpr int64 ThumbnailFromFile = 1;
+static constexpr int64 ThumbnailPrepared = 2;
+
+namespace
+{
+	/** Times and counts Functor, which performs the call and returns whether it succeeded. */
+	template <typename FunctorType>
+	bool TimeOperation(const TCHAR* BackendName, EDreamSMTCBackendOperation Operation, int64 ArgA, int64 ArgB,
+	                   FunctorType&& Functor)
+	{
+		FDreamSMTCOperationRecord Record;
+		Record.Operation = Operation;
+		Record.ArgA = ArgA;
+		Record.ArgB = ArgB;
+		Record.StartTime = FPlatformTime::Seconds();
+		Record.bSuccess = Functor();
+		Record.Seconds = FPlatformTime::Seconds() - Record.StartTime;
+		Record.ThreadId = FPlatformTLS::GetCurrentThreadId();
+		FDreamSMTCHitchDetector::Get().Record(Record, BackendName);
+		FDreamSMTCDebugStats::Get().RecordBackendCall(Record.bSuccess);
+		return Record.bSuccess;
+	}
+
+	FString GetThreadName(uint32 ThreadId)
+	{
+		if (ThreadId == GGameThreadId)
+		{
+			return TEXT("GameThread");
+		}
+		const FString& Name = FThreadManager::GetThreadName(ThreadId);
+		return Name.IsEmpty() ? FString::Printf(TEXT("Thread %u"), ThreadId) : Name;
+	}
+
+	FString DescribeArguments(const FDreamSMTCOperationRecord& Record)
+	{
+		switch (Record.Operation)
+		{
+		case EDreamSMTCBackendOperation::WriteSession:
+			return FString::Printf(TEXT("fields %s, buttons 0x%llx"),
+			                       *LexToString(static_cast<EDreamSMTCSessionField>(Record.ArgA)), Record.ArgB);
+		case EDreamSMTCBackendOperation::WriteTimeline:
+			return FString::Printf(TEXT("position %.3fs, end %.3fs"), FTimespan(Record.ArgA).GetTotalSeconds(),
+			                       FTimespan(Record.ArgB).GetTotalSeconds());
+		case EDreamSMTCBackendOperation::SetThumbnail:
+			return Record.ArgB == ThumbnailFromFile ? TEXT("from file") : TEXT("prepared stream");
+		case EDreamSMTCBackendOperation::PrepareThumbnail:
+			return FString::Printf(TEXT("%lld bytes"), Record.ArgA);
+		case EDreamSMTCBackendOperation::RemoveHandlers:
+			return FString::Printf(TEXT("registration %lld"), Record.ArgA);
+		default:
+			return FString();
+		}
+	}
+
+	FString DescribeOperation(const FDreamSMTCOperationRecord& Record)
+	{
+		return FString::Printf(TEXT("%s %.2f ms on %s, %s"),
+		                       *StaticEnum<EDreamSMTCBackendOperation>()->GetNameStringByValue(
+			                       static_cast<int64>(Record.Operation)),
+		                       Record.Seconds * 1000.0, *GetThreadName(Record.ThreadId),
+		                       Record.bSuccess ? TEXT("ok") : TEXT("failed"));
+	}
+
+	void PruneReports(const FString& Directory)
+	{
+		TArray<FString> Files;
+		IFileManager::Get().FindFiles(Files, *(Directory / TEXT("Hitch-*.txt")), true, false);
+		if (Files.Num() <= FDreamSMTCHitchDetector::MaxReports)
+		{
+			return;
+		}
+
+		// 文件名按时间排序
+		Files.Sort();
+		for (int32 Index = 0; Index < Files.Num() - FDreamSMTCHitchDetector::MaxReports; ++Index)
+		{
+			IFileManager::Get().Delete(*(Directory / Files[Index]));
+		}
+	}
+}
+
+FDreamSMTCHitchDetector& FDreamSMTCHitchDetector::Get()
+{
+	static FDreamSMTCHitchDetector Detector;
+	return Detector;
+}
+
+double FDreamSMTCHitchDetector::GetThresholdSeconds()
+{
+	return FMath::Max(CVarDreamSMTCHitchThresholdMs.GetValueOnAnyThread(), 0.0f) / 1000.0;
+}
+
+FString FDreamSMTCHitchDetector::GetReportDirectory()
+{
+	return FPaths::ProjectSavedDir() / TEXT("DreamSMTCHitches");
+}
+
+void FDreamSMTCHitchDetector::Record(const FDreamSMTCOperationRecord& Record, const TCHAR* BackendName)
+{
+	const uint64 Index = NextRecord.fetch_add(1, std::memory_order_relaxed);
+	Records[Index % MaxRecords].Write(Record);
+
+	const double Threshold = GetThresholdSeconds();
+	if (Threshold > 0.0 && Record.Seconds >= Threshold)
+	{
+		Capture(Record, BackendName);
+	}
+}
+
+void FDreamSMTCHitchDetector::GetRecentOperations(TArray<FDreamSMTCOperationRecord>& OutRecords) const
+{
+	OutRecords.Reset();
+	const uint64 End = NextRecord.load(std::memory_order_relaxed);
+	const uint64 Count = FMath::Min<uint64>(End, MaxRecords);
+	for (uint64 Position = End - Count; Position < End; ++Position)
+	{
+		Records[Position % MaxRecords].Read(OutRecords.AddDefaulted_GetRef());
+	}
+}
+
+void FDreamSMTCHitchDetector::Capture(const FDreamSMTCOperationRecord& Hitch, const TCHAR* BackendName)
+{
+	Hitches.fetch_add(1, std::memory_order_relaxed);
+
+	// 只有赢得时间戳的线程写报告
+	const double Now = FPlatformTime::Seconds();
+	double LastTime = LastReportTime.load(std::memory_order_relaxed);
+	if (Now - LastTime < MinReportInterval || !LastReportTime.compare_exchange_strong(LastTime, Now))
+	{
+		return;
+	}
+
+	// 卡顿线程上只复制原始数据，格式化与写文件在线程池进行
+	TArray<FDreamSMTCOperationRecord> Recent;
+	GetRecentOperations(Recent);
+	const FDreamSMTCQueueDepths Depths = QueueDepths.Read();
+	const int64 HitchCount = GetHitchCount();
+	const double Threshold = GetThresholdSeconds();
+
+	TFuture<void> Task = Async(EAsyncExecution::ThreadPool, [Hitch, BackendName, Recent = MoveTemp(Recent), Depths,
+		                           HitchCount, Threshold]()
+	{
+		TStringBuilder<8192> Report;
+		Report.Append(TEXT("DreamSMTC hitch report\n"));
+		Report.Appendf(TEXT("Time: %s UTC, build %s, engine %s\n"), *FDateTime::UtcNow().ToIso8601(),
+		               FApp::GetBuildVersion(), *FEngineVersion::Current().ToString());
+		Report.Appendf(TEXT("Backend: %s, threshold %.1f ms, %lld hitches so far\n\n"), BackendName,
+		               Threshold * 1000.0, HitchCount);
+
+		Report.Appendf(TEXT("Operation: %s\n"), *DescribeOperation(Hitch));
+		Report.Appendf(TEXT("Arguments: %s\n\n"), *DescribeArguments(Hitch));
+
+		// 队列深度在游戏线程的上一次 Tick 发布，空闲时可能较旧
+		if (Depths.Time > 0.0)
+		{
+			Report.Appendf(TEXT("Queues (%.3fs before the hitch):\n"), Hitch.StartTime - Depths.Time);
+			auto YesNo = [](bool bValue) { return bValue ? TEXT("yes") : TEXT("no"); };
+			Report.Appendf(TEXT("  pending writes: display %s, timeline %s, deferred timeline %s\n"),
+			               YesNo(EnumHasAnyFlags(Depths.PendingWrites, EDreamSMTCPendingWrite::Display)),
+			               YesNo(EnumHasAnyFlags(Depths.PendingWrites, EDreamSMTCPendingWrite::Timeline)),
+			               YesNo(Depths.bTimelineDeferred));
+			Report.Appendf(TEXT("  seek pending: %s, queued change sets: %d, staged switches: %d\n\n"),
+			               YesNo(Depths.bSeekPending), Depths.QueuedChangeSets, Depths.StagedSwitches);
+		}
+		else
+		{
+			Report.Append(TEXT("Queues: not published yet\n\n"));
+		}
+
+		Report.Appendf(TEXT("Last %d operations, oldest first:\n"), Recent.Num());
+		for (const FDreamSMTCOperationRecord& Record : Recent)
+		{
+			Report.Appendf(TEXT("  %+9.3fs  %s  %s\n"), Record.StartTime - Hitch.StartTime, *DescribeOperation(Record),
+			               *DescribeArguments(Record));
+		}
+
+		const FString Directory = FDreamSMTCHitchDetector::GetReportDirectory();
+		const FString FilePath = Directory / FString::Printf(TEXT("Hitch-%s.txt"),
+		                                                     *FDateTime::Now().ToString(TEXT("%Y%m%d-%H%M%S-%s")));
+		IFileManager::Get().MakeDirectory(*Directory, true);
+		if (!FFileHelper::SaveStringToFile(Report.ToString(), *FilePath))
+		{
+			DSMTC_LOG(Warning, TEXT("Backend hitch (%s), failed to write %s"), *DescribeOperation(Hitch), *FilePath);
+			return;
+		}
+		PruneReports(Directory);
+		DSMTC_LOG(Warning, TEXT("Backend hitch (%s), report written to %s"), *DescribeOperation(Hitch), *FilePath);
+	});
+
+	// 模块卸载前等待仍在写入的报告
+	FScopeLock Lock(&ReportLock);
+	ReportTasks.RemoveAll([](const TFuture<void>& Report) { return Report.IsReady(); });
+	ReportTasks.Add(MoveTemp(Task));
+}
+
+void FDreamSMTCHitchDetector::WaitForReports()
+{
+	TArray<TFuture<void>> Tasks;
+	{
+		FScopeLock Lock(&ReportLock);
+		Tasks = MoveTemp(ReportTasks);
+	}
+	for (TFuture<void>& Task : Tasks)
+	{
+		Task.Wait();
+	}
+}
+
+FDreamSMTCTimedBackend::FDreamSMTCTimedBackend(const TSharedRef<IDreamSMTCBackend, ESPMode::ThreadSafe>& InInner)
+	: Inner(InInner)
+{
+}
+
+bool FDreamSMTCTimedBackend::WriteSession(const FDreamSMTCSessionState& State, EDreamSMTCSessionField Fields,
+                                          uint32 ButtonMask, FString& OutError)
+{
+	return TimeOperation(GetName(), EDreamSMTCBackendOperation::WriteSession, static_cast<int64>(Fields), ButtonMask,
+	                     [&]() { return Inner->WriteSession(State, Fields, ButtonMask, OutError); });
+}
+
+bool FDreamSMTCTimedBackend::WriteTimeline(const FDreamSMTCTimelineProperties& Timeline, FString& OutError)
+{
+	return TimeOperation(GetName(), EDreamSMTCBackendOperation::WriteTimeline, Timeline.Position.GetTicks(),
+	                     Timeline.EndTime.GetTicks(), [&]() { return Inner->WriteTimeline(Timeline, OutError); });
+}
+
+bool FDreamSMTCTimedBackend::Update(FString& OutError)
+{
+	return TimeOperation(GetName(), EDreamSMTCBackendOperation::Update, 0, 0,
+	                     [&]() { return Inner->Update(OutError); });
+}
+
+bool FDreamSMTCTimedBackend::ClearAll(FString& OutError)
+{
+	return TimeOperation(GetName(), EDreamSMTCBackendOperation::ClearAll, 0, 0,
+	                     [&]() { return Inner->ClearAll(OutError); });
+}
+
+bool FDreamSMTCTimedBackend::SetThumbnailFromFile(const FString& FullPath, FString& OutError)
+{
+	return TimeOperation(GetName(), EDreamSMTCBackendOperation::SetThumbnail, 0, ThumbnailFromFile,
+	                     [&]() { return Inner->SetThumbnailFromFile(FullPath, OutError); });
+}
+
+TSharedPtr<FDreamSMTCPreparedThumbnail, ESPMode::ThreadSafe> FDreamSMTCTimedBackend::PrepareThumbnail(
+	const TArray64<uint8>& Encoded, FString& OutError)
+{
+	TSharedPtr<FDreamSMTCPreparedThumbnail, ESPMode::ThreadSafe> Prepared;
+	TimeOperation(GetName(), EDreamSMTCBackendOperation::PrepareThumbnail, Encoded.Num(), 0, [&]()
+	{
+		Prepared = Inner->PrepareThumbnail(Encoded, OutError);
+		return Prepared.IsValid();
+	});
+	return Prepared;
+}
+
+bool FDreamSMTCTimedBackend::SetPreparedThumbnail(const FDreamSMTCPreparedThumbnail& Prepared, FString& OutError)
+{
+	return TimeOperation(GetName(), EDreamSMTCBackendOperation::SetThumbnail, 0, ThumbnailPrepared,
+	                     [&]() { return Inner->SetPreparedThumbnail(Prepared, OutError); });
+}
+
+EDreamSMTCMediaSoundLevel FDreamSMTCTimedBackend::GetSoundLevel() const
+{
+	EDreamSMTCMediaSoundLevel SoundLevel = EDreamSMTCMediaSoundLevel::Full;
+	TimeOperation(GetName(), EDreamSMTCBackendOperation::GetSoundLevel, 0, 0, [&]()
+	{
+		SoundLevel = Inner->GetSoundLevel();
+		return true;
+	});
+	return SoundLevel;
+}
+
+uint64 FDreamSMTCTimedBackend::AddHandlers(FDreamSMTCBackendHandlers&& Handlers)
+{
+	uint64 HandlersId = 0;
+	TimeOperation(GetName(), EDreamSMTCBackendOperation::AddHandlers, 0, 0, [&]()
+	{
+		HandlersId = Inner->AddHandlers(MoveTemp(Handlers));
+		return HandlersId != 0;
+	});
+	return HandlersId;
+}
+
+void FDreamSMTCTimedBackend::RemoveHandlers(uint64 HandlersId)
+{
+	TimeOperation(GetName(), EDreamSMTCBackendOperation::RemoveHandlers, static_cast<int64>(HandlersId), 0, [&]()
+	{
+		Inner->RemoveHandlers(HandlersId);
+		return true;
+	});
+}
+
+bool FDreamSMTCTimedBackend::Release(FString& OutError)
+{
+	return TimeOperation(GetName(), EDreamSMTCBackendOperation::Release, 0, 0,
+	                     [&]() { return Inner->Release(OutError); });
+}
+
+static FAutoConsoleCommandWithOutputDevice GDreamSMTCHitchRecentCommand(
+	TEXT("DreamSMTC.Hitch.Recent"),
+	TEXT("Prints the backend operations kept for hitch reports, oldest first."),
+	FConsoleCommandWithOutputDeviceDelegate::CreateLambda([](FOutputDevice& Ar)
+	{
+		const FDreamSMTCHitchDetector& Detector = FDreamSMTCHitchDetector::Get();
+		TArray<FDreamSMTCOperationRecord> Recent;
+		Detector.GetRecentOperations(Recent);
+		Ar.Logf(TEXT("DreamSMTC backend operations: %d recent, %lld hitches over %.1f ms, reports in %s"), Recent.Num(),
+		        Detector.GetHitchCount(), FDreamSMTCHitchDetector::GetThresholdSeconds() * 1000.0,
+		        *FDreamSMTCHitchDetector::GetReportDirectory());
+
+		const double Now = FPlatformTime::Seconds();
+		for (const FDreamSMTCOperationRecord& Record : Recent)
+		{
+			Ar.Logf(TEXT("  -%.3fs  %s  %s"), Now - Record.StartTime, *DescribeOperation(Record),
+			        *DescribeArguments(Record));
+		}
+	}));
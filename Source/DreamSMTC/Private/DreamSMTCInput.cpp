@@ -0,0 +1,122 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCInput.h"
+
+#include "EnhancedInputSubsystems.h"
+#include "InputMappingContext.h"
+#include "Engine/GameInstance.h"
+#include "Engine/LocalPlayer.h"
+#include "GameFramework/PlayerController.h"
+
+#define LOCTEXT_NAMESPACE "DreamSMTCInput"
+
+static const FName DreamSMTCKeyCategory(TEXT("DreamSMTC"));
+
+void FDreamSMTCInput::RegisterKeys()
+{
+	EKeys::AddMenuCategoryDisplayInfo(DreamSMTCKeyCategory, LOCTEXT("MediaKeysCategory", "Media Transport Controls"),
+	                                  TEXT("GraphEditor.KeyEvent_16x"));
+
+	for (int32 Index = 0; Index < DreamSMTCButtonCount; ++Index)
+	{
+		const FKey& Key = GetKey(DreamSMTCButtons::Values[Index]);
+		if (!EKeys::GetKeyDetails(Key).IsValid())
+		{
+			EKeys::AddKey(FKeyDetails(Key, FText::Format(LOCTEXT("MediaKey", "Media {0}"),
+			                                             FText::FromString(DreamSMTCButtonNames[Index])),
+			                          FKeyDetails::NoFlags, DreamSMTCKeyCategory));
+		}
+	}
+}
+
+void FDreamSMTCInput::UnregisterKeys()
+{
+	EKeys::RemoveKeysWithCategory(DreamSMTCKeyCategory);
+}
+
+const FKey& FDreamSMTCInput::GetKey(EDreamSMTCButtonEvent Button)
+{
+#define DREAMSMTC_BUTTON_KEY(Name) FKey(TEXT("DreamSMTC_" #Name)),
+	static const FKey Keys[] = {DREAMSMTC_BUTTONS(DREAMSMTC_BUTTON_KEY)};
+#undef DREAMSMTC_BUTTON_KEY
+
+	return Keys[static_cast<uint8>(Button)];
+}
+
+void FDreamSMTCInput::Enqueue(EDreamSMTCButtonEvent Button)
+{
+	const int32 Index = static_cast<int32>(Button);
+	if (Index >= DreamSMTCButtonCount)
+	{
+		return;
+	}
+
+	// 长时间没有玩家控制器时不无限累积
+	std::atomic<uint32>& Presses = PendingPresses[Index];
+	uint32 Current = Presses.load(std::memory_order_relaxed);
+	while (Current < MaxQueuedPresses && !Presses.compare_exchange_weak(Current, Current + 1))
+	{
+	}
+}
+
+bool FDreamSMTCInput::HasPending() const
+{
+	for (const std::atomic<uint32>& Presses : PendingPresses)
+	{
+		if (Presses.load(std::memory_order_relaxed) != 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void FDreamSMTCInput::Dispatch(const UGameInstance* GameInstance, const UInputMappingContext* MappingContext,
+                               int32 Priority)
+{
+	if (!HasPending())
+	{
+		return;
+	}
+
+	// 没有玩家控制器时保留按键，等控制器创建后再注入
+	APlayerController* PlayerController = GameInstance ? GameInstance->GetFirstLocalPlayerController() : nullptr;
+	if (!PlayerController)
+	{
+		return;
+	}
+
+	// 控制器重生或重新创建输入子系统后再次添加
+	if (MappingContext)
+	{
+		UEnhancedInputLocalPlayerSubsystem* InputSubsystem =
+			ULocalPlayer::GetSubsystem<UEnhancedInputLocalPlayerSubsystem>(PlayerController->GetLocalPlayer());
+		if (InputSubsystem && !InputSubsystem->HasMappingContext(MappingContext))
+		{
+			FModifyContextOptions Options;
+			Options.bForceImmediately = true;
+			InputSubsystem->AddMappingContext(MappingContext, Priority, Options);
+		}
+	}
+
+	// 同一帧内按下并松开，映射到 Pressed 或 Triggered 的动作都会触发一次；同一按键在一帧内只注入一次，
+	// 否则输入系统会把它们合并
+	for (int32 Index = 0; Index < DreamSMTCButtonCount; ++Index)
+	{
+		std::atomic<uint32>& Presses = PendingPresses[Index];
+		uint32 Current = Presses.load(std::memory_order_relaxed);
+		while (Current > 0 && !Presses.compare_exchange_weak(Current, Current - 1))
+		{
+		}
+		if (Current == 0)
+		{
+			continue;
+		}
+
+		const FKey& Key = GetKey(static_cast<EDreamSMTCButtonEvent>(Index));
+		PlayerController->InputKey(FInputKeyParams(Key, IE_Pressed, 1.0, false));
+		PlayerController->InputKey(FInputKeyParams(Key, IE_Released, 0.0, false));
+	}
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,500 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCListeningHistory.h"
+
+#include "DreamSMTCButtons.h"
+#include "DreamSMTCLog.h"
+#include "DreamSMTCMemory.h"
+#include "DreamSMTCThumbnail.h"
+#include "HAL/Event.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/RunnableThread.h"
+
+namespace DreamSMTCHistory
+{
+	static constexpr int32 ChunkSize = 256;
+	static constexpr uint32 FlushIntervalMs = 5000;
+	static constexpr double SkipFraction = 0.9;
+
+	static const ANSICHAR* FileHeader = "time_ms,event,track,value,position_ms,duration_ms,label\n";
+
+	static const ANSICHAR* EventNames[] = {"start", "end", "status", "seek", "button"};
+	static const ANSICHAR* StatusNames[] = {"Closed", "Changing", "Stopped", "Playing", "Paused"};
+
+	/** Copies at most N - 1 characters without splitting a surrogate pair. */
+	template <int32 N>
+	static void CopyTruncated(TCHAR (&Out)[N], const FString& In)
+	{
+		int32 Length = FMath::Min(In.Len(), N - 1);
+		if (Length > 0 && Length < In.Len() && ((*In)[Length - 1] & 0xFC00) == 0xD800)
+		{
+			--Length;
+		}
+		FMemory::Memcpy(Out, *In, Length * sizeof(TCHAR));
+		Out[Length] = TEXT('\0');
+	}
+}
+
+FString FDreamSMTCHistoryRecord::GetLabel() const
+{
+	return Artist[0] == TEXT('\0') ? FString(Title) : FString::Printf(TEXT("%s - %s"), Artist, Title);
+}
+
+FDreamSMTCListeningHistory::FDreamSMTCListeningHistory(int32 InCapacity, int64 InMaxFileSize, int32 InMaxFiles,
+                                                       int32 InstanceIndex)
+	: Capacity(static_cast<int32>(FMath::RoundUpToPowerOfTwo(static_cast<uint32>(FMath::Max(InCapacity, 64)))))
+	, MaxFileSize(FMath::Max<int64>(InMaxFileSize, 4096))
+	, MaxFiles(FMath::Max(InMaxFiles, 0))
+	, ExportDirectory(GetExportDirectory(InstanceIndex))
+{
+	// 记录时不再分配内存
+	Ring = MakeUnique<std::atomic<uint64>[]>(static_cast<SIZE_T>(Capacity) * RecordWords);
+}
+
+FDreamSMTCListeningHistory::~FDreamSMTCListeningHistory()
+{
+	Shutdown();
+
+	if (WakeEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+		WakeEvent = nullptr;
+	}
+}
+
+bool FDreamSMTCListeningHistory::StartExport()
+{
+	if (Thread)
+	{
+		return true;
+	}
+
+	WriteChunk.SetNum(DreamSMTCHistory::ChunkSize);
+	WriteBuffer.Reserve(DreamSMTCHistory::ChunkSize * 128);
+
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, TEXT("DreamSMTCHistoryWriter"), 0, TPri_Lowest);
+	return Thread != nullptr;
+}
+
+void FDreamSMTCListeningHistory::Shutdown()
+{
+	if (Thread)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = nullptr;
+	}
+	File.Reset();
+}
+
+void FDreamSMTCListeningHistory::RecordTrackChange(const FDreamSMTCMusicDisplayProperties& Music,
+                                                   const FDreamSMTCTimelineProperties& PreviousTimeline)
+{
+	const uint32 TrackId = MakeTrackId(Music);
+	if (TrackId == CurrentTrack)
+	{
+		return;
+	}
+
+	if (CurrentTrack != 0)
+	{
+		FDreamSMTCHistoryRecord& Ended = BeginRecord(EDreamSMTCHistoryEvent::TrackEnded);
+		Ended.TrackId = CurrentTrack;
+		Ended.PositionMs = ToMilliseconds(PreviousTimeline.Position - PreviousTimeline.StartTime);
+		Ended.DurationMs = ToMilliseconds(PreviousTimeline.EndTime - PreviousTimeline.StartTime);
+		CommitRecord();
+	}
+
+	CurrentTrack = TrackId;
+	if (TrackId == 0)
+	{
+		return;
+	}
+
+	// 游戏线程只做定长拷贝，拼接与 UTF-8 转码留给写入线程
+	FDreamSMTCHistoryRecord& Started = BeginRecord(EDreamSMTCHistoryEvent::TrackStarted);
+	Started.TrackId = TrackId;
+	DreamSMTCHistory::CopyTruncated(Started.Artist, Music.Artist);
+	DreamSMTCHistory::CopyTruncated(Started.Title, Music.Title);
+	CommitRecord();
+}
+
+void FDreamSMTCListeningHistory::RecordSeek(const FDreamSMTCTimelineProperties& Timeline)
+{
+	FDreamSMTCHistoryRecord& Record = BeginRecord(EDreamSMTCHistoryEvent::Seek);
+	Record.TrackId = CurrentTrack;
+	Record.PositionMs = ToMilliseconds(Timeline.Position - Timeline.StartTime);
+	Record.DurationMs = ToMilliseconds(Timeline.EndTime - Timeline.StartTime);
+	CommitRecord();
+}
+
+void FDreamSMTCListeningHistory::RecordPlaybackStatus(EDreamSMTCMediaPlaybackStatus Status,
+                                                      const FDreamSMTCTimelineProperties& Timeline)
+{
+	if (Status == LastStatus)
+	{
+		return;
+	}
+	LastStatus = Status;
+
+	FDreamSMTCHistoryRecord& Record = BeginRecord(EDreamSMTCHistoryEvent::PlaybackStatus);
+	Record.TrackId = CurrentTrack;
+	Record.Value = static_cast<uint8>(Status);
+	Record.PositionMs = ToMilliseconds(Timeline.Position - Timeline.StartTime);
+	Record.DurationMs = ToMilliseconds(Timeline.EndTime - Timeline.StartTime);
+	CommitRecord();
+}
+
+void FDreamSMTCListeningHistory::RecordButton(EDreamSMTCButtonEvent Button)
+{
+	FDreamSMTCHistoryRecord& Record = BeginRecord(EDreamSMTCHistoryEvent::Button);
+	Record.TrackId = CurrentTrack;
+	Record.Value = static_cast<uint8>(Button);
+	CommitRecord();
+}
+
+FDreamSMTCHistoryRecord& FDreamSMTCListeningHistory::BeginRecord(EDreamSMTCHistoryEvent Event)
+{
+	Staged = FDreamSMTCHistoryRecord();
+	Staged.UtcTicks = FDateTime::UtcNow().GetTicks();
+	Staged.Event = Event;
+	return Staged;
+}
+
+void FDreamSMTCListeningHistory::CommitRecord()
+{
+	const uint64 Index = Head.load(std::memory_order_relaxed);
+	StoreRecord(Index, Staged);
+
+	const uint64 NewHead = Index + 1;
+	Head.store(NewHead, std::memory_order_release);
+
+	// 从空闲中唤醒写入线程，或积压到四分之一时提前写入
+	const uint64 Pending = NewHead - WriterCursor.load(std::memory_order_relaxed);
+	if (WakeEvent && (Pending == 1 || Pending == static_cast<uint64>(Capacity / 4)))
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+FDreamSMTCListeningSummary FDreamSMTCListeningHistory::Summarize(FTimespan Window) const
+{
+	FDreamSMTCListeningSummary Summary;
+	Summary.ButtonPresses.SetNumZeroed(DreamSMTCButtonCount);
+
+	const int64 NowTicks = FDateTime::UtcNow().GetTicks();
+	const int64 FromTicks = NowTicks - Window.GetTicks();
+	const uint64 End = Head.load(std::memory_order_relaxed);
+	const uint64 Begin = End > static_cast<uint64>(Capacity) ? End - Capacity : 0;
+
+	Summary.From = FDateTime(FromTicks);
+	if (Begin > 0)
+	{
+		FDreamSMTCHistoryRecord Oldest;
+		LoadRecord(Begin, Oldest);
+		Summary.From = FDateTime(FMath::Max(FromTicks, Oldest.UtcTicks));
+	}
+
+	TMap<uint32, int32> TrackIndices;
+	auto Stats = [&Summary, &TrackIndices](uint32 TrackId) -> FDreamSMTCTrackListeningStats&
+	{
+		const int32* Index = TrackIndices.Find(TrackId);
+		return Index ? Summary.Tracks[*Index] : Summary.Tracks[TrackIndices.Add(TrackId, Summary.Tracks.AddDefaulted())];
+	};
+
+	// 按记录重放播放状态，只统计落在窗口内的播放时长
+	uint32 Track = 0;
+	bool bPlaying = false;
+	int64 PlayStart = 0;
+	auto ClosePlay = [&](int64 Ticks)
+	{
+		const int64 Start = FMath::Max(PlayStart, FromTicks);
+		if (bPlaying && Track != 0 && Ticks > Start)
+		{
+			Stats(Track).PlaySeconds += static_cast<float>(static_cast<double>(Ticks - Start) / ETimespan::TicksPerSecond);
+		}
+		PlayStart = Ticks;
+	};
+
+	// 游戏线程是唯一的写者，直接读取
+	FDreamSMTCHistoryRecord Record;
+	for (uint64 Index = Begin; Index < End; ++Index)
+	{
+		LoadRecord(Index, Record);
+		const bool bInWindow = Record.UtcTicks >= FromTicks;
+		switch (Record.Event)
+		{
+		case EDreamSMTCHistoryEvent::TrackStarted:
+			ClosePlay(Record.UtcTicks);
+			Track = Record.TrackId;
+			if (bInWindow)
+			{
+				FDreamSMTCTrackListeningStats& TrackStats = Stats(Track);
+				TrackStats.Label = Record.GetLabel();
+				++TrackStats.Plays;
+			}
+			break;
+		case EDreamSMTCHistoryEvent::TrackEnded:
+			ClosePlay(Record.UtcTicks);
+			if (bInWindow && Record.DurationMs > 0 &&
+				Record.PositionMs < Record.DurationMs * DreamSMTCHistory::SkipFraction)
+			{
+				++Stats(Record.TrackId).Skips;
+			}
+			Track = 0;
+			break;
+		case EDreamSMTCHistoryEvent::PlaybackStatus:
+			ClosePlay(Record.UtcTicks);
+			bPlaying = Record.Value == static_cast<uint8>(EDreamSMTCMediaPlaybackStatus::Playing);
+			break;
+		case EDreamSMTCHistoryEvent::Button:
+			if (bInWindow && Record.Value < DreamSMTCButtonCount)
+			{
+				++Summary.ButtonPresses[Record.Value];
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	ClosePlay(NowTicks);
+
+	for (const FDreamSMTCTrackListeningStats& TrackStats : Summary.Tracks)
+	{
+		Summary.TotalPlaySeconds += TrackStats.PlaySeconds;
+		Summary.Plays += TrackStats.Plays;
+		Summary.Skips += TrackStats.Skips;
+	}
+	Summary.SkipRate = Summary.Plays > 0 ? static_cast<float>(Summary.Skips) / Summary.Plays : 0.0f;
+	Summary.Tracks.Sort([](const FDreamSMTCTrackListeningStats& A, const FDreamSMTCTrackListeningStats& B)
+	{
+		return A.PlaySeconds > B.PlaySeconds;
+	});
+	return Summary;
+}
+
+FString FDreamSMTCListeningHistory::GetExportDirectory(int32 InstanceIndex)
+{
+	return InstanceIndex > 0
+		       ? FDreamSMTCThumbnail::GetCacheDirectory() / FString::Printf(TEXT("History.%d"), InstanceIndex)
+		       : FDreamSMTCThumbnail::GetCacheDirectory() / TEXT("History");
+}
+
+FString FDreamSMTCListeningHistory::GetFilePath(int32 Index) const
+{
+	return Index == 0
+		       ? ExportDirectory / TEXT("ListeningHistory.csv")
+		       : ExportDirectory / FString::Printf(TEXT("ListeningHistory.%d.csv"), Index);
+}
+
+uint32 FDreamSMTCListeningHistory::Run()
+{
+	DSMTC_LLM_SCOPE();
+	while (!bStopping)
+	{
+		// 没有新记录时一直等待；有少量记录时攒一段时间再写
+		const uint64 Pending = Head.load(std::memory_order_acquire) - WriterCursor.load(std::memory_order_relaxed);
+		if (Pending == 0)
+		{
+			WakeEvent->Wait();
+		}
+		else if (Pending < static_cast<uint64>(Capacity / 4))
+		{
+			WakeEvent->Wait(DreamSMTCHistory::FlushIntervalMs);
+		}
+		WritePending();
+	}
+
+	WritePending();
+	return 0;
+}
+
+void FDreamSMTCListeningHistory::Stop()
+{
+	bStopping = true;
+	if (WakeEvent)
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+void FDreamSMTCListeningHistory::LoadRecord(uint64 Index, FDreamSMTCHistoryRecord& OutRecord) const
+{
+	const std::atomic<uint64>* Slot = &Ring[(Index & (Capacity - 1)) * RecordWords];
+	uint64 Copy[RecordWords];
+	for (int32 Word = 0; Word < RecordWords; ++Word)
+	{
+		Copy[Word] = Slot[Word].load(std::memory_order_relaxed);
+	}
+	FMemory::Memcpy(&OutRecord, Copy, sizeof(FDreamSMTCHistoryRecord));
+}
+
+void FDreamSMTCListeningHistory::StoreRecord(uint64 Index, const FDreamSMTCHistoryRecord& Record)
+{
+	uint64 Copy[RecordWords] = {};
+	FMemory::Memcpy(Copy, &Record, sizeof(FDreamSMTCHistoryRecord));
+
+	// Head 已等于 Index，写入线程看到新数据时也一定看到覆盖了旧记录的 Head
+	std::atomic_thread_fence(std::memory_order_release);
+	std::atomic<uint64>* Slot = &Ring[(Index & (Capacity - 1)) * RecordWords];
+	for (int32 Word = 0; Word < RecordWords; ++Word)
+	{
+		Slot[Word].store(Copy[Word], std::memory_order_relaxed);
+	}
+}
+
+void FDreamSMTCListeningHistory::WritePending()
+{
+	uint64 Cursor = WriterCursor.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		const uint64 Available = Head.load(std::memory_order_acquire);
+		if (Available == Cursor)
+		{
+			break;
+		}
+		if (Available - Cursor > static_cast<uint64>(Capacity))
+		{
+			DroppedRecords += static_cast<int64>(Available - Capacity - Cursor);
+			Cursor = Available - Capacity;
+		}
+
+		const int32 Count = static_cast<int32>(FMath::Min<uint64>(Available - Cursor, WriteChunk.Num()));
+		for (int32 Index = 0; Index < Count; ++Index)
+		{
+			LoadRecord(Cursor + Index, WriteChunk[Index]);
+		}
+
+		// 复制期间被游戏线程覆盖（或正在覆盖）的槽位作废；栅栏保证复制先于再次读取 Head
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const uint64 After = Head.load(std::memory_order_relaxed);
+		const uint64 FirstValid = After >= static_cast<uint64>(Capacity) ? After - Capacity + 1 : 0;
+		const int32 Skip = FirstValid > Cursor ? static_cast<int32>(FMath::Min<uint64>(FirstValid - Cursor, Count)) : 0;
+		DroppedRecords += Skip;
+
+		WriteBuffer.Reset();
+		for (int32 Index = Skip; Index < Count; ++Index)
+		{
+			const FDreamSMTCHistoryRecord& Record = WriteChunk[Index];
+			const int64 UnixMs = (Record.UtcTicks - FDateTime(1970, 1, 1).GetTicks()) / ETimespan::TicksPerMillisecond;
+
+			const ANSICHAR* Value = "";
+			if (Record.Event == EDreamSMTCHistoryEvent::PlaybackStatus && Record.Value < UE_ARRAY_COUNT(DreamSMTCHistory::StatusNames))
+			{
+				Value = DreamSMTCHistory::StatusNames[Record.Value];
+			}
+
+			ANSICHAR Line[128];
+			int32 Length = 0;
+			if (Record.Event == EDreamSMTCHistoryEvent::Button && Record.Value < DreamSMTCButtonCount)
+			{
+				Length = FCStringAnsi::Snprintf(Line, UE_ARRAY_COUNT(Line), "%lld,%s,%08x,%s,%lld,%lld,", UnixMs,
+				                                DreamSMTCHistory::EventNames[static_cast<uint8>(Record.Event)],
+				                                Record.TrackId, TCHAR_TO_ANSI(DreamSMTCButtonNames[Record.Value]),
+				                                Record.PositionMs, Record.DurationMs);
+			}
+			else
+			{
+				Length = FCStringAnsi::Snprintf(Line, UE_ARRAY_COUNT(Line), "%lld,%s,%08x,%s,%lld,%lld,", UnixMs,
+				                                DreamSMTCHistory::EventNames[static_cast<uint8>(Record.Event)],
+				                                Record.TrackId, Value, Record.PositionMs, Record.DurationMs);
+			}
+			WriteBuffer.Append(Line, FMath::Clamp(Length, 0, static_cast<int32>(UE_ARRAY_COUNT(Line)) - 1));
+
+			// 标题按 CSV 规则加引号，内部引号重复一次
+			if (Record.Event == EDreamSMTCHistoryEvent::TrackStarted)
+			{
+				const FTCHARToUTF8 Label(*Record.GetLabel());
+				WriteBuffer.Add('"');
+				for (const ANSICHAR* Char = Label.Get(); *Char; ++Char)
+				{
+					if (*Char == '"')
+					{
+						WriteBuffer.Add('"');
+					}
+					WriteBuffer.Add(*Char);
+				}
+				WriteBuffer.Add('"');
+			}
+			WriteBuffer.Add('\n');
+		}
+
+		if (WriteBuffer.Num() > 0 && RotateIfNeeded(WriteBuffer.Num()))
+		{
+			File->Write(reinterpret_cast<const uint8*>(WriteBuffer.GetData()), WriteBuffer.Num());
+		}
+
+		Cursor += Count;
+		WriterCursor.store(Cursor, std::memory_order_release);
+	}
+
+	if (File)
+	{
+		File->Flush();
+	}
+}
+
+bool FDreamSMTCListeningHistory::RotateIfNeeded(int64 IncomingBytes)
+{
+	if (!File && !OpenFile())
+	{
+		return false;
+	}
+
+	const int64 Size = File->Tell();
+	if (Size == 0 || Size + IncomingBytes <= MaxFileSize)
+	{
+		return true;
+	}
+
+	// ListeningHistory.csv -> .1.csv -> .2.csv ...，超出 MaxFiles 的删除
+	File.Reset();
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.DeleteFile(*GetFilePath(MaxFiles));
+	for (int32 Index = MaxFiles - 1; Index >= 0; --Index)
+	{
+		const FString From = GetFilePath(Index);
+		if (PlatformFile.FileExists(*From))
+		{
+			PlatformFile.MoveFile(*GetFilePath(Index + 1), *From);
+		}
+	}
+	PlatformFile.DeleteFile(*GetFilePath(0));
+
+	return OpenFile();
+}
+
+bool FDreamSMTCListeningHistory::OpenFile()
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*ExportDirectory);
+
+	const FString Path = GetFilePath(0);
+	File.Reset(PlatformFile.OpenWrite(*Path, true, false));
+	if (!File)
+	{
+		DSMTC_LOG(Warning, TEXT("Could not open listening history %s"), *Path);
+		return false;
+	}
+
+	if (File->Size() == 0)
+	{
+		File->Write(reinterpret_cast<const uint8*>(DreamSMTCHistory::FileHeader),
+		            FCStringAnsi::Strlen(DreamSMTCHistory::FileHeader));
+	}
+	return true;
+}
+
+uint32 FDreamSMTCListeningHistory::MakeTrackId(const FDreamSMTCMusicDisplayProperties& Music)
+{
+	if (Music.Title.IsEmpty() && Music.Artist.IsEmpty())
+	{
+		return 0;
+	}
+
+	// 0 保留为“没有曲目”
+	const uint32 TrackId = HashCombine(GetTypeHash(Music.Artist), GetTypeHash(Music.Title));
+	return TrackId != 0 ? TrackId : 1;
+}
@@ -0,0 +1,142 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCMemory.h"
+
+#include "DreamSMTCLog.h"
+#include "DreamSMTCSettings.h"
+#include "DreamSMTCSessionManager.h"
+#include "DreamSMTCSubsystem.h"
+#include "DreamSMTCThumbnail.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+
+LLM_DEFINE_TAG(DreamSMTC);
+
+FDreamSMTCMemoryTracker& FDreamSMTCMemoryTracker::Get()
+{
+	static FDreamSMTCMemoryTracker Tracker;
+	return Tracker;
+}
+
+void FDreamSMTCMemoryTracker::Tick(double Now)
+{
+	// 多个实例在同一帧调用时只采样一次
+	if (Now - LastSampleTime < SampleInterval)
+	{
+		return;
+	}
+	LastSampleTime = Now;
+	Sample(false);
+}
+
+FDreamSMTCMemoryUsage FDreamSMTCMemoryTracker::Sample(bool bMeasureCaches)
+{
+	FDreamSMTCMemoryUsage Usage;
+	FDreamSMTCSessionManager::Get().ForEachSession([&Usage](UDreamSMTCSubsystem& Subsystem)
+	{
+		Subsystem.GetMemoryUsage(Usage);
+	});
+
+	if (bMeasureCaches)
+	{
+		int64& CacheBytes = Usage[EDreamSMTCMemoryCategory::Caches];
+		IFileManager::Get().IterateDirectoryStatRecursively(*FDreamSMTCThumbnail::GetCacheDirectory(),
+			[&CacheBytes](const TCHAR*, const FFileStatData& StatData)
+			{
+				if (!StatData.bIsDirectory)
+				{
+					CacheBytes += StatData.FileSize;
+				}
+				return true;
+			});
+	}
+
+	Record(Usage, bMeasureCaches);
+	return Usage;
+}
+
+void FDreamSMTCMemoryTracker::Record(const FDreamSMTCMemoryUsage& Usage, bool bCachesMeasured)
+{
+	for (int32 Index = 0; Index < static_cast<int32>(EDreamSMTCMemoryCategory::Num); ++Index)
+	{
+		const EDreamSMTCMemoryCategory Category = static_cast<EDreamSMTCMemoryCategory>(Index);
+		if (Category == EDreamSMTCMemoryCategory::Caches && !bCachesMeasured)
+		{
+			continue;
+		}
+
+		const int64 Bytes = Usage[Category];
+		Last[Category] = Bytes;
+		HighWater[Category] = FMath::Max(HighWater[Category], Bytes);
+
+		// 超出时只警告一次，回落到预算以内后再次超出时重新警告
+		const int64 Budget = GetBudget(Category);
+		const bool bOver = Budget > 0 && Bytes > Budget;
+		if (bOver && !bOverBudget[Index])
+		{
+			DSMTC_LOG(Warning, TEXT("%s memory is over budget: %.1f KB of %.1f KB"), GetCategoryName(Category),
+			          Bytes / 1024.0, Budget / 1024.0);
+		}
+		bOverBudget[Index] = bOver;
+	}
+}
+
+void FDreamSMTCMemoryTracker::Report(FOutputDevice& Ar)
+{
+	const FDreamSMTCMemoryUsage Usage = Sample(true);
+
+	Ar.Logf(TEXT("DreamSMTC memory: %d session(s), allocations tagged \"DreamSMTC\" in LLM"),
+	        FDreamSMTCSessionManager::Get().Num());
+	Ar.Logf(TEXT("  %-12s %12s %12s %12s"), TEXT("Category"), TEXT("Current"), TEXT("High-water"), TEXT("Budget"));
+
+	int64 Total = 0;
+	for (int32 Index = 0; Index < static_cast<int32>(EDreamSMTCMemoryCategory::Num); ++Index)
+	{
+		const EDreamSMTCMemoryCategory Category = static_cast<EDreamSMTCMemoryCategory>(Index);
+		const int64 Budget = GetBudget(Category);
+		Ar.Logf(TEXT("  %-12s %9.1f KB %9.1f KB %12s%s"), GetCategoryName(Category), Usage[Category] / 1024.0,
+		        HighWater[Category] / 1024.0,
+		        Budget > 0 ? *FString::Printf(TEXT("%.1f KB"), Budget / 1024.0) : TEXT("-"),
+		        bOverBudget[Index] ? TEXT("  OVER BUDGET") : TEXT(""));
+
+		// 磁盘缓存不计入内存合计
+		if (Category != EDreamSMTCMemoryCategory::Caches)
+		{
+			Total += Usage[Category];
+		}
+	}
+	Ar.Logf(TEXT("  %-12s %9.1f KB"), TEXT("Memory"), Total / 1024.0);
+}
+
+int64 FDreamSMTCMemoryTracker::GetBudget(EDreamSMTCMemoryCategory Category)
+{
+	const UDreamSMTCSettings* Settings = UDreamSMTCSettings::Get();
+	switch (Category)
+	{
+	case EDreamSMTCMemoryCategory::Thumbnails: return Settings->ThumbnailMemoryBudget * 1024ll;
+	case EDreamSMTCMemoryCategory::Metadata: return Settings->MetadataMemoryBudget * 1024ll;
+	case EDreamSMTCMemoryCategory::Queues: return Settings->QueueMemoryBudget * 1024ll;
+	case EDreamSMTCMemoryCategory::Caches: return Settings->CacheDiskBudget * 1024ll;
+	default: return 0;
+	}
+}
+
+const TCHAR* FDreamSMTCMemoryTracker::GetCategoryName(EDreamSMTCMemoryCategory Category)
+{
+	switch (Category)
+	{
+	case EDreamSMTCMemoryCategory::Thumbnails: return TEXT("Thumbnails");
+	case EDreamSMTCMemoryCategory::Metadata: return TEXT("Metadata");
+	case EDreamSMTCMemoryCategory::Queues: return TEXT("Queues");
+	case EDreamSMTCMemoryCategory::Caches: return TEXT("Caches");
+	default: return TEXT("Unknown");
+	}
+}
+
+static FAutoConsoleCommandWithOutputDevice GDreamSMTCMemReportCommand(
+	TEXT("DreamSMTC.MemReport"),
+	TEXT("Prints DreamSMTC memory by category (thumbnails, metadata, queues, disk caches) with high-water marks and budgets."),
+	FConsoleCommandWithOutputDeviceDelegate::CreateLambda([](FOutputDevice& Ar)
+	{
+		FDreamSMTCMemoryTracker::Get().Report(Ar);
+	}));
@@ -2,17 +2,31 @@
 
 #include "DreamSMTCModule.h"
 
+#include "DreamSMTCDebugStats.h"
+#include "DreamSMTCHitchDetector.h"
+#include "DreamSMTCInput.h"
+#include "DreamSMTCSubsystem.h"
+
 #define LOCTEXT_NAMESPACE "FDreamSMTCModule"
 
 void FDreamSMTCModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+	FDreamSMTCInput::RegisterKeys();
+	FDreamSMTCDebugStats::Get().Start();
 }
 
 void FDreamSMTCModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+
+	// 反初始化时超时的关闭任务仍在使用模块代码，卸载前等待完成
+	UDreamSMTCSubsystem::WaitForDetachedShutdownWork();
+	FDreamSMTCHitchDetector::Get().WaitForReports();
+
+	FDreamSMTCDebugStats::Get().Stop();
+	FDreamSMTCInput::UnregisterKeys();
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -0,0 +1,594 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCPlaylistReader.h"
+
+#include "DreamSMTCLog.h"
+#include "DreamSMTCThumbnail.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "String/Find.h"
+
+namespace DreamSMTCPlaylist
+{
+	static bool ParseInt(FAnsiStringView Text, int64& OutValue)
+	{
+		Text = Text.TrimStartAndEnd();
+		bool bNegative = false;
+		if (Text.StartsWith('-') || Text.StartsWith('+'))
+		{
+			bNegative = Text[0] == '-';
+			Text.RightChopInline(1);
+		}
+
+		int64 Value = 0;
+		int32 Digits = 0;
+		for (const ANSICHAR Char : Text)
+		{
+			if (Char < '0' || Char > '9')
+			{
+				break;
+			}
+			Value = Value * 10 + (Char - '0');
+			++Digits;
+		}
+		OutValue = bNegative ? -Value : Value;
+		return Digits > 0;
+	}
+
+	static FTimespan SecondsToTimespan(FAnsiStringView Text)
+	{
+		int64 Seconds = 0;
+		return ParseInt(Text, Seconds) && Seconds > 0 ? FTimespan::FromSeconds(Seconds) : FTimespan::Zero();
+	}
+
+	static FString PercentDecode(const FString& Text)
+	{
+		FTCHARToUTF8 Utf8(*Text);
+		TArray<ANSICHAR> Decoded;
+		Decoded.Reserve(Utf8.Length() + 1);
+		for (int32 Index = 0; Index < Utf8.Length(); ++Index)
+		{
+			const ANSICHAR Char = Utf8.Get()[Index];
+			if (Char == '%' && Index + 2 < Utf8.Length() && FChar::IsHexDigit(Utf8.Get()[Index + 1]) &&
+				FChar::IsHexDigit(Utf8.Get()[Index + 2]))
+			{
+				Decoded.Add(static_cast<ANSICHAR>(FParse::HexDigit(Utf8.Get()[Index + 1]) * 16 +
+					FParse::HexDigit(Utf8.Get()[Index + 2])));
+				Index += 2;
+			}
+			else
+			{
+				Decoded.Add(Char);
+			}
+		}
+		const FUTF8ToTCHAR Converted(Decoded.GetData(), Decoded.Num());
+		return FString(Converted.Length(), Converted.Get());
+	}
+
+	static bool HasKeyPrefix(FAnsiStringView Key, FAnsiStringView Prefix, int64& OutIndex)
+	{
+		return Key.StartsWith(Prefix, ESearchCase::IgnoreCase) && ParseInt(Key.RightChop(Prefix.Len()), OutIndex);
+	}
+}
+
+FDreamSMTCPlaylistReader::FDreamSMTCPlaylistReader() = default;
+
+FDreamSMTCPlaylistReader::~FDreamSMTCPlaylistReader() = default;
+
+bool FDreamSMTCPlaylistReader::Open(const FString& Path)
+{
+	Close();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	MappedFile.Reset(PlatformFile.OpenMapped(*Path));
+	MappedRegion.Reset(MappedFile.IsValid() ? MappedFile->MapRegion() : nullptr);
+	if (MappedRegion.IsValid())
+	{
+		Data = reinterpret_cast<const ANSICHAR*>(MappedRegion->GetMappedPtr());
+		Size = MappedRegion->GetMappedSize();
+	}
+	else if (FFileHelper::LoadFileToArray(FallbackData, *Path, FILEREAD_Silent))
+	{
+		Data = reinterpret_cast<const ANSICHAR*>(FallbackData.GetData());
+		Size = FallbackData.Num();
+	}
+	else
+	{
+		DSMTC_LOG(Warning, TEXT("Could not open playlist %s"), *Path);
+		return false;
+	}
+
+	// 跳过 UTF-8 BOM
+	if (Size >= 3 && static_cast<uint8>(Data[0]) == 0xEF && static_cast<uint8>(Data[1]) == 0xBB &&
+		static_cast<uint8>(Data[2]) == 0xBF)
+	{
+		Cursor = 3;
+	}
+
+	BaseDirectory = FPaths::GetPath(FPaths::ConvertRelativePathToFull(Path));
+	Format = DetectFormat(Path, FAnsiStringView(Data + Cursor, static_cast<int32>(FMath::Min<int64>(Size - Cursor, 512))));
+	if (Format == EDreamSMTCPlaylistFormat::Unknown)
+	{
+		DSMTC_LOG(Warning, TEXT("Unrecognized playlist format: %s"), *Path);
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void FDreamSMTCPlaylistReader::Close()
+{
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	FallbackData.Empty();
+	Data = nullptr;
+	Size = 0;
+	Cursor = 0;
+	Format = EDreamSMTCPlaylistFormat::Unknown;
+	EntriesRead = 0;
+}
+
+bool FDreamSMTCPlaylistReader::Next(FDreamSMTCPlaylistEntry& OutEntry)
+{
+	OutEntry = FDreamSMTCPlaylistEntry();
+
+	bool bRead = false;
+	switch (Format)
+	{
+	case EDreamSMTCPlaylistFormat::M3U: bRead = NextM3U(OutEntry);
+		break;
+	case EDreamSMTCPlaylistFormat::PLS: bRead = NextPLS(OutEntry);
+		break;
+	case EDreamSMTCPlaylistFormat::XSPF: bRead = NextXSPF(OutEntry);
+		break;
+	default:
+		break;
+	}
+
+	EntriesRead += bRead ? 1 : 0;
+	return bRead;
+}
+
+EDreamSMTCPlaylistFormat FDreamSMTCPlaylistReader::DetectFormat(const FString& Path, FAnsiStringView Head)
+{
+	const FString Extension = FPaths::GetExtension(Path);
+	if (Extension.Equals(TEXT("m3u"), ESearchCase::IgnoreCase) || Extension.Equals(TEXT("m3u8"), ESearchCase::IgnoreCase))
+	{
+		return EDreamSMTCPlaylistFormat::M3U;
+	}
+	if (Extension.Equals(TEXT("pls"), ESearchCase::IgnoreCase))
+	{
+		return EDreamSMTCPlaylistFormat::PLS;
+	}
+	if (Extension.Equals(TEXT("xspf"), ESearchCase::IgnoreCase))
+	{
+		return EDreamSMTCPlaylistFormat::XSPF;
+	}
+
+	Head = Head.TrimStart();
+	if (Head.StartsWith("#EXTM3U", ESearchCase::IgnoreCase))
+	{
+		return EDreamSMTCPlaylistFormat::M3U;
+	}
+	if (Head.StartsWith("[playlist]", ESearchCase::IgnoreCase))
+	{
+		return EDreamSMTCPlaylistFormat::PLS;
+	}
+	if (UE::String::FindFirst(Head, "<playlist", ESearchCase::IgnoreCase) != INDEX_NONE)
+	{
+		return EDreamSMTCPlaylistFormat::XSPF;
+	}
+	return EDreamSMTCPlaylistFormat::Unknown;
+}
+
+bool FDreamSMTCPlaylistReader::NextM3U(FDreamSMTCPlaylistEntry& OutEntry)
+{
+	FAnsiStringView Line;
+	while (ReadLine(Line))
+	{
+		if (Line.IsEmpty())
+		{
+			continue;
+		}
+
+		if (Line.StartsWith("#EXTINF:", ESearchCase::IgnoreCase))
+		{
+			// #EXTINF:<seconds>[ attributes],<Artist - Title>
+			const FAnsiStringView Info = Line.RightChop(8);
+			int32 Comma = INDEX_NONE;
+			bool bInQuotes = false;
+			for (int32 Index = 0; Index < Info.Len(); ++Index)
+			{
+				if (Info[Index] == '"')
+				{
+					bInQuotes = !bInQuotes;
+				}
+				else if (Info[Index] == ',' && !bInQuotes)
+				{
+					Comma = Index;
+					break;
+				}
+			}
+
+			OutEntry.Duration = DreamSMTCPlaylist::SecondsToTimespan(Comma != INDEX_NONE ? Info.Left(Comma) : Info);
+			if (Comma != INDEX_NONE)
+			{
+				const FAnsiStringView Display = Info.RightChop(Comma + 1).TrimStartAndEnd();
+				const int32 Separator = UE::String::FindFirst(Display, " - ");
+				if (Separator != INDEX_NONE)
+				{
+					OutEntry.Artist = ToString(Display.Left(Separator).TrimEnd());
+					OutEntry.Title = ToString(Display.RightChop(Separator + 3).TrimStart());
+				}
+				else
+				{
+					OutEntry.Title = ToString(Display);
+				}
+			}
+			continue;
+		}
+
+		if (Line[0] == '#')
+		{
+			continue;
+		}
+
+		OutEntry.Location = ResolveLocation(Line);
+		return true;
+	}
+	return false;
+}
+
+bool FDreamSMTCPlaylistReader::NextPLS(FDreamSMTCPlaylistEntry& OutEntry)
+{
+	// FileN / TitleN / LengthN 按序号分组，读到下一个序号时回退到该行
+	int64 CurrentIndex = INDEX_NONE;
+	for (;;)
+	{
+		const int64 LineStart = Cursor;
+		FAnsiStringView Line;
+		if (!ReadLine(Line))
+		{
+			return !OutEntry.Location.IsEmpty();
+		}
+
+		const int32 Equals = UE::String::FindFirstChar(Line, '=');
+		if (Equals == INDEX_NONE)
+		{
+			continue;
+		}
+
+		const FAnsiStringView Key = Line.Left(Equals).TrimEnd();
+		const FAnsiStringView Value = Line.RightChop(Equals + 1).TrimStart();
+
+		int64 Index = INDEX_NONE;
+		FString* Target = nullptr;
+		bool bLength = false;
+		if (DreamSMTCPlaylist::HasKeyPrefix(Key, "File", Index))
+		{
+			Target = &OutEntry.Location;
+		}
+		else if (DreamSMTCPlaylist::HasKeyPrefix(Key, "Title", Index))
+		{
+			Target = &OutEntry.Title;
+		}
+		else if (DreamSMTCPlaylist::HasKeyPrefix(Key, "Length", Index))
+		{
+			bLength = true;
+		}
+		else
+		{
+			continue;
+		}
+
+		if (CurrentIndex != INDEX_NONE && Index != CurrentIndex)
+		{
+			if (!OutEntry.Location.IsEmpty())
+			{
+				Cursor = LineStart;
+				return true;
+			}
+			OutEntry = FDreamSMTCPlaylistEntry();
+		}
+		CurrentIndex = Index;
+
+		if (bLength)
+		{
+			OutEntry.Duration = DreamSMTCPlaylist::SecondsToTimespan(Value);
+		}
+		else if (Target == &OutEntry.Location)
+		{
+			OutEntry.Location = ResolveLocation(Value);
+		}
+		else
+		{
+			*Target = ToString(Value);
+		}
+	}
+}
+
+bool FDreamSMTCPlaylistReader::NextXSPF(FDreamSMTCPlaylistEntry& OutEntry)
+{
+	for (;;)
+	{
+		const FAnsiStringView Remaining(Data + Cursor, static_cast<int32>(FMath::Min<int64>(Size - Cursor, MAX_int32)));
+		const int32 TrackStart = UE::String::FindFirst(Remaining, "<track", ESearchCase::IgnoreCase);
+		if (TrackStart == INDEX_NONE)
+		{
+			Cursor = Size;
+			return false;
+		}
+
+		// 排除 <trackList>
+		const int32 AfterName = TrackStart + 6;
+		if (AfterName >= Remaining.Len() || (Remaining[AfterName] != '>' && !FCharAnsi::IsWhitespace(Remaining[AfterName])))
+		{
+			Cursor += AfterName;
+			continue;
+		}
+
+		const int32 TrackEnd = UE::String::FindFirst(Remaining.RightChop(AfterName), "</track>", ESearchCase::IgnoreCase);
+		if (TrackEnd == INDEX_NONE)
+		{
+			Cursor = Size;
+			return false;
+		}
+
+		const FAnsiStringView Track = Remaining.Mid(AfterName, TrackEnd);
+		Cursor += AfterName + TrackEnd + 8;
+
+		const FAnsiStringView Location = FindElement(Track, "location");
+		if (Location.IsEmpty())
+		{
+			continue;
+		}
+
+		OutEntry.Location = DecodeXml(Location);
+		if (OutEntry.Location.StartsWith(TEXT("file://"), ESearchCase::IgnoreCase))
+		{
+			// file:///C:/Music/a%20b.mp3 与 file://localhost/C:/Music/a%20b.mp3 -> C:/Music/a b.mp3
+			FString Path = OutEntry.Location.RightChop(7);
+			if (Path.StartsWith(TEXT("localhost/"), ESearchCase::IgnoreCase))
+			{
+				Path.RightChopInline(9);
+			}
+			if (Path.StartsWith(TEXT("/")) && Path.Len() > 2 && Path[2] == TEXT(':'))
+			{
+				Path.RightChopInline(1);
+			}
+			OutEntry.Location = DreamSMTCPlaylist::PercentDecode(Path);
+		}
+		else if (!OutEntry.Location.Contains(TEXT("://")))
+		{
+			OutEntry.Location = FPaths::ConvertRelativePathToFull(BaseDirectory, OutEntry.Location);
+		}
+
+		OutEntry.Title = DecodeXml(FindElement(Track, "title"));
+		OutEntry.Artist = DecodeXml(FindElement(Track, "creator"));
+
+		int64 Milliseconds = 0;
+		if (DreamSMTCPlaylist::ParseInt(FindElement(Track, "duration"), Milliseconds) && Milliseconds > 0)
+		{
+			OutEntry.Duration = FTimespan::FromMilliseconds(Milliseconds);
+		}
+		return true;
+	}
+}
+
+bool FDreamSMTCPlaylistReader::ReadLine(FAnsiStringView& OutLine)
+{
+	if (Cursor >= Size)
+	{
+		return false;
+	}
+
+	const int64 Start = Cursor;
+	const ANSICHAR* LineEnd = static_cast<const ANSICHAR*>(
+		FMemory::Memchr(Data + Start, '\n', static_cast<SIZE_T>(Size - Start)));
+	const int64 End = LineEnd ? LineEnd - Data : Size;
+	Cursor = LineEnd ? End + 1 : Size;
+
+	OutLine = FAnsiStringView(Data + Start, static_cast<int32>(End - Start)).TrimStartAndEnd();
+	return true;
+}
+
+FString FDreamSMTCPlaylistReader::ResolveLocation(FAnsiStringView Location) const
+{
+	FString Result = ToString(Location);
+	if (Result.Contains(TEXT("://")) || !FPaths::IsRelative(Result))
+	{
+		return Result;
+	}
+	return FPaths::ConvertRelativePathToFull(BaseDirectory, Result);
+}
+
+FString FDreamSMTCPlaylistReader::ToString(FAnsiStringView Text)
+{
+	const FUTF8ToTCHAR Converted(Text.GetData(), Text.Len());
+	return FString(Converted.Length(), Converted.Get());
+}
+
+FString FDreamSMTCPlaylistReader::DecodeXml(FAnsiStringView Text)
+{
+	Text = Text.TrimStartAndEnd();
+	if (Text.StartsWith("<![CDATA[") && Text.EndsWith("]]>"))
+	{
+		return ToString(Text.Mid(9, Text.Len() - 12));
+	}
+
+	FString Result = ToString(Text);
+	if (!Result.Contains(TEXT("&")))
+	{
+		return Result;
+	}
+
+	FString Decoded;
+	Decoded.Reserve(Result.Len());
+	for (int32 Index = 0; Index < Result.Len(); ++Index)
+	{
+		const int32 Semicolon = Result[Index] == TEXT('&') ? Result.Find(TEXT(";"), ESearchCase::CaseSensitive,
+		                                                                  ESearchDir::FromStart, Index) : INDEX_NONE;
+		if (Semicolon == INDEX_NONE || Semicolon - Index > 10)
+		{
+			Decoded.AppendChar(Result[Index]);
+			continue;
+		}
+
+		static const TPair<const TCHAR*, TCHAR> NamedEntities[] = {
+			{TEXT("amp"), TEXT('&')}, {TEXT("lt"), TEXT('<')}, {TEXT("gt"), TEXT('>')},
+			{TEXT("quot"), TEXT('"')}, {TEXT("apos"), TEXT('\'')},
+		};
+
+		const FString Entity = Result.Mid(Index + 1, Semicolon - Index - 1);
+		TCHAR Char = 0;
+		if (Entity.StartsWith(TEXT("#x"), ESearchCase::IgnoreCase))
+		{
+			Char = static_cast<TCHAR>(FParse::HexNumber(*Entity.RightChop(2)));
+		}
+		else if (Entity.StartsWith(TEXT("#")))
+		{
+			Char = static_cast<TCHAR>(FCString::Atoi(*Entity.RightChop(1)));
+		}
+		else
+		{
+			for (const TPair<const TCHAR*, TCHAR>& Named : NamedEntities)
+			{
+				if (Entity == Named.Key)
+				{
+					Char = Named.Value;
+					break;
+				}
+			}
+		}
+
+		if (Char == 0)
+		{
+			Decoded.AppendChar(Result[Index]);
+			continue;
+		}
+		Decoded.AppendChar(Char);
+		Index = Semicolon;
+	}
+	return Decoded;
+}
+
+FAnsiStringView FDreamSMTCPlaylistReader::FindElement(FAnsiStringView Track, FAnsiStringView Name)
+{
+	TAnsiStringBuilder<32> Open;
+	Open << '<' << Name << '>';
+	TAnsiStringBuilder<32> Close;
+	Close << "</" << Name << '>';
+
+	const int32 Start = UE::String::FindFirst(Track, Open.ToView(), ESearchCase::IgnoreCase);
+	if (Start == INDEX_NONE)
+	{
+		return FAnsiStringView();
+	}
+	const FAnsiStringView Content = Track.RightChop(Start + Open.Len());
+	const int32 End = UE::String::FindFirst(Content, Close.ToView(), ESearchCase::IgnoreCase);
+	return End == INDEX_NONE ? FAnsiStringView() : Content.Left(End);
+}
+
+namespace DreamSMTCPlaylist
+{
+	static bool WriteBenchPlaylist(const FString& Path, EDreamSMTCPlaylistFormat Format, int32 NumEntries)
+	{
+		TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Path));
+		if (!Writer)
+		{
+			return false;
+		}
+
+		auto Write = [&Writer](const FString& Text)
+		{
+			const FTCHARToUTF8 Utf8(*Text);
+			Writer->Serialize(const_cast<ANSICHAR*>(Utf8.Get()), Utf8.Length());
+		};
+
+		switch (Format)
+		{
+		case EDreamSMTCPlaylistFormat::M3U: Write(TEXT("#EXTM3U\n"));
+			break;
+		case EDreamSMTCPlaylistFormat::PLS: Write(TEXT("[playlist]\n"));
+			break;
+		default: Write(TEXT("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<playlist version=\"1\" xmlns=\"http://xspf.org/ns/0/\">\n<trackList>\n"));
+			break;
+		}
+
+		for (int32 Index = 1; Index <= NumEntries; ++Index)
+		{
+			const int32 Seconds = 180 + Index % 60;
+			switch (Format)
+			{
+			case EDreamSMTCPlaylistFormat::M3U:
+				Write(FString::Printf(TEXT("#EXTINF:%d,Artist %d - Title %d\nMusic/Track%06d.mp3\n"), Seconds, Index, Index, Index));
+				break;
+			case EDreamSMTCPlaylistFormat::PLS:
+				Write(FString::Printf(TEXT("File%d=Music/Track%06d.mp3\nTitle%d=Title %d\nLength%d=%d\n"), Index, Index, Index, Index, Index, Seconds));
+				break;
+			default:
+				Write(FString::Printf(TEXT("<track><location>Music/Track%06d.mp3</location><title>Title %d &amp; more</title>")
+				                      TEXT("<creator>Artist %d</creator><duration>%d</duration></track>\n"), Index, Index, Index, Seconds * 1000));
+				break;
+			}
+		}
+
+		switch (Format)
+		{
+		case EDreamSMTCPlaylistFormat::PLS: Write(FString::Printf(TEXT("NumberOfEntries=%d\nVersion=2\n"), NumEntries));
+			break;
+		case EDreamSMTCPlaylistFormat::XSPF: Write(TEXT("</trackList>\n</playlist>\n"));
+			break;
+		default:
+			break;
+		}
+		return true;
+	}
+}
+
+static FAutoConsoleCommand GDreamSMTCPlaylistBenchCommand(
+	TEXT("DreamSMTC.PlaylistBench"),
+	TEXT("Writes M3U, PLS and XSPF playlists with N entries (default 100000) and measures streaming import."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const int32 NumEntries = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 100000;
+		const FString Directory = FDreamSMTCThumbnail::GetCacheDirectory() / TEXT("PlaylistBench");
+		IFileManager::Get().MakeDirectory(*Directory, true);
+
+		const TPair<EDreamSMTCPlaylistFormat, const TCHAR*> Formats[] = {
+			{EDreamSMTCPlaylistFormat::M3U, TEXT("m3u8")},
+			{EDreamSMTCPlaylistFormat::PLS, TEXT("pls")},
+			{EDreamSMTCPlaylistFormat::XSPF, TEXT("xspf")},
+		};
+		for (const TPair<EDreamSMTCPlaylistFormat, const TCHAR*>& Format : Formats)
+		{
+			const FString Path = Directory / FString::Printf(TEXT("Bench.%s"), Format.Value);
+			if (!DreamSMTCPlaylist::WriteBenchPlaylist(Path, Format.Key, NumEntries))
+			{
+				DSMTC_LOG(Warning, TEXT("PlaylistBench: could not write %s"), *Path);
+				continue;
+			}
+
+			const double StartTime = FPlatformTime::Seconds();
+			FDreamSMTCPlaylistReader Reader;
+			FDreamSMTCPlaylistEntry Entry;
+			double FirstEntryTime = StartTime;
+			if (Reader.Open(Path) && Reader.Next(Entry))
+			{
+				FirstEntryTime = FPlatformTime::Seconds();
+				while (Reader.Next(Entry))
+				{
+				}
+			}
+			const double EndTime = FPlatformTime::Seconds();
+
+			DSMTC_LOG(Display, TEXT("PlaylistBench %s: %d entries, first entry %.3f ms, total %.2f ms (%.0f entries/s)"),
+			          Format.Value, Reader.GetEntriesRead(), (FirstEntryTime - StartTime) * 1000.0,
+			          (EndTime - StartTime) * 1000.0, Reader.GetEntriesRead() / FMath::Max(EndTime - StartTime, 1e-9));
+			IFileManager::Get().Delete(*Path);
+		}
+	}));
@@ -0,0 +1,742 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCRemoteServer.h"
+
+#include "DreamSMTCButtons.h"
+#include "DreamSMTCLog.h"
+#include "DreamSMTCMemory.h"
+#include "Common/TcpSocketBuilder.h"
+#include "Dom/JsonObject.h"
+#include "HAL/Event.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/RunnableThread.h"
+#include "Interfaces/IPv4/IPv4Endpoint.h"
+#include "Misc/Base64.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Guid.h"
+#include "Misc/Paths.h"
+#include "Misc/SecureHash.h"
+#include "Policies/CondensedJsonPrintPolicy.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+
+namespace DreamSMTCRemote
+{
+	// RFC 6455
+	static const TCHAR* WebSocketGuid = TEXT("258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+
+	static constexpr int32 MaxRequestSize = 8 * 1024;
+	static constexpr int32 MaxMessageSize = 4 * 1024;
+
+	static constexpr uint8 OpcodeText = 0x1;
+	static constexpr uint8 OpcodeClose = 0x8;
+	static constexpr uint8 OpcodePing = 0x9;
+	static constexpr uint8 OpcodePong = 0xA;
+}
+
+FDreamSMTCRemoteServer::FDreamSMTCRemoteServer(int32 InPort, int32 InMaxQueuedFrames, const FString& InToken,
+                                               const TArray<FString>& InAllowedOrigins)
+	: Port(InPort), MaxQueuedFrames(FMath::Max(InMaxQueuedFrames, 2)), Token(InToken), AllowedOrigins(InAllowedOrigins)
+{
+	if (Token.IsEmpty())
+	{
+		Token = FGuid::NewGuid().ToString(EGuidFormats::Digits);
+		bGeneratedToken = true;
+	}
+}
+
+FDreamSMTCRemoteServer::~FDreamSMTCRemoteServer()
+{
+	Shutdown();
+
+	// 事件在析构时才归还，关闭后仍在途的 Publish 可以安全触发
+	if (WakeEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+		WakeEvent = nullptr;
+	}
+}
+
+bool FDreamSMTCRemoteServer::Start()
+{
+	// 只监听本机回环地址
+	const FIPv4Endpoint Endpoint(FIPv4Address(127, 0, 0, 1), Port);
+	ListenSocket = FTcpSocketBuilder(TEXT("DreamSMTCRemote"))
+	               .AsNonBlocking()
+	               .AsReusable()
+	               .BoundToEndpoint(Endpoint)
+	               .Listening(8);
+	if (!ListenSocket)
+	{
+		DSMTC_LOG(Warning, TEXT("Remote control server could not listen on %s."), *Endpoint.ToString());
+		return false;
+	}
+
+	// 配套工具从文件读取本次生成的令牌
+	if (bGeneratedToken && !FFileHelper::SaveStringToFile(Token, *GetTokenFilePath(Port)))
+	{
+		DSMTC_LOG(Warning, TEXT("Remote control could not write %s."), *GetTokenFilePath(Port));
+	}
+
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, TEXT("DreamSMTCRemoteServer"), 0, TPri_BelowNormal);
+	DSMTC_LOG(Log, TEXT("Remote control server listening on %s."), *Endpoint.ToString());
+	return Thread != nullptr;
+}
+
+void FDreamSMTCRemoteServer::Shutdown()
+{
+	if (Thread)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	for (FClient& Client : Clients)
+	{
+		CloseClient(Client);
+	}
+	Clients.Empty();
+
+	if (ListenSocket)
+	{
+		ListenSocket->Close();
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(ListenSocket);
+		ListenSocket = nullptr;
+
+		if (bGeneratedToken)
+		{
+			IFileManager::Get().Delete(*GetTokenFilePath(Port), false, false, true);
+		}
+	}
+}
+
+FString FDreamSMTCRemoteServer::GetTokenFilePath(int32 InPort)
+{
+	return FPaths::ProjectSavedDir() / TEXT("DreamSMTCRemote") / FString::Printf(TEXT("Token-%d.txt"), InPort);
+}
+
+void FDreamSMTCRemoteServer::OnStateChanged(const FDreamSMTCChangeSetRef& ChangeSet)
+{
+	Publish(ChangeSet->State);
+}
+
+void FDreamSMTCRemoteServer::Publish(const FDreamSMTCSessionState& State)
+{
+	// 每次状态变化只序列化一次，所有客户端共享同一份帧数据
+	FString Json = SerializeState(State);
+	const FTCHARToUTF8 Utf8(*Json);
+	const FFrame Frame = MakeWebSocketFrame(DreamSMTCRemote::OpcodeText, reinterpret_cast<const uint8*>(Utf8.Get()),
+	                                        Utf8.Length());
+	{
+		FScopeLock Lock(&LatestLock);
+		LatestFrame = Frame;
+		LatestJson = MoveTemp(Json);
+	}
+
+	PendingFrames.Enqueue(Frame);
+	++PublishedFrames;
+	if (WakeEvent)
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+void FDreamSMTCRemoteServer::DrainCommands(TArray<EDreamSMTCButtonEvent>& OutCommands)
+{
+	EDreamSMTCButtonEvent Button;
+	while (Commands.Dequeue(Button))
+	{
+		OutCommands.Add(Button);
+	}
+}
+
+FDreamSMTCRemoteServerStats FDreamSMTCRemoteServer::GetStats() const
+{
+	FDreamSMTCRemoteServerStats Stats;
+	Stats.Clients = ClientCount.load(std::memory_order_relaxed);
+	Stats.PublishedFrames = PublishedFrames.load(std::memory_order_relaxed);
+	Stats.DroppedFrames = DroppedFrames.load(std::memory_order_relaxed);
+	Stats.ReceivedCommands = ReceivedCommands.load(std::memory_order_relaxed);
+	return Stats;
+}
+
+uint32 FDreamSMTCRemoteServer::Run()
+{
+	DSMTC_LLM_SCOPE();
+	while (!bStopping)
+	{
+		AcceptClients();
+
+		TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe> Frame;
+		while (PendingFrames.Dequeue(Frame))
+		{
+			for (FClient& Client : Clients)
+			{
+				if (Client.bWebSocket)
+				{
+					Enqueue(Client, Frame.ToSharedRef());
+				}
+			}
+		}
+
+		bool bHasBacklog = false;
+		for (FClient& Client : Clients)
+		{
+			ReceiveFrom(Client);
+			SendTo(Client);
+			bHasBacklog |= Client.SendQueue.Num() > 0;
+		}
+
+		Clients.RemoveAll([](const FClient& Client) { return Client.bClosed; });
+		ClientCount.store(Clients.Num(), std::memory_order_relaxed);
+
+		// 有积压数据时快速轮询，否则等待新的状态或连接
+		WakeEvent->Wait(bHasBacklog ? 1 : 10);
+	}
+	return 0;
+}
+
+void FDreamSMTCRemoteServer::Stop()
+{
+	bStopping = true;
+	if (WakeEvent)
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+void FDreamSMTCRemoteServer::AcceptClients()
+{
+	bool bHasPendingConnection = false;
+	while (ListenSocket->HasPendingConnection(bHasPendingConnection) && bHasPendingConnection)
+	{
+		FSocket* Socket = ListenSocket->Accept(TEXT("DreamSMTCRemoteClient"));
+		if (!Socket)
+		{
+			break;
+		}
+		Socket->SetNonBlocking(true);
+		Socket->SetNoDelay(true);
+
+		FClient& Client = Clients.AddDefaulted_GetRef();
+		Client.Socket = Socket;
+	}
+}
+
+void FDreamSMTCRemoteServer::ReceiveFrom(FClient& Client)
+{
+	if (Client.bClosed)
+	{
+		return;
+	}
+
+	uint8 Buffer[2048];
+	for (;;)
+	{
+		int32 BytesRead = 0;
+		if (!Client.Socket->Recv(Buffer, sizeof(Buffer), BytesRead))
+		{
+			const ESocketErrors Error = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->GetLastErrorCode();
+			if (Error != SE_EWOULDBLOCK && Error != SE_NO_ERROR)
+			{
+				CloseClient(Client);
+				return;
+			}
+			break;
+		}
+		if (BytesRead <= 0)
+		{
+			break;
+		}
+		Client.ReceiveBuffer.Append(Buffer, BytesRead);
+	}
+
+	if (Client.Socket->GetConnectionState() == SCS_ConnectionError)
+	{
+		CloseClient(Client);
+		return;
+	}
+
+	if (Client.bWebSocket)
+	{
+		HandleWebSocketFrames(Client);
+	}
+	else
+	{
+		HandleHttpRequest(Client);
+	}
+}
+
+void FDreamSMTCRemoteServer::SendTo(FClient& Client)
+{
+	while (!Client.bClosed && Client.SendQueue.Num() > 0)
+	{
+		const TArray<uint8>& Frame = *Client.SendQueue[0];
+		int32 BytesSent = 0;
+		if (!Client.Socket->Send(Frame.GetData() + Client.SendOffset, Frame.Num() - Client.SendOffset, BytesSent))
+		{
+			const ESocketErrors Error = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->GetLastErrorCode();
+			if (Error != SE_EWOULDBLOCK)
+			{
+				CloseClient(Client);
+			}
+			return;
+		}
+
+		Client.SendOffset += BytesSent;
+		if (Client.SendOffset < Frame.Num())
+		{
+			// 发送缓冲区已满，等待下一轮
+			return;
+		}
+
+		Client.SendQueue.RemoveAt(0, 1, false);
+		Client.SendOffset = 0;
+		Client.PinnedFrames = FMath::Max(Client.PinnedFrames - 1, 0);
+	}
+
+	if (Client.bCloseAfterSend && Client.SendQueue.Num() == 0)
+	{
+		CloseClient(Client);
+	}
+}
+
+void FDreamSMTCRemoteServer::Enqueue(FClient& Client, const FFrame& Frame)
+{
+	Client.SendQueue.Add(Frame);
+	if (Client.SendQueue.Num() <= MaxQueuedFrames)
+	{
+		return;
+	}
+
+	// 慢客户端：保留正在发送的帧和最新的帧，丢弃中间过期的快照
+	const int32 FirstDroppable = FMath::Max(Client.PinnedFrames, Client.SendOffset > 0 ? 1 : 0);
+	const int32 NumDropped = Client.SendQueue.Num() - 1 - FirstDroppable;
+	if (NumDropped > 0)
+	{
+		Client.SendQueue.RemoveAt(FirstDroppable, NumDropped, false);
+		DroppedFrames.fetch_add(NumDropped, std::memory_order_relaxed);
+	}
+}
+
+void FDreamSMTCRemoteServer::CloseClient(FClient& Client)
+{
+	if (Client.Socket)
+	{
+		Client.Socket->Close();
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Client.Socket);
+		Client.Socket = nullptr;
+	}
+	Client.SendQueue.Empty();
+	Client.bClosed = true;
+}
+
+void FDreamSMTCRemoteServer::HandleHttpRequest(FClient& Client)
+{
+	const TArray<uint8>& Buffer = Client.ReceiveBuffer;
+	int32 HeaderEnd = INDEX_NONE;
+	for (int32 Index = 0; Index + 3 < Buffer.Num(); ++Index)
+	{
+		if (Buffer[Index] == '\r' && Buffer[Index + 1] == '\n' && Buffer[Index + 2] == '\r' && Buffer[Index + 3] == '\n')
+		{
+			HeaderEnd = Index;
+			break;
+		}
+	}
+	if (HeaderEnd == INDEX_NONE)
+	{
+		if (Buffer.Num() > DreamSMTCRemote::MaxRequestSize)
+		{
+			CloseClient(Client);
+		}
+		return;
+	}
+
+	const FUTF8ToTCHAR Header(reinterpret_cast<const ANSICHAR*>(Buffer.GetData()), HeaderEnd);
+	TArray<FString> Lines;
+	FString(Header.Length(), Header.Get()).ParseIntoArray(Lines, TEXT("\r\n"));
+
+	// 请求头之后的数据属于 WebSocket 帧
+	Client.ReceiveBuffer.RemoveAt(0, HeaderEnd + 4, false);
+	TArray<FString> RequestLine;
+	if (Lines.Num() == 0 || Lines[0].ParseIntoArrayWS(RequestLine) < 2)
+	{
+		Enqueue(Client, MakeHttpResponse(400, TEXT("text/plain"), TEXT("Bad Request")));
+		Client.bCloseAfterSend = true;
+		return;
+	}
+
+	const FString& Method = RequestLine[0];
+	FString Path = RequestLine[1];
+	FString Query;
+	Path.Split(TEXT("?"), &Path, &Query);
+
+	FString WebSocketKey;
+	FString Host;
+	FString Origin;
+	FString PresentedToken;
+	for (int32 Index = 1; Index < Lines.Num(); ++Index)
+	{
+		FString Name, Value;
+		if (!Lines[Index].Split(TEXT(":"), &Name, &Value))
+		{
+			continue;
+		}
+		Name.TrimStartAndEndInline();
+		Value.TrimStartAndEndInline();
+		if (Name.Equals(TEXT("Sec-WebSocket-Key"), ESearchCase::IgnoreCase))
+		{
+			WebSocketKey = Value;
+		}
+		else if (Name.Equals(TEXT("Host"), ESearchCase::IgnoreCase))
+		{
+			Host = Value;
+		}
+		else if (Name.Equals(TEXT("Origin"), ESearchCase::IgnoreCase))
+		{
+			Origin = Value;
+		}
+		else if (Name.Equals(TEXT("Authorization"), ESearchCase::IgnoreCase) &&
+			Value.StartsWith(TEXT("Bearer "), ESearchCase::IgnoreCase))
+		{
+			PresentedToken = Value.RightChop(7).TrimStart();
+		}
+	}
+
+	TArray<FString> Parameters;
+	Query.ParseIntoArray(Parameters, TEXT("&"));
+	for (const FString& Parameter : Parameters)
+	{
+		if (Parameter.StartsWith(TEXT("token=")) && PresentedToken.IsEmpty())
+		{
+			PresentedToken = Parameter.RightChop(6);
+		}
+	}
+
+	// 检查 Host 可防止 DNS 重绑定，检查 Origin 可防止网页跨站连接
+	if (!IsHostAllowed(Host) || !IsOriginAllowed(Origin))
+	{
+		DSMTC_LOG(Warning, TEXT("Remote control rejected a request from origin '%s' for host '%s'."), *Origin, *Host);
+		Enqueue(Client, MakeHttpResponse(403, TEXT("text/plain"), TEXT("Forbidden")));
+		Client.bCloseAfterSend = true;
+		return;
+	}
+
+	// 会话状态包含曲目与收听信息，读取同样需要令牌
+	if (!IsTokenValid(PresentedToken))
+	{
+		Enqueue(Client, MakeHttpResponse(401, TEXT("text/plain"), TEXT("Unauthorized")));
+		Client.bCloseAfterSend = true;
+		return;
+	}
+
+	if (!WebSocketKey.IsEmpty())
+	{
+		const FString AcceptSource = WebSocketKey + DreamSMTCRemote::WebSocketGuid;
+		const FTCHARToUTF8 AcceptUtf8(*AcceptSource);
+		uint8 Digest[FSHA1::DigestSize];
+		FSHA1::HashBuffer(AcceptUtf8.Get(), AcceptUtf8.Length(), Digest);
+
+		const FString Handshake = FString::Printf(
+			TEXT("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n")
+			TEXT("Sec-WebSocket-Accept: %s\r\n\r\n"), *FBase64::Encode(Digest, FSHA1::DigestSize));
+		const FTCHARToUTF8 HandshakeUtf8(*Handshake);
+		Enqueue(Client, MakeShared<const TArray<uint8>, ESPMode::ThreadSafe>(
+			        reinterpret_cast<const uint8*>(HandshakeUtf8.Get()), HandshakeUtf8.Length()));
+		Client.PinnedFrames = Client.SendQueue.Num();
+		Client.bWebSocket = true;
+
+		// 新连接立即收到当前状态
+		FScopeLock Lock(&LatestLock);
+		if (LatestFrame.IsValid())
+		{
+			Enqueue(Client, LatestFrame.ToSharedRef());
+		}
+		return;
+	}
+
+	Client.bCloseAfterSend = true;
+	if (Method == TEXT("GET") && (Path == TEXT("/") || Path == TEXT("/state")))
+	{
+		FScopeLock Lock(&LatestLock);
+		Enqueue(Client, MakeHttpResponse(200, TEXT("application/json"), LatestJson.IsEmpty() ? TEXT("{}") : LatestJson));
+		return;
+	}
+
+	if (Method == TEXT("POST") && Path.StartsWith(TEXT("/button/")))
+	{
+		EDreamSMTCButtonEvent Button;
+		if (ParseButton(FStringView(Path).RightChop(8), Button))
+		{
+			HandleCommand(FStringView(Path).RightChop(8));
+			Enqueue(Client, MakeHttpResponse(204, TEXT("text/plain"), FString()));
+		}
+		else
+		{
+			Enqueue(Client, MakeHttpResponse(400, TEXT("text/plain"), TEXT("Unknown button")));
+		}
+		return;
+	}
+
+	Enqueue(Client, MakeHttpResponse(404, TEXT("text/plain"), TEXT("Not Found")));
+}
+
+bool FDreamSMTCRemoteServer::IsHostAllowed(const FString& Host) const
+{
+	return Host.Equals(FString::Printf(TEXT("127.0.0.1:%d"), Port), ESearchCase::IgnoreCase) ||
+		Host.Equals(FString::Printf(TEXT("localhost:%d"), Port), ESearchCase::IgnoreCase);
+}
+
+bool FDreamSMTCRemoteServer::IsOriginAllowed(const FString& Origin) const
+{
+	if (Origin.IsEmpty())
+	{
+		return true;
+	}
+	for (const FString& Allowed : AllowedOrigins)
+	{
+		if (Origin.Equals(Allowed, ESearchCase::IgnoreCase))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FDreamSMTCRemoteServer::IsTokenValid(const FString& Presented) const
+{
+	if (Token.IsEmpty() || Presented.Len() != Token.Len())
+	{
+		return false;
+	}
+
+	// 比较耗时与第一个不同字符的位置无关
+	uint32 Difference = 0;
+	for (int32 Index = 0; Index < Token.Len(); ++Index)
+	{
+		Difference |= static_cast<uint32>(Presented[Index] ^ Token[Index]);
+	}
+	return Difference == 0;
+}
+
+void FDreamSMTCRemoteServer::HandleWebSocketFrames(FClient& Client)
+{
+	TArray<uint8>& Buffer = Client.ReceiveBuffer;
+	while (Buffer.Num() >= 2)
+	{
+		const uint8 Opcode = Buffer[0] & 0x0F;
+		const bool bMasked = (Buffer[1] & 0x80) != 0;
+		uint64 PayloadSize = Buffer[1] & 0x7F;
+		int32 HeaderSize = 2;
+		if (PayloadSize == 126)
+		{
+			if (Buffer.Num() < 4)
+			{
+				return;
+			}
+			PayloadSize = (uint64(Buffer[2]) << 8) | Buffer[3];
+			HeaderSize = 4;
+		}
+		else if (PayloadSize == 127)
+		{
+			// 命令消息很短，超大帧直接断开
+			CloseClient(Client);
+			return;
+		}
+
+		// 客户端发来的帧必须带掩码
+		if (!bMasked || PayloadSize > DreamSMTCRemote::MaxMessageSize)
+		{
+			CloseClient(Client);
+			return;
+		}
+
+		const int32 FrameSize = HeaderSize + 4 + static_cast<int32>(PayloadSize);
+		if (Buffer.Num() < FrameSize)
+		{
+			return;
+		}
+
+		const uint8* Mask = Buffer.GetData() + HeaderSize;
+		TArray<uint8, TInlineAllocator<256>> Payload;
+		Payload.SetNumUninitialized(static_cast<int32>(PayloadSize));
+		for (int32 Index = 0; Index < Payload.Num(); ++Index)
+		{
+			Payload[Index] = Buffer[HeaderSize + 4 + Index] ^ Mask[Index % 4];
+		}
+		Buffer.RemoveAt(0, FrameSize, false);
+
+		switch (Opcode)
+		{
+		case DreamSMTCRemote::OpcodeText:
+			{
+				const FUTF8ToTCHAR Text(reinterpret_cast<const ANSICHAR*>(Payload.GetData()), Payload.Num());
+				HandleCommand(FStringView(Text.Get(), Text.Length()));
+				break;
+			}
+		case DreamSMTCRemote::OpcodePing:
+			Enqueue(Client, MakeWebSocketFrame(DreamSMTCRemote::OpcodePong, Payload.GetData(), Payload.Num()));
+			break;
+		case DreamSMTCRemote::OpcodeClose:
+			Enqueue(Client, MakeWebSocketFrame(DreamSMTCRemote::OpcodeClose, nullptr, 0));
+			Client.bCloseAfterSend = true;
+			return;
+		default:
+			break;
+		}
+	}
+}
+
+void FDreamSMTCRemoteServer::HandleCommand(FStringView Text)
+{
+	FString Name(Text.TrimStartAndEnd());
+	if (Name.StartsWith(TEXT("{")))
+	{
+		TSharedPtr<FJsonObject> Object;
+		if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Name), Object) || !Object.IsValid() ||
+			!Object->TryGetStringField(TEXT("button"), Name))
+		{
+			return;
+		}
+	}
+
+	EDreamSMTCButtonEvent Button;
+	if (!ParseButton(Name, Button))
+	{
+		DSMTC_LOG(Verbose, TEXT("Remote control ignored unknown command '%s'."), *Name);
+		return;
+	}
+
+	++ReceivedCommands;
+	if (ServerThreadCommandHandler)
+	{
+		ServerThreadCommandHandler(Button);
+	}
+	Commands.Enqueue(Button);
+}
+
+FDreamSMTCRemoteServer::FFrame FDreamSMTCRemoteServer::MakeWebSocketFrame(uint8 Opcode, const uint8* Payload, int32 Size)
+{
+	TArray<uint8> Frame;
+	Frame.Reserve(Size + 10);
+	Frame.Add(0x80 | Opcode);
+	if (Size < 126)
+	{
+		Frame.Add(static_cast<uint8>(Size));
+	}
+	else if (Size <= 0xFFFF)
+	{
+		Frame.Add(126);
+		Frame.Add(static_cast<uint8>(Size >> 8));
+		Frame.Add(static_cast<uint8>(Size));
+	}
+	else
+	{
+		Frame.Add(127);
+		for (int32 Shift = 56; Shift >= 0; Shift -= 8)
+		{
+			Frame.Add(static_cast<uint8>(static_cast<uint64>(Size) >> Shift));
+		}
+	}
+	Frame.Append(Payload, Size);
+	return MakeShared<const TArray<uint8>, ESPMode::ThreadSafe>(MoveTemp(Frame));
+}
+
+FDreamSMTCRemoteServer::FFrame FDreamSMTCRemoteServer::MakeHttpResponse(int32 StatusCode, const FString& ContentType,
+                                                                        const FString& Body)
+{
+	const FTCHARToUTF8 BodyUtf8(*Body);
+	const FString Header = FString::Printf(
+		TEXT("HTTP/1.1 %d %s\r\nContent-Type: %s; charset=utf-8\r\nContent-Length: %d\r\n")
+		TEXT("Connection: close\r\n\r\n"),
+		StatusCode, StatusCode < 300 ? TEXT("OK") : TEXT("Error"), *ContentType, BodyUtf8.Length());
+	const FTCHARToUTF8 HeaderUtf8(*Header);
+
+	TArray<uint8> Response;
+	Response.Reserve(HeaderUtf8.Length() + BodyUtf8.Length());
+	Response.Append(reinterpret_cast<const uint8*>(HeaderUtf8.Get()), HeaderUtf8.Length());
+	Response.Append(reinterpret_cast<const uint8*>(BodyUtf8.Get()), BodyUtf8.Length());
+	return MakeShared<const TArray<uint8>, ESPMode::ThreadSafe>(MoveTemp(Response));
+}
+
+FString FDreamSMTCRemoteServer::SerializeState(const FDreamSMTCSessionState& State)
+{
+	FString Json;
+	const TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> Writer =
+		TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Json);
+
+	Writer->WriteObjectStart();
+	Writer->WriteValue(TEXT("enabled"), State.bEnabled);
+	Writer->WriteValue(TEXT("status"), StaticEnum<EDreamSMTCMediaPlaybackStatus>()->GetNameStringByValue(
+		                   static_cast<int64>(State.PlaybackStatus)));
+	Writer->WriteValue(TEXT("type"), StaticEnum<EDreamSMTCMediaPlaybackType>()->GetNameStringByValue(
+		                   static_cast<int64>(State.Type)));
+	Writer->WriteValue(TEXT("rate"), State.PlaybackRate);
+	Writer->WriteValue(TEXT("shuffle"), State.bShuffleEnabled);
+	Writer->WriteValue(TEXT("repeat"), StaticEnum<EDreamSMTCAutoRepeatMode>()->GetNameStringByValue(
+		                   static_cast<int64>(State.AutoRepeatMode)));
+	Writer->WriteValue(TEXT("appMediaId"), State.AppMediaId);
+
+	Writer->WriteArrayStart(TEXT("buttons"));
+	for (int32 Index = 0; Index < DreamSMTCButtonCount; ++Index)
+	{
+		if (State.EnabledButtons & (1u << Index))
+		{
+			Writer->WriteValue(DreamSMTCButtonNames[Index]);
+		}
+	}
+	Writer->WriteArrayEnd();
+
+	switch (State.Type)
+	{
+	case EDreamSMTCMediaPlaybackType::Music:
+		Writer->WriteValue(TEXT("title"), State.Music.Title);
+		Writer->WriteValue(TEXT("artist"), State.Music.Artist);
+		Writer->WriteValue(TEXT("albumTitle"), State.Music.AlbumTitle);
+		Writer->WriteValue(TEXT("albumArtist"), State.Music.AlbumArtist);
+		Writer->WriteValue(TEXT("trackNumber"), State.Music.TrackNumber);
+		Writer->WriteValue(TEXT("albumTrackCount"), State.Music.AlbumTrackCount);
+		break;
+	case EDreamSMTCMediaPlaybackType::Video:
+		Writer->WriteValue(TEXT("title"), State.Video.Title);
+		Writer->WriteValue(TEXT("subtitle"), State.Video.Subtitle);
+		break;
+	case EDreamSMTCMediaPlaybackType::Image:
+		Writer->WriteValue(TEXT("title"), State.Image.Title);
+		Writer->WriteValue(TEXT("subtitle"), State.Image.Subtitle);
+		break;
+	default:
+		break;
+	}
+
+	Writer->WriteObjectStart(TEXT("timeline"));
+	Writer->WriteValue(TEXT("start"), State.Timeline.StartTime.GetTotalSeconds());
+	Writer->WriteValue(TEXT("end"), State.Timeline.EndTime.GetTotalSeconds());
+	Writer->WriteValue(TEXT("position"), State.Timeline.Position.GetTotalSeconds());
+	Writer->WriteValue(TEXT("minSeek"), State.Timeline.MinSeekTime.GetTotalSeconds());
+	Writer->WriteValue(TEXT("maxSeek"), State.Timeline.MaxSeekTime.GetTotalSeconds());
+	Writer->WriteObjectEnd();
+
+	Writer->WriteObjectEnd();
+	Writer->Close();
+	return Json;
+}
+
+bool FDreamSMTCRemoteServer::ParseButton(FStringView Name, EDreamSMTCButtonEvent& OutButton)
+{
+	for (int32 Index = 0; Index < DreamSMTCButtonCount; ++Index)
+	{
+		if (Name.Equals(DreamSMTCButtonNames[Index], ESearchCase::IgnoreCase))
+		{
+			OutButton = static_cast<EDreamSMTCButtonEvent>(Index);
+			return true;
+		}
+	}
+	return false;
+}
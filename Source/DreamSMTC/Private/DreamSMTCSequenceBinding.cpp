@@ -0,0 +1,290 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCSequenceBinding.h"
+
+#include "DreamSMTCButtons.h"
+#include "DreamSMTCSubsystem.h"
+#include "LevelSequencePlayer.h"
+#include "MovieSceneSequence.h"
+#include "Engine/World.h"
+#include "GameFramework/WorldSettings.h"
+
+static constexpr uint32 SequenceButtons = DreamSMTCButtonBit(EDreamSMTCButtonEvent::Play) |
+	DreamSMTCButtonBit(EDreamSMTCButtonEvent::Pause) | DreamSMTCButtonBit(EDreamSMTCButtonEvent::Stop);
+
+void UDreamSMTCSequenceBinding::Bind(UDreamSMTCSubsystem* InSubsystem, ULevelSequencePlayer* InPlayer,
+                                     const FDreamSMTCVideoDisplayProperties& Display)
+{
+	check(InSubsystem && InPlayer);
+	Subsystem = InSubsystem;
+	Player = InPlayer;
+
+	InPlayer->OnPlay.AddDynamic(this, &UDreamSMTCSequenceBinding::OnPlay);
+	InPlayer->OnPlayReverse.AddDynamic(this, &UDreamSMTCSequenceBinding::OnPlay);
+	InPlayer->OnPause.AddDynamic(this, &UDreamSMTCSequenceBinding::OnPause);
+	InPlayer->OnStop.AddDynamic(this, &UDreamSMTCSequenceBinding::OnStop);
+	InPlayer->OnFinished.AddDynamic(this, &UDreamSMTCSequenceBinding::OnStop);
+	UpdateHandle = InPlayer->OnSequenceUpdated().AddUObject(this, &UDreamSMTCSequenceBinding::OnSequenceUpdated);
+	// 世界暂停时播放器不再更新，只能在世界的 Tick 中发现
+	WorldTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(
+		this, &UDreamSMTCSequenceBinding::OnWorldPostActorTick);
+
+	ButtonHandle = InSubsystem->AddNativeButtonListener(
+		FDreamSMTCNativeButtonDelegate::CreateUObject(this, &UDreamSMTCSequenceBinding::OnButton), SequenceButtons);
+	InSubsystem->PlaybackPositionChangeRequested.AddDynamic(this, &UDreamSMTCSequenceBinding::OnPositionChangeRequested);
+	InSubsystem->PlaybackRateChangeRequested.AddDynamic(this, &UDreamSMTCSequenceBinding::OnRateChangeRequested);
+
+	PreviousButtons = InSubsystem->GetEnabledButtons();
+	bPreviousEnabled = InSubsystem->IsEnabled();
+	PreviousType = InSubsystem->GetType();
+	PreviousVideo = InSubsystem->GetVideoProperties();
+	PreviousStatus = InSubsystem->GetPlaybackStatus();
+	PreviousRate = InSubsystem->GetPlaybackRate();
+	PreviousTimeline = InSubsystem->GetTimelineProperties();
+
+	FDreamSMTCVideoDisplayProperties Shown = Display;
+	if (Shown.Title.IsEmpty())
+	{
+		if (const UMovieSceneSequence* Sequence = InPlayer->GetSequence())
+		{
+			Shown.Title = FName::NameToDisplayString(Sequence->GetName(), false);
+		}
+	}
+
+	InSubsystem->SetEnabled(true);
+	InSubsystem->SetEnabledButtons(SequenceButtons);
+	InSubsystem->SetType(EDreamSMTCMediaPlaybackType::Video);
+	InSubsystem->SetVideoProperties(Shown);
+	InSubsystem->Update();
+
+	SetStatus(GetPlayerStatus());
+}
+
+void UDreamSMTCSequenceBinding::Unbind()
+{
+	if (ULevelSequencePlayer* BoundPlayer = Player.Get())
+	{
+		BoundPlayer->OnPlay.RemoveAll(this);
+		BoundPlayer->OnPlayReverse.RemoveAll(this);
+		BoundPlayer->OnPause.RemoveAll(this);
+		BoundPlayer->OnStop.RemoveAll(this);
+		BoundPlayer->OnFinished.RemoveAll(this);
+		BoundPlayer->OnSequenceUpdated().Remove(UpdateHandle);
+	}
+	Player.Reset();
+	UpdateHandle.Reset();
+	FWorldDelegates::OnWorldPostActorTick.Remove(WorldTickHandle);
+	WorldTickHandle.Reset();
+
+	// 过场动画的标题、状态与进度不再留在系统控件上
+	if (UDreamSMTCSubsystem* BoundSubsystem = Subsystem.Get())
+	{
+		BoundSubsystem->RemoveNativeButtonListener(ButtonHandle);
+		BoundSubsystem->PlaybackPositionChangeRequested.RemoveAll(this);
+		BoundSubsystem->PlaybackRateChangeRequested.RemoveAll(this);
+		BoundSubsystem->SetEnabledButtons(PreviousButtons);
+		BoundSubsystem->SetType(PreviousType);
+		BoundSubsystem->SetVideoProperties(PreviousVideo);
+		BoundSubsystem->SetPlaybackRate(PreviousRate);
+		BoundSubsystem->SetPlaybackStatus(PreviousStatus);
+		BoundSubsystem->SetUpdateTimelineProperties(PreviousTimeline);
+		BoundSubsystem->SetEnabled(bPreviousEnabled);
+		BoundSubsystem->Update();
+	}
+	Subsystem.Reset();
+	ButtonHandle.Reset();
+}
+
+ULevelSequencePlayer* UDreamSMTCSequenceBinding::GetPlayer() const
+{
+	return Player.Get();
+}
+
+void UDreamSMTCSequenceBinding::OnPlay()
+{
+	SetStatus(EDreamSMTCMediaPlaybackStatus::Playing);
+}
+
+void UDreamSMTCSequenceBinding::OnPause()
+{
+	SetStatus(EDreamSMTCMediaPlaybackStatus::Paused);
+}
+
+void UDreamSMTCSequenceBinding::OnStop()
+{
+	SetStatus(EDreamSMTCMediaPlaybackStatus::Stopped);
+}
+
+void UDreamSMTCSequenceBinding::SetStatus(EDreamSMTCMediaPlaybackStatus Status)
+{
+	UDreamSMTCSubsystem* BoundSubsystem = Subsystem.Get();
+	ULevelSequencePlayer* BoundPlayer = Player.Get();
+	if (!BoundSubsystem || !BoundPlayer)
+	{
+		return;
+	}
+
+	// 世界暂停时显示为暂停，慢动作时显示实际的速度
+	if (Status == EDreamSMTCMediaPlaybackStatus::Playing &&
+		GetPlayerStatus() == EDreamSMTCMediaPlaybackStatus::Paused)
+	{
+		Status = EDreamSMTCMediaPlaybackStatus::Paused;
+	}
+	BoundSubsystem->SetPlaybackRate(BoundPlayer->GetPlayRate() * GetTimeDilation());
+	BoundSubsystem->SetPlaybackStatus(Status);
+	PushedStatus = Status;
+	PushTimeline();
+}
+
+void UDreamSMTCSequenceBinding::OnSequenceUpdated(const UMovieSceneSequencePlayer& InPlayer, FFrameTime CurrentTime,
+                                                  FFrameTime PreviousTime)
+{
+	// 连续播放时系统自行推算进度，只有偏离推算值时才推送
+	const double Expected = PushedPosition.GetTotalSeconds() + (FPlatformTime::Seconds() - PushedTime) * PushedRate;
+	if (FMath::Abs(GetPosition().GetTotalSeconds() - Expected) > DiscontinuityTolerance)
+	{
+		PushTimeline();
+	}
+}
+
+void UDreamSMTCSequenceBinding::OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	const ULevelSequencePlayer* BoundPlayer = Player.Get();
+	if (!BoundPlayer || World != BoundPlayer->GetWorld())
+	{
+		return;
+	}
+
+	// 暂停与时间膨胀改变了系统的推算速度，立即重新推送
+	if (GetPlayerStatus() != PushedStatus ||
+		!FMath::IsNearlyEqual(GetEffectiveRate(), PushedRate, RateTolerance))
+	{
+		SetStatus(GetPlayerStatus());
+	}
+}
+
+void UDreamSMTCSequenceBinding::PushTimeline()
+{
+	UDreamSMTCSubsystem* BoundSubsystem = Subsystem.Get();
+	ULevelSequencePlayer* BoundPlayer = Player.Get();
+	if (!BoundSubsystem || !BoundPlayer)
+	{
+		return;
+	}
+
+	const FTimespan Duration = FTimespan::FromSeconds(BoundPlayer->GetDuration().AsSeconds());
+	FDreamSMTCTimelineProperties Timeline;
+	Timeline.StartTime = FTimespan::Zero();
+	Timeline.EndTime = Duration;
+	Timeline.MinSeekTime = FTimespan::Zero();
+	Timeline.MaxSeekTime = Duration;
+	Timeline.Position = GetPosition();
+	BoundSubsystem->SetUpdateTimelineProperties(Timeline);
+
+	PushedPosition = Timeline.Position;
+	PushedTime = FPlatformTime::Seconds();
+	PushedRate = GetEffectiveRate();
+}
+
+EDreamSMTCMediaPlaybackStatus UDreamSMTCSequenceBinding::GetPlayerStatus() const
+{
+	const ULevelSequencePlayer* BoundPlayer = Player.Get();
+	if (!BoundPlayer)
+	{
+		return EDreamSMTCMediaPlaybackStatus::Stopped;
+	}
+
+	if (BoundPlayer->IsPlaying())
+	{
+		const UWorld* World = BoundPlayer->GetWorld();
+		return World && World->IsPaused()
+			       ? EDreamSMTCMediaPlaybackStatus::Paused
+			       : EDreamSMTCMediaPlaybackStatus::Playing;
+	}
+	return BoundPlayer->IsPaused() ? EDreamSMTCMediaPlaybackStatus::Paused : EDreamSMTCMediaPlaybackStatus::Stopped;
+}
+
+float UDreamSMTCSequenceBinding::GetTimeDilation() const
+{
+	const ULevelSequencePlayer* BoundPlayer = Player.Get();
+	const UWorld* World = BoundPlayer ? BoundPlayer->GetWorld() : nullptr;
+	const AWorldSettings* WorldSettings = World ? World->GetWorldSettings() : nullptr;
+	return WorldSettings ? WorldSettings->GetEffectiveTimeDilation() : 1.0f;
+}
+
+double UDreamSMTCSequenceBinding::GetEffectiveRate() const
+{
+	const ULevelSequencePlayer* BoundPlayer = Player.Get();
+	if (!BoundPlayer || GetPlayerStatus() != EDreamSMTCMediaPlaybackStatus::Playing)
+	{
+		return 0.0;
+	}
+	return BoundPlayer->GetPlayRate() * GetTimeDilation() * (BoundPlayer->IsReversed() ? -1.0 : 1.0);
+}
+
+FTimespan UDreamSMTCSequenceBinding::GetPosition() const
+{
+	const ULevelSequencePlayer* BoundPlayer = Player.Get();
+	if (!BoundPlayer)
+	{
+		return FTimespan::Zero();
+	}
+
+	const FFrameRate FrameRate = BoundPlayer->GetFrameRate();
+	const FFrameTime Offset = BoundPlayer->GetCurrentTime().Time - BoundPlayer->GetStartTime().Time;
+	return FTimespan::FromSeconds(FrameRate.AsSeconds(Offset));
+}
+
+void UDreamSMTCSequenceBinding::OnButton(EDreamSMTCButtonEvent Button)
+{
+	ULevelSequencePlayer* BoundPlayer = Player.Get();
+	if (!BoundPlayer)
+	{
+		return;
+	}
+
+	switch (Button)
+	{
+	case EDreamSMTCButtonEvent::Play:
+		BoundPlayer->Play();
+		break;
+	case EDreamSMTCButtonEvent::Pause:
+		BoundPlayer->Pause();
+		break;
+	case EDreamSMTCButtonEvent::Stop:
+		BoundPlayer->Stop();
+		break;
+	default:
+		break;
+	}
+}
+
+void UDreamSMTCSequenceBinding::OnPositionChangeRequested(FTimespan Position)
+{
+	ULevelSequencePlayer* BoundPlayer = Player.Get();
+	if (!BoundPlayer)
+	{
+		return;
+	}
+
+	// 按显示帧率换算，跳转后更新事件会推送新的进度
+	const FFrameRate FrameRate = BoundPlayer->GetFrameRate();
+	const FFrameTime Target = BoundPlayer->GetStartTime().Time + FrameRate.AsFrameTime(Position.GetTotalSeconds());
+	BoundPlayer->SetPlaybackPosition(FMovieSceneSequencePlaybackParams(Target, EUpdatePositionMethod::Jump));
+}
+
+void UDreamSMTCSequenceBinding::OnRateChangeRequested(double Rate)
+{
+	ULevelSequencePlayer* BoundPlayer = Player.Get();
+	if (!BoundPlayer || Rate <= 0.0)
+	{
+		return;
+	}
+
+	BoundPlayer->SetPlayRate(static_cast<float>(Rate));
+	if (UDreamSMTCSubsystem* BoundSubsystem = Subsystem.Get())
+	{
+		BoundSubsystem->SetPlaybackRate(Rate);
+	}
+	PushTimeline();
+}
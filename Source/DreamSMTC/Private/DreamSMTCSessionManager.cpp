@@ -0,0 +1,158 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCSessionManager.h"
+
+#include "DreamSMTCSubsystem.h"
+#include "Engine/GameInstance.h"
+#include "Engine/GameViewportClient.h"
+#include "Framework/Application/SlateApplication.h"
+#include "Widgets/SWindow.h"
+
+FDreamSMTCSessionManager& FDreamSMTCSessionManager::Get()
+{
+	static FDreamSMTCSessionManager Manager;
+	return Manager;
+}
+
+void FDreamSMTCSessionManager::Register(UDreamSMTCSubsystem* Subsystem, int32 Priority)
+{
+	check(IsInGameThread());
+	if (Find(Subsystem))
+	{
+		return;
+	}
+
+	FEntry& Entry = Entries.AddDefaulted_GetRef();
+	Entry.Subsystem = Subsystem;
+	Entry.Priority = Priority;
+	Entry.FocusSerial = ++NextFocusSerial;
+
+	// 焦点切换到哪个实例的窗口，哪个实例就成为最近获得焦点的会话
+	if (!FocusChangingHandle.IsValid() && FSlateApplication::IsInitialized())
+	{
+		FocusChangingHandle = FSlateApplication::Get().OnFocusChanging().AddRaw(
+			this, &FDreamSMTCSessionManager::OnFocusChanging);
+	}
+
+	Arbitrate();
+}
+
+void FDreamSMTCSessionManager::Unregister(UDreamSMTCSubsystem* Subsystem)
+{
+	check(IsInGameThread());
+	Entries.RemoveAll([Subsystem](const FEntry& Entry)
+	{
+		return !Entry.Subsystem.IsValid() || Entry.Subsystem.Get() == Subsystem;
+	});
+
+	if (Owner.Get() == Subsystem)
+	{
+		Owner.Reset();
+		Subsystem->SetBackendOwner(false);
+	}
+
+	if (Entries.Num() == 0 && FocusChangingHandle.IsValid())
+	{
+		if (FSlateApplication::IsInitialized())
+		{
+			FSlateApplication::Get().OnFocusChanging().Remove(FocusChangingHandle);
+		}
+		FocusChangingHandle.Reset();
+	}
+
+	Arbitrate();
+}
+
+void FDreamSMTCSessionManager::SetPriority(UDreamSMTCSubsystem* Subsystem, int32 Priority)
+{
+	if (FEntry* Entry = Find(Subsystem))
+	{
+		Entry->Priority = Priority;
+		Arbitrate();
+	}
+}
+
+void FDreamSMTCSessionManager::NotifyFocused(UDreamSMTCSubsystem* Subsystem)
+{
+	FEntry* Entry = Find(Subsystem);
+	if (Entry && Entry->FocusSerial != NextFocusSerial)
+	{
+		Entry->FocusSerial = ++NextFocusSerial;
+		Arbitrate();
+	}
+}
+
+void FDreamSMTCSessionManager::ForEachSession(TFunctionRef<void(UDreamSMTCSubsystem&)> Function) const
+{
+	for (const FEntry& Entry : Entries)
+	{
+		if (UDreamSMTCSubsystem* Subsystem = Entry.Subsystem.Get())
+		{
+			Function(*Subsystem);
+		}
+	}
+}
+
+FDreamSMTCSessionManager::FEntry* FDreamSMTCSessionManager::Find(const UDreamSMTCSubsystem* Subsystem)
+{
+	return Entries.FindByPredicate([Subsystem](const FEntry& Entry) { return Entry.Subsystem.Get() == Subsystem; });
+}
+
+void FDreamSMTCSessionManager::Arbitrate()
+{
+	const FEntry* Best = nullptr;
+	for (const FEntry& Entry : Entries)
+	{
+		if (!Entry.Subsystem.IsValid())
+		{
+			continue;
+		}
+		if (!Best || Entry.Priority > Best->Priority ||
+			(Entry.Priority == Best->Priority && Entry.FocusSerial > Best->FocusSerial))
+		{
+			Best = &Entry;
+		}
+	}
+
+	UDreamSMTCSubsystem* NewOwner = Best ? Best->Subsystem.Get() : nullptr;
+	if (NewOwner == Owner.Get())
+	{
+		return;
+	}
+
+	// 先让旧的会话停止写入，新的会话再整体覆盖后端
+	if (UDreamSMTCSubsystem* OldOwner = Owner.Get())
+	{
+		OldOwner->SetBackendOwner(false);
+	}
+	Owner = NewOwner;
+	if (NewOwner)
+	{
+		NewOwner->SetBackendOwner(true);
+	}
+}
+
+void FDreamSMTCSessionManager::OnFocusChanging(const FFocusEvent& FocusEvent,
+                                               const FWeakWidgetPath& OldFocusedWidgetPath,
+                                               const TSharedPtr<SWidget>& OldFocusedWidget,
+                                               const FWidgetPath& NewFocusedWidgetPath,
+                                               const TSharedPtr<SWidget>& NewFocusedWidget)
+{
+	if (Entries.Num() < 2 || !NewFocusedWidgetPath.IsValid())
+	{
+		return;
+	}
+
+	const TSharedRef<SWindow> FocusedWindow = NewFocusedWidgetPath.GetWindow();
+	for (const FEntry& Entry : Entries)
+	{
+		const UDreamSMTCSubsystem* Subsystem = Entry.Subsystem.Get();
+		const UGameInstance* GameInstance = Subsystem ? Subsystem->GetGameInstance() : nullptr;
+		UGameViewportClient* Viewport = GameInstance ? GameInstance->GetGameViewportClient() : nullptr;
+		if (Viewport && Viewport->GetWindow() == FocusedWindow)
+		{
+			NotifyFocused(Entry.Subsystem.Get());
+			return;
+		}
+	}
+}
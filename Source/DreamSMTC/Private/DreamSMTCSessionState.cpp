@@ -0,0 +1,368 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCSessionState.h"
+
+#include "DreamSMTCLog.h"
+#include "DreamSMTCThumbnail.h"
+#include "HAL/PlatformFileManager.h"
+#include "Async/MappedFileHandle.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+void FDreamSMTCSessionState::ClearDisplay()
+{
+	Type = EDreamSMTCMediaPlaybackType::Unknown;
+	AppMediaId.Reset();
+	Music = FDreamSMTCMusicDisplayProperties();
+	Video = FDreamSMTCVideoDisplayProperties();
+	Image = FDreamSMTCImageDisplayProperties();
+	Thumbnail.Reset();
+}
+
+void FDreamSMTCSessionState::CopyFields(const FDreamSMTCSessionState& From, EDreamSMTCSessionField Fields)
+{
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Enabled))
+	{
+		bEnabled = From.bEnabled;
+	}
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Buttons))
+	{
+		EnabledButtons = From.EnabledButtons;
+	}
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::PlaybackStatus))
+	{
+		PlaybackStatus = From.PlaybackStatus;
+	}
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::PlaybackRate))
+	{
+		PlaybackRate = From.PlaybackRate;
+	}
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Shuffle))
+	{
+		bShuffleEnabled = From.bShuffleEnabled;
+	}
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::AutoRepeat))
+	{
+		AutoRepeatMode = From.AutoRepeatMode;
+	}
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Type))
+	{
+		Type = From.Type;
+	}
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::AppMediaId))
+	{
+		AppMediaId = From.AppMediaId;
+	}
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Music))
+	{
+		Music = From.Music;
+	}
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Video))
+	{
+		Video = From.Video;
+	}
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Image))
+	{
+		Image = From.Image;
+	}
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Timeline))
+	{
+		Timeline = From.Timeline;
+	}
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Thumbnail))
+	{
+		Thumbnail = From.Thumbnail;
+	}
+}
+
+EDreamSMTCSessionField FDreamSMTCSessionState::Diff(const FDreamSMTCSessionState& From,
+                                                    const FDreamSMTCSessionState& To, uint32* OutChangedButtons)
+{
+	EDreamSMTCSessionField Fields = EDreamSMTCSessionField::None;
+	auto Compare = [&Fields](bool bEqual, EDreamSMTCSessionField Field)
+	{
+		if (!bEqual)
+		{
+			Fields |= Field;
+		}
+	};
+
+	// FString 的 == 不区分大小写，显示文本需要精确比较
+	auto SameText = [](const FString& A, const FString& B) { return A.Equals(B, ESearchCase::CaseSensitive); };
+	auto SameTexts = [&SameText](const TArray<FString>& A, const TArray<FString>& B)
+	{
+		if (A.Num() != B.Num())
+		{
+			return false;
+		}
+		for (int32 Index = 0; Index < A.Num(); ++Index)
+		{
+			if (!SameText(A[Index], B[Index]))
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	const uint32 ChangedButtons = From.EnabledButtons ^ To.EnabledButtons;
+	if (OutChangedButtons)
+	{
+		*OutChangedButtons = ChangedButtons;
+	}
+
+	Compare(From.bEnabled == To.bEnabled, EDreamSMTCSessionField::Enabled);
+	Compare(ChangedButtons == 0, EDreamSMTCSessionField::Buttons);
+	Compare(From.PlaybackStatus == To.PlaybackStatus, EDreamSMTCSessionField::PlaybackStatus);
+	Compare(From.PlaybackRate == To.PlaybackRate, EDreamSMTCSessionField::PlaybackRate);
+	Compare(From.bShuffleEnabled == To.bShuffleEnabled, EDreamSMTCSessionField::Shuffle);
+	Compare(From.AutoRepeatMode == To.AutoRepeatMode, EDreamSMTCSessionField::AutoRepeat);
+	Compare(From.Type == To.Type, EDreamSMTCSessionField::Type);
+	Compare(SameText(From.AppMediaId, To.AppMediaId), EDreamSMTCSessionField::AppMediaId);
+
+	Compare(SameText(From.Music.AlbumArtist, To.Music.AlbumArtist) &&
+	        SameText(From.Music.AlbumTitle, To.Music.AlbumTitle) &&
+	        From.Music.AlbumTrackCount == To.Music.AlbumTrackCount &&
+	        SameText(From.Music.Artist, To.Music.Artist) &&
+	        SameTexts(From.Music.Genres, To.Music.Genres) &&
+	        SameText(From.Music.Title, To.Music.Title) &&
+	        From.Music.TrackNumber == To.Music.TrackNumber, EDreamSMTCSessionField::Music);
+
+	Compare(SameTexts(From.Video.Genres, To.Video.Genres) &&
+	        SameText(From.Video.Subtitle, To.Video.Subtitle) &&
+	        SameText(From.Video.Title, To.Video.Title), EDreamSMTCSessionField::Video);
+
+	Compare(SameText(From.Image.Title, To.Image.Title) &&
+	        SameText(From.Image.Subtitle, To.Image.Subtitle), EDreamSMTCSessionField::Image);
+
+	Compare(From.Timeline.StartTime == To.Timeline.StartTime &&
+	        From.Timeline.EndTime == To.Timeline.EndTime &&
+	        From.Timeline.Position == To.Timeline.Position &&
+	        From.Timeline.MaxSeekTime == To.Timeline.MaxSeekTime &&
+	        From.Timeline.MinSeekTime == To.Timeline.MinSeekTime, EDreamSMTCSessionField::Timeline);
+
+	Compare(From.Thumbnail == To.Thumbnail, EDreamSMTCSessionField::Thumbnail);
+	return Fields;
+}
+
+SIZE_T FDreamSMTCSessionState::GetAllocatedSize() const
+{
+	auto GenresSize = [](const TArray<FString>& Genres)
+	{
+		SIZE_T Size = Genres.GetAllocatedSize();
+		for (const FString& Genre : Genres)
+		{
+			Size += Genre.GetAllocatedSize();
+		}
+		return Size;
+	};
+
+	return AppMediaId.GetAllocatedSize() +
+		Music.AlbumArtist.GetAllocatedSize() + Music.AlbumTitle.GetAllocatedSize() + Music.Artist.GetAllocatedSize() +
+		Music.Title.GetAllocatedSize() + GenresSize(Music.Genres) +
+		Video.Title.GetAllocatedSize() + Video.Subtitle.GetAllocatedSize() + GenresSize(Video.Genres) +
+		Image.Title.GetAllocatedSize() + Image.Subtitle.GetAllocatedSize();
+}
+
+namespace
+{
+	/** True when Bytes more bytes can be read. Lengths come from the file, so check them before allocating. */
+	bool FitsRemaining(FArchive& Ar, int64 Bytes)
+	{
+		return Bytes >= 0 && Bytes <= Ar.TotalSize() - Ar.Tell();
+	}
+
+	void SerializeString(FArchive& Ar, FString& Value)
+	{
+		if (Ar.IsLoading())
+		{
+			// 先读出长度检查剩余字节，再退回交给 FString 读取；负数长度表示 UTF-16 存储
+			const int64 Start = Ar.Tell();
+			int32 SaveNum = 0;
+			Ar << SaveNum;
+			const int64 Bytes = SaveNum < 0 ? -static_cast<int64>(SaveNum) * sizeof(UTF16CHAR) : SaveNum;
+			if (Ar.IsError() || !FitsRemaining(Ar, Bytes))
+			{
+				Ar.SetError();
+				return;
+			}
+			Ar.Seek(Start);
+		}
+		Ar << Value;
+	}
+
+	void SerializeStrings(FArchive& Ar, TArray<FString>& Values)
+	{
+		int32 Num = Values.Num();
+		Ar << Num;
+		if (Ar.IsLoading())
+		{
+			// 每个字符串至少占用一个长度字段
+			if (Ar.IsError() || !FitsRemaining(Ar, static_cast<int64>(Num) * sizeof(int32)))
+			{
+				Ar.SetError();
+				return;
+			}
+			Values.Empty(Num);
+			Values.SetNum(Num);
+		}
+		for (FString& Value : Values)
+		{
+			SerializeString(Ar, Value);
+			if (Ar.IsError())
+			{
+				return;
+			}
+		}
+	}
+}
+
+FArchive& operator<<(FArchive& Ar, FDreamSMTCSessionState& State)
+{
+	// 枚举统一按 uint8 存储
+	uint8 PlaybackStatus = static_cast<uint8>(State.PlaybackStatus);
+	uint8 AutoRepeatMode = static_cast<uint8>(State.AutoRepeatMode);
+	uint8 Type = static_cast<uint8>(State.Type);
+
+	Ar << State.bEnabled;
+	Ar << State.EnabledButtons;
+	Ar << PlaybackStatus;
+	Ar << State.PlaybackRate;
+	Ar << State.bShuffleEnabled;
+	Ar << AutoRepeatMode;
+
+	Ar << Type;
+	SerializeString(Ar, State.AppMediaId);
+
+	SerializeString(Ar, State.Music.AlbumArtist);
+	SerializeString(Ar, State.Music.AlbumTitle);
+	Ar << State.Music.AlbumTrackCount;
+	SerializeString(Ar, State.Music.Artist);
+	SerializeStrings(Ar, State.Music.Genres);
+	SerializeString(Ar, State.Music.Title);
+	Ar << State.Music.TrackNumber;
+
+	SerializeStrings(Ar, State.Video.Genres);
+	SerializeString(Ar, State.Video.Subtitle);
+	SerializeString(Ar, State.Video.Title);
+
+	SerializeString(Ar, State.Image.Title);
+	SerializeString(Ar, State.Image.Subtitle);
+
+	Ar << State.Timeline.StartTime;
+	Ar << State.Timeline.EndTime;
+	Ar << State.Timeline.Position;
+	Ar << State.Timeline.MaxSeekTime;
+	Ar << State.Timeline.MinSeekTime;
+
+	int64 ThumbnailSize = State.Thumbnail.IsValid() ? State.Thumbnail->Num() : 0;
+	Ar << ThumbnailSize;
+	if (Ar.IsLoading())
+	{
+		State.PlaybackStatus = static_cast<EDreamSMTCMediaPlaybackStatus>(PlaybackStatus);
+		State.AutoRepeatMode = static_cast<EDreamSMTCAutoRepeatMode>(AutoRepeatMode);
+		State.Type = static_cast<EDreamSMTCMediaPlaybackType>(Type);
+
+		State.Thumbnail.Reset();
+		if (!FitsRemaining(Ar, ThumbnailSize))
+		{
+			Ar.SetError();
+		}
+		else if (ThumbnailSize > 0)
+		{
+			TSharedRef<FDreamSMTCSessionState::FEncodedImage, ESPMode::ThreadSafe> Encoded =
+				MakeShared<FDreamSMTCSessionState::FEncodedImage, ESPMode::ThreadSafe>();
+			Encoded->SetNumUninitialized(ThumbnailSize);
+			Ar.Serialize(Encoded->GetData(), ThumbnailSize);
+			State.Thumbnail = Encoded;
+		}
+	}
+	else if (ThumbnailSize > 0)
+	{
+		Ar.Serialize(const_cast<uint8*>(State.Thumbnail->GetData()), ThumbnailSize);
+	}
+	return Ar;
+}
+
+FString FDreamSMTCSessionSnapshot::GetSnapshotPath(int32 InstanceIndex)
+{
+	return InstanceIndex > 0
+		       ? FDreamSMTCThumbnail::GetCacheDirectory() / FString::Printf(TEXT("Session.%d.bin"), InstanceIndex)
+		       : FDreamSMTCThumbnail::GetCacheDirectory() / TEXT("Session.bin");
+}
+
+bool FDreamSMTCSessionSnapshot::Save(const FDreamSMTCSessionState& State, int32 InstanceIndex)
+{
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+
+	uint32 FileMagic = Magic;
+	uint32 FileVersion = Version;
+	Writer << FileMagic;
+	Writer << FileVersion;
+	Writer << const_cast<FDreamSMTCSessionState&>(State);
+
+	// 先写临时文件再替换，避免进程退出时留下半个快照
+	const FString Path = GetSnapshotPath(InstanceIndex);
+	const FString TempPath = Path + TEXT(".tmp");
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(Path), true);
+	if (!FFileHelper::SaveArrayToFile(Data, *TempPath) || !IFileManager::Get().Move(*Path, *TempPath, true))
+	{
+		DSMTC_LOG(Warning, TEXT("Failed to save session snapshot to %s"), *Path);
+		return false;
+	}
+	return true;
+}
+
+bool FDreamSMTCSessionSnapshot::Load(FDreamSMTCSessionState& OutState, int32 InstanceIndex)
+{
+	const FString Path = GetSnapshotPath(InstanceIndex);
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (!PlatformFile.FileExists(*Path))
+	{
+		return false;
+	}
+
+	TUniquePtr<IMappedFileHandle> MappedFile(PlatformFile.OpenMapped(*Path));
+	TUniquePtr<IMappedFileRegion> MappedRegion(MappedFile.IsValid() ? MappedFile->MapRegion() : nullptr);
+
+	// 平台不支持内存映射时退回到普通读取
+	TArray<uint8> FallbackData;
+	TArrayView<const uint8> View;
+	if (MappedRegion.IsValid())
+	{
+		View = TArrayView<const uint8>(MappedRegion->GetMappedPtr(), MappedRegion->GetMappedSize());
+	}
+	else if (FFileHelper::LoadFileToArray(FallbackData, *Path))
+	{
+		View = FallbackData;
+	}
+
+	FMemoryReaderView Reader(View);
+	uint32 FileMagic = 0;
+	uint32 FileVersion = 0;
+	Reader << FileMagic;
+	Reader << FileVersion;
+	if (Reader.IsError() || FileMagic != Magic || FileVersion != Version)
+	{
+		DSMTC_LOG(Log, TEXT("Ignoring session snapshot %s (version %u)."), *Path, FileVersion);
+		return false;
+	}
+
+	FDreamSMTCSessionState State;
+	Reader << State;
+	if (Reader.IsError())
+	{
+		DSMTC_LOG(Warning, TEXT("Session snapshot %s is corrupted."), *Path);
+		return false;
+	}
+
+	OutState = MoveTemp(State);
+	return true;
+}
+
+void FDreamSMTCSessionSnapshot::Delete(int32 InstanceIndex)
+{
+	IFileManager::Get().Delete(*GetSnapshotPath(InstanceIndex), false, true, true);
+}
@@ -0,0 +1,13 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCSettings.h"
+
+FName UDreamSMTCSettings::GetCategoryName() const
+{
+	return TEXT("Plugins");
+}
+
+const UDreamSMTCSettings* UDreamSMTCSettings::Get()
+{
+	return GetDefault<UDreamSMTCSettings>();
+}
@@ -0,0 +1,245 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCShuffleSequencer.h"
+
+namespace DreamSMTCShuffle
+{
+	static constexpr int32 NumRounds = 4;
+
+	static uint64 Mix(uint64 Value)
+	{
+		// SplitMix64 finalizer
+		Value ^= Value >> 30;
+		Value *= 0xBF58476D1CE4E5B9ull;
+		Value ^= Value >> 27;
+		Value *= 0x94D049BB133111EBull;
+		Value ^= Value >> 31;
+		return Value;
+	}
+}
+
+void FDreamSMTCShuffleSequencer::Reset(int32 InNumTracks, int32 StartTrack, uint32 InSeed)
+{
+	NumTracks = FMath::Max(InNumTracks, 0);
+	BaseSeed = InSeed != 0 ? InSeed : FPlatformTime::Cycles();
+	SegmentHead = 0;
+	SegmentCount = 0;
+	Step = 0;
+
+	// 取满足 2^(2 * HalfBits) >= NumTracks 的最小平衡分组，循环行走的期望次数小于 4
+	const int32 Bits = NumTracks > 1 ? FMath::CeilLogTwo64(static_cast<uint64>(NumTracks)) : 1;
+	HalfBits = FMath::Max((Bits + 1) / 2, 1);
+	HalfMask = (uint64(1) << HalfBits) - 1;
+
+	if (NumTracks == 0)
+	{
+		CurrentTrack = INDEX_NONE;
+		return;
+	}
+
+	CurrentTrack = FMath::Clamp(StartTrack, 0, NumTracks - 1);
+	BeginSegment(bShuffle);
+}
+
+void FDreamSMTCShuffleSequencer::SetShuffleEnabled(bool bEnable)
+{
+	if (bShuffle == bEnable)
+	{
+		return;
+	}
+
+	// 不重排整个列表，只从当前曲目开始一段新的播放顺序
+	bShuffle = bEnable;
+	if (NumTracks > 0)
+	{
+		BeginSegment(bShuffle);
+	}
+}
+
+bool FDreamSMTCShuffleSequencer::Next()
+{
+	return StepForward();
+}
+
+bool FDreamSMTCShuffleSequencer::Previous()
+{
+	if (NumTracks == 0)
+	{
+		return false;
+	}
+
+	for (;;)
+	{
+		if (Step > 0)
+		{
+			--Step;
+			break;
+		}
+		if (SegmentCount <= 1)
+		{
+			return false;
+		}
+
+		// 回到上一段；该段最后一步与当前段第一步是同一首，继续向前一步
+		SegmentHead = (SegmentHead + MaxSegments - 1) % MaxSegments;
+		--SegmentCount;
+		Step = Segments[SegmentHead].LastStep;
+	}
+
+	CurrentTrack = TrackAt(Segments[SegmentHead], Step);
+	return true;
+}
+
+bool FDreamSMTCShuffleSequencer::OnTrackFinished()
+{
+	if (NumTracks > 0 && RepeatMode == EDreamSMTCAutoRepeatMode::Track)
+	{
+		return true;
+	}
+	return StepForward();
+}
+
+void FDreamSMTCShuffleSequencer::JumpTo(int32 Track)
+{
+	if (NumTracks == 0)
+	{
+		return;
+	}
+
+	CurrentTrack = FMath::Clamp(Track, 0, NumTracks - 1);
+	BeginSegment(bShuffle);
+}
+
+int32 FDreamSMTCShuffleSequencer::PeekNext() const
+{
+	if (NumTracks == 0)
+	{
+		return INDEX_NONE;
+	}
+
+	const FSegment& Segment = Segments[SegmentHead];
+	return IsStepInQueue(Segment, Step + 1) ? TrackAt(Segment, Step + 1) : INDEX_NONE;
+}
+
+int32 FDreamSMTCShuffleSequencer::TrackAt(const FSegment& Segment, int64 InStep) const
+{
+	const int64 Position = Segment.Offset + InStep;
+	if (!Segment.bShuffle)
+	{
+		return static_cast<int32>(Position % NumTracks);
+	}
+
+	// 每一轮使用新的密钥，整轮内旋转 Offset 使本段从切换时的曲目开始
+	const int64 Lap = InStep / NumTracks;
+	return static_cast<int32>(Permute(static_cast<uint64>(Position % NumTracks), LapKey(Segment.Seed, Lap)));
+}
+
+bool FDreamSMTCShuffleSequencer::IsStepInQueue(const FSegment& Segment, int64 InStep) const
+{
+	if (RepeatMode == EDreamSMTCAutoRepeatMode::List)
+	{
+		return true;
+	}
+	// 不循环时：顺序播放到列表末尾，随机播放一整轮
+	return Segment.bShuffle ? InStep < NumTracks : Segment.Offset + InStep < NumTracks;
+}
+
+bool FDreamSMTCShuffleSequencer::StepForward()
+{
+	if (NumTracks == 0)
+	{
+		return false;
+	}
+
+	// 回退到历史中另一种顺序后再前进时，从当前曲目按现在的设置开始新的一段
+	if (Segments[SegmentHead].bShuffle != bShuffle)
+	{
+		BeginSegment(bShuffle);
+	}
+
+	const FSegment& Segment = Segments[SegmentHead];
+	if (!IsStepInQueue(Segment, Step + 1))
+	{
+		return false;
+	}
+
+	++Step;
+	CurrentTrack = TrackAt(Segment, Step);
+	return true;
+}
+
+void FDreamSMTCShuffleSequencer::BeginSegment(bool bInShuffle)
+{
+	if (SegmentCount > 0)
+	{
+		Segments[SegmentHead].LastStep = Step;
+		SegmentHead = (SegmentHead + 1) % MaxSegments;
+	}
+	SegmentCount = FMath::Min(SegmentCount + 1, MaxSegments);
+
+	FSegment& Segment = Segments[SegmentHead];
+	Segment.bShuffle = bInShuffle;
+	Segment.Seed = static_cast<uint32>(DreamSMTCShuffle::Mix(BaseSeed + (uint64(++SegmentSerial) << 32)));
+	Segment.Offset = bInShuffle
+		                 ? static_cast<int64>(InversePermute(static_cast<uint64>(CurrentTrack), LapKey(Segment.Seed, 0)))
+		                 : CurrentTrack;
+	Segment.LastStep = 0;
+	Step = 0;
+}
+
+uint64 FDreamSMTCShuffleSequencer::Permute(uint64 Index, uint32 Key) const
+{
+	// 循环行走：结果落在 [0, NumTracks) 之外时继续加密，保持双射
+	uint64 Value = Encrypt(Index, Key);
+	while (Value >= static_cast<uint64>(NumTracks))
+	{
+		Value = Encrypt(Value, Key);
+	}
+	return Value;
+}
+
+uint64 FDreamSMTCShuffleSequencer::InversePermute(uint64 Index, uint32 Key) const
+{
+	uint64 Value = Decrypt(Index, Key);
+	while (Value >= static_cast<uint64>(NumTracks))
+	{
+		Value = Decrypt(Value, Key);
+	}
+	return Value;
+}
+
+uint64 FDreamSMTCShuffleSequencer::Encrypt(uint64 Value, uint32 Key) const
+{
+	uint64 Left = (Value >> HalfBits) & HalfMask;
+	uint64 Right = Value & HalfMask;
+	for (int32 RoundIndex = 0; RoundIndex < DreamSMTCShuffle::NumRounds; ++RoundIndex)
+	{
+		const uint64 NewRight = Left ^ Round(Right, Key, RoundIndex);
+		Left = Right;
+		Right = NewRight;
+	}
+	return (Left << HalfBits) | Right;
+}
+
+uint64 FDreamSMTCShuffleSequencer::Decrypt(uint64 Value, uint32 Key) const
+{
+	uint64 Left = (Value >> HalfBits) & HalfMask;
+	uint64 Right = Value & HalfMask;
+	for (int32 RoundIndex = DreamSMTCShuffle::NumRounds - 1; RoundIndex >= 0; --RoundIndex)
+	{
+		const uint64 PrevLeft = Right ^ Round(Left, Key, RoundIndex);
+		Right = Left;
+		Left = PrevLeft;
+	}
+	return (Left << HalfBits) | Right;
+}
+
+uint32 FDreamSMTCShuffleSequencer::Round(uint64 Half, uint32 Key, int32 RoundIndex) const
+{
+	return static_cast<uint32>(DreamSMTCShuffle::Mix(Half ^ (uint64(Key) << 32) ^ (uint64(RoundIndex) << 24)) & HalfMask);
+}
+
+uint32 FDreamSMTCShuffleSequencer::LapKey(uint32 Seed, int64 Lap)
+{
+	return static_cast<uint32>(DreamSMTCShuffle::Mix((uint64(Seed) << 32) ^ static_cast<uint64>(Lap)));
+}
@@ -0,0 +1,448 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCSimulatedBackend.h"
+
+#include "DreamSMTCButtons.h"
+#include "DreamSMTCLog.h"
+#include "DreamSMTCMemory.h"
+#include "DreamSMTCSettings.h"
+#include "DreamSMTCSubsystem.h"
+#include "Async/Async.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/FileHelper.h"
+
+namespace
+{
+	struct FSimulatedPreparedThumbnail : FDreamSMTCPreparedThumbnail
+	{
+		TSharedPtr<const FDreamSMTCSessionState::FEncodedImage, ESPMode::ThreadSafe> Encoded;
+	};
+
+	FString GetOperationName(EDreamSMTCBackendOperation Operation)
+	{
+		return StaticEnum<EDreamSMTCBackendOperation>()->GetNameStringByValue(static_cast<int64>(Operation));
+	}
+}
+
+FDreamSMTCSimulatedBackend::FDreamSMTCSimulatedBackend(int32 InSeed,
+                                                       const FDreamSMTCSimulatedOperationProfile& InDefaultProfile,
+                                                       const TMap<EDreamSMTCBackendOperation,
+                                                                  FDreamSMTCSimulatedOperationProfile>& InProfiles)
+	: Seed(InSeed)
+	, DefaultProfile(InDefaultProfile)
+	, Profiles(InProfiles)
+{
+}
+
+TSharedRef<FDreamSMTCSimulatedBackend, ESPMode::ThreadSafe> FDreamSMTCSimulatedBackend::CreateFromSettings()
+{
+	const UDreamSMTCSettings* Settings = UDreamSMTCSettings::Get();
+	return MakeShared<FDreamSMTCSimulatedBackend, ESPMode::ThreadSafe>(
+		Settings->SimulatedBackendSeed, Settings->SimulatedDefaultProfile, Settings->SimulatedOperationProfiles);
+}
+
+bool FDreamSMTCSimulatedBackend::Simulate(EDreamSMTCBackendOperation Operation, FString& OutError)
+{
+	double LatencyMs;
+	bool bSpike;
+	bool bFail;
+	{
+		FScopeLock ScopeLock(&Lock);
+		const FDreamSMTCSimulatedOperationProfile* Found = Profiles.Find(Operation);
+		const FDreamSMTCSimulatedOperationProfile& Profile = Found ? *Found : DefaultProfile;
+
+		// 操作的第 N 次调用使用独立的随机流，结果与其它操作及线程的调用顺序无关
+		const uint32 Draw = Draws[static_cast<int32>(Operation)]++;
+		const uint32 StreamSeed = HashCombine(HashCombine(GetTypeHash(Seed), GetTypeHash(static_cast<uint8>(Operation))),
+		                                      GetTypeHash(Draw));
+		FRandomStream Random(static_cast<int32>(StreamSeed));
+		const float Jitter = Random.FRandRange(-1.0f, 1.0f) * Profile.JitterMs;
+		bSpike = Random.FRand() < Profile.SpikeRate;
+		bFail = Random.FRand() < Profile.FailureRate;
+		LatencyMs = FMath::Max(Profile.LatencyMs + Jitter + (bSpike ? Profile.SpikeMs : 0.0f), 0.0f);
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	if (LatencyMs > 0.0)
+	{
+		FPlatformProcess::Sleep(static_cast<float>(LatencyMs / 1000.0));
+	}
+	const double Elapsed = FPlatformTime::Seconds() - StartTime;
+
+	{
+		FScopeLock ScopeLock(&Lock);
+		FOperationStats& OperationStats = Stats[static_cast<int32>(Operation)];
+		++OperationStats.Calls;
+		OperationStats.Failures += bFail ? 1 : 0;
+		OperationStats.Spikes += bSpike ? 1 : 0;
+		OperationStats.TotalSeconds += Elapsed;
+		OperationStats.MaxSeconds = FMath::Max(OperationStats.MaxSeconds, Elapsed);
+	}
+
+	if (bFail)
+	{
+		OutError = FString::Printf(TEXT("Simulated %s failure"), *GetOperationName(Operation));
+		return false;
+	}
+	return true;
+}
+
+bool FDreamSMTCSimulatedBackend::WriteSession(const FDreamSMTCSessionState& State, EDreamSMTCSessionField Fields,
+                                              uint32 ButtonMask, FString& OutError)
+{
+	if (!Simulate(EDreamSMTCBackendOperation::WriteSession, OutError))
+	{
+		return false;
+	}
+
+	DSMTC_LLM_SCOPE();
+	FScopeLock ScopeLock(&Lock);
+	// 与系统控件一致：显示属性等待 Update，其余立即生效
+	const EDreamSMTCSessionField Immediate = Fields & ~(EDreamSMTCSessionField::Display |
+		EDreamSMTCSessionField::Buttons | EDreamSMTCSessionField::Thumbnail);
+	Displayed.CopyFields(State, Immediate);
+	Pending.CopyFields(State, Immediate | (Fields & EDreamSMTCSessionField::Display));
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Buttons))
+	{
+		const uint32 Mask = ButtonMask & DreamSMTCValidButtons;
+		Displayed.EnabledButtons = (Displayed.EnabledButtons & ~Mask) | (State.EnabledButtons & Mask);
+		Pending.EnabledButtons = Displayed.EnabledButtons;
+	}
+	return true;
+}
+
+bool FDreamSMTCSimulatedBackend::WriteTimeline(const FDreamSMTCTimelineProperties& Timeline, FString& OutError)
+{
+	if (!Simulate(EDreamSMTCBackendOperation::WriteTimeline, OutError))
+	{
+		return false;
+	}
+
+	FScopeLock ScopeLock(&Lock);
+	Displayed.Timeline = Timeline;
+	Pending.Timeline = Timeline;
+	return true;
+}
+
+bool FDreamSMTCSimulatedBackend::Update(FString& OutError)
+{
+	if (!Simulate(EDreamSMTCBackendOperation::Update, OutError))
+	{
+		return false;
+	}
+
+	DSMTC_LLM_SCOPE();
+	FScopeLock ScopeLock(&Lock);
+	Displayed.CopyFields(Pending, EDreamSMTCSessionField::Display | EDreamSMTCSessionField::Thumbnail);
+	return true;
+}
+
+bool FDreamSMTCSimulatedBackend::ClearAll(FString& OutError)
+{
+	if (!Simulate(EDreamSMTCBackendOperation::ClearAll, OutError))
+	{
+		return false;
+	}
+
+	FScopeLock ScopeLock(&Lock);
+	Pending.ClearDisplay();
+	Displayed.ClearDisplay();
+	return true;
+}
+
+bool FDreamSMTCSimulatedBackend::SetThumbnailFromFile(const FString& FullPath, FString& OutError)
+{
+	if (!Simulate(EDreamSMTCBackendOperation::SetThumbnail, OutError))
+	{
+		return false;
+	}
+
+	DSMTC_LLM_SCOPE();
+	TSharedRef<FDreamSMTCSessionState::FEncodedImage, ESPMode::ThreadSafe> Encoded =
+		MakeShared<FDreamSMTCSessionState::FEncodedImage, ESPMode::ThreadSafe>();
+	if (!FFileHelper::LoadFileToArray(*Encoded, *FullPath))
+	{
+		OutError = FString::Printf(TEXT("Failed to read %s"), *FullPath);
+		return false;
+	}
+
+	FScopeLock ScopeLock(&Lock);
+	Pending.Thumbnail = Encoded;
+	return true;
+}
+
+TSharedPtr<FDreamSMTCPreparedThumbnail, ESPMode::ThreadSafe> FDreamSMTCSimulatedBackend::PrepareThumbnail(
+	const TArray64<uint8>& Encoded, FString& OutError)
+{
+	if (!Simulate(EDreamSMTCBackendOperation::PrepareThumbnail, OutError))
+	{
+		return nullptr;
+	}
+
+	DSMTC_LLM_SCOPE();
+	TSharedRef<FSimulatedPreparedThumbnail, ESPMode::ThreadSafe> Prepared =
+		MakeShared<FSimulatedPreparedThumbnail, ESPMode::ThreadSafe>();
+	Prepared->Encoded = MakeShared<const FDreamSMTCSessionState::FEncodedImage, ESPMode::ThreadSafe>(Encoded);
+	return Prepared;
+}
+
+bool FDreamSMTCSimulatedBackend::SetPreparedThumbnail(const FDreamSMTCPreparedThumbnail& Prepared, FString& OutError)
+{
+	// 与系统控件一致，设置已准备好的封面不阻塞
+	FScopeLock ScopeLock(&Lock);
+	Pending.Thumbnail = static_cast<const FSimulatedPreparedThumbnail&>(Prepared).Encoded;
+	return true;
+}
+
+uint64 FDreamSMTCSimulatedBackend::AddHandlers(FDreamSMTCBackendHandlers&& Handlers)
+{
+	FScopeLock ScopeLock(&Lock);
+	const uint64 HandlersId = NextHandlersId++;
+	Registrations.Add(HandlersId, MakeShared<const FDreamSMTCBackendHandlers, ESPMode::ThreadSafe>(MoveTemp(Handlers)));
+	return HandlersId;
+}
+
+void FDreamSMTCSimulatedBackend::RemoveHandlers(uint64 HandlersId)
+{
+	FScopeLock ScopeLock(&Lock);
+	Registrations.Remove(HandlersId);
+}
+
+bool FDreamSMTCSimulatedBackend::Release(FString& OutError)
+{
+	{
+		FScopeLock ScopeLock(&Lock);
+		Registrations.Empty();
+	}
+	return ClearAll(OutError);
+}
+
+void FDreamSMTCSimulatedBackend::SetProfile(EDreamSMTCBackendOperation Operation,
+                                            const FDreamSMTCSimulatedOperationProfile& Profile)
+{
+	FScopeLock ScopeLock(&Lock);
+	Profiles.Add(Operation, Profile);
+}
+
+FDreamSMTCSimulatedOperationProfile FDreamSMTCSimulatedBackend::GetProfile(EDreamSMTCBackendOperation Operation) const
+{
+	FScopeLock ScopeLock(&Lock);
+	const FDreamSMTCSimulatedOperationProfile* Found = Profiles.Find(Operation);
+	return Found ? *Found : DefaultProfile;
+}
+
+void FDreamSMTCSimulatedBackend::Reseed(int32 InSeed)
+{
+	FScopeLock ScopeLock(&Lock);
+	Seed = InSeed;
+	FMemory::Memzero(Draws);
+}
+
+TArray<FDreamSMTCSimulatedBackend::FHandlersRef> FDreamSMTCSimulatedBackend::GetHandlers() const
+{
+	TArray<FHandlersRef> Handlers;
+	FScopeLock ScopeLock(&Lock);
+	Registrations.GenerateValueArray(Handlers);
+	return Handlers;
+}
+
+void FDreamSMTCSimulatedBackend::InjectBurst(int32 Count, float IntervalMs,
+                                             TFunction<void(const FDreamSMTCBackendHandlers&, int32)>&& Fire)
+{
+	Async(EAsyncExecution::ThreadPool, [This = AsShared(), Count, IntervalMs, Fire = MoveTemp(Fire)]()
+	{
+		for (int32 Index = 0; Index < Count; ++Index)
+		{
+			// 每次重新获取，爆发期间注销的处理函数不再收到事件
+			for (const FHandlersRef& Handlers : This->GetHandlers())
+			{
+				Fire(*Handlers, Index);
+			}
+			if (IntervalMs > 0.0f && Index + 1 < Count)
+			{
+				FPlatformProcess::Sleep(IntervalMs / 1000.0f);
+			}
+		}
+	});
+}
+
+void FDreamSMTCSimulatedBackend::InjectButtonBurst(EDreamSMTCButtonEvent Button, int32 Count, float IntervalMs)
+{
+	InjectBurst(Count, IntervalMs, [Button](const FDreamSMTCBackendHandlers& Handlers, int32)
+	{
+		if (Handlers.ButtonPressed)
+		{
+			Handlers.ButtonPressed(Button);
+		}
+	});
+}
+
+void FDreamSMTCSimulatedBackend::InjectSeekBurst(FTimespan From, FTimespan To, int32 Count, float IntervalMs)
+{
+	InjectBurst(Count, IntervalMs, [From, To, Count](const FDreamSMTCBackendHandlers& Handlers, int32 Index)
+	{
+		if (Handlers.PlaybackPositionChangeRequested)
+		{
+			const double Alpha = Count > 1 ? static_cast<double>(Index) / (Count - 1) : 1.0;
+			Handlers.PlaybackPositionChangeRequested(From + (To - From) * Alpha);
+		}
+	});
+}
+
+FDreamSMTCSessionState FDreamSMTCSimulatedBackend::GetDisplayedState() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return Displayed;
+}
+
+FDreamSMTCSimulatedBackend::FOperationStats FDreamSMTCSimulatedBackend::GetStats(
+	EDreamSMTCBackendOperation Operation) const
+{
+	FScopeLock ScopeLock(&Lock);
+	return Stats[static_cast<int32>(Operation)];
+}
+
+void FDreamSMTCSimulatedBackend::ResetStats()
+{
+	FScopeLock ScopeLock(&Lock);
+	for (FOperationStats& OperationStats : Stats)
+	{
+		OperationStats = FOperationStats();
+	}
+}
+
+void FDreamSMTCSimulatedBackend::Report(FOutputDevice& Ar) const
+{
+	FScopeLock ScopeLock(&Lock);
+	Ar.Logf(TEXT("DreamSMTC simulated backend: %d handler registration(s)"), Registrations.Num());
+	Ar.Logf(TEXT("  %-16s %8s %8s %8s %10s %10s"), TEXT("Operation"), TEXT("Calls"), TEXT("Failed"), TEXT("Spikes"),
+	        TEXT("Avg ms"), TEXT("Max ms"));
+	for (int32 Index = 0; Index < NumOperations; ++Index)
+	{
+		const FOperationStats& OperationStats = Stats[Index];
+		Ar.Logf(TEXT("  %-16s %8lld %8lld %8lld %10.2f %10.2f"),
+		        *GetOperationName(static_cast<EDreamSMTCBackendOperation>(Index)), OperationStats.Calls,
+		        OperationStats.Failures, OperationStats.Spikes,
+		        OperationStats.Calls > 0 ? OperationStats.TotalSeconds * 1000.0 / OperationStats.Calls : 0.0,
+		        OperationStats.MaxSeconds * 1000.0);
+	}
+
+	Ar.Logf(TEXT("  Displayed: %s, status %s, position %s, \"%s - %s\", thumbnail %lld bytes"),
+	        Displayed.bEnabled ? TEXT("enabled") : TEXT("disabled"),
+	        *StaticEnum<EDreamSMTCMediaPlaybackStatus>()->GetNameStringByValue(
+		        static_cast<int64>(Displayed.PlaybackStatus)),
+	        *Displayed.Timeline.Position.ToString(), *Displayed.Music.Artist, *Displayed.Music.Title,
+	        Displayed.Thumbnail.IsValid() ? Displayed.Thumbnail->Num() : 0ll);
+}
+
+static TSharedPtr<FDreamSMTCSimulatedBackend, ESPMode::ThreadSafe> GetSimulatedBackend()
+{
+	const TSharedPtr<IDreamSMTCBackend, ESPMode::ThreadSafe> Backend = UDreamSMTCSubsystem::GetBackend();
+	if (!Backend.IsValid())
+	{
+		DSMTC_LOG(Warning, TEXT("No DreamSMTC session is running"));
+		return nullptr;
+	}
+	if (!Backend->IsSimulated())
+	{
+		DSMTC_LOG(Warning, TEXT("DreamSMTC is using the %s backend, set bUseSimulatedBackend to simulate"),
+		          Backend->GetName());
+		return nullptr;
+	}
+	return static_cast<FDreamSMTCSimulatedBackend&>(Backend->GetImplementation()).AsShared();
+}
+
+static FAutoConsoleCommandWithOutputDevice GDreamSMTCSimReportCommand(
+	TEXT("DreamSMTC.Sim.Report"),
+	TEXT("Prints call counts, failures and latencies per operation of the simulated backend, and what it displays."),
+	FConsoleCommandWithOutputDeviceDelegate::CreateLambda([](FOutputDevice& Ar)
+	{
+		if (const TSharedPtr<FDreamSMTCSimulatedBackend, ESPMode::ThreadSafe> Backend = GetSimulatedBackend())
+		{
+			Backend->Report(Ar);
+		}
+	}));
+
+static FAutoConsoleCommand GDreamSMTCSimButtonBurstCommand(
+	TEXT("DreamSMTC.Sim.ButtonBurst"),
+	TEXT("DreamSMTC.Sim.ButtonBurst [Button=Play] [Count=10] [IntervalMs=0]: presses a button from a worker thread."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const TSharedPtr<FDreamSMTCSimulatedBackend, ESPMode::ThreadSafe> Backend = GetSimulatedBackend();
+		if (!Backend)
+		{
+			return;
+		}
+
+		int64 Button = static_cast<int64>(EDreamSMTCButtonEvent::Play);
+		if (Args.Num() > 0)
+		{
+			Button = StaticEnum<EDreamSMTCButtonEvent>()->GetValueByNameString(Args[0]);
+			if (Button == INDEX_NONE)
+			{
+				DSMTC_LOG(Warning, TEXT("Unknown button %s"), *Args[0]);
+				return;
+			}
+		}
+		const int32 Count = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 10;
+		const float IntervalMs = Args.Num() > 2 ? FMath::Max(FCString::Atof(*Args[2]), 0.0f) : 0.0f;
+		Backend->InjectButtonBurst(static_cast<EDreamSMTCButtonEvent>(Button), Count, IntervalMs);
+	}));
+
+static FAutoConsoleCommand GDreamSMTCSimSeekBurstCommand(
+	TEXT("DreamSMTC.Sim.SeekBurst"),
+	TEXT("DreamSMTC.Sim.SeekBurst [FromSeconds=0] [ToSeconds=60] [Count=100] [IntervalMs=1]: scrubs from a worker thread."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		if (const TSharedPtr<FDreamSMTCSimulatedBackend, ESPMode::ThreadSafe> Backend = GetSimulatedBackend())
+		{
+			const double From = Args.Num() > 0 ? FCString::Atod(*Args[0]) : 0.0;
+			const double To = Args.Num() > 1 ? FCString::Atod(*Args[1]) : 60.0;
+			const int32 Count = Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 1) : 100;
+			const float IntervalMs = Args.Num() > 3 ? FMath::Max(FCString::Atof(*Args[3]), 0.0f) : 1.0f;
+			Backend->InjectSeekBurst(FTimespan::FromSeconds(From), FTimespan::FromSeconds(To), Count, IntervalMs);
+		}
+	}));
+
+static FAutoConsoleCommand GDreamSMTCSimProfileCommand(
+	TEXT("DreamSMTC.Sim.Profile"),
+	TEXT("DreamSMTC.Sim.Profile <Operation> <LatencyMs> [JitterMs] [FailureRate] [SpikeRate] [SpikeMs]: ")
+	TEXT("changes one operation of the simulated backend until it is recreated."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const TSharedPtr<FDreamSMTCSimulatedBackend, ESPMode::ThreadSafe> Backend = GetSimulatedBackend();
+		if (!Backend || Args.Num() < 2)
+		{
+			return;
+		}
+
+		const int64 Operation = StaticEnum<EDreamSMTCBackendOperation>()->GetValueByNameString(Args[0]);
+		if (Operation == INDEX_NONE)
+		{
+			DSMTC_LOG(Warning, TEXT("Unknown backend operation %s"), *Args[0]);
+			return;
+		}
+
+		FDreamSMTCSimulatedOperationProfile Profile;
+		Profile.LatencyMs = FMath::Max(FCString::Atof(*Args[1]), 0.0f);
+		Profile.JitterMs = Args.Num() > 2 ? FMath::Max(FCString::Atof(*Args[2]), 0.0f) : 0.0f;
+		Profile.FailureRate = Args.Num() > 3 ? FMath::Clamp(FCString::Atof(*Args[3]), 0.0f, 1.0f) : 0.0f;
+		Profile.SpikeRate = Args.Num() > 4 ? FMath::Clamp(FCString::Atof(*Args[4]), 0.0f, 1.0f) : 0.0f;
+		Profile.SpikeMs = Args.Num() > 5 ? FMath::Max(FCString::Atof(*Args[5]), 0.0f) : 0.0f;
+		Backend->SetProfile(static_cast<EDreamSMTCBackendOperation>(Operation), Profile);
+	}));
+
+static FAutoConsoleCommand GDreamSMTCSimReseedCommand(
+	TEXT("DreamSMTC.Sim.Reseed"),
+	TEXT("DreamSMTC.Sim.Reseed [Seed=SimulatedBackendSeed]: restarts the random stream and clears the statistics."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		if (const TSharedPtr<FDreamSMTCSimulatedBackend, ESPMode::ThreadSafe> Backend = GetSimulatedBackend())
+		{
+			Backend->Reseed(Args.Num() > 0
+				                ? FCString::Atoi(*Args[0])
+				                : UDreamSMTCSettings::Get()->SimulatedBackendSeed);
+			Backend->ResetStats();
+		}
+	}));
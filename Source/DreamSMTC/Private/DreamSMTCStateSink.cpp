@@ -0,0 +1,149 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCStateSink.h"
+
+#include "DreamSMTCLog.h"
+#include "DreamSMTCMemory.h"
+#include "DreamSMTCRemoteServer.h"
+#include "Async/Async.h"
+
+FDreamSMTCStateSinkRegistry::~FDreamSMTCStateSinkRegistry()
+{
+	Reset();
+}
+
+void FDreamSMTCStateSinkRegistry::Add(const FDreamSMTCStateSinkRef& Sink, EDreamSMTCSinkThread Thread,
+                                      const FDreamSMTCChangeSetRef& InitialState)
+{
+	Remove(Sink);
+
+	const FEntryRef& Entry = Entries.Add_GetRef(MakeShared<FEntry, ESPMode::ThreadSafe>(Sink, Thread));
+	Deliver(Entry, InitialState);
+}
+
+bool FDreamSMTCStateSinkRegistry::Remove(const FDreamSMTCStateSinkRef& Sink)
+{
+	const int32 Index = Entries.IndexOfByPredicate([&Sink](const FEntryRef& Entry) { return Entry->Sink == Sink; });
+	if (Index == INDEX_NONE)
+	{
+		return false;
+	}
+
+	// 仍在队列中的变更不再派发给它
+	Entries[Index]->bRemoved = true;
+	Entries.RemoveAt(Index);
+	return true;
+}
+
+void FDreamSMTCStateSinkRegistry::Reset()
+{
+	for (const FEntryRef& Entry : Entries)
+	{
+		Entry->bRemoved = true;
+	}
+	Entries.Reset();
+}
+
+void FDreamSMTCStateSinkRegistry::Dispatch(const FDreamSMTCChangeSetRef& ChangeSet)
+{
+	// 游戏线程的接收者可能在回调中增删接收者，遍历副本
+	const TArray<FEntryRef> Snapshot = Entries;
+	for (const FEntryRef& Entry : Snapshot)
+	{
+		if (!Entry->bRemoved)
+		{
+			Deliver(Entry, ChangeSet);
+		}
+	}
+}
+
+int32 FDreamSMTCStateSinkRegistry::GetQueuedChangeSets() const
+{
+	int32 Queued = 0;
+	for (const FEntryRef& Entry : Entries)
+	{
+		Queued += Entry->Queued.load(std::memory_order_relaxed);
+	}
+	return Queued;
+}
+
+void FDreamSMTCStateSinkRegistry::Deliver(const FEntryRef& Entry, const FDreamSMTCChangeSetRef& ChangeSet)
+{
+	if (Entry->Thread == EDreamSMTCSinkThread::GameThread)
+	{
+		Entry->Sink->OnStateChanged(ChangeSet);
+		return;
+	}
+
+	Entry->Queue.Enqueue(ChangeSet);
+	++Entry->Queued;
+
+	// 每个接收者同一时刻最多一个任务，保证按顺序处理
+	if (!Entry->bScheduled.exchange(true))
+	{
+		Async(EAsyncExecution::ThreadPool, [Entry]() { Drain(Entry); });
+	}
+}
+
+void FDreamSMTCStateSinkRegistry::Drain(const FEntryRef& Entry)
+{
+	DSMTC_LLM_SCOPE();
+	for (;;)
+	{
+		TSharedPtr<const FDreamSMTCChangeSet, ESPMode::ThreadSafe> ChangeSet;
+		while (Entry->Queue.Dequeue(ChangeSet))
+		{
+			--Entry->Queued;
+			if (!Entry->bRemoved)
+			{
+				Entry->Sink->OnStateChanged(ChangeSet.ToSharedRef());
+			}
+		}
+
+		// 释放标记后再检查一次，避免错过释放前刚入队的变更
+		Entry->bScheduled = false;
+		if (Entry->Queue.IsEmpty() || Entry->bScheduled.exchange(true))
+		{
+			return;
+		}
+	}
+}
+
+void FDreamSMTCLogStateSink::OnStateChanged(const FDreamSMTCChangeSetRef& ChangeSet)
+{
+	DSMTC_LOG(Log, TEXT("{\"seq\":%llu,\"changed\":\"%s\",\"state\":%s}"), ChangeSet->Sequence,
+	          *LexToString(ChangeSet->ChangedFields), *FDreamSMTCRemoteServer::SerializeState(ChangeSet->State));
+}
+
+FString LexToString(EDreamSMTCSessionField Fields)
+{
+	static const TPair<EDreamSMTCSessionField, const TCHAR*> Names[] = {
+		{EDreamSMTCSessionField::Enabled, TEXT("Enabled")},
+		{EDreamSMTCSessionField::Buttons, TEXT("Buttons")},
+		{EDreamSMTCSessionField::PlaybackStatus, TEXT("PlaybackStatus")},
+		{EDreamSMTCSessionField::PlaybackRate, TEXT("PlaybackRate")},
+		{EDreamSMTCSessionField::Shuffle, TEXT("Shuffle")},
+		{EDreamSMTCSessionField::AutoRepeat, TEXT("AutoRepeat")},
+		{EDreamSMTCSessionField::Type, TEXT("Type")},
+		{EDreamSMTCSessionField::AppMediaId, TEXT("AppMediaId")},
+		{EDreamSMTCSessionField::Music, TEXT("Music")},
+		{EDreamSMTCSessionField::Video, TEXT("Video")},
+		{EDreamSMTCSessionField::Image, TEXT("Image")},
+		{EDreamSMTCSessionField::Timeline, TEXT("Timeline")},
+		{EDreamSMTCSessionField::Thumbnail, TEXT("Thumbnail")},
+	};
+
+	FString Result;
+	for (const TPair<EDreamSMTCSessionField, const TCHAR*>& Name : Names)
+	{
+		if (EnumHasAnyFlags(Fields, Name.Key))
+		{
+			if (!Result.IsEmpty())
+			{
+				Result += TEXT(',');
+			}
+			Result += Name.Value;
+		}
+	}
+	return Result;
+}
@@ -8,740 +8,2285 @@
 #include "DreamSMTCSubsystem.h"
 
 #include "DreamSMTCTypes.h"
+#include "DreamSMTCBackend.h"
+#include "DreamSMTCDebugStats.h"
+#include "DreamSMTCHitchDetector.h"
+#include "DreamSMTCSimulatedBackend.h"
+#include "DreamSMTCWinRTBackend.h"
+#include "DreamSMTCSettings.h"
+#include "DreamSMTCMemory.h"
+#include "DreamSMTCSessionManager.h"
+#include "DreamSMTCSequenceBinding.h"
+#include "DreamSMTCThumbnail.h"
 #include "Async/Async.h"
-#include "Kismet/KismetRenderingLibrary.h"
-#include "Misc/AsyncTaskNotification.h"
+#include "Engine/Engine.h"
+#include "Engine/GameInstance.h"
+#include "Framework/Application/SlateApplication.h"
+#include "Misc/ScopeExit.h"
 
-#define CHECK_SMTC() \
-	if (!mediaPlayer.has_value()) mediaPlayer = MediaPlayer();
+// 进程内唯一的后端，所有实例共享，最后一个实例注销时释放
+static FCriticalSection GBackendLock;
+static TSharedPtr<IDreamSMTCBackend, ESPMode::ThreadSafe> GBackend;
+// 最后一个实例释放后端后为 true，仍在排队的工作线程任务不会重新创建后端
+static bool GBackendReleased = true;
 
-std::optional<winrt::Windows::Media::Playback::MediaPlayer> mediaPlayer;
-FDreamSMTCTimelineProperties GSmtcTimelineProperties;
+TArray<TFuture<bool>> UDreamSMTCSubsystem::DetachedShutdownWork;
 
-UDreamSMTCSubsystem::UDreamSMTCSubsystem()
+void UDreamSMTCSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 {
-	if (!mediaPlayer.has_value())
-		mediaPlayer = winrt::Windows::Media::Playback::MediaPlayer();
+	DSMTC_LLM_SCOPE();
+	Super::Initialize(Collection);
 
-	GetSystemMediaTransportControls().ButtonPressed(
-		[&](winrt::Windows::Media::SystemMediaTransportControls Sender,
-		    winrt::Windows::Media::SystemMediaTransportControlsButtonPressedEventArgs Args)
-		{
-			// 先在线程上下文中获取参数值
-			const EDreamSMTCButtonEvent ButtonEvent = static_cast<EDreamSMTCButtonEvent>(Args.Button());
-
-			// 通过异步任务派发到游戏线程执行
-			FAsyncTaskNotificationConfig Config;
-			AsyncTask(ENamedThreads::GameThread, [this, ButtonEvent]()
-			{
-				// 确保在游戏线程执行广播
-				ButtonPressed.Broadcast(ButtonEvent);
-			});
-		});
+	const UDreamSMTCSettings* Settings = UDreamSMTCSettings::Get();
+	UpdateScheduler.Configure(Settings->MaxBackendCallsPerSecond, Settings->LowPriorityFlushDelay,
+	                          Settings->HighPriorityReserve);
 
-	const auto commandManager = mediaPlayer->CommandManager();
-	commandManager.IsEnabled(false);
-}
+	// 编码在工作线程进行，模块需要先在游戏线程加载
+	FModuleManager::LoadModuleChecked<IModuleInterface>(TEXT("ImageWrapper"));
 
-UDreamSMTCSubsystem::~UDreamSMTCSubsystem()
-{
-	ClearAll();
-	SetEnabled(false);
-}
+	{
+		FScopeLock Lock(&GBackendLock);
+		GBackendReleased = false;
+	}
 
-winrt::Windows::Media::SystemMediaTransportControls UDreamSMTCSubsystem::GetSystemMediaTransportControls()
-{
-	if (!mediaPlayer.has_value())
-		mediaPlayer = winrt::Windows::Media::Playback::MediaPlayer();
+	// PIE 的多个客户端各自使用独立的会话文件、历史目录与远程端口
+	const FWorldContext* WorldContext = GetGameInstance()->GetWorldContext();
+	InstanceIndex = WorldContext ? FMath::Max(WorldContext->PIEInstance, 0) : 0;
 
-	return mediaPlayer->SystemMediaTransportControls();
-}
+	Callbacks->Owner = this;
+	ThumbnailJobs->Owner = this;
+	Callbacks->bInjectMediaKeys = Settings->bInjectMediaKeys;
+	if (Callbacks->bInjectMediaKeys)
+	{
+		MediaKeyMappingContext = Settings->MediaKeyMappingContext.LoadSynchronous();
+	}
 
-winrt::Windows::Media::SystemMediaTransportControlsDisplayUpdater
-UDreamSMTCSubsystem::GetSystemMediaTransportControlsDisplayUpdater()
-{
-	if (!mediaPlayer.has_value())
-		mediaPlayer = winrt::Windows::Media::Playback::MediaPlayer();
+	bInitialized = true;
+	RegisterChangeRequestHandlers();
 
-	return mediaPlayer->SystemMediaTransportControls().DisplayUpdater();
-}
+	if (Settings->bRestoreSessionOnStartup)
+	{
+		RestoreSession();
+	}
 
-void UDreamSMTCSubsystem::SetAutoRepeatMode(bool bAutoRepeatMode)
-{
-	try
+	if (Settings->bRecordListeningHistory)
 	{
-		GetSystemMediaTransportControls().AutoRepeatMode(bAutoRepeatMode
-			                                                 ? winrt::Windows::Media::MediaPlaybackAutoRepeatMode::List
-			                                                 : winrt::Windows::Media::MediaPlaybackAutoRepeatMode::None);
+		ListeningHistory = MakeUnique<FDreamSMTCListeningHistory>(Settings->ListeningHistoryCapacity,
+		                                                          Settings->ListeningHistoryMaxFileSize * 1024ll,
+		                                                          Settings->ListeningHistoryMaxFiles, InstanceIndex);
+		if (Settings->bExportListeningHistory)
+		{
+			ListeningHistory->StartExport();
+		}
 	}
-	catch (std::exception& e)
+
+	if (Settings->bLogStateChanges)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return;
+		LogSink = MakeShared<FDreamSMTCLogStateSink, ESPMode::ThreadSafe>();
+		AddStateSink(LogSink.ToSharedRef());
 	}
-}
 
-bool UDreamSMTCSubsystem::GetAutoRepeatMode() const
-{
-	try
+	if (Settings->bEnableRemoteControl)
 	{
-		return GetSystemMediaTransportControls().AutoRepeatMode() ==
-			winrt::Windows::Media::MediaPlaybackAutoRepeatMode::List;
+		StartRemoteServer();
 	}
-	catch (std::exception& e)
+
+	// 成为持有者时才把本地会话写入后端
+	FDreamSMTCSessionManager::Get().Register(this, SessionPriority);
+
+	if (FSlateApplication::IsInitialized())
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return false;
+		bApplicationActive = FSlateApplication::Get().IsActive();
+		ApplicationActivationHandle = FSlateApplication::Get().OnApplicationActivationStateChanged().AddUObject(
+			this, &UDreamSMTCSubsystem::OnApplicationActivationChanged);
 	}
+
+	UpdateIdleState();
 }
 
-void UDreamSMTCSubsystem::SetIsChannelDownEnabled(bool bEnable)
+void UDreamSMTCSubsystem::Deinitialize()
 {
-	try
-	{
-		GetSystemMediaTransportControls().IsChannelDownEnabled(bEnable);
-	}
-	catch (std::exception& e)
+	// 系统媒体服务响应慢时不能拖住关卡切换与退出，最多等待 ShutdownTimeout
+	const double ShutdownDeadline = FPlatformTime::Seconds() + UDreamSMTCSettings::Get()->ShutdownTimeout;
+
+	bInitialized = false;
+	UnbindSequencePlayer();
+	UnregisterChangeRequestHandlers(ShutdownDeadline);
+	FDreamSMTCSessionManager::Get().Unregister(this);
+
+	if (FSlateApplication::IsInitialized())
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return;
+		FSlateApplication::Get().OnApplicationActivationStateChanged().Remove(ApplicationActivationHandle);
 	}
-}
+	ApplicationActivationHandle.Reset();
 
-bool UDreamSMTCSubsystem::GetIsChannelDownEnabled() const
-{
-	try
+	if (TickerHandle.IsValid())
 	{
-		return GetSystemMediaTransportControls().IsChannelDownEnabled();
+		FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+		TickerHandle.Reset();
 	}
-	catch (std::exception& e)
+
+	ConsumePlaybackPublication();
+
+	// 最后一次变更也交给接收者，之后不再派发
+	DispatchStateChanges();
+	StateSinks.Reset();
+	LogSink.Reset();
+
+	if (RemoteServer)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return false;
+		RemoteServer->Shutdown();
+		RemoteServer.Reset();
 	}
-}
 
-void UDreamSMTCSubsystem::SetIsChannelUpEnabled(bool bEnable)
-{
-	try
+	if (ListeningHistory)
 	{
-		GetSystemMediaTransportControls().IsChannelUpEnabled(bEnable);
+		ListeningHistory->Shutdown();
+		ListeningHistory.Reset();
 	}
-	catch (std::exception& e)
+
+	// 定时器线程可能正卡在系统调用中，与其它关闭任务共用同一个期限
+	TFuture<bool> TimerShutdown =
+		SwitchTimers->Shutdown(FMath::Max(ShutdownDeadline - FPlatformTime::Seconds(), 0.0));
+	if (TimerShutdown.IsValid())
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return;
+		DetachedShutdownWork.Add(MoveTemp(TimerShutdown));
 	}
-}
+	StagedSwitches.Empty();
 
-bool UDreamSMTCSubsystem::GetIsChannelUpEnabled() const
-{
-	try
+	// 丢弃仍在进行中的封面任务
+	ThumbnailJobs->Invalidate();
+
+	TArray<TFuture<bool>, TInlineAllocator<2>> ShutdownWork;
+	ShutdownWork.Add(ReleaseBackendAsync());
+
+	// 最后一次变更接在仍在进行的保存之后写入，避免旧快照覆盖新快照
+	if (bSessionDirty && UDreamSMTCSettings::Get()->bPersistSession)
 	{
-		return GetSystemMediaTransportControls().IsChannelUpEnabled();
+		bSessionDirty = false;
+		SessionSaveTask = Async(EAsyncExecution::ThreadPool,
+		                        [State = Session, Previous = MoveTemp(SessionSaveTask), Index = InstanceIndex]() mutable
+		                        {
+			                        if (Previous.IsValid())
+			                        {
+				                        Previous.Wait();
+			                        }
+			                        return FDreamSMTCSessionSnapshot::Save(State, Index);
+		                        });
 	}
-	catch (std::exception& e)
+	if (SessionSaveTask.IsValid())
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return false;
+		ShutdownWork.Add(MoveTemp(SessionSaveTask));
 	}
-}
 
-void UDreamSMTCSubsystem::SetEnabled(bool bEnable) const
-{
-	try
+	DetachedShutdownWork.RemoveAll([](const TFuture<bool>& Work) { return Work.IsReady(); });
+	for (TFuture<bool>& Work : ShutdownWork)
 	{
-		GetSystemMediaTransportControls().IsEnabled(bEnable);
+		const double Remaining = FMath::Max(ShutdownDeadline - FPlatformTime::Seconds(), 0.0);
+		if (!Work.WaitFor(FTimespan::FromSeconds(Remaining)))
+		{
+			DetachedShutdownWork.Add(MoveTemp(Work));
+		}
 	}
-	catch (std::exception& e)
+	if (DetachedShutdownWork.Num() > 0)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return;
+		UE_LOG(LogDreamSMTC, Warning, TEXT("SMTC shutdown exceeded %.2fs, finishing in the background"),
+		       UDreamSMTCSettings::Get()->ShutdownTimeout);
 	}
+
+	Super::Deinitialize();
 }
 
-bool UDreamSMTCSubsystem::IsEnabled() const
+void UDreamSMTCSubsystem::GetMemoryUsage(FDreamSMTCMemoryUsage& Usage) const
 {
-	try
+	using FSharedImage = TSharedPtr<const FDreamSMTCSessionState::FEncodedImage, ESPMode::ThreadSafe>;
+
+	// 同一张图片可能同时被会话、占位图缓存与暂存的切换引用，只计一次
+	TSet<const void*, DefaultKeyFuncs<const void*>, TInlineSetAllocator<16>> CountedImages;
+	auto AddImage = [&Usage, &CountedImages](const FSharedImage& Image)
 	{
-		return GetSystemMediaTransportControls().IsEnabled();
-	}
-	catch (std::exception& e)
+		bool bAlreadyCounted = false;
+		if (Image.IsValid())
+		{
+			CountedImages.Add(Image.Get(), &bAlreadyCounted);
+			if (!bAlreadyCounted)
+			{
+				Usage[EDreamSMTCMemoryCategory::Thumbnails] += Image->GetAllocatedSize();
+			}
+		}
+	};
+
+	AddImage(Session.Thumbnail);
+	for (const auto& Entry : PlaceholderCache)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return false;
+		AddImage(Entry.Value);
 	}
-}
+	Usage[EDreamSMTCMemoryCategory::Thumbnails] += PlaceholderCache.GetAllocatedSize();
 
-void UDreamSMTCSubsystem::SetFastForwardEnabled(bool bEnable)
-{
-	try
+	Usage[EDreamSMTCMemoryCategory::Metadata] += sizeof(Session) + Session.GetAllocatedSize() +
+		CueTrack.GetAllocatedSize();
+	for (const TPair<int32, FStagedSwitchRef>& Pair : StagedSwitches)
 	{
-		GetSystemMediaTransportControls().IsFastForwardEnabled(bEnable);
+		FStagedSwitch& Switch = *Pair.Value;
+		Usage[EDreamSMTCMemoryCategory::Metadata] += sizeof(FStagedSwitch) + Switch.State.GetAllocatedSize();
+
+		FScopeLock Lock(&Switch.ThumbnailLock);
+		AddImage(Switch.EncodedThumbnail);
+		// 预先准备的系统流是编码数据的一份拷贝
+		if (Switch.PreparedThumbnail.IsValid() && Switch.EncodedThumbnail.IsValid())
+		{
+			Usage[EDreamSMTCMemoryCategory::Thumbnails] += Switch.EncodedThumbnail->Num();
+		}
 	}
-	catch (std::exception& e)
+
+	Usage[EDreamSMTCMemoryCategory::Queues] += StagedSwitches.GetAllocatedSize() + SwitchTimers->GetAllocatedSize();
+	if (ListeningHistory)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return;
+		Usage[EDreamSMTCMemoryCategory::Queues] += ListeningHistory->GetAllocatedSize();
 	}
+	// 排队中的变更集各自持有一份会话状态，按当前状态估算
+	Usage[EDreamSMTCMemoryCategory::Queues] += StateSinks.GetQueuedChangeSets() *
+		(sizeof(FDreamSMTCChangeSet) + Session.GetAllocatedSize());
 }
 
-bool UDreamSMTCSubsystem::GetFastForwardEnabled() const
+void UDreamSMTCSubsystem::GetDebugSnapshot(FDreamSMTCDebugSnapshot& OutSnapshot) const
 {
-	try
-	{
-		return GetSystemMediaTransportControls().IsFastForwardEnabled();
-	}
-	catch (std::exception& e)
-	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return false;
-	}
+	OutSnapshot.Session = Session;
+	OutSnapshot.PendingWrites = UpdateScheduler.GetPendingWrites();
+	OutSnapshot.bTimelineDeferred = bTimelineDeferred;
+	OutSnapshot.bSessionDirty = bSessionDirty;
+	OutSnapshot.bOwner = IsBackendOwner();
+	OutSnapshot.bIdle = IsIdle();
+	OutSnapshot.StagedSwitches = StagedSwitches.Num();
+	OutSnapshot.Scheduler = UpdateScheduler.GetStats();
+	OutSnapshot.CoalescedSeekRequests = GetCoalescedSeekRequestCount();
+	OutSnapshot.SeekRequests = DispatchedSeekRequests + OutSnapshot.CoalescedSeekRequests;
 }
 
-void UDreamSMTCSubsystem::SetNextEnabled(bool bEnable)
+void UDreamSMTCSubsystem::WaitForDetachedShutdownWork()
 {
-	try
+	for (TFuture<bool>& Work : DetachedShutdownWork)
 	{
-		GetSystemMediaTransportControls().IsNextEnabled(bEnable);
-	}
-	catch (std::exception& e)
-	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return;
+		Work.Wait();
 	}
+	DetachedShutdownWork.Empty();
 }
 
-bool UDreamSMTCSubsystem::GetNextEnabled() const
+TFuture<bool> UDreamSMTCSubsystem::ReleaseBackendAsync()
 {
-	try
+	// 其它会话仍在时，新的持有者已经整体覆盖了后端
+	if (FDreamSMTCSessionManager::Get().Num() > 0)
 	{
-		return GetSystemMediaTransportControls().IsNextEnabled();
+		return MakeFulfilledPromise<bool>(true).GetFuture();
 	}
-	catch (std::exception& e)
+
+	// 最后一个会话清空并关闭后端，剩余的写入不再需要
+	TSharedPtr<IDreamSMTCBackend, ESPMode::ThreadSafe> Backend;
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return false;
+		FScopeLock Lock(&GBackendLock);
+		Backend = MoveTemp(GBackend);
+		GBackendReleased = true;
 	}
+
+	return Async(EAsyncExecution::ThreadPool, [Backend = MoveTemp(Backend)]() mutable
+	{
+		if (!Backend.IsValid())
+		{
+			return true;
+		}
+
+		FString Error;
+		const bool bSuccess = Backend->Release(Error);
+		if (!bSuccess)
+		{
+			UE_LOG(LogDreamSMTC, Error, TEXT("Failed to release SMTC: %s"), *Error);
+		}
+		Backend.Reset();
+		return bSuccess;
+	});
 }
 
-void UDreamSMTCSubsystem::SetPauseEnabled(bool bEnable)
+bool UDreamSMTCSubsystem::Tick(float DeltaTime)
 {
-	try
-	{
-		GetSystemMediaTransportControls().IsPauseEnabled(bEnable);
-	}
-	catch (std::exception& e)
+	DSMTC_LLM_SCOPE();
+	Callbacks->bWakeRequested.store(false);
+
+	// 核心 Ticker 在玩家控制器处理输入之前运行，注入的按键在同一帧触发动作
+	if (Callbacks->bInjectMediaKeys)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return;
+		Callbacks->MediaKeys.Dispatch(GetGameInstance(), MediaKeyMappingContext,
+		                   UDreamSMTCSettings::Get()->MediaKeyMappingPriority);
 	}
-}
+	DispatchCoalescedSeekRequest();
+	ConsumePlaybackPublication();
 
-bool UDreamSMTCSubsystem::GetPauseEnabled() const
-{
-	try
+	const double Now = FPlatformTime::Seconds();
+	if (UpdateScheduler.HasPendingWrites())
 	{
-		return GetSystemMediaTransportControls().IsPauseEnabled();
+		CommitPendingWrites(UpdateScheduler.Poll(Now));
 	}
-	catch (std::exception& e)
+
+	TickSessionPersistence(Now);
+	TickRemoteServer();
+	DispatchStateChanges();
+	FDreamSMTCMemoryTracker::Get().Tick(Now);
+	PublishQueueDepths(Now);
+
+	UpdateIdleState();
+	if (!IsIdle() || HasPendingWork())
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return false;
+		return true;
 	}
+
+	// 空闲且没有剩余工作，返回 false 移除自身
+	TickerHandle.Reset();
+	UE_LOG(LogDreamSMTC, Verbose, TEXT("Ticker stopped while idle"));
+	return false;
 }
 
-void UDreamSMTCSubsystem::SetPlayEnabled(bool bEnable)
+void UDreamSMTCSubsystem::PublishQueueDepths(double Now) const
 {
-	try
-	{
-		GetSystemMediaTransportControls().IsPlayEnabled(bEnable);
-	}
-	catch (std::exception& e)
+	// 卡顿报告只关心持有系统控件的会话
+	if (!IsBackendOwner() || FDreamSMTCHitchDetector::GetThresholdSeconds() <= 0.0)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
 		return;
 	}
+
+	FDreamSMTCQueueDepths Depths;
+	Depths.Time = Now;
+	Depths.PendingWrites = UpdateScheduler.GetPendingWrites();
+	Depths.bTimelineDeferred = bTimelineDeferred;
+	Depths.bSeekPending = Callbacks->bSeekPending.load(std::memory_order_relaxed);
+	Depths.QueuedChangeSets = StateSinks.GetQueuedChangeSets();
+	Depths.StagedSwitches = StagedSwitches.Num();
+	FDreamSMTCHitchDetector::Get().PublishQueueDepths(Depths);
 }
 
-bool UDreamSMTCSubsystem::GetPlayEnabled() const
+bool UDreamSMTCSubsystem::ShouldIdle() const
 {
-	try
-	{
-		return GetSystemMediaTransportControls().IsPlayEnabled();
-	}
-	catch (std::exception& e)
+	switch (Session.PlaybackStatus)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return false;
+	case EDreamSMTCMediaPlaybackStatus::Closed:
+	case EDreamSMTCMediaPlaybackStatus::Stopped:
+	case EDreamSMTCMediaPlaybackStatus::Paused:
+		return true;
+	default:
+		break;
 	}
+
+	// 播放中失去焦点时系统会按播放速率推算进度，无需继续推送
+	return !bApplicationActive && UDreamSMTCSettings::Get()->bIdleWhenUnfocused;
 }
 
-void UDreamSMTCSubsystem::SetPreviousEnabled(bool bEnable)
+bool UDreamSMTCSubsystem::HasPendingWork() const
 {
-	try
-	{
-		GetSystemMediaTransportControls().IsPreviousEnabled(bEnable);
-	}
-	catch (std::exception& e)
-	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return;
-	}
+	return Callbacks->bWakeRequested.load() ||
+		Callbacks->bSeekPending.load() ||
+		Callbacks->MediaKeys.HasPending() ||
+		UpdateScheduler.HasPendingWrites() ||
+		PlaybackPublication.GetSequence() != ConsumedPlaybackSequence ||
+		(bSessionDirty && UDreamSMTCSettings::Get()->bPersistSession) ||
+		(bSinkStateDirty && StateSinks.HasSinks());
 }
 
-bool UDreamSMTCSubsystem::GetPreviousEnabled() const
+void UDreamSMTCSubsystem::UpdateIdleState()
 {
-	try
+	const bool bShouldIdle = ShouldIdle();
+	if (bShouldIdle != IsIdle())
 	{
-		return GetSystemMediaTransportControls().IsPreviousEnabled();
+		Callbacks->bIdle = bShouldIdle;
+		UE_LOG(LogDreamSMTC, Verbose, TEXT("%s idle state"), bShouldIdle ? TEXT("Entering") : TEXT("Leaving"));
+
+		// 恢复播放时补发空闲期间积累的进度
+		if (!bShouldIdle && bTimelineDeferred)
+		{
+			bTimelineDeferred = false;
+			EnqueueWrite(EDreamSMTCPendingWrite::Timeline, EDreamSMTCUpdatePriority::High);
+		}
+
+		IdleStateChanged.Broadcast(bShouldIdle);
 	}
-	catch (std::exception& e)
+
+	if (bInitialized && (!IsIdle() || HasPendingWork()) && !TickerHandle.IsValid())
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return false;
+		TickerHandle = FTSTicker::GetCoreTicker().AddTicker(
+			FTickerDelegate::CreateUObject(this, &UDreamSMTCSubsystem::Tick));
 	}
 }
 
-void UDreamSMTCSubsystem::SetRecordEnabled(bool bEnable)
+void UDreamSMTCSubsystem::SetSessionPriority(int32 Priority)
+{
+	SessionPriority = Priority;
+	FDreamSMTCSessionManager::Get().SetPriority(this, Priority);
+}
+
+void UDreamSMTCSubsystem::SetBackendOwner(bool bOwner)
 {
-	try
+	if (IsBackendOwner() == bOwner)
 	{
-		GetSystemMediaTransportControls().IsRecordEnabled(bEnable);
+		return;
 	}
-	catch (std::exception& e)
+
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return;
+		// 等待正在提交的封面结束，之后的任务都能看到新的归属
+		FScopeLock Lock(&ThumbnailJobs->ApplyLock);
+		ThumbnailJobs->bBackendOwner = bOwner;
 	}
-}
 
-bool UDreamSMTCSubsystem::GetRecordEnabled() const
-{
-	try
+	UE_LOG(LogDreamSMTC, Log, TEXT("%s %s the SMTC session owner"), *GetNameSafe(GetGameInstance()),
+	       bOwner ? TEXT("became") : TEXT("is no longer"));
+	if (bOwner)
 	{
-		return GetSystemMediaTransportControls().IsRecordEnabled();
+		PushSessionToBackend();
 	}
-	catch (std::exception& e)
+	else
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return false;
+		// 尚未提交的写入属于旧的持有者，丢弃
+		UpdateScheduler.Flush(FPlatformTime::Seconds());
+		bTimelineDeferred = false;
 	}
+	SessionOwnershipChanged.Broadcast(bOwner);
 }
 
-void UDreamSMTCSubsystem::SetRewindEnabled(bool bEnable)
+void UDreamSMTCSubsystem::PushSessionToBackend()
 {
-	try
+	// 覆盖上一个持有者留下的全部内容，只调用一次 Update
+	UpdateScheduler.Flush(FPlatformTime::Seconds());
+	bTimelineDeferred = false;
+
+	FString Error;
+	const TSharedPtr<IDreamSMTCBackend, ESPMode::ThreadSafe> Backend = GetBackend();
+	if (!Backend.IsValid())
 	{
-		GetSystemMediaTransportControls().IsRewindEnabled(bEnable);
+		return;
 	}
-	catch (std::exception& e)
+	if (!Backend->ClearAll(Error) ||
+		!Backend->WriteSession(Session, EDreamSMTCSessionField::All, DreamSMTCAllButtons, Error) ||
+		!CommitToBackend(EDreamSMTCPendingWrite::Display, Session.Timeline, Error))
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
+		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC session push failed: %s"), *Error);
 		return;
 	}
-}
 
-bool UDreamSMTCSubsystem::GetRewindEnabled() const
-{
-	try
-	{
-		return GetSystemMediaTransportControls().IsRewindEnabled();
-	}
-	catch (std::exception& e)
+	if (Session.Thumbnail.IsValid())
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return false;
+		const uint64 Generation = ThumbnailJobs->Invalidate();
+		Async(EAsyncExecution::ThreadPool, [Jobs = ThumbnailJobs, Generation, Encoded = Session.Thumbnail]()
+		{
+			FString ThumbnailError;
+			if (!ApplyThumbnailIfCurrent(*Jobs, Generation, *Encoded, false, ThumbnailError))
+			{
+				UE_LOG(LogDreamSMTC, Warning, TEXT("Pushing thumbnail failed: %s"), *ThumbnailError);
+			}
+		});
 	}
 }
 
-void UDreamSMTCSubsystem::SetStopEnabled(bool bEnable)
+void UDreamSMTCSubsystem::FCallbackState::RequestWake()
 {
-	try
+	// 同一时刻只排队一个唤醒任务
+	if (bWakeRequested.exchange(true))
 	{
-		GetSystemMediaTransportControls().IsStopEnabled(bEnable);
-	}
-	catch (std::exception& e)
-	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
 		return;
 	}
+
+	AsyncTask(ENamedThreads::GameThread, [WeakOwner = Owner]()
+	{
+		if (UDreamSMTCSubsystem* This = WeakOwner.Get())
+		{
+			This->UpdateIdleState();
+		}
+	});
 }
 
-bool UDreamSMTCSubsystem::GetStopEnabled() const
+void UDreamSMTCSubsystem::OnApplicationActivationChanged(bool bActive)
 {
-	try
-	{
-		return GetSystemMediaTransportControls().IsStopEnabled();
-	}
-	catch (std::exception& e)
-	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return false;
-	}
+	bApplicationActive = bActive;
+	UpdateIdleState();
 }
 
-void UDreamSMTCSubsystem::SetPlaybackRate(double Rate)
+void UDreamSMTCSubsystem::EnqueueWrite(EDreamSMTCPendingWrite Writes, EDreamSMTCUpdatePriority Priority)
 {
-	try
+	// 不持有系统控件时只更新本地会话
+	if (!IsBackendOwner())
 	{
-		GetSystemMediaTransportControls().PlaybackRate(Rate);
+		return;
 	}
-	catch (std::exception& e)
+
+	const double Now = FPlatformTime::Seconds();
+	UpdateScheduler.Enqueue(Writes, Priority, Now);
+
+	// 高优先级写入在预算允许时立即提交，其余等待 Tick
+	if (Priority == EDreamSMTCUpdatePriority::High)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return;
+		CommitPendingWrites(UpdateScheduler.Poll(Now));
 	}
+
+	UpdateIdleState();
 }
 
-double UDreamSMTCSubsystem::GetPlaybackRate() const
+void UDreamSMTCSubsystem::CommitPendingWrites(EDreamSMTCPendingWrite Writes)
 {
-	try
+	if (Writes == EDreamSMTCPendingWrite::None || !IsBackendOwner())
 	{
-		return GetSystemMediaTransportControls().PlaybackRate();
+		return;
 	}
-	catch (std::exception& e)
+
+	FString Error;
+	if (!CommitToBackend(Writes, Session.Timeline, Error))
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return -1.0f;
+		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *Error);
 	}
 }
 
-void UDreamSMTCSubsystem::SetPlaybackStatus(EDreamSMTCMediaPlaybackStatus Status)
+bool UDreamSMTCSubsystem::CommitToBackend(EDreamSMTCPendingWrite Writes, const FDreamSMTCTimelineProperties& Timeline,
+                                          FString& OutError)
 {
-	try
+	// 最后一个会话关闭后仍在排队的提交直接放弃，不重新创建后端
+	const TSharedPtr<IDreamSMTCBackend, ESPMode::ThreadSafe> Backend = GetBackend();
+	if (!Backend.IsValid())
+	{
+		OutError = TEXT("The SMTC backend has been released.");
+		return false;
+	}
+	if (EnumHasAnyFlags(Writes, EDreamSMTCPendingWrite::Timeline) && !Backend->WriteTimeline(Timeline, OutError))
 	{
-		GetSystemMediaTransportControls().PlaybackStatus(
-			static_cast<winrt::Windows::Media::MediaPlaybackStatus>(Status));
+		return false;
 	}
-	catch (std::exception& e)
+	if (EnumHasAnyFlags(Writes, EDreamSMTCPendingWrite::Display) && !Backend->Update(OutError))
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return;
+		return false;
 	}
+	return true;
 }
 
-EDreamSMTCMediaPlaybackStatus UDreamSMTCSubsystem::GetPlaybackStatus() const
+void UDreamSMTCSubsystem::FlushPendingUpdates()
 {
-	try
-	{
-		return static_cast<EDreamSMTCMediaPlaybackStatus>(GetSystemMediaTransportControls().PlaybackStatus());
-	}
-	catch (std::exception& e)
+	const double Now = FPlatformTime::Seconds();
+	if (bTimelineDeferred)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return EDreamSMTCMediaPlaybackStatus::Closed;
+		bTimelineDeferred = false;
+		UpdateScheduler.Enqueue(EDreamSMTCPendingWrite::Timeline, EDreamSMTCUpdatePriority::Low, Now);
 	}
+	CommitPendingWrites(UpdateScheduler.Flush(Now));
 }
 
-void UDreamSMTCSubsystem::SetShuffleEnabled(bool bEnable)
+void UDreamSMTCSubsystem::WriteSessionFields(EDreamSMTCSessionField Fields, uint32 ButtonMask)
 {
-	try
+	if (ListeningHistory && EnumHasAnyFlags(Fields, EDreamSMTCSessionField::PlaybackStatus))
 	{
-		GetSystemMediaTransportControls().ShuffleEnabled(bEnable);
+		ListeningHistory->RecordPlaybackStatus(Session.PlaybackStatus, Session.Timeline);
 	}
-	catch (std::exception& e)
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::PlaybackStatus | EDreamSMTCSessionField::PlaybackRate))
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return;
+		const bool bPlaying = Session.PlaybackStatus == EDreamSMTCMediaPlaybackStatus::Playing;
+		TimelineClock.SetRate(bPlaying ? Session.PlaybackRate : 0.0, FPlatformTime::Seconds());
+		RearmPositionSwitches();
 	}
-}
 
-bool UDreamSMTCSubsystem::GetShuffleEnabled() const
-{
-	try
-	{
-		return GetSystemMediaTransportControls().ShuffleEnabled();
-	}
-	catch (std::exception& e)
+	FString Error;
+	const TSharedPtr<IDreamSMTCBackend, ESPMode::ThreadSafe> Backend = IsBackendOwner() ? GetBackend() : nullptr;
+	if (Backend.IsValid() && !Backend->WriteSession(Session, Fields, ButtonMask, Error))
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return false;
+		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *Error);
 	}
+
+	// 在状态写入后再判断空闲，恢复播放时先更新状态再补发进度
+	MarkSessionChanged();
 }
 
-EDreamSMTCMediaSoundLevel UDreamSMTCSubsystem::GetSoundLevel() const
+void UDreamSMTCSubsystem::SetButtonEnabled(EDreamSMTCButtonEvent Button, bool bEnable)
 {
-	try
-	{
-		return static_cast<EDreamSMTCMediaSoundLevel>(GetSystemMediaTransportControls().SoundLevel());
-	}
-	catch (std::exception& e)
-	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return EDreamSMTCMediaSoundLevel::Muted;
-	}
+	const uint32 Bit = DreamSMTCButtonBit(Button);
+	SetEnabledButtons(bEnable ? Session.EnabledButtons | Bit : Session.EnabledButtons & ~Bit);
 }
 
-void UDreamSMTCSubsystem::SetAppMediaId(FString AppID)
+void UDreamSMTCSubsystem::SetEnabledButtons(int32 ButtonMask)
 {
-	try
-	{
-		GetSystemMediaTransportControlsDisplayUpdater().AppMediaId(*AppID);
-	}
-	catch (std::exception& e)
+	const uint32 NewButtons = static_cast<uint32>(ButtonMask) & DreamSMTCValidButtons;
+	const uint32 ChangedButtons = Session.EnabledButtons ^ NewButtons;
+	if (ChangedButtons == 0)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
 		return;
 	}
+
+	// 一次提交中只写入发生变化的按钮
+	Session.EnabledButtons = NewButtons;
+	WriteSessionFields(EDreamSMTCSessionField::Buttons, ChangedButtons);
 }
 
-FString UDreamSMTCSubsystem::GetAppMediaId() const
+int32 UDreamSMTCSubsystem::GetEnabledButtons() const
 {
-	try
-	{
-		return GetSystemMediaTransportControlsDisplayUpdater().AppMediaId().c_str();
-	}
-	catch (std::exception& e)
-	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return FString();
-	}
+	return static_cast<int32>(Session.EnabledButtons);
 }
 
-void UDreamSMTCSubsystem::SetImageProperties(FDreamSMTCImageDisplayProperties ImageDisplayProperties)
+bool UDreamSMTCSubsystem::IsButtonEnabled(EDreamSMTCButtonEvent Button) const
 {
-	try
-	{
-		GetSystemMediaTransportControlsDisplayUpdater().ImageProperties().Subtitle(*ImageDisplayProperties.Subtitle);
-		GetSystemMediaTransportControlsDisplayUpdater().ImageProperties().Title(*ImageDisplayProperties.Title);
-	}
-	catch (std::exception& e)
-	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-	}
+	return (Session.EnabledButtons & DreamSMTCButtonBit(Button)) != 0;
 }
 
-FDreamSMTCImageDisplayProperties UDreamSMTCSubsystem::GetImageProperties() const
+void UDreamSMTCSubsystem::MarkSessionChanged(bool bPositionOnly)
 {
-	try
+	const double Now = FPlatformTime::Seconds();
+	if (!bSessionDirty)
 	{
-		return FDreamSMTCImageDisplayProperties(
-			GetSystemMediaTransportControlsDisplayUpdater().ImageProperties().Title().c_str(),
-			GetSystemMediaTransportControlsDisplayUpdater().ImageProperties().Subtitle().c_str()
-		);
+		FirstUnsavedChangeTime = Now;
 	}
-	catch (std::exception& e)
+	bSessionDirty = true;
+	bSinkStateDirty = true;
+
+	// 播放中进度每帧都在变化，只有其它字段的变化才重新开始防抖
+	if (!bPositionOnly)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return FDreamSMTCImageDisplayProperties();
+		bSessionFieldsChanged = true;
+		LastSessionChangeTime = Now;
 	}
+	UpdateIdleState();
 }
 
-void UDreamSMTCSubsystem::SetMusicProperties(FDreamSMTCMusicDisplayProperties MusicDisplayProperties)
+void UDreamSMTCSubsystem::TickSessionPersistence(double Now)
 {
-	try
+	const UDreamSMTCSettings* Settings = UDreamSMTCSettings::Get();
+	if (!bSessionDirty || !Settings->bPersistSession)
 	{
-		GetSystemMediaTransportControlsDisplayUpdater().MusicProperties().AlbumArtist(
-			*MusicDisplayProperties.AlbumArtist);
-		GetSystemMediaTransportControlsDisplayUpdater().MusicProperties().
-		                                                AlbumTitle(*MusicDisplayProperties.AlbumTitle);
-		GetSystemMediaTransportControlsDisplayUpdater().MusicProperties().AlbumTrackCount(
-			MusicDisplayProperties.AlbumTrackCount);
-		GetSystemMediaTransportControlsDisplayUpdater().MusicProperties().Artist(*MusicDisplayProperties.Artist);
-		GetSystemMediaTransportControlsDisplayUpdater().MusicProperties().Title(*MusicDisplayProperties.Title);
-		GetSystemMediaTransportControlsDisplayUpdater().MusicProperties().TrackNumber(
-			MusicDisplayProperties.TrackNumber);
+		return;
 	}
-	catch (std::exception& e)
+
+	// 字段变化在安静一段时间后保存；只有进度变化或变化不断时按最长间隔保存
+	const bool bSettled = bSessionFieldsChanged && Now - LastSessionChangeTime >= Settings->SessionSaveDebounce;
+	const bool bOverdue = Now - FirstUnsavedChangeTime >= FMath::Max(Settings->SessionSaveMaxDelay,
+	                                                                 Settings->SessionSaveDebounce);
+	if (!bSettled && !bOverdue)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
 		return;
 	}
-}
 
-FDreamSMTCMusicDisplayProperties UDreamSMTCSubsystem::GetMusicProperties() const
-{
-	try
+	// 上一次保存尚未完成时推迟到下一帧
+	if (SessionSaveTask.IsValid() && !SessionSaveTask.IsReady())
 	{
-		TArray<FString> Genres;
-		for (auto Genre : GetSystemMediaTransportControlsDisplayUpdater().MusicProperties().Genres())
-		{
-			Genres.Add(Genre.c_str());
-		}
-		return FDreamSMTCMusicDisplayProperties(
-			GetSystemMediaTransportControlsDisplayUpdater().MusicProperties().AlbumArtist().c_str(),
-			GetSystemMediaTransportControlsDisplayUpdater().MusicProperties().AlbumTitle().c_str(),
-			GetSystemMediaTransportControlsDisplayUpdater().MusicProperties().AlbumTrackCount(),
-			GetSystemMediaTransportControlsDisplayUpdater().MusicProperties().Artist().c_str(),
-			Genres,
-			GetSystemMediaTransportControlsDisplayUpdater().MusicProperties().Title().c_str(),
-			GetSystemMediaTransportControlsDisplayUpdater().MusicProperties().TrackNumber()
-		);
+		return;
 	}
-	catch (std::exception& e)
+
+	bSessionDirty = false;
+	bSessionFieldsChanged = false;
+	SessionSaveTask = Async(EAsyncExecution::ThreadPool, [State = Session, Index = InstanceIndex]()
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return FDreamSMTCMusicDisplayProperties();
-	}
+		DSMTC_LLM_SCOPE();
+		return FDreamSMTCSessionSnapshot::Save(State, Index);
+	});
 }
 
-void UDreamSMTCSubsystem::SetVideoProperties(FDreamSMTCVideoDisplayProperties VideoDisplayProperties)
+void UDreamSMTCSubsystem::RestoreSession()
 {
-	try
+	FDreamSMTCSessionState Restored;
+	if (!FDreamSMTCSessionSnapshot::Load(Restored, InstanceIndex))
 	{
-		GetSystemMediaTransportControlsDisplayUpdater().VideoProperties().Subtitle(*VideoDisplayProperties.Subtitle);
-		GetSystemMediaTransportControlsDisplayUpdater().VideoProperties().Title(*VideoDisplayProperties.Title);
+		return;
 	}
-	catch (std::exception& e)
+
+	// 启动时游戏并未在播放
+	if (Restored.PlaybackStatus == EDreamSMTCMediaPlaybackStatus::Playing ||
+		Restored.PlaybackStatus == EDreamSMTCMediaPlaybackStatus::Changing)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
+		Restored.PlaybackStatus = EDreamSMTCMediaPlaybackStatus::Paused;
 	}
+	Session = MoveTemp(Restored);
+	PlayQueue.SetShuffleEnabled(Session.bShuffleEnabled);
+	PlayQueue.SetRepeatMode(Session.AutoRepeatMode);
+
+	FDreamSMTCPlaybackSnapshot Published;
+	Published.Timeline = Session.Timeline;
+	Published.PlaybackRate = Session.PlaybackRate;
+	Published.PlaybackStatus = Session.PlaybackStatus;
+	ConsumedPlaybackSequence = PlaybackPublication.Write(Published);
+
+	// 后端在本会话成为持有者时整体写入
+	UE_LOG(LogDreamSMTC, Log, TEXT("Restored SMTC session from %s"),
+	       *FDreamSMTCSessionSnapshot::GetSnapshotPath(InstanceIndex));
 }
 
-FDreamSMTCVideoDisplayProperties UDreamSMTCSubsystem::GetVideoProperties() const
+TSharedPtr<IDreamSMTCBackend, ESPMode::ThreadSafe> UDreamSMTCSubsystem::GetBackend()
 {
-	try
+	FScopeLock Lock(&GBackendLock);
+	if (!GBackend.IsValid() && !GBackendReleased)
 	{
-		TArray<FString> Genres;
-		for (auto Genre : GetSystemMediaTransportControlsDisplayUpdater().VideoProperties().Genres())
+#if PLATFORM_WINDOWS || PLATFORM_HOLOLENS
+		if (!UDreamSMTCSettings::Get()->bUseSimulatedBackend)
 		{
-			Genres.Add(Genre.c_str());
+			GBackend = MakeShared<FDreamSMTCWinRTBackend, ESPMode::ThreadSafe>();
 		}
-		return FDreamSMTCVideoDisplayProperties(
-			Genres,
-			GetSystemMediaTransportControlsDisplayUpdater().VideoProperties().Subtitle().c_str(),
-			GetSystemMediaTransportControlsDisplayUpdater().VideoProperties().Title().c_str()
-		);
-	}
-	catch (std::exception& e)
-	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return FDreamSMTCVideoDisplayProperties();
+		else
+#endif
+		{
+			GBackend = FDreamSMTCSimulatedBackend::CreateFromSettings();
+		}
+		// 所有调用都计时，超过 DreamSMTC.HitchThresholdMs 时写卡顿报告
+		GBackend = MakeShared<FDreamSMTCTimedBackend, ESPMode::ThreadSafe>(GBackend.ToSharedRef());
+		UE_LOG(LogDreamSMTC, Log, TEXT("Using the %s SMTC backend"), GBackend->GetName());
 	}
+	return GBackend;
 }
 
-void UDreamSMTCSubsystem::SetThumbnail(UTexture2D* InThumbnail)
+void UDreamSMTCSubsystem::SetAutoRepeatMode(bool bAutoRepeatMode)
 {
-	if (!InThumbnail)
-	{
-		UE_LOG(LogDreamSMTC, Warning, TEXT("Invalid thumbnail texture."));
-		return;
-	}
-
-	// 定义缓存路径
-	FString FilePath = FPaths::ProjectSavedDir() / TEXT("DreamSMTCCache");
-	FString FileName = TEXT("ThumbnailCache.jpg");
-	FString FileFullName = FPaths::Combine(FilePath, FileName);
+	SetAutoRepeat(bAutoRepeatMode ? EDreamSMTCAutoRepeatMode::List : EDreamSMTCAutoRepeatMode::None);
+}
 
-	// 确保目录存在
-	IFileManager::Get().MakeDirectory(*FilePath, true);
+bool UDreamSMTCSubsystem::GetAutoRepeatMode() const
+{
+	return Session.AutoRepeatMode == EDreamSMTCAutoRepeatMode::List;
+}
 
-	// 同步保存纹理到文件
-	UKismetRenderingLibrary::ExportTexture2D(GetWorld(), InThumbnail, FilePath, FileName);
+void UDreamSMTCSubsystem::SetAutoRepeat(EDreamSMTCAutoRepeatMode Mode)
+{
+	Session.AutoRepeatMode = Mode;
+	PlayQueue.SetRepeatMode(Mode);
+	WriteSessionFields(EDreamSMTCSessionField::AutoRepeat);
+}
 
-	// 转换为 WinRT 兼容路径
-	FString FullPath = FPaths::ConvertRelativePathToFull(FileFullName);
-	FullPath.ReplaceInline(TEXT("/"), TEXT("\\"));
-	std::wstring winrtPath = *FullPath;
+EDreamSMTCAutoRepeatMode UDreamSMTCSubsystem::GetAutoRepeat() const
+{
+	return Session.AutoRepeatMode;
+}
 
-	// 异步获取文件并设置缩略图
-	AsyncTask(ENamedThreads::GameThread, [this, winrtPath]()
+void UDreamSMTCSubsystem::SetIsChannelDownEnabled(bool bEnable)
+{
+	SetButtonEnabled(EDreamSMTCButtonEvent::ChannelDown, bEnable);
+}
+
+bool UDreamSMTCSubsystem::GetIsChannelDownEnabled() const
+{
+	return IsButtonEnabled(EDreamSMTCButtonEvent::ChannelDown);
+}
+
+void UDreamSMTCSubsystem::SetIsChannelUpEnabled(bool bEnable)
+{
+	SetButtonEnabled(EDreamSMTCButtonEvent::ChannelUp, bEnable);
+}
+
+bool UDreamSMTCSubsystem::GetIsChannelUpEnabled() const
+{
+	return IsButtonEnabled(EDreamSMTCButtonEvent::ChannelUp);
+}
+
+void UDreamSMTCSubsystem::SetEnabled(bool bEnable)
+{
+	Session.bEnabled = bEnable;
+	WriteSessionFields(EDreamSMTCSessionField::Enabled);
+}
+
+bool UDreamSMTCSubsystem::IsEnabled() const
+{
+	return Session.bEnabled;
+}
+
+void UDreamSMTCSubsystem::SetFastForwardEnabled(bool bEnable)
+{
+	SetButtonEnabled(EDreamSMTCButtonEvent::FastForward, bEnable);
+}
+
+bool UDreamSMTCSubsystem::GetFastForwardEnabled() const
+{
+	return IsButtonEnabled(EDreamSMTCButtonEvent::FastForward);
+}
+
+void UDreamSMTCSubsystem::SetNextEnabled(bool bEnable)
+{
+	SetButtonEnabled(EDreamSMTCButtonEvent::Next, bEnable);
+}
+
+bool UDreamSMTCSubsystem::GetNextEnabled() const
+{
+	return IsButtonEnabled(EDreamSMTCButtonEvent::Next);
+}
+
+void UDreamSMTCSubsystem::SetPauseEnabled(bool bEnable)
+{
+	SetButtonEnabled(EDreamSMTCButtonEvent::Pause, bEnable);
+}
+
+bool UDreamSMTCSubsystem::GetPauseEnabled() const
+{
+	return IsButtonEnabled(EDreamSMTCButtonEvent::Pause);
+}
+
+void UDreamSMTCSubsystem::SetPlayEnabled(bool bEnable)
+{
+	SetButtonEnabled(EDreamSMTCButtonEvent::Play, bEnable);
+}
+
+bool UDreamSMTCSubsystem::GetPlayEnabled() const
+{
+	return IsButtonEnabled(EDreamSMTCButtonEvent::Play);
+}
+
+void UDreamSMTCSubsystem::SetPreviousEnabled(bool bEnable)
+{
+	SetButtonEnabled(EDreamSMTCButtonEvent::Previous, bEnable);
+}
+
+bool UDreamSMTCSubsystem::GetPreviousEnabled() const
+{
+	return IsButtonEnabled(EDreamSMTCButtonEvent::Previous);
+}
+
+void UDreamSMTCSubsystem::SetRecordEnabled(bool bEnable)
+{
+	SetButtonEnabled(EDreamSMTCButtonEvent::Record, bEnable);
+}
+
+bool UDreamSMTCSubsystem::GetRecordEnabled() const
+{
+	return IsButtonEnabled(EDreamSMTCButtonEvent::Record);
+}
+
+void UDreamSMTCSubsystem::SetRewindEnabled(bool bEnable)
+{
+	SetButtonEnabled(EDreamSMTCButtonEvent::Rewind, bEnable);
+}
+
+bool UDreamSMTCSubsystem::GetRewindEnabled() const
+{
+	return IsButtonEnabled(EDreamSMTCButtonEvent::Rewind);
+}
+
+void UDreamSMTCSubsystem::SetStopEnabled(bool bEnable)
+{
+	SetButtonEnabled(EDreamSMTCButtonEvent::Stop, bEnable);
+}
+
+bool UDreamSMTCSubsystem::GetStopEnabled() const
+{
+	return IsButtonEnabled(EDreamSMTCButtonEvent::Stop);
+}
+
+void UDreamSMTCSubsystem::SetPlaybackRate(double Rate)
+{
+	// 读取不写共享内存，重复设置相同的值时不占用写锁
+	const FDreamSMTCPlaybackSnapshot Published = PlaybackPublication.Read();
+	if (!IsInGameThread())
+	{
+		if (Published.PlaybackRate == Rate)
+		{
+			return;
+		}
+		PlaybackPublication.Modify([Rate](FDreamSMTCPlaybackSnapshot& Snapshot)
+		{
+			Snapshot.PlaybackRate = Rate;
+			Snapshot.ChangedFields |= EDreamSMTCSessionField::PlaybackRate;
+		});
+		RequestWake();
+		return;
+	}
+
+	if (Published.PlaybackRate == Rate && Session.PlaybackRate == Rate)
+	{
+		return;
+	}
+	Session.PlaybackRate = Rate;
+	if (Published.PlaybackRate != Rate)
+	{
+		PlaybackPublication.Modify([Rate](FDreamSMTCPlaybackSnapshot& Snapshot) { Snapshot.PlaybackRate = Rate; });
+	}
+	WriteSessionFields(EDreamSMTCSessionField::PlaybackRate);
+}
+
+double UDreamSMTCSubsystem::GetPlaybackRate() const
+{
+	return Session.PlaybackRate;
+}
+
+void UDreamSMTCSubsystem::SetPlaybackStatus(EDreamSMTCMediaPlaybackStatus Status)
+{
+	const FDreamSMTCPlaybackSnapshot Published = PlaybackPublication.Read();
+	if (!IsInGameThread())
+	{
+		if (Published.PlaybackStatus == Status)
+		{
+			return;
+		}
+		PlaybackPublication.Modify([Status](FDreamSMTCPlaybackSnapshot& Snapshot)
+		{
+			Snapshot.PlaybackStatus = Status;
+			Snapshot.ChangedFields |= EDreamSMTCSessionField::PlaybackStatus;
+		});
+		RequestWake();
+		return;
+	}
+
+	if (Published.PlaybackStatus == Status && Session.PlaybackStatus == Status)
+	{
+		return;
+	}
+	Session.PlaybackStatus = Status;
+	if (Published.PlaybackStatus != Status)
+	{
+		PlaybackPublication.Modify([Status](FDreamSMTCPlaybackSnapshot& Snapshot)
+		{
+			Snapshot.PlaybackStatus = Status;
+		});
+	}
+	WriteSessionFields(EDreamSMTCSessionField::PlaybackStatus);
+}
+
+EDreamSMTCMediaPlaybackStatus UDreamSMTCSubsystem::GetPlaybackStatus() const
+{
+	return Session.PlaybackStatus;
+}
+
+void UDreamSMTCSubsystem::SetShuffleEnabled(bool bEnable)
+{
+	Session.bShuffleEnabled = bEnable;
+	PlayQueue.SetShuffleEnabled(bEnable);
+	WriteSessionFields(EDreamSMTCSessionField::Shuffle);
+}
+
+bool UDreamSMTCSubsystem::GetShuffleEnabled() const
+{
+	return Session.bShuffleEnabled;
+}
+
+EDreamSMTCMediaSoundLevel UDreamSMTCSubsystem::GetSoundLevel() const
+{
+	const TSharedPtr<IDreamSMTCBackend, ESPMode::ThreadSafe> Backend = GetBackend();
+	return Backend.IsValid() ? Backend->GetSoundLevel() : EDreamSMTCMediaSoundLevel::Full;
+}
+
+void UDreamSMTCSubsystem::SetAppMediaId(FString AppID)
+{
+	DSMTC_LLM_SCOPE();
+	Session.AppMediaId = AppID;
+	WriteSessionFields(EDreamSMTCSessionField::AppMediaId);
+}
+
+FString UDreamSMTCSubsystem::GetAppMediaId() const
+{
+	return Session.AppMediaId;
+}
+
+void UDreamSMTCSubsystem::SetImageProperties(FDreamSMTCImageDisplayProperties ImageDisplayProperties)
+{
+	DSMTC_LLM_SCOPE();
+	// 轨道播放期间由调用方设置的内容作为新的恢复目标
+	if (!bApplyingCue && CueBaseType == EDreamSMTCMediaPlaybackType::Image)
+	{
+		CueBaseDisplay.Title = ImageDisplayProperties.Title;
+		CueBaseDisplay.Subtitle = ImageDisplayProperties.Subtitle;
+	}
+	Session.Image = ImageDisplayProperties;
+	WriteSessionFields(EDreamSMTCSessionField::Image);
+}
+
+FDreamSMTCImageDisplayProperties UDreamSMTCSubsystem::GetImageProperties() const
+{
+	return Session.Image;
+}
+
+void UDreamSMTCSubsystem::SetMusicProperties(FDreamSMTCMusicDisplayProperties MusicDisplayProperties)
+{
+	DSMTC_LLM_SCOPE();
+	// 旧曲目在切换前的进度用于判断是否跳过；歌词等提示不是新曲目
+	if (ListeningHistory && !bApplyingCue)
+	{
+		ListeningHistory->RecordTrackChange(MusicDisplayProperties, Session.Timeline);
+	}
+
+	if (!bApplyingCue && CueBaseType == EDreamSMTCMediaPlaybackType::Music)
+	{
+		CueBaseDisplay.Title = MusicDisplayProperties.Title;
+		CueBaseDisplay.Subtitle = MusicDisplayProperties.Artist;
+	}
+	Session.Music = MusicDisplayProperties;
+	WriteSessionFields(EDreamSMTCSessionField::Music);
+}
+
+FDreamSMTCMusicDisplayProperties UDreamSMTCSubsystem::GetMusicProperties() const
+{
+	return Session.Music;
+}
+
+void UDreamSMTCSubsystem::SetVideoProperties(FDreamSMTCVideoDisplayProperties VideoDisplayProperties)
+{
+	DSMTC_LLM_SCOPE();
+	if (!bApplyingCue && CueBaseType == EDreamSMTCMediaPlaybackType::Video)
+	{
+		CueBaseDisplay.Title = VideoDisplayProperties.Title;
+		CueBaseDisplay.Subtitle = VideoDisplayProperties.Subtitle;
+	}
+	Session.Video = VideoDisplayProperties;
+	WriteSessionFields(EDreamSMTCSessionField::Video);
+}
+
+FDreamSMTCVideoDisplayProperties UDreamSMTCSubsystem::GetVideoProperties() const
+{
+	return Session.Video;
+}
+
+void UDreamSMTCSubsystem::SetThumbnail(UTexture2D* InThumbnail)
+{
+	SetThumbnailAsync(InThumbnail);
+}
+
+void UDreamSMTCSubsystem::SetThumbnailAsync(UTexture2D* InThumbnail, FAsyncCallback&& OnDone)
+{
+	DSMTC_LLM_SCOPE();
+	const double RequestTime = FPlatformTime::Seconds();
+	if (!InThumbnail)
+	{
+		UE_LOG(LogDreamSMTC, Warning, TEXT("Invalid thumbnail texture."));
+		FinishAsync(this, MoveTemp(OnDone), false, RequestTime, RequestTime, RequestTime,
+		            TEXT("Invalid thumbnail texture."));
+		return;
+	}
+
+	Thumbnail = InThumbnail;
+
+	using FEncodedImage = FDreamSMTCSessionState::FEncodedImage;
+	using FSharedImage = TSharedPtr<const FEncodedImage, ESPMode::ThreadSafe>;
+
+	// 新的请求使仍在进行中的旧任务失效
+	const uint64 Generation = ThumbnailJobs->Invalidate();
+	const UDreamSMTCSettings* Settings = UDreamSMTCSettings::Get();
+	const bool bProgressive = Settings->bProgressiveThumbnail;
+	const int32 PlaceholderSize = Settings->ThumbnailPlaceholderSize;
+
+	// 切回最近用过的封面时，本帧就提交缓存的占位图
+	FSharedImage CachedPlaceholder;
+	if (bProgressive)
+	{
+		PlaceholderCache.RemoveAll([](const auto& Entry) { return !Entry.Key.IsValid(); });
+		for (const auto& Entry : PlaceholderCache)
+		{
+			if (Entry.Key == InThumbnail)
+			{
+				CachedPlaceholder = Entry.Value;
+				break;
+			}
+		}
+		FDreamSMTCDebugStats::Get().RecordPlaceholderLookup(CachedPlaceholder.IsValid());
+	}
+	if (CachedPlaceholder.IsValid())
+	{
+		Async(EAsyncExecution::ThreadPool, [Jobs = ThumbnailJobs, Generation, CachedPlaceholder]()
+		{
+			FString Error;
+			ApplyThumbnailIfCurrent(*Jobs, Generation, *CachedPlaceholder, true, Error);
+		});
+	}
+
+	// 回调可能在读回失败时立即执行，先包装成可共享的对象
+	TSharedRef<FAsyncCallback> SharedOnDone = MakeShared<FAsyncCallback>(MoveTemp(OnDone));
+	TWeakObjectPtr<UDreamSMTCSubsystem> WeakThis(this);
+	TWeakObjectPtr<UTexture2D> WeakTexture(InThumbnail);
+	const bool bNeedsPlaceholder = bProgressive && !CachedPlaceholder.IsValid();
+
+	// 渲染线程回读像素，工作线程先提交占位图，再编码完整图片并提交给系统
+	const bool bQueued = FDreamSMTCThumbnail::ReadPixelsAsync(InThumbnail,
+		[WeakThis, WeakTexture, SharedOnDone, RequestTime, Jobs = ThumbnailJobs, Generation, bNeedsPlaceholder,
+			PlaceholderSize](TArray<FColor>&& Pixels, FIntPoint Size)
+		{
+			Async(EAsyncExecution::ThreadPool, [WeakThis, WeakTexture, SharedOnDone, RequestTime, Jobs, Generation,
+				        bNeedsPlaceholder, PlaceholderSize, Pixels = MoveTemp(Pixels), Size]()
+			{
+				DSMTC_LLM_SCOPE();
+				const double WorkStartTime = FPlatformTime::Seconds();
+				auto IsCurrent = [&Jobs, Generation]() { return Jobs->Generation.load() == Generation; };
+				FString Error;
+
+				if (bNeedsPlaceholder && IsCurrent())
+				{
+					TArray<FColor> SmallPixels;
+					FIntPoint SmallSize;
+					FDreamSMTCThumbnail::Downsample(Pixels, Size, PlaceholderSize, SmallPixels, SmallSize);
+
+					TSharedRef<FEncodedImage, ESPMode::ThreadSafe> Placeholder =
+						MakeShared<FEncodedImage, ESPMode::ThreadSafe>();
+					if (FDreamSMTCThumbnail::Encode(SmallPixels, SmallSize, 75, *Placeholder) &&
+						ApplyThumbnailIfCurrent(*Jobs, Generation, *Placeholder, true, Error))
+					{
+						AsyncTask(ENamedThreads::GameThread, [WeakThis, WeakTexture, Placeholder]()
+						{
+							if (WeakThis.IsValid())
+							{
+								auto& Cache = WeakThis->PlaceholderCache;
+								Cache.RemoveAll([&WeakTexture](const auto& Entry) { return Entry.Key == WeakTexture; });
+								if (Cache.Num() >= MaxCachedPlaceholders)
+								{
+									Cache.RemoveAt(0);
+								}
+								Cache.Emplace(WeakTexture, Placeholder);
+							}
+						});
+					}
+				}
+
+				bool bSuccess = false;
+				TSharedRef<FEncodedImage, ESPMode::ThreadSafe> Encoded = MakeShared<FEncodedImage, ESPMode::ThreadSafe>();
+				if (!IsCurrent())
+				{
+					Error = TEXT("Superseded by a newer thumbnail.");
+				}
+				else if (!FDreamSMTCThumbnail::Encode(Pixels, Size, 90, *Encoded))
+				{
+					Error = TEXT("Thumbnail readback or encoding failed.");
+				}
+				else
+				{
+					bSuccess = ApplyThumbnailIfCurrent(*Jobs, Generation, *Encoded, false, Error);
+				}
+
+				if (bSuccess)
+				{
+					// 编码结果保存在会话状态中，供下次启动恢复；期间被新封面或 ClearAll 取代时不再写入
+					AsyncTask(ENamedThreads::GameThread, [WeakThis, Jobs, Generation, Encoded]()
+					{
+						if (WeakThis.IsValid() && Jobs->Generation.load() == Generation)
+						{
+							WeakThis->Session.Thumbnail = Encoded;
+							WeakThis->MarkSessionChanged();
+						}
+					});
+				}
+				FinishAsync(WeakThis, MoveTemp(*SharedOnDone), bSuccess, RequestTime, WorkStartTime,
+				            FPlatformTime::Seconds(), MoveTemp(Error));
+			});
+		});
+
+	if (!bQueued)
+	{
+		FinishAsync(this, MoveTemp(*SharedOnDone), false, RequestTime, RequestTime, RequestTime,
+		            TEXT("Thumbnail texture has no render resource."));
+	}
+}
+
+bool UDreamSMTCSubsystem::ApplyThumbnailIfCurrent(FThumbnailJobs& Jobs, uint64 Generation,
+                                                  const FDreamSMTCSessionState::FEncodedImage& Encoded,
+                                                  bool bPlaceholder, FString& OutError)
+{
+	auto IsSuperseded = [&Jobs, Generation, &OutError]()
+	{
+		if (Jobs.Generation.load() != Generation)
+		{
+			OutError = TEXT("Superseded by a newer thumbnail.");
+			return true;
+		}
+		return false;
+	};
+	if (IsSuperseded())
+	{
+		return false;
+	}
+
+	// 写入内存流会阻塞，放在锁外进行，游戏线程切换所有权时不必等待它；每次请求各自的流，互不覆盖
+	TSharedPtr<FDreamSMTCPreparedThumbnail, ESPMode::ThreadSafe> Prepared;
+	if (Jobs.bBackendOwner)
+	{
+		Prepared = FDreamSMTCThumbnail::Prepare(Encoded, OutError);
+		if (!Prepared.IsValid())
+		{
+			return false;
+		}
+	}
+
+	bool bStaged = false;
+	{
+		FScopeLock Lock(&Jobs.ApplyLock);
+		if (IsSuperseded())
+		{
+			return false;
+		}
+		// 缓存的占位图在单独的任务中提交，可能晚于同代的完整图片
+		if (bPlaceholder && Jobs.FullAppliedGeneration == Generation)
+		{
+			return true;
+		}
+		// 不持有系统控件时封面只保存在本地会话中
+		if (Jobs.bBackendOwner && Prepared.IsValid())
+		{
+			if (!FDreamSMTCThumbnail::SetPrepared(*Prepared, OutError))
+			{
+				return false;
+			}
+			bStaged = true;
+		}
+		if (!bPlaceholder)
+		{
+			Jobs.FullAppliedGeneration = Generation;
+		}
+	}
+
+	// 提交与其它写入一样经过调度器的预算
+	if (bStaged)
+	{
+		AsyncTask(ENamedThreads::GameThread, [WeakOwner = Jobs.Owner, Generation]()
+		{
+			UDreamSMTCSubsystem* This = WeakOwner.Get();
+			if (This && This->ThumbnailJobs->Generation.load() == Generation)
+			{
+				This->EnqueueWrite(EDreamSMTCPendingWrite::Display, EDreamSMTCUpdatePriority::High);
+			}
+		});
+	}
+	return true;
+}
+
+void UDreamSMTCSubsystem::CommitAsync(FAsyncCallback&& OnDone)
+{
+	const double RequestTime = FPlatformTime::Seconds();
+	// 其它会话持有系统控件时没有任何内容送达系统
+	if (!IsBackendOwner())
+	{
+		FinishAsync(this, MoveTemp(OnDone), false, RequestTime, RequestTime, RequestTime,
+		            TEXT("This session does not own the OS media controls."));
+		return;
+	}
+
+	const EDreamSMTCPendingWrite Writes = UpdateScheduler.Flush(RequestTime) | EDreamSMTCPendingWrite::Display;
+	const FDreamSMTCTimelineProperties Timeline = Session.Timeline;
+
+	Async(EAsyncExecution::ThreadPool,
+	      [WeakThis = TWeakObjectPtr<UDreamSMTCSubsystem>(this), OnDone = MoveTemp(OnDone), RequestTime, Writes,
+		      Timeline]() mutable
+	      {
+		      const double WorkStartTime = FPlatformTime::Seconds();
+		      FString Error;
+		      const bool bSuccess = CommitToBackend(Writes, Timeline, Error);
+		      FinishAsync(WeakThis, MoveTemp(OnDone), bSuccess, RequestTime, WorkStartTime, FPlatformTime::Seconds(),
+		                  MoveTemp(Error));
+	      });
+}
+
+void UDreamSMTCSubsystem::FinishAsync(TWeakObjectPtr<UDreamSMTCSubsystem> WeakThis, FAsyncCallback&& OnDone,
+                                      bool bSuccess, double RequestTime, double WorkStartTime, double WorkEndTime,
+                                      FString&& Error)
+{
+	AsyncTask(ENamedThreads::GameThread, [WeakThis, OnDone = MoveTemp(OnDone), bSuccess, RequestTime, WorkStartTime,
+		          WorkEndTime, Error = MoveTemp(Error)]() mutable
+	          {
+		          // 会话已关闭时仍然回调并报告失败，等待结果的异步节点才能结束
+		          if (!WeakThis.IsValid())
+		          {
+			          bSuccess = false;
+			          Error = TEXT("The media session was shut down before the request finished.");
+		          }
+		          if (!bSuccess)
+		          {
+			          UE_LOG(LogDreamSMTC, Error, TEXT("SMTC async request failed: %s"), *Error);
+		          }
+		          if (!OnDone)
+		          {
+			          return;
+		          }
+
+		          FDreamSMTCAsyncTiming Timing;
+		          Timing.QueueMilliseconds = (WorkStartTime - RequestTime) * 1000.0;
+		          Timing.WorkMilliseconds = (WorkEndTime - WorkStartTime) * 1000.0;
+		          Timing.TotalMilliseconds = (FPlatformTime::Seconds() - RequestTime) * 1000.0;
+		          OnDone(bSuccess, Timing, Error);
+	          });
+}
+
+UTexture2D* UDreamSMTCSubsystem::GetThumbnail() const
+{
+	return Thumbnail;
+}
+
+void UDreamSMTCSubsystem::SetType(EDreamSMTCMediaPlaybackType Type)
+{
+	Session.Type = Type;
+	// 属性只能写入当前类型，切换类型时一并补写
+	WriteSessionFields(EDreamSMTCSessionField::Display);
+}
+
+EDreamSMTCMediaPlaybackType UDreamSMTCSubsystem::GetType() const
+{
+	return Session.Type;
+}
+
+void UDreamSMTCSubsystem::ClearAll()
+{
+	// 丢弃仍在进行中的封面任务
+	ThumbnailJobs->Invalidate();
+	Thumbnail = nullptr;
+	Session.ClearDisplay();
+	MarkSessionChanged();
+	if (!IsBackendOwner())
+	{
+		return;
+	}
+
+	FString Error;
+	const TSharedPtr<IDreamSMTCBackend, ESPMode::ThreadSafe> Backend = GetBackend();
+	if (Backend.IsValid() && !Backend->ClearAll(Error))
+	{
+		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *Error);
+	}
+}
+
+void UDreamSMTCSubsystem::Update()
+{
+	EnqueueWrite(EDreamSMTCPendingWrite::Display, EDreamSMTCUpdatePriority::High);
+}
+
+void UDreamSMTCSubsystem::SetUpdateTimelineProperties(FDreamSMTCTimelineProperties TimelineProperties)
+{
+	if (!IsInGameThread())
+	{
+		PublishTimelineProperties(TimelineProperties);
+		return;
+	}
+
+	const double SampleTime = FPlatformTime::Seconds();
+	if (PlaybackPublication.Read().Timeline != TimelineProperties)
+	{
+		PlaybackPublication.Modify([&TimelineProperties, SampleTime](FDreamSMTCPlaybackSnapshot& Snapshot)
+		{
+			Snapshot.Timeline = TimelineProperties;
+			Snapshot.TimelineTime = SampleTime;
+		});
+	}
+	ApplyTimelineProperties(TimelineProperties, SampleTime);
+}
+
+void UDreamSMTCSubsystem::PublishTimelineProperties(const FDreamSMTCTimelineProperties& TimelineProperties)
+{
+	// 暂停时调用方常会重复发布相同的进度
+	if (PlaybackPublication.Read().Timeline == TimelineProperties)
+	{
+		return;
+	}
+
+	const double SampleTime = FPlatformTime::Seconds();
+	PlaybackPublication.Modify([&TimelineProperties, SampleTime](FDreamSMTCPlaybackSnapshot& Snapshot)
+	{
+		Snapshot.Timeline = TimelineProperties;
+		Snapshot.TimelineTime = SampleTime;
+		Snapshot.ChangedFields |= EDreamSMTCSessionField::Timeline;
+	});
+
+	// 空闲时只记录进度，随下一次唤醒一起应用
+	if (!IsIdle())
+	{
+		RequestWake();
+	}
+}
+
+void UDreamSMTCSubsystem::PublishPlaybackState(EDreamSMTCMediaPlaybackStatus Status, double Rate)
+{
+	const FDreamSMTCPlaybackSnapshot Published = PlaybackPublication.Read();
+	if (Published.PlaybackStatus == Status && Published.PlaybackRate == Rate)
+	{
+		return;
+	}
+
+	PlaybackPublication.Modify([Status, Rate](FDreamSMTCPlaybackSnapshot& Snapshot)
+	{
+		Snapshot.PlaybackStatus = Status;
+		Snapshot.PlaybackRate = Rate;
+		Snapshot.ChangedFields |= EDreamSMTCSessionField::PlaybackStatus | EDreamSMTCSessionField::PlaybackRate;
+	});
+	RequestWake();
+}
+
+void UDreamSMTCSubsystem::ConsumePlaybackPublication()
+{
+	if (PlaybackPublication.GetSequence() == ConsumedPlaybackSequence)
+	{
+		return;
+	}
+
+	// 取走其它线程写入的变更并清除标记，保证每次发布只应用一次
+	FDreamSMTCPlaybackSnapshot Snapshot;
+	ConsumedPlaybackSequence = PlaybackPublication.Modify([&Snapshot](FDreamSMTCPlaybackSnapshot& Current)
+	{
+		Snapshot = Current;
+		Current.ChangedFields = EDreamSMTCSessionField::None;
+	});
+
+	EDreamSMTCSessionField Fields = EDreamSMTCSessionField::None;
+	if (EnumHasAnyFlags(Snapshot.ChangedFields, EDreamSMTCSessionField::PlaybackStatus) &&
+		Snapshot.PlaybackStatus != Session.PlaybackStatus)
+	{
+		Session.PlaybackStatus = Snapshot.PlaybackStatus;
+		Fields |= EDreamSMTCSessionField::PlaybackStatus;
+	}
+	if (EnumHasAnyFlags(Snapshot.ChangedFields, EDreamSMTCSessionField::PlaybackRate) &&
+		Snapshot.PlaybackRate != Session.PlaybackRate)
+	{
+		Session.PlaybackRate = Snapshot.PlaybackRate;
+		Fields |= EDreamSMTCSessionField::PlaybackRate;
+	}
+	if (Fields != EDreamSMTCSessionField::None)
+	{
+		WriteSessionFields(Fields);
+	}
+
+	if (EnumHasAnyFlags(Snapshot.ChangedFields, EDreamSMTCSessionField::Timeline))
+	{
+		ApplyTimelineProperties(Snapshot.Timeline, Snapshot.TimelineTime);
+	}
+}
+
+void UDreamSMTCSubsystem::ApplyTimelineProperties(const FDreamSMTCTimelineProperties& TimelineProperties,
+                                                  double SampleTime)
+{
+	// 时间范围变化或跳转需要立即生效，普通的进度刷新可以延后合并
+	const FTimespan SeekThreshold = FTimespan::FromSeconds(UDreamSMTCSettings::Get()->TimelineSeekThreshold);
+	const FTimespan PositionDelta = TimelineProperties.Position - Session.Timeline.Position;
+	const bool bRangeChanged = TimelineProperties.StartTime != Session.Timeline.StartTime ||
+		TimelineProperties.EndTime != Session.Timeline.EndTime ||
+		TimelineProperties.MinSeekTime != Session.Timeline.MinSeekTime ||
+		TimelineProperties.MaxSeekTime != Session.Timeline.MaxSeekTime;
+	const bool bSeeked = PositionDelta < FTimespan::Zero() || PositionDelta > SeekThreshold;
+
+	// 暂停时调用方常会重复提交相同的进度，不产生任何工作
+	if (!bRangeChanged && PositionDelta == FTimespan::Zero())
+	{
+		return;
+	}
+
+	Session.Timeline = TimelineProperties;
+	TimelineClock.Position = TimelineProperties.Position.GetTotalSeconds();
+	TimelineClock.Time = SampleTime;
+	MarkSessionChanged(!bRangeChanged);
+	RearmPositionSwitches();
+	if (ListeningHistory && bSeeked && !bRangeChanged)
+	{
+		ListeningHistory->RecordSeek(TimelineProperties);
+	}
+	if (IsIdle() && !bRangeChanged && !bSeeked)
+	{
+		bTimelineDeferred = true;
+	}
+	else
+	{
+		EnqueueWrite(EDreamSMTCPendingWrite::Timeline,
+		             bRangeChanged || bSeeked ? EDreamSMTCUpdatePriority::High : EDreamSMTCUpdatePriority::Low);
+	}
+
+	AdvanceCueTrack(TimelineProperties.Position);
+}
+
+FDreamSMTCTimelineProperties UDreamSMTCSubsystem::GetTimelineProperties() const
+{
+	return Session.Timeline;
+}
+
+UDreamSMTCSequenceBinding* UDreamSMTCSubsystem::BindSequencePlayer(ULevelSequencePlayer* Player,
+                                                                   FDreamSMTCVideoDisplayProperties Display)
+{
+	UnbindSequencePlayer();
+	if (!Player)
+	{
+		return nullptr;
+	}
+
+	SequenceBinding = NewObject<UDreamSMTCSequenceBinding>(this);
+	SequenceBinding->Bind(this, Player, Display);
+	return SequenceBinding;
+}
+
+void UDreamSMTCSubsystem::UnbindSequencePlayer()
+{
+	if (SequenceBinding)
+	{
+		SequenceBinding->Unbind();
+		SequenceBinding = nullptr;
+	}
+}
+
+void UDreamSMTCSubsystem::RegisterChangeRequestHandlers()
+{
+	Callbacks->bAcceptingRequests = true;
+
+	FDreamSMTCBackendHandlers Handlers;
+
+	// 系统线程上的回调只访问共享的状态块，不触及可能已销毁的子系统
+	Handlers.ButtonPressed = [State = Callbacks, Jobs = ThumbnailJobs](EDreamSMTCButtonEvent ButtonEvent)
+	{
+		++State->HandlersInFlight;
+		ON_SCOPE_EXIT { --State->HandlersInFlight; };
+		if (!State->bAcceptingRequests || !Jobs->bBackendOwner)
+		{
+			return;
+		}
+
+		// 对延迟敏感的 C++ 监听者直接在回调线程上处理
+		State->NativeButtonListeners.Dispatch(ButtonEvent, EDreamSMTCListenerThread::CallbackThread);
+		State->EnqueueMediaKey(ButtonEvent);
+
+		// 通过异步任务派发到游戏线程执行
+		const double CallbackTime = FPlatformTime::Seconds();
+		AsyncTask(ENamedThreads::GameThread, [WeakOwner = State->Owner, ButtonEvent, CallbackTime]()
+		{
+			if (WeakOwner.IsValid())
+			{
+				FDreamSMTCDebugStats::Get().RecordButtonLatency(FPlatformTime::Seconds() - CallbackTime);
+				WeakOwner->DispatchButtonOnGameThread(ButtonEvent);
+			}
+		});
+	};
+
+	Handlers.PlaybackPositionChangeRequested = [State = Callbacks, Jobs = ThumbnailJobs](FTimespan Position)
+	{
+		if (!State->bAcceptingRequests || !Jobs->bBackendOwner)
+		{
+			return;
+		}
+
+		// 只记录最新的位置，游戏线程在 Tick 中统一派发
+		State->PendingSeekTicks.store(Position.GetTicks());
+		if (State->bSeekPending.exchange(true))
+		{
+			State->CoalescedSeekRequests.fetch_add(1, std::memory_order_relaxed);
+		}
+		else
+		{
+			State->RequestWake();
+		}
+	};
+
+	Handlers.PlaybackRateChangeRequested = [State = Callbacks, Jobs = ThumbnailJobs](double Rate)
+	{
+		if (!State->bAcceptingRequests || !Jobs->bBackendOwner)
+		{
+			return;
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [WeakOwner = State->Owner, Rate]()
+		{
+			if (WeakOwner.IsValid() && WeakOwner->IsBackendOwner())
+			{
+				WeakOwner->PlaybackRateChangeRequested.Broadcast(Rate);
+			}
+		});
+	};
+
+	Handlers.ShuffleEnabledChangeRequested = [State = Callbacks, Jobs = ThumbnailJobs](bool bShuffleEnabled)
+	{
+		if (!State->bAcceptingRequests || !Jobs->bBackendOwner)
+		{
+			return;
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [WeakOwner = State->Owner, bShuffleEnabled]()
+		{
+			if (WeakOwner.IsValid() && WeakOwner->IsBackendOwner())
+			{
+				WeakOwner->ShuffleEnabledChangeRequested.Broadcast(bShuffleEnabled);
+			}
+		});
+	};
+
+	Handlers.AutoRepeatModeChangeRequested = [State = Callbacks, Jobs = ThumbnailJobs](EDreamSMTCAutoRepeatMode Mode)
+	{
+		if (!State->bAcceptingRequests || !Jobs->bBackendOwner)
+		{
+			return;
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [WeakOwner = State->Owner, Mode]()
+		{
+			if (WeakOwner.IsValid() && WeakOwner->IsBackendOwner())
+			{
+				WeakOwner->AutoRepeatModeChangeRequested.Broadcast(Mode);
+			}
+		});
+	};
+
+	// 记住注册时的后端，最后一个实例释放后端后仍能注销
+	HandlersBackend = GetBackend();
+	if (HandlersBackend.IsValid())
+	{
+		HandlersId = HandlersBackend->AddHandlers(MoveTemp(Handlers));
+	}
+}
+
+void UDreamSMTCSubsystem::UnregisterChangeRequestHandlers(double Deadline)
+{
+	Callbacks->bAcceptingRequests = false;
+	if (HandlersBackend.IsValid())
+	{
+		HandlersBackend->RemoveHandlers(HandlersId);
+		HandlersBackend.Reset();
+	}
+
+	// 回调自己持有状态块；这里只等待仍在调用本地监听者的回调，监听者的对象可能随子系统一起销毁
+	while (Callbacks->HandlersInFlight.load() > 0 && FPlatformTime::Seconds() < Deadline)
+	{
+		FPlatformProcess::YieldThread();
+	}
+}
+
+void UDreamSMTCSubsystem::DispatchCoalescedSeekRequest()
+{
+	if (!Callbacks->bSeekPending.exchange(false))
+	{
+		return;
+	}
+
+	++DispatchedSeekRequests;
+	PlaybackPositionChangeRequested.Broadcast(FTimespan(Callbacks->PendingSeekTicks.load()));
+}
+
+FDelegateHandle UDreamSMTCSubsystem::AddNativeButtonListener(FDreamSMTCNativeButtonDelegate&& Delegate,
+                                                             uint32 ButtonMask, EDreamSMTCListenerThread Thread)
+{
+	return Callbacks->NativeButtonListeners.Add(MoveTemp(Delegate), ButtonMask, Thread);
+}
+
+bool UDreamSMTCSubsystem::RemoveNativeButtonListener(FDelegateHandle Handle)
+{
+	return Callbacks->NativeButtonListeners.Remove(Handle);
+}
+
+void UDreamSMTCSubsystem::RemoveNativeButtonListeners(const void* UserObject)
+{
+	Callbacks->NativeButtonListeners.RemoveAll(UserObject);
+}
+
+void UDreamSMTCSubsystem::FCallbackState::EnqueueMediaKey(EDreamSMTCButtonEvent Button)
+{
+	if (!bInjectMediaKeys)
+	{
+		return;
+	}
+
+	// Tick 运行期间不需要分配唤醒任务，只在空闲时唤醒
+	MediaKeys.Enqueue(Button);
+	if (bIdle.load())
+	{
+		RequestWake();
+	}
+}
+
+void UDreamSMTCSubsystem::DispatchButtonOnGameThread(EDreamSMTCButtonEvent Button)
+{
+	if (ListeningHistory)
+	{
+		ListeningHistory->RecordButton(Button);
+	}
+
+	// 队列先移动，监听者收到按钮事件时 GetQueueTrack 已是新曲目
+	if (bQueueHandlesNextPrevious && PlayQueue.Num() > 0)
 	{
-		try
+		if (Button == EDreamSMTCButtonEvent::Next)
+		{
+			SkipToNextTrack();
+		}
+		else if (Button == EDreamSMTCButtonEvent::Previous)
 		{
-			// auto file = winrt::Windows::Storage::StorageFile::GetFileFromPathAsync(winrtPath).get();
-			// auto thumbnailRef = winrt::Windows::Storage::Streams::RandomAccessStreamReference::CreateFromFile(file);
-			// GetSystemMediaTransportControlsDisplayUpdater().Thumbnail(thumbnailRef);
-			// GetSystemMediaTransportControlsDisplayUpdater().Update();
+			SkipToPreviousTrack();
 		}
-		catch (const winrt::hresult_error& ex)
+	}
+
+	Callbacks->NativeButtonListeners.Dispatch(Button, EDreamSMTCListenerThread::GameThread);
+	ButtonPressed.Broadcast(Button);
+}
+
+void UDreamSMTCSubsystem::StartRemoteServer()
+{
+	const UDreamSMTCSettings* Settings = UDreamSMTCSettings::Get();
+	// PIE 客户端依次使用后面的端口
+	RemoteServer = MakeShared<FDreamSMTCRemoteServer, ESPMode::ThreadSafe>(
+		Settings->RemoteControlPort + InstanceIndex, Settings->RemoteControlMaxQueuedFrames,
+		Settings->RemoteControlToken, Settings->RemoteControlAllowedOrigins);
+
+	// 远程命令与系统按钮走同一条派发路径；服务器线程可能比子系统活得久，只访问状态块
+	RemoteServer->SetCommandHandler([State = Callbacks](EDreamSMTCButtonEvent Button)
+	{
+		++State->HandlersInFlight;
+		ON_SCOPE_EXIT { --State->HandlersInFlight; };
+		if (!State->bAcceptingRequests)
 		{
-			UE_LOG(LogDreamSMTC, Error, TEXT("SetThumbnail failed: 0x%08X - %s"),
-			       ex.code().value, *FString(ex.message().c_str()));
+			return;
 		}
+
+		State->NativeButtonListeners.Dispatch(Button, EDreamSMTCListenerThread::CallbackThread);
+		State->EnqueueMediaKey(Button);
+		State->RequestWake();
 	});
+
+	if (!RemoteServer->Start())
+	{
+		RemoteServer.Reset();
+		return;
+	}
+
+	// 序列化与分帧在工作线程进行
+	AddStateSink(RemoteServer.ToSharedRef());
 }
 
-UTexture2D* UDreamSMTCSubsystem::GetThumbnail() const
+void UDreamSMTCSubsystem::TickRemoteServer()
 {
-	return Thumbnail;
+	if (!RemoteServer)
+	{
+		return;
+	}
+
+	TArray<EDreamSMTCButtonEvent> Commands;
+	RemoteServer->DrainCommands(Commands);
+	for (const EDreamSMTCButtonEvent Button : Commands)
+	{
+		DispatchButtonOnGameThread(Button);
+	}
 }
 
-void UDreamSMTCSubsystem::SetType(EDreamSMTCMediaPlaybackType Type)
+void UDreamSMTCSubsystem::AddStateSink(const FDreamSMTCStateSinkRef& Sink, EDreamSMTCSinkThread Thread)
+{
+	// 先把已有接收者尚未收到的变更派发出去，新接收者从同一基准开始
+	DispatchStateChanges();
+	if (!StateSinks.HasSinks())
+	{
+		SinkBaseline = Session;
+	}
+
+	StateSinks.Add(Sink, Thread, MakeChangeSet(EDreamSMTCSessionField::All, DreamSMTCValidButtons));
+}
+
+bool UDreamSMTCSubsystem::RemoveStateSink(const FDreamSMTCStateSinkRef& Sink)
+{
+	return StateSinks.Remove(Sink);
+}
+
+void UDreamSMTCSubsystem::DispatchStateChanges()
 {
-	try
+	if (!bSinkStateDirty)
 	{
-		GetSystemMediaTransportControlsDisplayUpdater().Type(
-			static_cast<winrt::Windows::Media::MediaPlaybackType>(Type));
+		return;
+	}
+	bSinkStateDirty = false;
+
+	if (!StateSinks.HasSinks())
+	{
+		return;
 	}
-	catch (std::exception& e)
+
+	// 同一帧内的多次修改只比较、构建一次，所有接收者共享
+	uint32 ChangedButtons = 0;
+	const EDreamSMTCSessionField Fields = FDreamSMTCSessionState::Diff(SinkBaseline, Session, &ChangedButtons);
+	if (Fields == EDreamSMTCSessionField::None)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
 		return;
 	}
+
+	SinkBaseline = Session;
+	StateSinks.Dispatch(MakeChangeSet(Fields, ChangedButtons));
 }
 
-EDreamSMTCMediaPlaybackType UDreamSMTCSubsystem::GetType() const
+FDreamSMTCChangeSetRef UDreamSMTCSubsystem::MakeChangeSet(EDreamSMTCSessionField Fields, uint32 ChangedButtons)
 {
-	try
+	const TSharedRef<FDreamSMTCChangeSet, ESPMode::ThreadSafe> ChangeSet =
+		MakeShared<FDreamSMTCChangeSet, ESPMode::ThreadSafe>();
+	ChangeSet->State = SinkBaseline;
+	ChangeSet->ChangedFields = Fields;
+	ChangeSet->ChangedButtons = ChangedButtons;
+	ChangeSet->Sequence = ++ChangeSetSequence;
+	ChangeSet->Time = FPlatformTime::Seconds();
+	return ChangeSet;
+}
+
+int64 UDreamSMTCSubsystem::GetCoalescedSeekRequestCount() const
+{
+	return Callbacks->CoalescedSeekRequests.load(std::memory_order_relaxed);
+}
+
+FDreamSMTCListeningSummary UDreamSMTCSubsystem::GetListeningSummary(float WithinSeconds) const
+{
+	if (!ListeningHistory)
+	{
+		return FDreamSMTCListeningSummary();
+	}
+	return ListeningHistory->Summarize(FTimespan::FromSeconds(FMath::Max(WithinSeconds, 0.0f)));
+}
+
+int32 UDreamSMTCSubsystem::StageMusicSwitch(FDreamSMTCMusicDisplayProperties Music,
+                                            FDreamSMTCTimelineProperties Timeline, UTexture2D* InThumbnail)
+{
+	FDreamSMTCSessionState State;
+	State.Type = EDreamSMTCMediaPlaybackType::Music;
+	State.Music = Music;
+	State.Timeline = Timeline;
+	return StageSessionSwitch(State, EDreamSMTCSessionField::Type | EDreamSMTCSessionField::Music |
+	                          EDreamSMTCSessionField::Timeline, InThumbnail);
+}
+
+int32 UDreamSMTCSubsystem::StageSessionSwitch(const FDreamSMTCSessionState& State, EDreamSMTCSessionField Fields,
+                                              UTexture2D* InThumbnail)
+{
+	DSMTC_LLM_SCOPE();
+	const FStagedSwitchRef Switch = MakeShared<FStagedSwitch, ESPMode::ThreadSafe>();
+	Switch->Id = ++NextSwitchId;
+	Switch->State = State;
+	Switch->Fields = Fields & ~EDreamSMTCSessionField::Thumbnail;
+	StagedSwitches.Add(Switch->Id, Switch);
+
+	if (!InThumbnail)
 	{
-		return static_cast<EDreamSMTCMediaPlaybackType>(GetSystemMediaTransportControlsDisplayUpdater().Type());
+		return Switch->Id;
 	}
-	catch (std::exception& e)
+
+	Switch->Fields |= EDreamSMTCSessionField::Thumbnail;
+	Switch->Texture = InThumbnail;
+
+	// 暂存时就完成回读、编码与系统流的拷贝，提交时只需交给系统
+	const int32 SwitchId = Switch->Id;
+	const bool bQueued = FDreamSMTCThumbnail::ReadPixelsAsync(InThumbnail,
+		[Switch](TArray<FColor>&& Pixels, FIntPoint Size)
+		{
+			Async(EAsyncExecution::ThreadPool, [Switch, Pixels = MoveTemp(Pixels), Size]()
+			{
+				DSMTC_LLM_SCOPE();
+				using FEncodedImage = FDreamSMTCSessionState::FEncodedImage;
+				TSharedRef<FEncodedImage, ESPMode::ThreadSafe> Encoded = MakeShared<FEncodedImage, ESPMode::ThreadSafe>();
+				FString Error;
+				TSharedPtr<FDreamSMTCPreparedThumbnail, ESPMode::ThreadSafe> Prepared;
+				if (FDreamSMTCThumbnail::Encode(Pixels, Size, 90, *Encoded))
+				{
+					Prepared = FDreamSMTCThumbnail::Prepare(*Encoded, Error);
+				}
+				if (!Prepared.IsValid())
+				{
+					UE_LOG(LogDreamSMTC, Warning, TEXT("Failed to prepare the thumbnail of switch %d: %s"), Switch->Id,
+					       *Error);
+					return;
+				}
+
+				FScopeLock Lock(&Switch->ThumbnailLock);
+				Switch->PreparedThumbnail = Prepared;
+				Switch->EncodedThumbnail = Encoded;
+			});
+		});
+	if (!bQueued)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return EDreamSMTCMediaPlaybackType::Unknown;
+		UE_LOG(LogDreamSMTC, Warning, TEXT("Thumbnail texture of switch %d has no render resource."), SwitchId);
 	}
+	return SwitchId;
 }
 
-void UDreamSMTCSubsystem::ClearAll()
+bool UDreamSMTCSubsystem::ScheduleSwitchAtPosition(int32 SwitchId, FTimespan Position)
+{
+	const FStagedSwitchRef* Switch = StagedSwitches.Find(SwitchId);
+	if (!Switch)
+	{
+		return false;
+	}
+
+	(*Switch)->Position = Position;
+	const TOptional<double> Deadline = GetPositionDeadline(Position);
+	if (Deadline.IsSet())
+	{
+		ArmSwitch(*Switch, Deadline.GetValue());
+	}
+	// 未在播放时等待恢复播放后再计时
+	else if ((*Switch)->TimerId != 0 && SwitchTimers->Cancel((*Switch)->TimerId))
+	{
+		(*Switch)->TimerId = 0;
+	}
+	return true;
+}
+
+bool UDreamSMTCSubsystem::ScheduleSwitchAtAudioTime(int32 SwitchId, double AudioTime, double CurrentAudioTime)
+{
+	const FStagedSwitchRef* Switch = StagedSwitches.Find(SwitchId);
+	if (!Switch)
+	{
+		return false;
+	}
+
+	(*Switch)->Position.Reset();
+	ArmSwitch(*Switch, FPlatformTime::Seconds() + (AudioTime - CurrentAudioTime));
+	return true;
+}
+
+bool UDreamSMTCSubsystem::CancelSwitch(int32 SwitchId)
 {
-	try
+	const FStagedSwitchRef* Switch = StagedSwitches.Find(SwitchId);
+	if (!Switch)
+	{
+		return false;
+	}
+
+	// 定时器已触发时提交正在进行，无法撤回
+	if ((*Switch)->TimerId != 0 && !SwitchTimers->Cancel((*Switch)->TimerId))
 	{
-		GetSystemMediaTransportControlsDisplayUpdater().ClearAll();
+		return false;
 	}
-	catch (std::exception& e)
+	StagedSwitches.Remove(SwitchId);
+	return true;
+}
+
+void UDreamSMTCSubsystem::ArmSwitch(const FStagedSwitchRef& Switch, double Deadline)
+{
+	Switch->Deadline = Deadline;
+	if (Switch->TimerId != 0)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
+		// 重新调度失败说明定时器已触发，提交结果稍后回到游戏线程
+		SwitchTimers->Reschedule(Switch->TimerId, Deadline);
 		return;
 	}
+
+	TWeakObjectPtr<UDreamSMTCSubsystem> WeakThis(this);
+	Switch->TimerId = SwitchTimers->Schedule(Deadline, [WeakThis, Switch, Jobs = ThumbnailJobs](double FiredTime)
+	{
+		FString Error;
+		const bool bSuccess = CommitSwitchToBackend(*Switch, *Jobs, Error);
+		if (!bSuccess)
+		{
+			UE_LOG(LogDreamSMTC, Error, TEXT("Failed to commit switch %d: %s"), Switch->Id, *Error);
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Switch, FiredTime, bSuccess, Error = MoveTemp(Error)]()
+		{
+			if (WeakThis.IsValid())
+			{
+				WeakThis->OnSwitchCommitted(Switch, FiredTime, bSuccess, Error);
+			}
+		});
+	});
 }
 
-void UDreamSMTCSubsystem::Update()
+void UDreamSMTCSubsystem::RearmPositionSwitches()
+{
+	for (const TPair<int32, FStagedSwitchRef>& Pair : StagedSwitches)
+	{
+		const FStagedSwitchRef& Switch = Pair.Value;
+		if (!Switch->Position.IsSet())
+		{
+			continue;
+		}
+
+		const TOptional<double> Deadline = GetPositionDeadline(Switch->Position.GetValue());
+		if (Deadline.IsSet())
+		{
+			ArmSwitch(Switch, Deadline.GetValue());
+		}
+		else if (Switch->TimerId != 0 && SwitchTimers->Cancel(Switch->TimerId))
+		{
+			Switch->TimerId = 0;
+		}
+	}
+}
+
+TOptional<double> UDreamSMTCSubsystem::GetPositionDeadline(FTimespan Position) const
+{
+	if (TimelineClock.Rate <= 0.0)
+	{
+		return TOptional<double>();
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	return Now + (Position.GetTotalSeconds() - TimelineClock.Sample(Now)) / TimelineClock.Rate;
+}
+
+bool UDreamSMTCSubsystem::CommitSwitchToBackend(FStagedSwitch& Switch, FThumbnailJobs& Jobs, FString& OutError)
+{
+	TSharedPtr<FDreamSMTCPreparedThumbnail, ESPMode::ThreadSafe> Prepared;
+	TSharedPtr<const FDreamSMTCSessionState::FEncodedImage, ESPMode::ThreadSafe> Encoded;
+	{
+		FScopeLock Lock(&Switch.ThumbnailLock);
+		Prepared = Switch.PreparedThumbnail;
+		Encoded = Switch.EncodedThumbnail;
+	}
+
+	// 不持有系统控件时只更新本地会话，本地会话记录此刻已就绪的封面
+	if (!Jobs.bBackendOwner)
+	{
+		FScopeLock Lock(&Switch.ThumbnailLock);
+		Switch.CommittedThumbnail = Encoded;
+		return true;
+	}
+
+	// 封面还没准备好时只提交其它字段
+	TOptional<FScopeLock> ThumbnailLock;
+	if (Prepared.IsValid())
+	{
+		// 使仍在进行中的 SetThumbnailAsync 失效，避免旧封面覆盖；与其它失效点一样在锁内递增
+		ThumbnailLock.Emplace(&Jobs.ApplyLock);
+		++Jobs.Generation;
+	}
+
+	const EDreamSMTCSessionField Fields = Switch.Fields & ~EDreamSMTCSessionField::Thumbnail;
+	const uint32 ButtonMask = EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Buttons) ? DreamSMTCAllButtons : 0;
+	const TSharedPtr<IDreamSMTCBackend, ESPMode::ThreadSafe> Backend = GetBackend();
+	if (!Backend.IsValid())
+	{
+		OutError = TEXT("The SMTC backend has been released.");
+		return false;
+	}
+	if (!Backend->WriteSession(Switch.State, Fields, ButtonMask, OutError))
+	{
+		return false;
+	}
+	if (Prepared.IsValid() && !FDreamSMTCThumbnail::SetPrepared(*Prepared, OutError))
+	{
+		return false;
+	}
+	if ((EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Display) || Prepared.IsValid()) &&
+		!CommitToBackend(EDreamSMTCPendingWrite::Display, Switch.State.Timeline, OutError))
+	{
+		return false;
+	}
+
+	// 只有随本次提交送达系统的封面才同步到会话
+	if (Prepared.IsValid())
+	{
+		FScopeLock Lock(&Switch.ThumbnailLock);
+		Switch.CommittedThumbnail = Encoded;
+	}
+	return true;
+}
+
+void UDreamSMTCSubsystem::OnSwitchCommitted(const FStagedSwitchRef& Switch, double CommitTime, bool bSuccess,
+                                            const FString& Error)
 {
-	try
+	// 反初始化后才回到游戏线程的提交不再更新会话
+	if (StagedSwitches.Remove(Switch->Id) == 0)
 	{
-		GetSystemMediaTransportControlsDisplayUpdater().Update();
+		return;
 	}
-	catch (std::exception& e)
+	if (!bSuccess)
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
+		UE_LOG(LogDreamSMTC, Warning, TEXT("Switch %d was dropped: %s"), Switch->Id, *Error);
+		SessionSwitchFailed.Broadcast(Switch->Id, Error);
 		return;
 	}
+
+	const EDreamSMTCSessionField Fields = Switch->Fields;
+	if (ListeningHistory && EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Music))
+	{
+		ListeningHistory->RecordTrackChange(Switch->State.Music, Session.Timeline);
+	}
+
+	Session.CopyFields(Switch->State, Fields & ~EDreamSMTCSessionField::Thumbnail);
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Thumbnail))
+	{
+		FScopeLock Lock(&Switch->ThumbnailLock);
+		if (Switch->CommittedThumbnail.IsValid())
+		{
+			Session.Thumbnail = Switch->CommittedThumbnail;
+			Thumbnail = Switch->Texture.Get();
+		}
+	}
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Timeline))
+	{
+		// 新曲目的进度从提交时刻开始推算
+		PlaybackPublication.Modify([&Switch, CommitTime](FDreamSMTCPlaybackSnapshot& Snapshot)
+		{
+			Snapshot.Timeline = Switch->State.Timeline;
+			Snapshot.TimelineTime = CommitTime;
+		});
+		TimelineClock.Position = Switch->State.Timeline.Position.GetTotalSeconds();
+		TimelineClock.Time = CommitTime;
+	}
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::PlaybackStatus | EDreamSMTCSessionField::PlaybackRate))
+	{
+		// 发布的值与会话保持一致，其它线程才能据此跳过重复的设置
+		const EDreamSMTCMediaPlaybackStatus Status = Session.PlaybackStatus;
+		const double Rate = Session.PlaybackRate;
+		PlaybackPublication.Modify([Status, Rate](FDreamSMTCPlaybackSnapshot& Snapshot)
+		{
+			Snapshot.PlaybackStatus = Status;
+			Snapshot.PlaybackRate = Rate;
+		});
+
+		const bool bPlaying = Session.PlaybackStatus == EDreamSMTCMediaPlaybackStatus::Playing;
+		TimelineClock.SetRate(bPlaying ? Session.PlaybackRate : 0.0, CommitTime);
+	}
+
+	MarkSessionChanged();
+	RearmPositionSwitches();
+	SessionSwitchCommitted.Broadcast(Switch->Id, static_cast<float>((CommitTime - Switch->Deadline) * 1000.0));
 }
 
-void UDreamSMTCSubsystem::SetUpdateTimelineProperties(FDreamSMTCTimelineProperties TimelineProperties)
+bool UDreamSMTCSubsystem::LoadCueTrackFromLrc(const FString& Lrc)
+{
+	DSMTC_LLM_SCOPE();
+	BeginCueTrack();
+	const bool bLoaded = CueTrack.LoadLrc(Lrc);
+	AdvanceCueTrack(Session.Timeline.Position);
+	return bLoaded;
+}
+
+bool UDreamSMTCSubsystem::LoadCueTrackFromChapters(const FString& Chapters)
+{
+	DSMTC_LLM_SCOPE();
+	BeginCueTrack();
+	const bool bLoaded = CueTrack.LoadChapters(Chapters);
+	AdvanceCueTrack(Session.Timeline.Position);
+	return bLoaded;
+}
+
+void UDreamSMTCSubsystem::SetCueTrack(const TArray<FDreamSMTCCue>& Cues)
+{
+	DSMTC_LLM_SCOPE();
+	BeginCueTrack();
+	CueTrack.SetCues(Cues);
+	AdvanceCueTrack(Session.Timeline.Position);
+}
+
+void UDreamSMTCSubsystem::ClearCueTrack()
+{
+	const bool bRestore = bCueTrackUpdatesDisplay && CueTrack.GetActiveCue() != nullptr;
+	CueTrack.Reset();
+	if (bRestore)
+	{
+		ApplyActiveCue();
+	}
+	CueBaseType = EDreamSMTCMediaPlaybackType::Unknown;
+}
+
+int32 UDreamSMTCSubsystem::GetActiveCueIndex() const
+{
+	return CueTrack.GetActiveIndex();
+}
+
+bool UDreamSMTCSubsystem::GetActiveCue(FDreamSMTCCue& OutCue) const
+{
+	if (const FDreamSMTCCue* Cue = CueTrack.GetActiveCue())
+	{
+		OutCue = *Cue;
+		return true;
+	}
+	return false;
+}
+
+void UDreamSMTCSubsystem::SetPlayQueue(int32 NumTracks, int32 StartTrack)
+{
+	PlayQueue.SetShuffleEnabled(Session.bShuffleEnabled);
+	PlayQueue.SetRepeatMode(Session.AutoRepeatMode);
+	PlayQueue.Reset(NumTracks, StartTrack);
+	BroadcastQueueTrack(PlayQueue.Num() > 0);
+}
+
+void UDreamSMTCSubsystem::ClearPlayQueue()
+{
+	PlayQueue.Reset(0);
+}
+
+int32 UDreamSMTCSubsystem::GetQueueTrack() const
+{
+	return PlayQueue.GetCurrentTrack();
+}
+
+int32 UDreamSMTCSubsystem::PeekNextQueueTrack() const
+{
+	return PlayQueue.PeekNext();
+}
+
+bool UDreamSMTCSubsystem::SkipToNextTrack()
+{
+	const bool bMoved = PlayQueue.Next();
+	BroadcastQueueTrack(bMoved);
+	return bMoved;
+}
+
+bool UDreamSMTCSubsystem::SkipToPreviousTrack()
+{
+	const bool bMoved = PlayQueue.Previous();
+	BroadcastQueueTrack(bMoved);
+	return bMoved;
+}
+
+bool UDreamSMTCSubsystem::NotifyTrackFinished()
+{
+	const bool bMoved = PlayQueue.OnTrackFinished();
+	BroadcastQueueTrack(bMoved);
+	return bMoved;
+}
+
+void UDreamSMTCSubsystem::JumpToQueueTrack(int32 TrackIndex)
+{
+	PlayQueue.JumpTo(TrackIndex);
+	BroadcastQueueTrack(PlayQueue.Num() > 0);
+}
+
+void UDreamSMTCSubsystem::BroadcastQueueTrack(bool bMoved)
 {
-	try
+	if (bMoved)
 	{
-		winrt::Windows::Media::SystemMediaTransportControlsTimelineProperties Time;
-		Time.StartTime(UnrealToWinRTTimespan(TimelineProperties.StartTime));
-		Time.EndTime(UnrealToWinRTTimespan(TimelineProperties.EndTime));
-		Time.MinSeekTime(UnrealToWinRTTimespan(TimelineProperties.MinSeekTime));
-		Time.MaxSeekTime(UnrealToWinRTTimespan(TimelineProperties.MaxSeekTime));
-		Time.Position(UnrealToWinRTTimespan(TimelineProperties.Position));
-		GetSystemMediaTransportControls().UpdateTimelineProperties(Time);
-		GSmtcTimelineProperties = TimelineProperties;
+		QueueTrackChanged.Broadcast(PlayQueue.GetCurrentTrack());
+	}
+}
+
+void UDreamSMTCSubsystem::BeginCueTrack()
+{
+	// 替换轨道时先恢复原来的显示内容，再保存
+	ClearCueTrack();
+
+	CueBaseType = GetType();
+	switch (CueBaseType)
+	{
+	case EDreamSMTCMediaPlaybackType::Music:
+		CueBaseDisplay = FDreamSMTCCue(FTimespan::Zero(), Session.Music.Title, Session.Music.Artist);
+		break;
+	case EDreamSMTCMediaPlaybackType::Video:
+		CueBaseDisplay = FDreamSMTCCue(FTimespan::Zero(), Session.Video.Title, Session.Video.Subtitle);
+		break;
+	case EDreamSMTCMediaPlaybackType::Image:
+		CueBaseDisplay = FDreamSMTCCue(FTimespan::Zero(), Session.Image.Title, Session.Image.Subtitle);
+		break;
+	default:
+		CueBaseDisplay = FDreamSMTCCue();
+		break;
 	}
-	catch (std::exception& e)
+}
+
+void UDreamSMTCSubsystem::AdvanceCueTrack(FTimespan Position)
+{
+	if (CueTrack.IsEmpty() || !CueTrack.Seek(Position))
 	{
-		UE_LOG(LogDreamSMTC, Error,TEXT("SMTC update failed: %s"), *FString(e.what()))
 		return;
 	}
+
+	if (bCueTrackUpdatesDisplay)
+	{
+		ApplyActiveCue();
+	}
+
+	const FDreamSMTCCue* Cue = CueTrack.GetActiveCue();
+	CueChanged.Broadcast(CueTrack.GetActiveIndex(), Cue ? *Cue : FDreamSMTCCue());
 }
 
-FDreamSMTCTimelineProperties UDreamSMTCSubsystem::GetTimelineProperties() const
+void UDreamSMTCSubsystem::ApplyActiveCue()
 {
-	try
+	// 没有活动的提示时显示设置轨道时保存的内容；类型已改变时保存的内容不再适用
+	const FDreamSMTCCue* Cue = CueTrack.GetActiveCue();
+	if (!Cue && CueBaseType != GetType())
 	{
-		return GSmtcTimelineProperties;
+		return;
 	}
-	catch (std::exception& e)
+	const FDreamSMTCCue& Shown = Cue ? *Cue : CueBaseDisplay;
+
+	TGuardValue<bool> ApplyingCue(bApplyingCue, true);
+	switch (GetType())
 	{
-		UE_LOG(LogDreamSMTC, Error, TEXT("SMTC update failed: %s"), *FString(e.what()));
-		return FDreamSMTCTimelineProperties();
+	case EDreamSMTCMediaPlaybackType::Music:
+		{
+			FDreamSMTCMusicDisplayProperties Music = GetMusicProperties();
+			Music.Title = Shown.Title;
+			Music.Artist = Shown.Subtitle;
+			SetMusicProperties(Music);
+			break;
+		}
+	case EDreamSMTCMediaPlaybackType::Video:
+		{
+			FDreamSMTCVideoDisplayProperties Video = GetVideoProperties();
+			Video.Title = Shown.Title;
+			Video.Subtitle = Shown.Subtitle;
+			SetVideoProperties(Video);
+			break;
+		}
+	case EDreamSMTCMediaPlaybackType::Image:
+		{
+			SetImageProperties(FDreamSMTCImageDisplayProperties(Shown.Title, Shown.Subtitle));
+			break;
+		}
+	default:
+		return;
 	}
+
+	Update();
 }
 
 // void UDreamSMTCSubsystem::UpdateSMTC(FString Title)
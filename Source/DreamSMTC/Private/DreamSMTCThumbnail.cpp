@@ -0,0 +1,191 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCThumbnail.h"
+
+#include "DreamSMTCBackend.h"
+#include "DreamSMTCLog.h"
+#include "DreamSMTCSubsystem.h"
+#include "Async/Async.h"
+#include "CanvasTypes.h"
+#include "Engine/Texture2D.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "RenderingThread.h"
+#include "TextureResource.h"
+#include "Modules/ModuleManager.h"
+#include "Math/VectorRegister.h"
+#include "UObject/StrongObjectPtr.h"
+
+namespace
+{
+	/** Draws the resident mips into a new BGRA8 render target; the GPU decompresses block formats while sampling. */
+	UTextureRenderTarget2D* DrawToRenderTarget(UTexture2D* Texture)
+	{
+		const int32 SizeX = Texture->GetSizeX();
+		const int32 SizeY = Texture->GetSizeY();
+		if (SizeX <= 0 || SizeY <= 0)
+		{
+			return nullptr;
+		}
+
+		UTextureRenderTarget2D* RenderTarget = NewObject<UTextureRenderTarget2D>(GetTransientPackage());
+		RenderTarget->InitCustomFormat(SizeX, SizeY, PF_B8G8R8A8, false);
+		RenderTarget->UpdateResourceImmediate(false);
+		FTextureRenderTargetResource* Target = RenderTarget->GameThread_GetRenderTargetResource();
+		if (!Target)
+		{
+			return nullptr;
+		}
+
+		// 绘制命令先于回读进入渲染线程队列
+		FCanvas Canvas(Target, nullptr, FGameTime(), GMaxRHIFeatureLevel);
+		Canvas.DrawTile(0.0f, 0.0f, SizeX, SizeY, 0.0f, 0.0f, 1.0f, 1.0f, FLinearColor::White, Texture->GetResource(),
+		                false);
+		Canvas.Flush_GameThread();
+		return RenderTarget;
+	}
+}
+
+bool FDreamSMTCThumbnail::ReadPixelsAsync(UTexture2D* Texture, FOnPixelsReady&& OnReady)
+{
+	FTextureResource* Resource = Texture ? Texture->GetResource() : nullptr;
+	if (!Resource)
+	{
+		return false;
+	}
+
+	// ReadSurfaceData 不支持 DXT/BC 等块压缩格式，先绘制到未压缩的渲染目标再回读
+	TStrongObjectPtr<UTextureRenderTarget2D> RenderTarget;
+	if (GPixelFormats[Texture->GetPixelFormat()].BlockSizeX > 1)
+	{
+		RenderTarget.Reset(DrawToRenderTarget(Texture));
+		if (!RenderTarget.IsValid())
+		{
+			return false;
+		}
+		Resource = RenderTarget->GameThread_GetRenderTargetResource();
+	}
+
+	ENQUEUE_RENDER_COMMAND(DreamSMTCReadThumbnail)(
+		[Resource, RenderTarget = MoveTemp(RenderTarget), OnReady = MoveTemp(OnReady)](
+		FRHICommandListImmediate& RHICmdList) mutable
+		{
+			TArray<FColor> Pixels;
+			FIntPoint Size = FIntPoint::ZeroValue;
+			if (FRHITexture* TextureRHI = Resource->GetTexture2DRHI())
+			{
+				Size = TextureRHI->GetSizeXY();
+				RHICmdList.ReadSurfaceData(TextureRHI, FIntRect(FIntPoint::ZeroValue, Size), Pixels,
+				                           FReadSurfaceDataFlags());
+			}
+
+			// 临时渲染目标在游戏线程释放
+			if (RenderTarget.IsValid())
+			{
+				AsyncTask(ENamedThreads::GameThread, [RenderTarget = MoveTemp(RenderTarget)]() mutable
+				{
+					RenderTarget.Reset();
+				});
+			}
+			OnReady(MoveTemp(Pixels), Size);
+		});
+	return true;
+}
+
+bool FDreamSMTCThumbnail::Encode(const TArray<FColor>& Pixels, FIntPoint Size, int32 Quality,
+                                 TArray64<uint8>& OutEncoded)
+{
+	if (Pixels.Num() == 0 || Pixels.Num() != Size.X * Size.Y)
+	{
+		return false;
+	}
+
+	IImageWrapperModule* ImageWrapperModule = FModuleManager::GetModulePtr<IImageWrapperModule>(TEXT("ImageWrapper"));
+	if (!ImageWrapperModule)
+	{
+		return false;
+	}
+
+	const TSharedPtr<IImageWrapper> ImageWrapper = ImageWrapperModule->CreateImageWrapper(EImageFormat::JPEG);
+	if (!ImageWrapper.IsValid() ||
+		!ImageWrapper->SetRaw(Pixels.GetData(), Pixels.Num() * sizeof(FColor), Size.X, Size.Y, ERGBFormat::BGRA, 8))
+	{
+		return false;
+	}
+
+	OutEncoded = ImageWrapper->GetCompressed(Quality);
+	return OutEncoded.Num() > 0;
+}
+
+void FDreamSMTCThumbnail::Downsample(const TArray<FColor>& Pixels, FIntPoint Size, int32 MaxSize,
+                                     TArray<FColor>& OutPixels, FIntPoint& OutSize)
+{
+	OutPixels.Reset();
+	OutSize = FIntPoint::ZeroValue;
+	if (Pixels.Num() == 0 || Pixels.Num() != Size.X * Size.Y || MaxSize <= 0)
+	{
+		return;
+	}
+
+	// 两边按同一比例缩小，保持宽高比
+	const int32 LongSide = FMath::Max(Size.X, Size.Y);
+	OutSize = LongSide <= MaxSize
+		          ? Size
+		          : FIntPoint(FMath::Max(FMath::DivideAndRoundNearest(Size.X * MaxSize, LongSide), 1),
+		                      FMath::Max(FMath::DivideAndRoundNearest(Size.Y * MaxSize, LongSide), 1));
+	OutPixels.SetNumUninitialized(OutSize.X * OutSize.Y);
+
+	for (int32 OutY = 0; OutY < OutSize.Y; ++OutY)
+	{
+		const int32 BeginY = OutY * Size.Y / OutSize.Y;
+		const int32 EndY = FMath::Max((OutY + 1) * Size.Y / OutSize.Y, BeginY + 1);
+		for (int32 OutX = 0; OutX < OutSize.X; ++OutX)
+		{
+			const int32 BeginX = OutX * Size.X / OutSize.X;
+			const int32 EndX = FMath::Max((OutX + 1) * Size.X / OutSize.X, BeginX + 1);
+
+			// 每次加载一个像素的四个通道，整块累加后求平均
+			VectorRegister4Float Sum = VectorZeroFloat();
+			for (int32 Y = BeginY; Y < EndY; ++Y)
+			{
+				const FColor* Row = Pixels.GetData() + Y * Size.X;
+				for (int32 X = BeginX; X < EndX; ++X)
+				{
+					Sum = VectorAdd(Sum, VectorLoadByte4(&Row[X]));
+				}
+			}
+
+			const float InvCount = 1.0f / ((EndY - BeginY) * (EndX - BeginX));
+			VectorStoreByte4(VectorMultiply(Sum, VectorSetFloat1(InvCount)), &OutPixels[OutY * OutSize.X + OutX]);
+		}
+	}
+}
+
+TSharedPtr<FDreamSMTCPreparedThumbnail, ESPMode::ThreadSafe> FDreamSMTCThumbnail::Prepare(
+	const TArray64<uint8>& Encoded, FString& OutError)
+{
+	const TSharedPtr<IDreamSMTCBackend, ESPMode::ThreadSafe> Backend = UDreamSMTCSubsystem::GetBackend();
+	if (!Backend.IsValid())
+	{
+		OutError = TEXT("The SMTC backend has been released.");
+		return nullptr;
+	}
+	return Backend->PrepareThumbnail(Encoded, OutError);
+}
+
+bool FDreamSMTCThumbnail::SetPrepared(const FDreamSMTCPreparedThumbnail& Prepared, FString& OutError)
+{
+	const TSharedPtr<IDreamSMTCBackend, ESPMode::ThreadSafe> Backend = UDreamSMTCSubsystem::GetBackend();
+	if (!Backend.IsValid())
+	{
+		OutError = TEXT("The SMTC backend has been released.");
+		return false;
+	}
+	return Backend->SetPreparedThumbnail(Prepared, OutError);
+}
+
+FString FDreamSMTCThumbnail::GetCacheDirectory()
+{
+	return FPaths::ProjectSavedDir() / TEXT("DreamSMTCCache");
+}
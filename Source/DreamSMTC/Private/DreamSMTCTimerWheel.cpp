@@ -0,0 +1,254 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCTimerWheel.h"
+
+#include "DreamSMTCMemory.h"
+#include "Async/Async.h"
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/RunnableThread.h"
+
+FDreamSMTCTimerWheel::~FDreamSMTCTimerWheel()
+{
+	// 线程持有自身的引用，走到这里时线程只可能尚未停止或已经退出
+	Stop();
+	ReleaseThread();
+}
+
+uint64 FDreamSMTCTimerWheel::Schedule(double Deadline, FTimerCallback&& Callback)
+{
+	uint64 TimerId;
+	{
+		FScopeLock ScopeLock(&Lock);
+
+		// 第一次调度时才创建线程
+		if (!Thread && !bStopping)
+		{
+			CurrentTick = ToTick(FPlatformTime::Seconds());
+			WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+			ExitedEvent = FPlatformProcess::GetSynchEventFromPool(true);
+			Thread = FRunnableThread::Create(this, TEXT("DreamSMTCTimerWheel"), 0, TPri_TimeCritical);
+		}
+
+		TimerId = NextTimerId++;
+		Insert(FTimer{TimerId, Deadline, MoveTemp(Callback)});
+	}
+
+	if (WakeEvent)
+	{
+		WakeEvent->Trigger();
+	}
+	return TimerId;
+}
+
+bool FDreamSMTCTimerWheel::Reschedule(uint64 TimerId, double Deadline)
+{
+	{
+		FScopeLock ScopeLock(&Lock);
+		FTimer Timer;
+		if (!Extract(TimerId, Timer))
+		{
+			return false;
+		}
+		Timer.Deadline = Deadline;
+		Insert(MoveTemp(Timer));
+	}
+
+	if (WakeEvent)
+	{
+		WakeEvent->Trigger();
+	}
+	return true;
+}
+
+bool FDreamSMTCTimerWheel::Cancel(uint64 TimerId)
+{
+	FScopeLock ScopeLock(&Lock);
+	FTimer Timer;
+	return Extract(TimerId, Timer);
+}
+
+TFuture<bool> FDreamSMTCTimerWheel::Shutdown(double Timeout)
+{
+	Stop();
+	{
+		FScopeLock ScopeLock(&Lock);
+		for (TArray<FTimer>& Slot : Slots)
+		{
+			Slot.Empty();
+		}
+		SlotOfTimer.Empty();
+	}
+
+	// 回调卡在系统调用中时不再等待，由后台任务持有定时器轮直到线程退出
+	if (ExitedEvent && !ExitedEvent->Wait(static_cast<uint32>(FMath::Max(Timeout, 0.0) * 1000.0)))
+	{
+		return Async(EAsyncExecution::ThreadPool, [This = AsShared()]()
+		{
+			This->ReleaseThread();
+			return true;
+		});
+	}
+
+	ReleaseThread();
+	return TFuture<bool>();
+}
+
+void FDreamSMTCTimerWheel::ReleaseThread()
+{
+	if (Thread)
+	{
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	if (WakeEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+		WakeEvent = nullptr;
+	}
+	if (ExitedEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(ExitedEvent);
+		ExitedEvent = nullptr;
+	}
+}
+
+int32 FDreamSMTCTimerWheel::Num() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return SlotOfTimer.Num();
+}
+
+SIZE_T FDreamSMTCTimerWheel::GetAllocatedSize() const
+{
+	FScopeLock ScopeLock(&Lock);
+	SIZE_T Size = SlotOfTimer.GetAllocatedSize();
+	for (const TArray<FTimer>& Slot : Slots)
+	{
+		Size += Slot.GetAllocatedSize();
+	}
+	return Size;
+}
+
+uint32 FDreamSMTCTimerWheel::Run()
+{
+	DSMTC_LLM_SCOPE();
+	TArray<FTimer> Due;
+	while (!bStopping)
+	{
+		const double Next = GetNextDeadline();
+		const double Remaining = Next - FPlatformTime::Seconds();
+		if (Next == TNumericLimits<double>::Max())
+		{
+			WakeEvent->Wait();
+			continue;
+		}
+		if (Remaining > SpinSeconds)
+		{
+			// 提前醒来，剩余的时间让出时间片等待，避免睡眠精度造成的延迟
+			WakeEvent->Wait(static_cast<uint32>((Remaining - SpinSeconds) * 1000.0));
+			continue;
+		}
+		while (FPlatformTime::Seconds() < Next && !bStopping)
+		{
+			FPlatformProcess::YieldThread();
+		}
+
+		const double Now = FPlatformTime::Seconds();
+		{
+			FScopeLock ScopeLock(&Lock);
+			CollectDue(Now, Due);
+		}
+
+		Due.Sort([](const FTimer& A, const FTimer& B) { return A.Deadline < B.Deadline; });
+		for (FTimer& Timer : Due)
+		{
+			Timer.Callback(FPlatformTime::Seconds());
+		}
+		Due.Reset();
+	}
+
+	ExitedEvent->Trigger();
+	return 0;
+}
+
+void FDreamSMTCTimerWheel::Stop()
+{
+	bStopping = true;
+	if (WakeEvent)
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+void FDreamSMTCTimerWheel::Insert(FTimer&& Timer)
+{
+	// 已过期的定时器放入当前槽位，下一次推进时触发
+	const int64 Tick = FMath::Max(ToTick(Timer.Deadline), CurrentTick);
+	const int32 Slot = static_cast<int32>(Tick & (NumSlots - 1));
+	SlotOfTimer.Add(Timer.Id, Slot);
+	Slots[Slot].Add(MoveTemp(Timer));
+}
+
+bool FDreamSMTCTimerWheel::Extract(uint64 TimerId, FTimer& OutTimer)
+{
+	int32 Slot;
+	if (!SlotOfTimer.RemoveAndCopyValue(TimerId, Slot))
+	{
+		return false;
+	}
+
+	TArray<FTimer>& Timers = Slots[Slot];
+	const int32 Index = Timers.IndexOfByPredicate([TimerId](const FTimer& Timer) { return Timer.Id == TimerId; });
+	check(Index != INDEX_NONE);
+	OutTimer = MoveTemp(Timers[Index]);
+	Timers.RemoveAtSwap(Index);
+	return true;
+}
+
+double FDreamSMTCTimerWheel::GetNextDeadline() const
+{
+	FScopeLock ScopeLock(&Lock);
+	double Next = TNumericLimits<double>::Max();
+	if (SlotOfTimer.Num() == 0)
+	{
+		return Next;
+	}
+
+	// 从当前槽位向后找，一圈之内第一个非空槽位中最早的定时器即为下一个
+	for (int32 Step = 0; Step < NumSlots; ++Step)
+	{
+		for (const FTimer& Timer : Slots[(CurrentTick + Step) & (NumSlots - 1)])
+		{
+			Next = FMath::Min(Next, Timer.Deadline);
+		}
+		if (Next < (CurrentTick + Step + 1) * SlotSeconds)
+		{
+			break;
+		}
+	}
+	return Next;
+}
+
+void FDreamSMTCTimerWheel::CollectDue(double Now, TArray<FTimer>& OutDue)
+{
+	// 只需检查从上次推进到现在经过的槽位，超过一圈时每个槽位检查一次
+	const int64 NowTick = ToTick(Now);
+	const int64 LastTick = FMath::Min(NowTick, CurrentTick + NumSlots - 1);
+	for (int64 Tick = CurrentTick; Tick <= LastTick; ++Tick)
+	{
+		TArray<FTimer>& Timers = Slots[Tick & (NumSlots - 1)];
+		for (int32 Index = Timers.Num() - 1; Index >= 0; --Index)
+		{
+			if (Timers[Index].Deadline <= Now)
+			{
+				SlotOfTimer.Remove(Timers[Index].Id);
+				OutDue.Add(MoveTemp(Timers[Index]));
+				Timers.RemoveAtSwap(Index);
+			}
+		}
+	}
+	CurrentTick = FMath::Max(CurrentTick, NowTick);
+}
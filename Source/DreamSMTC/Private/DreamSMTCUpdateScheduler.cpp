@@ -0,0 +1,117 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCUpdateScheduler.h"
+
+void FDreamSMTCUpdateScheduler::Configure(float InMaxCallsPerSecond, float InLowPriorityFlushDelay,
+                                          float InHighPriorityReserve)
+{
+	MaxCallsPerSecond = FMath::Max(InMaxCallsPerSecond, 1.0f);
+	LowPriorityFlushDelay = FMath::Max(InLowPriorityFlushDelay, 0.0f);
+	HighPriorityReserve = FMath::Clamp(InHighPriorityReserve, 0.0f, MaxCallsPerSecond);
+	Tokens = FMath::Min(Tokens, static_cast<double>(MaxCallsPerSecond));
+}
+
+void FDreamSMTCUpdateScheduler::Enqueue(EDreamSMTCPendingWrite Writes, EDreamSMTCUpdatePriority Priority, double Now)
+{
+	if (Priority == EDreamSMTCUpdatePriority::High)
+	{
+		// 提升为高优先级，从低优先级队列中移除
+		PendingHigh |= Writes;
+		PendingLow &= ~Writes;
+		return;
+	}
+
+	// 已经在高优先级队列中的写入无需降级
+	Writes &= ~PendingHigh;
+	if (Writes == EDreamSMTCPendingWrite::None)
+	{
+		return;
+	}
+
+	if (PendingLow == EDreamSMTCPendingWrite::None)
+	{
+		LowPriorityQueuedTime = Now;
+	}
+	PendingLow |= Writes;
+}
+
+EDreamSMTCPendingWrite FDreamSMTCUpdateScheduler::Poll(double Now)
+{
+	Refill(Now);
+
+	if (PendingHigh != EDreamSMTCPendingWrite::None)
+	{
+		// 预算不足时等待下一帧；预算允许透支一次，后续提交会被推迟直到还清
+		if (Tokens < 1.0)
+		{
+			++Stats.ThrottledCommits;
+			return EDreamSMTCPendingWrite::None;
+		}
+
+		if (PendingLow != EDreamSMTCPendingWrite::None)
+		{
+			Stats.MergedLowPriorityWrites += CountCalls(PendingLow);
+		}
+		return Take(PendingHigh | PendingLow);
+	}
+
+	if (PendingLow != EDreamSMTCPendingWrite::None && Now - LowPriorityQueuedTime >= LowPriorityFlushDelay)
+	{
+		if (Tokens < CountCalls(PendingLow) + HighPriorityReserve)
+		{
+			++Stats.ThrottledCommits;
+			return EDreamSMTCPendingWrite::None;
+		}
+		return Take(PendingLow);
+	}
+
+	return EDreamSMTCPendingWrite::None;
+}
+
+EDreamSMTCPendingWrite FDreamSMTCUpdateScheduler::Flush(double Now)
+{
+	Refill(Now);
+	return Take(PendingHigh | PendingLow);
+}
+
+void FDreamSMTCUpdateScheduler::Reset()
+{
+	PendingHigh = EDreamSMTCPendingWrite::None;
+	PendingLow = EDreamSMTCPendingWrite::None;
+	Tokens = MaxCallsPerSecond;
+	LastRefillTime = -1.0;
+}
+
+void FDreamSMTCUpdateScheduler::Refill(double Now)
+{
+	if (LastRefillTime < 0.0)
+	{
+		Tokens = MaxCallsPerSecond;
+	}
+	else
+	{
+		Tokens = FMath::Min(Tokens + (Now - LastRefillTime) * MaxCallsPerSecond,
+		                    static_cast<double>(MaxCallsPerSecond));
+	}
+	LastRefillTime = Now;
+}
+
+EDreamSMTCPendingWrite FDreamSMTCUpdateScheduler::Take(EDreamSMTCPendingWrite Writes)
+{
+	PendingHigh &= ~Writes;
+	PendingLow &= ~Writes;
+
+	const int32 Calls = CountCalls(Writes);
+	Tokens -= Calls;
+	Stats.BackendCalls += Calls;
+	if (Calls > 0)
+	{
+		++Stats.Commits;
+	}
+	return Writes;
+}
+
+int32 FDreamSMTCUpdateScheduler::CountCalls(EDreamSMTCPendingWrite Writes)
+{
+	return FMath::CountBits(static_cast<uint64>(Writes));
+}
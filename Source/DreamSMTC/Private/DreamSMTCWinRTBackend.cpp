@@ -0,0 +1,369 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCWinRTBackend.h"
+
+#if PLATFORM_WINDOWS || PLATFORM_HOLOLENS
+
+#include "DreamSMTCButtons.h"
+#include "DreamSMTCLog.h"
+
+namespace
+{
+	struct FWinRTPreparedThumbnail : FDreamSMTCPreparedThumbnail
+	{
+		winrt::Windows::Storage::Streams::RandomAccessStreamReference Reference{nullptr};
+	};
+}
+
+FDreamSMTCWinRTBackend::FDreamSMTCWinRTBackend()
+{
+	try
+	{
+		Player.emplace();
+		// 按钮事件由本插件处理，不交给 MediaPlayer 的默认行为
+		Player->CommandManager().IsEnabled(false);
+	}
+	catch (const winrt::hresult_error& ex)
+	{
+		DSMTC_LOG(Error, TEXT("Failed to create SMTC media player: %s"), *FormatError(ex));
+	}
+}
+
+winrt::Windows::Media::SystemMediaTransportControls FDreamSMTCWinRTBackend::GetControls() const
+{
+	if (!Player.has_value())
+	{
+		throw winrt::hresult_error(E_ILLEGAL_METHOD_CALL);
+	}
+	return Player->SystemMediaTransportControls();
+}
+
+FString FDreamSMTCWinRTBackend::FormatError(const winrt::hresult_error& Error)
+{
+	return FString::Printf(TEXT("0x%08X - %s"), Error.code().value, Error.message().c_str());
+}
+
+bool FDreamSMTCWinRTBackend::WriteSession(const FDreamSMTCSessionState& State, EDreamSMTCSessionField Fields,
+                                          uint32 ButtonMask, FString& OutError)
+{
+	using namespace winrt::Windows::Media;
+
+	try
+	{
+		const SystemMediaTransportControls Controls = GetControls();
+
+		if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Enabled))
+		{
+			Controls.IsEnabled(State.bEnabled);
+		}
+		if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Buttons))
+		{
+			// 只遍历需要写入的位
+			for (uint32 Pending = ButtonMask & DreamSMTCValidButtons; Pending != 0; Pending &= Pending - 1)
+			{
+				const EDreamSMTCButtonEvent Button = static_cast<EDreamSMTCButtonEvent>(
+					FMath::CountTrailingZeros(Pending));
+				WriteButton(Controls, Button, (State.EnabledButtons & DreamSMTCButtonBit(Button)) != 0);
+			}
+		}
+		if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::PlaybackStatus))
+		{
+			Controls.PlaybackStatus(static_cast<MediaPlaybackStatus>(State.PlaybackStatus));
+		}
+		if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::PlaybackRate))
+		{
+			Controls.PlaybackRate(State.PlaybackRate);
+		}
+		if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Shuffle))
+		{
+			Controls.ShuffleEnabled(State.bShuffleEnabled);
+		}
+		if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::AutoRepeat))
+		{
+			Controls.AutoRepeatMode(static_cast<MediaPlaybackAutoRepeatMode>(State.AutoRepeatMode));
+		}
+
+		if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Display))
+		{
+			const SystemMediaTransportControlsDisplayUpdater Updater = Controls.DisplayUpdater();
+			if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Type))
+			{
+				Updater.Type(static_cast<MediaPlaybackType>(State.Type));
+			}
+			if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::AppMediaId))
+			{
+				Updater.AppMediaId(*State.AppMediaId);
+			}
+
+			// 只有当前类型对应的属性可以访问
+			if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Music) && State.Type == EDreamSMTCMediaPlaybackType::Music)
+			{
+				const MusicDisplayProperties Music = Updater.MusicProperties();
+				Music.AlbumArtist(*State.Music.AlbumArtist);
+				Music.AlbumTitle(*State.Music.AlbumTitle);
+				Music.AlbumTrackCount(State.Music.AlbumTrackCount);
+				Music.Artist(*State.Music.Artist);
+				Music.Title(*State.Music.Title);
+				Music.TrackNumber(State.Music.TrackNumber);
+			}
+			if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Video) && State.Type == EDreamSMTCMediaPlaybackType::Video)
+			{
+				const VideoDisplayProperties Video = Updater.VideoProperties();
+				Video.Subtitle(*State.Video.Subtitle);
+				Video.Title(*State.Video.Title);
+			}
+			if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Image) && State.Type == EDreamSMTCMediaPlaybackType::Image)
+			{
+				const ImageDisplayProperties Image = Updater.ImageProperties();
+				Image.Subtitle(*State.Image.Subtitle);
+				Image.Title(*State.Image.Title);
+			}
+		}
+	}
+	catch (std::exception& e)
+	{
+		OutError = e.what();
+		return false;
+	}
+	catch (const winrt::hresult_error& ex)
+	{
+		OutError = FormatError(ex);
+		return false;
+	}
+
+	if (EnumHasAnyFlags(Fields, EDreamSMTCSessionField::Timeline))
+	{
+		return WriteTimeline(State.Timeline, OutError);
+	}
+	return true;
+}
+
+bool FDreamSMTCWinRTBackend::WriteTimeline(const FDreamSMTCTimelineProperties& Timeline, FString& OutError)
+{
+	try
+	{
+		winrt::Windows::Media::SystemMediaTransportControlsTimelineProperties Time;
+		Time.StartTime(UnrealToWinRTTimespan(Timeline.StartTime));
+		Time.EndTime(UnrealToWinRTTimespan(Timeline.EndTime));
+		Time.MinSeekTime(UnrealToWinRTTimespan(Timeline.MinSeekTime));
+		Time.MaxSeekTime(UnrealToWinRTTimespan(Timeline.MaxSeekTime));
+		Time.Position(UnrealToWinRTTimespan(Timeline.Position));
+		GetControls().UpdateTimelineProperties(Time);
+	}
+	catch (const winrt::hresult_error& ex)
+	{
+		OutError = FormatError(ex);
+		return false;
+	}
+	return true;
+}
+
+void FDreamSMTCWinRTBackend::WriteButton(const winrt::Windows::Media::SystemMediaTransportControls& Controls,
+                                         EDreamSMTCButtonEvent Button, bool bEnable)
+{
+	switch (Button)
+	{
+#define DREAMSMTC_WRITE_BUTTON(Name) \
+	case EDreamSMTCButtonEvent::Name: Controls.Is##Name##Enabled(bEnable); \
+		break;
+		DREAMSMTC_BUTTONS(DREAMSMTC_WRITE_BUTTON)
+#undef DREAMSMTC_WRITE_BUTTON
+	}
+}
+
+bool FDreamSMTCWinRTBackend::Update(FString& OutError)
+{
+	try
+	{
+		GetControls().DisplayUpdater().Update();
+	}
+	catch (const winrt::hresult_error& ex)
+	{
+		OutError = FormatError(ex);
+		return false;
+	}
+	return true;
+}
+
+bool FDreamSMTCWinRTBackend::ClearAll(FString& OutError)
+{
+	try
+	{
+		GetControls().DisplayUpdater().ClearAll();
+	}
+	catch (const winrt::hresult_error& ex)
+	{
+		OutError = FormatError(ex);
+		return false;
+	}
+	return true;
+}
+
+bool FDreamSMTCWinRTBackend::SetThumbnailFromFile(const FString& FullPath, FString& OutError)
+{
+	// 转换为 WinRT 兼容路径
+	const FString WinRTPath = FullPath.Replace(TEXT("/"), TEXT("\\"));
+
+	try
+	{
+		const auto File = winrt::Windows::Storage::StorageFile::GetFileFromPathAsync(*WinRTPath).get();
+		const auto ThumbnailRef = winrt::Windows::Storage::Streams::RandomAccessStreamReference::CreateFromFile(File);
+		GetControls().DisplayUpdater().Thumbnail(ThumbnailRef);
+	}
+	catch (const winrt::hresult_error& ex)
+	{
+		OutError = FormatError(ex);
+		return false;
+	}
+	return true;
+}
+
+TSharedPtr<FDreamSMTCPreparedThumbnail, ESPMode::ThreadSafe> FDreamSMTCWinRTBackend::PrepareThumbnail(
+	const TArray64<uint8>& Encoded, FString& OutError)
+{
+	try
+	{
+		using namespace winrt::Windows::Storage::Streams;
+
+		const InMemoryRandomAccessStream Stream;
+		const DataWriter Writer(Stream);
+		Writer.WriteBytes(winrt::array_view<const uint8_t>(Encoded.GetData(), Encoded.GetData() + Encoded.Num()));
+		Writer.StoreAsync().get();
+		Writer.DetachStream();
+		Stream.Seek(0);
+
+		TSharedRef<FWinRTPreparedThumbnail, ESPMode::ThreadSafe> Prepared =
+			MakeShared<FWinRTPreparedThumbnail, ESPMode::ThreadSafe>();
+		Prepared->Reference = RandomAccessStreamReference::CreateFromStream(Stream);
+		return Prepared;
+	}
+	catch (const winrt::hresult_error& ex)
+	{
+		OutError = FormatError(ex);
+		return nullptr;
+	}
+}
+
+bool FDreamSMTCWinRTBackend::SetPreparedThumbnail(const FDreamSMTCPreparedThumbnail& Prepared, FString& OutError)
+{
+	try
+	{
+		GetControls().DisplayUpdater().Thumbnail(static_cast<const FWinRTPreparedThumbnail&>(Prepared).Reference);
+	}
+	catch (const winrt::hresult_error& ex)
+	{
+		OutError = FormatError(ex);
+		return false;
+	}
+	return true;
+}
+
+EDreamSMTCMediaSoundLevel FDreamSMTCWinRTBackend::GetSoundLevel() const
+{
+	try
+	{
+		return static_cast<EDreamSMTCMediaSoundLevel>(GetControls().SoundLevel());
+	}
+	catch (const winrt::hresult_error& ex)
+	{
+		DSMTC_LOG(Error, TEXT("SMTC update failed: %s"), *FormatError(ex));
+		return EDreamSMTCMediaSoundLevel::Muted;
+	}
+}
+
+uint64 FDreamSMTCWinRTBackend::AddHandlers(FDreamSMTCBackendHandlers&& InHandlers)
+{
+	using namespace winrt::Windows::Media;
+
+	// 回调持有处理函数的共享副本，注销时仍在执行的回调不受影响
+	const TSharedRef<const FDreamSMTCBackendHandlers, ESPMode::ThreadSafe> Handlers =
+		MakeShared<const FDreamSMTCBackendHandlers, ESPMode::ThreadSafe>(MoveTemp(InHandlers));
+	TUniquePtr<FRegistration> Registration = MakeUnique<FRegistration>();
+
+	try
+	{
+		const SystemMediaTransportControls Controls = GetControls();
+
+		Registration->ButtonPressedRevoker = Controls.ButtonPressed(winrt::auto_revoke,
+			[Handlers](const SystemMediaTransportControls&, const SystemMediaTransportControlsButtonPressedEventArgs& Args)
+			{
+				Handlers->ButtonPressed(static_cast<EDreamSMTCButtonEvent>(Args.Button()));
+			});
+
+		Registration->PlaybackPositionChangeRevoker = Controls.PlaybackPositionChangeRequested(winrt::auto_revoke,
+			[Handlers](const SystemMediaTransportControls&, const PlaybackPositionChangeRequestedEventArgs& Args)
+			{
+				Handlers->PlaybackPositionChangeRequested(WinRTToUnrealTimespan(Args.RequestedPlaybackPosition()));
+			});
+
+		Registration->PlaybackRateChangeRevoker = Controls.PlaybackRateChangeRequested(winrt::auto_revoke,
+			[Handlers](const SystemMediaTransportControls&, const PlaybackRateChangeRequestedEventArgs& Args)
+			{
+				Handlers->PlaybackRateChangeRequested(Args.RequestedPlaybackRate());
+			});
+
+		Registration->ShuffleEnabledChangeRevoker = Controls.ShuffleEnabledChangeRequested(winrt::auto_revoke,
+			[Handlers](const SystemMediaTransportControls&, const ShuffleEnabledChangeRequestedEventArgs& Args)
+			{
+				Handlers->ShuffleEnabledChangeRequested(Args.RequestedShuffleEnabled());
+			});
+
+		Registration->AutoRepeatModeChangeRevoker = Controls.AutoRepeatModeChangeRequested(winrt::auto_revoke,
+			[Handlers](const SystemMediaTransportControls&, const AutoRepeatModeChangeRequestedEventArgs& Args)
+			{
+				Handlers->AutoRepeatModeChangeRequested(
+					static_cast<EDreamSMTCAutoRepeatMode>(Args.RequestedAutoRepeatMode()));
+			});
+	}
+	catch (const winrt::hresult_error& ex)
+	{
+		DSMTC_LOG(Error, TEXT("Failed to register SMTC change request handlers: %s"), *FormatError(ex));
+	}
+
+	FScopeLock Lock(&RegistrationLock);
+	const uint64 HandlersId = NextHandlersId++;
+	Registrations.Add(HandlersId, MoveTemp(Registration));
+	return HandlersId;
+}
+
+void FDreamSMTCWinRTBackend::RemoveHandlers(uint64 HandlersId)
+{
+	TUniquePtr<FRegistration> Registration;
+	{
+		FScopeLock Lock(&RegistrationLock);
+		Registrations.RemoveAndCopyValue(HandlersId, Registration);
+	}
+	// 析构时撤销全部回调
+	Registration.Reset();
+}
+
+bool FDreamSMTCWinRTBackend::Release(FString& OutError)
+{
+	{
+		FScopeLock Lock(&RegistrationLock);
+		Registrations.Empty();
+	}
+
+	if (!Player.has_value())
+	{
+		return true;
+	}
+
+	bool bSuccess = true;
+	try
+	{
+		const winrt::Windows::Media::SystemMediaTransportControls Controls = Player->SystemMediaTransportControls();
+		Controls.DisplayUpdater().ClearAll();
+		Controls.IsEnabled(false);
+		Player->Close();
+	}
+	catch (const winrt::hresult_error& ex)
+	{
+		OutError = FormatError(ex);
+		bSuccess = false;
+	}
+	Player.reset();
+	return bSuccess;
+}
+
+#endif
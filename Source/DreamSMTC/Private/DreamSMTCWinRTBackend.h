@@ -0,0 +1,89 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DreamSMTCBackend.h"
+
+#if PLATFORM_WINDOWS || PLATFORM_HOLOLENS
+
+#include <optional>
+
+#include "DreamSMTCWindowsRuntimeInclude.h"
+
+/**
+ * Windows System Media Transport Controls backend
+ * Owns the MediaPlayer whose controls the OS shows for this process.
+ */
+class FDreamSMTCWinRTBackend : public IDreamSMTCBackend
+{
+public:
+	FDreamSMTCWinRTBackend();
+
+	virtual const TCHAR* GetName() const override { return TEXT("WinRT"); }
+
+	virtual bool WriteSession(const FDreamSMTCSessionState& State, EDreamSMTCSessionField Fields, uint32 ButtonMask,
+	                          FString& OutError) override;
+	virtual bool WriteTimeline(const FDreamSMTCTimelineProperties& Timeline, FString& OutError) override;
+	virtual bool Update(FString& OutError) override;
+	virtual bool ClearAll(FString& OutError) override;
+
+	virtual bool SetThumbnailFromFile(const FString& FullPath, FString& OutError) override;
+	virtual TSharedPtr<FDreamSMTCPreparedThumbnail, ESPMode::ThreadSafe> PrepareThumbnail(
+		const TArray64<uint8>& Encoded, FString& OutError) override;
+	virtual bool SetPreparedThumbnail(const FDreamSMTCPreparedThumbnail& Prepared, FString& OutError) override;
+
+	virtual EDreamSMTCMediaSoundLevel GetSoundLevel() const override;
+
+	virtual uint64 AddHandlers(FDreamSMTCBackendHandlers&& Handlers) override;
+	virtual void RemoveHandlers(uint64 HandlersId) override;
+
+	virtual bool Release(FString& OutError) override;
+
+private:
+	struct FRegistration
+	{
+		winrt::Windows::Media::SystemMediaTransportControls::ButtonPressed_revoker ButtonPressedRevoker;
+		winrt::Windows::Media::SystemMediaTransportControls::PlaybackPositionChangeRequested_revoker PlaybackPositionChangeRevoker;
+		winrt::Windows::Media::SystemMediaTransportControls::PlaybackRateChangeRequested_revoker PlaybackRateChangeRevoker;
+		winrt::Windows::Media::SystemMediaTransportControls::ShuffleEnabledChangeRequested_revoker ShuffleEnabledChangeRevoker;
+		winrt::Windows::Media::SystemMediaTransportControls::AutoRepeatModeChangeRequested_revoker AutoRepeatModeChangeRevoker;
+	};
+
+	winrt::Windows::Media::SystemMediaTransportControls GetControls() const;
+
+	static void WriteButton(const winrt::Windows::Media::SystemMediaTransportControls& Controls,
+	                        EDreamSMTCButtonEvent Button, bool bEnable);
+
+	static FString FormatError(const winrt::hresult_error& Error);
+
+	static FTimespan WinRTToUnrealTimespan(const winrt::Windows::Foundation::TimeSpan& WinRTTime)
+	{
+		// 获取 WinRT 的 100 纳秒单位值
+		int64_t WinRTTicks = WinRTTime.count();
+		// 转换为微秒：除以 10
+		int64_t UnrealTicks = WinRTTicks / 10;
+		// 构造 Unreal 的 FTimespan
+		return FTimespan(UnrealTicks);
+	}
+
+	static winrt::Windows::Foundation::TimeSpan UnrealToWinRTTimespan(const FTimespan& UnrealTime)
+	{
+		// 获取 Unreal 的微秒值
+		int64_t UnrealTicks = UnrealTime.GetTicks();
+		// 转换为 100 纳秒单位：乘以 10
+		int64_t WinRTTicks = UnrealTicks * 10;
+		// 构造 WinRT 的 TimeSpan
+		winrt::Windows::Foundation::TimeSpan WinRTTime(WinRTTicks);
+		return WinRTTime;
+	}
+
+private:
+	std::optional<winrt::Windows::Media::Playback::MediaPlayer> Player;
+
+	FCriticalSection RegistrationLock;
+	TMap<uint64, TUniquePtr<FRegistration>> Registrations;
+	uint64 NextHandlersId = 1;
+};
+
+#endif
@@ -0,0 +1,38 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCCueTrack.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDreamSMTCCueTrackChaptersTest, "DreamSMTC.CueTrack.Chapters",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDreamSMTCCueTrackChaptersTest::RunTest(const FString& Parameters)
+{
+	FDreamSMTCCueTrack Track;
+	const bool bLoaded = Track.LoadChapters(TEXT("00:00\tOpening Theme - Main Cast\n")
+	                                        TEXT("01:30.500 Second Chapter\n")
+	                                        TEXT("1:02:03 \t Final Act\n")
+	                                        TEXT("not a chapter\n"));
+	TestTrue(TEXT("Chapters loaded"), bLoaded);
+	if (!TestEqual(TEXT("Cue count"), Track.Num(), 3))
+	{
+		return false;
+	}
+
+	// 制表符分隔的标题保留其中的空格
+	const TArray<FDreamSMTCCue>& Cues = Track.GetCues();
+	TestTrue(TEXT("Tab separated time"), Cues[0].Time == FTimespan::Zero());
+	TestEqual(TEXT("Tab separated title"), Cues[0].Title, FString(TEXT("Opening Theme")));
+	TestEqual(TEXT("Tab separated subtitle"), Cues[0].Subtitle, FString(TEXT("Main Cast")));
+
+	TestTrue(TEXT("Space separated time"), Cues[1].Time == FTimespan::FromMilliseconds(90500.0));
+	TestEqual(TEXT("Space separated title"), Cues[1].Title, FString(TEXT("Second Chapter")));
+
+	TestTrue(TEXT("Padded tab time"), Cues[2].Time == FTimespan(1, 2, 3));
+	TestEqual(TEXT("Padded tab title"), Cues[2].Title, FString(TEXT("Final Act")));
+	return true;
+}
+
+#endif
@@ -0,0 +1,170 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCRemoteServer.h"
+#include "DreamSMTCTypes.h"
+#include "Misc/AutomationTest.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace DreamSMTCRemoteServerTests
+{
+	static const TCHAR* TestToken = TEXT("0123456789abcdef");
+	static const TCHAR* AllowedOrigin = TEXT("http://allowed.example");
+
+	/** Sends Request on a new loopback connection and returns the response up to the end of its header. */
+	static FString Exchange(int32 Port, const FString& Request)
+	{
+		ISocketSubsystem* Sockets = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+		FSocket* Socket = Sockets->CreateSocket(NAME_Stream, TEXT("DreamSMTCRemoteTest"), false);
+		if (!Socket)
+		{
+			return FString();
+		}
+
+		const TSharedRef<FInternetAddr> Address = Sockets->CreateInternetAddr();
+		Address->SetIp(0x7F000001);
+		Address->SetPort(Port);
+
+		TArray<uint8> Received;
+		if (Socket->Connect(*Address))
+		{
+			const FTCHARToUTF8 RequestUtf8(*Request);
+			int32 BytesSent = 0;
+			Socket->Send(reinterpret_cast<const uint8*>(RequestUtf8.Get()), RequestUtf8.Length(), BytesSent);
+
+			// 升级成功的连接不会关闭，收到完整的响应头即返回
+			const double Deadline = FPlatformTime::Seconds() + 5.0;
+			while (FPlatformTime::Seconds() < Deadline)
+			{
+				if (!Socket->Wait(ESocketWaitConditions::WaitForRead, FTimespan::FromMilliseconds(100)))
+				{
+					continue;
+				}
+
+				uint8 Buffer[1024];
+				int32 BytesRead = 0;
+				if (!Socket->Recv(Buffer, sizeof(Buffer), BytesRead) || BytesRead <= 0)
+				{
+					break;
+				}
+				Received.Append(Buffer, BytesRead);
+
+				const FUTF8ToTCHAR Text(reinterpret_cast<const ANSICHAR*>(Received.GetData()), Received.Num());
+				if (FString(Text.Length(), Text.Get()).Contains(TEXT("\r\n\r\n")))
+				{
+					break;
+				}
+			}
+		}
+
+		Socket->Close();
+		Sockets->DestroySocket(Socket);
+
+		const FUTF8ToTCHAR Text(reinterpret_cast<const ANSICHAR*>(Received.GetData()), Received.Num());
+		return FString(Text.Length(), Text.Get());
+	}
+
+	static FString WebSocketRequest(int32 Port, const FString& Host, const FString& Path, const FString& ExtraHeaders)
+	{
+		return FString::Printf(
+			TEXT("GET %s HTTP/1.1\r\nHost: %s\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n")
+			TEXT("Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n%s\r\n"),
+			*Path, Host.IsEmpty() ? *FString::Printf(TEXT("127.0.0.1:%d"), Port) : *Host, *ExtraHeaders);
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDreamSMTCRemoteServerAccessTest, "DreamSMTC.RemoteServer.Access",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDreamSMTCRemoteServerAccessTest::RunTest(const FString& Parameters)
+{
+	using namespace DreamSMTCRemoteServerTests;
+
+	// 端口可能被占用，依次尝试
+	TSharedPtr<FDreamSMTCRemoteServer, ESPMode::ThreadSafe> Server;
+	int32 Port = 0;
+	for (int32 Candidate = 47311; Candidate < 47321 && !Server.IsValid(); ++Candidate)
+	{
+		Server = MakeShared<FDreamSMTCRemoteServer, ESPMode::ThreadSafe>(Candidate, 8, TestToken,
+		                                                                 TArray<FString>{AllowedOrigin});
+		if (Server->Start())
+		{
+			Port = Candidate;
+		}
+		else
+		{
+			Server->Shutdown();
+			Server.Reset();
+		}
+	}
+	if (!TestTrue(TEXT("Server listens on a loopback port"), Server.IsValid()))
+	{
+		return false;
+	}
+
+	const FString TokenQuery = FString::Printf(TEXT("/?token=%s"), TestToken);
+	const FString Bearer = FString::Printf(TEXT("Authorization: Bearer %s\r\n"), TestToken);
+
+	const FString ForeignOrigin = Exchange(Port, WebSocketRequest(Port, FString(), TokenQuery,
+	                                                              TEXT("Origin: http://evil.example\r\n")));
+	TestTrue(TEXT("Upgrade from a foreign origin is rejected"), ForeignOrigin.StartsWith(TEXT("HTTP/1.1 403")));
+
+	const FString RebindHost = Exchange(Port, WebSocketRequest(Port, FString::Printf(TEXT("evil.example:%d"), Port),
+	                                                           TokenQuery, FString()));
+	TestTrue(TEXT("Upgrade for a foreign host is rejected"), RebindHost.StartsWith(TEXT("HTTP/1.1 403")));
+
+	const FString NoToken = Exchange(Port, WebSocketRequest(Port, FString(), TEXT("/"),
+	                                                        FString::Printf(TEXT("Origin: %s\r\n"), AllowedOrigin)));
+	TestTrue(TEXT("Upgrade without a token is rejected"), NoToken.StartsWith(TEXT("HTTP/1.1 401")));
+
+	const FString WrongToken = Exchange(Port, WebSocketRequest(Port, FString(), TEXT("/?token=0123456789abcdeX"),
+	                                                           FString()));
+	TestTrue(TEXT("Upgrade with a wrong token is rejected"), WrongToken.StartsWith(TEXT("HTTP/1.1 401")));
+
+	const FString Accepted = Exchange(Port, WebSocketRequest(Port, FString(), TokenQuery,
+	                                                         FString::Printf(TEXT("Origin: %s\r\n"), AllowedOrigin)));
+	TestTrue(TEXT("Upgrade from an allowed origin with the token is accepted"),
+	         Accepted.StartsWith(TEXT("HTTP/1.1 101")));
+
+	const FString HeaderToken = Exchange(Port, WebSocketRequest(Port, FString(), TEXT("/"), Bearer));
+	TestTrue(TEXT("Upgrade from a native tool with a bearer token is accepted"),
+	         HeaderToken.StartsWith(TEXT("HTTP/1.1 101")));
+
+	const FString Host = FString::Printf(TEXT("Host: 127.0.0.1:%d\r\n"), Port);
+	const FString PostNoToken = Exchange(Port, FString::Printf(
+		                                     TEXT("POST /button/Play HTTP/1.1\r\n%sContent-Length: 0\r\n\r\n"), *Host));
+	TestTrue(TEXT("POST without a token is rejected"), PostNoToken.StartsWith(TEXT("HTTP/1.1 401")));
+
+	const FString PostForeign = Exchange(Port, FString::Printf(
+		                                     TEXT("POST /button/Play HTTP/1.1\r\n%s%sOrigin: http://evil.example\r\n")
+		                                     TEXT("Content-Length: 0\r\n\r\n"), *Host, *Bearer));
+	TestTrue(TEXT("POST from a foreign origin is rejected"), PostForeign.StartsWith(TEXT("HTTP/1.1 403")));
+
+	const FString GetNoToken = Exchange(Port, FString::Printf(TEXT("GET /state HTTP/1.1\r\n%s\r\n"), *Host));
+	TestTrue(TEXT("GET /state without a token is rejected"), GetNoToken.StartsWith(TEXT("HTTP/1.1 401")));
+
+	const FString GetAccepted = Exchange(Port, FString::Printf(TEXT("GET /state HTTP/1.1\r\n%s%s\r\n"), *Host,
+	                                                           *Bearer));
+	TestTrue(TEXT("GET /state with the token is accepted"), GetAccepted.StartsWith(TEXT("HTTP/1.1 200")));
+
+	TArray<EDreamSMTCButtonEvent> Commands;
+	Server->DrainCommands(Commands);
+	TestEqual(TEXT("Rejected requests queue no commands"), Commands.Num(), 0);
+
+	const FString PostAccepted = Exchange(Port, FString::Printf(
+		                                      TEXT("POST /button/Play HTTP/1.1\r\n%s%sContent-Length: 0\r\n\r\n"),
+		                                      *Host, *Bearer));
+	TestTrue(TEXT("POST with the token is accepted"), PostAccepted.StartsWith(TEXT("HTTP/1.1 204")));
+	TestFalse(TEXT("Responses carry no wildcard CORS header"), PostAccepted.Contains(TEXT("Access-Control-Allow-Origin")));
+
+	Server->DrainCommands(Commands);
+	TestTrue(TEXT("Accepted POST queues the button"),
+	         Commands.Num() == 1 && Commands[0] == EDreamSMTCButtonEvent::Play);
+
+	Server->Shutdown();
+	return true;
+}
+
+#endif
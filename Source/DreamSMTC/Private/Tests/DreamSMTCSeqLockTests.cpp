@@ -0,0 +1,124 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCSeqLock.h"
+#include "Async/Async.h"
+#include "Misc/AutomationTest.h"
+
+#include <atomic>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace DreamSMTCSeqLockTests
+{
+	/** Spans several words and ends in a partial one; every word of a consistent copy holds the same count. */
+	struct FProbe
+	{
+		uint64 Words[5] = {};
+		uint32 Tail = 0;
+
+		bool IsConsistent() const
+		{
+			for (const uint64 Word : Words)
+			{
+				if (Word != Words[0])
+				{
+					return false;
+				}
+			}
+			return Tail == static_cast<uint32>(Words[0]);
+		}
+	};
+
+	static constexpr int32 NumWriters = 2;
+	static constexpr int32 NumReaders = 3;
+	static constexpr int32 WritesPerWriter = 100000;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDreamSMTCSeqLockTornReadTest, "DreamSMTC.SeqLock.TornRead",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDreamSMTCSeqLockTornReadTest::RunTest(const FString& Parameters)
+{
+	using namespace DreamSMTCSeqLockTests;
+
+	TDreamSMTCSeqLock<FProbe> Lock;
+	std::atomic<bool> bWriting{true};
+	std::atomic<int64> TornReads{0};
+	std::atomic<int64> SequenceRegressions{0};
+	std::atomic<int64> Reads{0};
+
+	// 读者校验每份拷贝的所有字相同，且序号与计数不回退
+	TArray<TFuture<void>> Readers;
+	for (int32 Reader = 0; Reader < NumReaders; ++Reader)
+	{
+		Readers.Add(Async(EAsyncExecution::Thread, [&Lock, &bWriting, &TornReads, &SequenceRegressions, &Reads]()
+		{
+			uint64 LastSequence = 0;
+			uint64 LastCount = 0;
+			int64 Local = 0;
+			while (bWriting.load(std::memory_order_relaxed))
+			{
+				FProbe Probe;
+				const uint64 Sequence = Lock.Read(Probe);
+				if (!Probe.IsConsistent())
+				{
+					TornReads.fetch_add(1, std::memory_order_relaxed);
+				}
+				if (Sequence < LastSequence || Probe.Words[0] < LastCount)
+				{
+					SequenceRegressions.fetch_add(1, std::memory_order_relaxed);
+				}
+				LastSequence = Sequence;
+				LastCount = Probe.Words[0];
+				++Local;
+			}
+			Reads.fetch_add(Local, std::memory_order_relaxed);
+		}));
+	}
+
+	// 多个写者同时递增，写锁互斥时不会丢失任何一次递增
+	TArray<TFuture<void>> Writers;
+	for (int32 Writer = 0; Writer < NumWriters; ++Writer)
+	{
+		Writers.Add(Async(EAsyncExecution::Thread, [&Lock]()
+		{
+			for (int32 Index = 0; Index < WritesPerWriter; ++Index)
+			{
+				Lock.Modify([](FProbe& Probe)
+				{
+					for (uint64& Word : Probe.Words)
+					{
+						++Word;
+					}
+					++Probe.Tail;
+				});
+			}
+		}));
+	}
+
+	for (TFuture<void>& Writer : Writers)
+	{
+		Writer.Wait();
+	}
+	bWriting.store(false, std::memory_order_relaxed);
+	for (TFuture<void>& Reader : Readers)
+	{
+		Reader.Wait();
+	}
+
+	const FProbe Final = Lock.Read();
+	constexpr uint64 ExpectedWrites = static_cast<uint64>(NumWriters) * WritesPerWriter;
+	TestEqual(TEXT("No read observed a partially written value"), TornReads.load(), static_cast<int64>(0));
+	TestEqual(TEXT("Readers never observed an older value after a newer one"), SequenceRegressions.load(),
+	          static_cast<int64>(0));
+	TestTrue(TEXT("Final value is consistent"), Final.IsConsistent());
+	TestEqual(TEXT("Concurrent writers lost no update"), Final.Words[0], ExpectedWrites);
+	TestEqual(TEXT("Sequence advanced by two per write"), Lock.GetSequence(), ExpectedWrites * 2);
+	TestTrue(TEXT("Readers ran while writers were active"), Reads.load() > 0);
+
+	AddInfo(FString::Printf(TEXT("%lld reads, %lld read retries, %lld write retries"), Reads.load(),
+	                        Lock.GetReadRetries(), Lock.GetWriteRetries()));
+	return true;
+}
+
+#endif
@@ -0,0 +1,250 @@
+﻿// Copyright Dream Moon.
+
+#include "DreamSMTCButtons.h"
+#include "DreamSMTCSessionManager.h"
+#include "DreamSMTCSettings.h"
+#include "DreamSMTCSimulatedBackend.h"
+#include "DreamSMTCSubsystem.h"
+#include "Engine/Engine.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "Misc/AutomationTest.h"
+#include "UObject/StrongObjectPtr.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace DreamSMTCSimulatedBackendTests
+{
+	static FDreamSMTCSimulatedOperationProfile MakeFailingProfile(float FailureRate)
+	{
+		FDreamSMTCSimulatedOperationProfile Profile;
+		Profile.FailureRate = FailureRate;
+		return Profile;
+	}
+
+	/** Runs the subsystem on a fresh simulated backend without touching the saved session, history or ports. */
+	struct FScopedSimulatedSettings
+	{
+		FScopedSimulatedSettings()
+			: Settings(GetMutableDefault<UDreamSMTCSettings>())
+		{
+			Swap(Settings->bUseSimulatedBackend, bUseSimulatedBackend);
+			Swap(Settings->SimulatedBackendSeed, SimulatedBackendSeed);
+			Swap(Settings->SimulatedDefaultProfile, SimulatedDefaultProfile);
+			Swap(Settings->SimulatedOperationProfiles, SimulatedOperationProfiles);
+			Swap(Settings->bPersistSession, bPersistSession);
+			Swap(Settings->bRestoreSessionOnStartup, bRestoreSessionOnStartup);
+			Swap(Settings->bRecordListeningHistory, bRecordListeningHistory);
+			Swap(Settings->bEnableRemoteControl, bEnableRemoteControl);
+			Swap(Settings->bInjectMediaKeys, bInjectMediaKeys);
+			Swap(Settings->bLogStateChanges, bLogStateChanges);
+			Swap(Settings->bIdleWhenUnfocused, bIdleWhenUnfocused);
+			Swap(Settings->MaxBackendCallsPerSecond, MaxBackendCallsPerSecond);
+		}
+
+		~FScopedSimulatedSettings()
+		{
+			Swap(Settings->bUseSimulatedBackend, bUseSimulatedBackend);
+			Swap(Settings->SimulatedBackendSeed, SimulatedBackendSeed);
+			Swap(Settings->SimulatedDefaultProfile, SimulatedDefaultProfile);
+			Swap(Settings->SimulatedOperationProfiles, SimulatedOperationProfiles);
+			Swap(Settings->bPersistSession, bPersistSession);
+			Swap(Settings->bRestoreSessionOnStartup, bRestoreSessionOnStartup);
+			Swap(Settings->bRecordListeningHistory, bRecordListeningHistory);
+			Swap(Settings->bEnableRemoteControl, bEnableRemoteControl);
+			Swap(Settings->bInjectMediaKeys, bInjectMediaKeys);
+			Swap(Settings->bLogStateChanges, bLogStateChanges);
+			Swap(Settings->bIdleWhenUnfocused, bIdleWhenUnfocused);
+			Swap(Settings->MaxBackendCallsPerSecond, MaxBackendCallsPerSecond);
+		}
+
+		UDreamSMTCSettings* Settings;
+
+		// 测试期间的值，析构时与原设置交换回去
+		bool bUseSimulatedBackend = true;
+		int32 SimulatedBackendSeed = 1;
+		FDreamSMTCSimulatedOperationProfile SimulatedDefaultProfile;
+		TMap<EDreamSMTCBackendOperation, FDreamSMTCSimulatedOperationProfile> SimulatedOperationProfiles;
+		bool bPersistSession = false;
+		bool bRestoreSessionOnStartup = false;
+		bool bRecordListeningHistory = false;
+		bool bEnableRemoteControl = false;
+		bool bInjectMediaKeys = false;
+		bool bLogStateChanges = false;
+		bool bIdleWhenUnfocused = false;
+		float MaxBackendCallsPerSecond = 1000.0f;
+	};
+
+	/** Game instance with its own world; shutting it down deinitializes the subsystem and releases the backend. */
+	struct FScopedGameInstance
+	{
+		FScopedGameInstance()
+			: GameInstance(NewObject<UGameInstance>(GEngine))
+		{
+			GameInstance->InitializeStandalone();
+		}
+
+		~FScopedGameInstance()
+		{
+			UWorld* World = GameInstance->GetWorld();
+			GameInstance->Shutdown();
+			if (World)
+			{
+				GEngine->DestroyWorldContext(World);
+				World->DestroyWorld(false);
+			}
+		}
+
+		UDreamSMTCSubsystem* GetSubsystem() const { return GameInstance->GetSubsystem<UDreamSMTCSubsystem>(); }
+
+		TStrongObjectPtr<UGameInstance> GameInstance;
+	};
+
+	static FDreamSMTCSimulatedBackend* FindSimulatedBackend()
+	{
+		const TSharedPtr<IDreamSMTCBackend, ESPMode::ThreadSafe> Backend = UDreamSMTCSubsystem::GetBackend();
+		return Backend.IsValid() && Backend->IsSimulated()
+			       ? &static_cast<FDreamSMTCSimulatedBackend&>(Backend->GetImplementation())
+			       : nullptr;
+	}
+
+	/** Sets a new title NumTracks times and records whether each one reached the display. */
+	static TArray<bool> PublishTracks(UDreamSMTCSubsystem& Subsystem, const FDreamSMTCSimulatedBackend& Backend,
+	                                  int32 NumTracks)
+	{
+		TArray<bool> Displayed;
+		for (int32 Track = 0; Track < NumTracks; ++Track)
+		{
+			FDreamSMTCMusicDisplayProperties Music;
+			Music.Title = FString::Printf(TEXT("Track %d"), Track);
+			Subsystem.SetMusicProperties(Music);
+			Subsystem.Update();
+			Subsystem.FlushPendingUpdates();
+			Displayed.Add(Backend.GetDisplayedState().Music.Title == Music.Title);
+		}
+		return Displayed;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDreamSMTCSimulatedBackendDeterminismTest, "DreamSMTC.SimulatedBackend.Determinism",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDreamSMTCSimulatedBackendDeterminismTest::RunTest(const FString& Parameters)
+{
+	using namespace DreamSMTCSimulatedBackendTests;
+
+	constexpr int32 NumCalls = 64;
+	const TMap<EDreamSMTCBackendOperation, FDreamSMTCSimulatedOperationProfile> NoProfiles;
+	const TSharedRef<FDreamSMTCSimulatedBackend, ESPMode::ThreadSafe> Alone =
+		MakeShared<FDreamSMTCSimulatedBackend, ESPMode::ThreadSafe>(42, MakeFailingProfile(0.5f), NoProfiles);
+	const TSharedRef<FDreamSMTCSimulatedBackend, ESPMode::ThreadSafe> Interleaved =
+		MakeShared<FDreamSMTCSimulatedBackend, ESPMode::ThreadSafe>(42, MakeFailingProfile(0.5f), NoProfiles);
+
+	// 另一个操作穿插的调用次数不影响 Update 自己的结果序列
+	TArray<bool> AloneResults;
+	TArray<bool> InterleavedResults;
+	FString Error;
+	for (int32 Call = 0; Call < NumCalls; ++Call)
+	{
+		AloneResults.Add(Alone->Update(Error));
+
+		for (int32 Extra = 0; Extra < Call % 3; ++Extra)
+		{
+			Interleaved->WriteTimeline(FDreamSMTCTimelineProperties(), Error);
+		}
+		InterleavedResults.Add(Interleaved->Update(Error));
+	}
+
+	TestTrue(TEXT("Interleaved operations do not shift the draws of another operation"),
+	         InterleavedResults == AloneResults);
+	TestTrue(TEXT("The failure rate produced both outcomes"),
+	         AloneResults.Contains(true) && AloneResults.Contains(false));
+	TestEqual(TEXT("Every call was counted"), Alone->GetStats(EDreamSMTCBackendOperation::Update).Calls,
+	          static_cast<int64>(NumCalls));
+
+	// 重新播种后可以完整重放
+	Alone->Reseed(42);
+	TArray<bool> Replayed;
+	for (int32 Call = 0; Call < NumCalls; ++Call)
+	{
+		Replayed.Add(Alone->Update(Error));
+	}
+	TestTrue(TEXT("Reseeding replays the same results"), Replayed == AloneResults);
+
+	const TSharedRef<FDreamSMTCSimulatedBackend, ESPMode::ThreadSafe> OtherSeed =
+		MakeShared<FDreamSMTCSimulatedBackend, ESPMode::ThreadSafe>(43, MakeFailingProfile(0.5f), NoProfiles);
+	TArray<bool> OtherResults;
+	for (int32 Call = 0; Call < NumCalls; ++Call)
+	{
+		OtherResults.Add(OtherSeed->Update(Error));
+	}
+	TestTrue(TEXT("A different seed gives different results"), OtherResults != AloneResults);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDreamSMTCSimulatedBackendSubsystemTest, "DreamSMTC.SimulatedBackend.Subsystem",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDreamSMTCSimulatedBackendSubsystemTest::RunTest(const FString& Parameters)
+{
+	using namespace DreamSMTCSimulatedBackendTests;
+
+	// 后端由所有会话共享，已有会话时无法换成模拟后端
+	if (FDreamSMTCSessionManager::Get().Num() > 0 || UDreamSMTCSubsystem::GetBackend().IsValid())
+	{
+		AddWarning(TEXT("Skipped: a DreamSMTC session is already running"));
+		return true;
+	}
+
+	const FScopedSimulatedSettings Settings;
+	{
+		const FScopedGameInstance Game;
+		UDreamSMTCSubsystem* Subsystem = Game.GetSubsystem();
+		if (!TestNotNull(TEXT("The game instance creates the subsystem"), Subsystem))
+		{
+			return false;
+		}
+		FDreamSMTCSimulatedBackend* Backend = FindSimulatedBackend();
+		if (!TestNotNull(TEXT("The subsystem uses the simulated backend"), Backend))
+		{
+			return false;
+		}
+		TestTrue(TEXT("The only session owns the OS controls"), Subsystem->IsSessionOwner());
+
+		// 显示属性在 Update 之后才出现，状态与按钮立即生效
+		FDreamSMTCMusicDisplayProperties Music;
+		Music.Artist = TEXT("Artist");
+		Music.Title = TEXT("Title");
+		Subsystem->SetType(EDreamSMTCMediaPlaybackType::Music);
+		Subsystem->SetMusicProperties(Music);
+		Subsystem->SetPlaybackStatus(EDreamSMTCMediaPlaybackStatus::Playing);
+		Subsystem->SetPlayEnabled(true);
+		TestTrue(TEXT("Display waits for Update"), Backend->GetDisplayedState().Music.Title != Music.Title);
+
+		Subsystem->Update();
+		Subsystem->FlushPendingUpdates();
+		const FDreamSMTCSessionState Displayed = Backend->GetDisplayedState();
+		TestEqual(TEXT("Update shows the title"), Displayed.Music.Title, Music.Title);
+		TestEqual(TEXT("Update shows the artist"), Displayed.Music.Artist, Music.Artist);
+		TestTrue(TEXT("Status is written"), Displayed.PlaybackStatus == EDreamSMTCMediaPlaybackStatus::Playing);
+		TestTrue(TEXT("Play is enabled"),
+		         (Displayed.EnabledButtons & DreamSMTCButtonBit(EDreamSMTCButtonEvent::Play)) != 0);
+
+		// 同一种子下，失败的 Update 落在同样的曲目上
+		AddExpectedError(TEXT("Simulated Update failure"), EAutomationExpectedErrorFlags::Contains, 0);
+		constexpr int32 NumTracks = 32;
+		Backend->SetProfile(EDreamSMTCBackendOperation::Update, MakeFailingProfile(0.5f));
+		Backend->Reseed(7);
+		const TArray<bool> FirstRun = PublishTracks(*Subsystem, *Backend, NumTracks);
+		Backend->Reseed(7);
+		const TArray<bool> SecondRun = PublishTracks(*Subsystem, *Backend, NumTracks);
+		TestTrue(TEXT("The same seed fails the same updates"), SecondRun == FirstRun);
+		TestTrue(TEXT("Some updates failed and some reached the display"),
+		         FirstRun.Contains(true) && FirstRun.Contains(false));
+	}
+
+	TestFalse(TEXT("The last session releases the backend"), UDreamSMTCSubsystem::GetBackend().IsValid());
+	return true;
+}
+
+#endif
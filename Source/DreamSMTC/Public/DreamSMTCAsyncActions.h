@@ -0,0 +1,147 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "DreamSMTCTypes.h"
+#include "DreamSMTCPlaylistReader.h"
+
+#include <atomic>
+
+#include "DreamSMTCAsyncActions.generated.h"
+
+class UDreamSMTCSubsystem;
+class UTexture2D;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FDreamSMTCAsyncActionPin, const FDreamSMTCAsyncTiming&, Timing,
+                                             const FString&, Error);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FDreamSMTCPlaylistPin, const TArray<FDreamSMTCPlaylistEntry>&, Entries,
+                                               int32, FirstIndex, const FString&, Error);
+
+/**
+ * Base of the DreamSMTC async Blueprint nodes
+ * The work runs off the game thread, the output pins fire on the game thread once the OS answered.
+ */
+UCLASS(Abstract)
+class DREAMSMTC_API UDreamSMTCAsyncActionBase : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(BlueprintAssignable)
+	FDreamSMTCAsyncActionPin OnCompleted;
+
+	UPROPERTY(BlueprintAssignable)
+	FDreamSMTCAsyncActionPin OnFailed;
+
+protected:
+	UDreamSMTCSubsystem* GetSubsystem() const;
+
+	void Finish(bool bSuccess, const FDreamSMTCAsyncTiming& Timing, const FString& Error);
+
+protected:
+	TWeakObjectPtr<UObject> WorldContext;
+};
+
+UCLASS()
+class DREAMSMTC_API UDreamSMTCSetThumbnailAsyncAction : public UDreamSMTCAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Async",
+		meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject", DisplayName = "Set Thumbnail Async"))
+	static UDreamSMTCSetThumbnailAsyncAction* SetThumbnailAsync(UObject* WorldContextObject, UTexture2D* Thumbnail);
+
+	virtual void Activate() override;
+
+private:
+	UPROPERTY()
+	TObjectPtr<UTexture2D> Thumbnail = nullptr;
+};
+
+UCLASS()
+class DREAMSMTC_API UDreamSMTCCommitAsyncAction : public UDreamSMTCAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Async",
+		meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject", DisplayName = "Commit Media Session Async"))
+	static UDreamSMTCCommitAsyncAction* CommitMediaSessionAsync(UObject* WorldContextObject);
+
+	virtual void Activate() override;
+};
+
+/**
+ * Streams a playlist file (M3U/M3U8, PLS, XSPF) on a worker thread
+ * OnEntries fires with the first entry as soon as it is parsed, then with batches of BatchSize.
+ * At most a few batches are in flight at once, so memory stays bounded for any playlist size.
+ */
+UCLASS()
+class DREAMSMTC_API UDreamSMTCStreamPlaylistAsyncAction : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Async",
+		meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject", DisplayName = "Stream Playlist Async"))
+	static UDreamSMTCStreamPlaylistAsyncAction* StreamPlaylistAsync(UObject* WorldContextObject, const FString& FilePath,
+	                                                                int32 BatchSize = 256);
+
+	virtual void Activate() override;
+	virtual void BeginDestroy() override;
+
+	/** Stops parsing; no further pins fire. */
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Async")
+	void Cancel();
+
+	UPROPERTY(BlueprintAssignable)
+	FDreamSMTCPlaylistPin OnEntries;
+
+	/** Entries is empty, FirstIndex is the total number of entries. */
+	UPROPERTY(BlueprintAssignable)
+	FDreamSMTCPlaylistPin OnCompleted;
+
+	UPROPERTY(BlueprintAssignable)
+	FDreamSMTCPlaylistPin OnFailed;
+
+private:
+	using FPin = FDreamSMTCPlaylistPin UDreamSMTCStreamPlaylistAsyncAction::*;
+
+	// 游戏线程最多同时排队的批次
+	static constexpr int32 MaxBatchesInFlight = 4;
+
+	struct FStreamState
+	{
+		std::atomic<bool> bCancelled{false};
+		std::atomic<int32> BatchesInFlight{0};
+		// 游戏线程处理不过来时读取任务置位后退出，之后送达的批次负责恢复读取
+		std::atomic<bool> bPaused{false};
+
+		// Activate 之前设置，之后不再修改
+		TWeakObjectPtr<UDreamSMTCStreamPlaylistAsyncAction> Action;
+		int32 BatchSize = 256;
+
+		// 同一时刻只有一个读取任务访问
+		FDreamSMTCPlaylistReader Reader;
+		TArray<FDreamSMTCPlaylistEntry> Batch;
+		int32 FirstIndex = 0;
+		// 第一条单独发送，之后按批发送
+		int32 Limit = 1;
+	};
+
+	using FStreamStateRef = TSharedRef<FStreamState, ESPMode::ThreadSafe>;
+
+	/** Reads on a worker thread until the game thread falls behind; the delivery that catches up resumes it. */
+	static void ReadBatches(const FStreamStateRef& State);
+
+	/** Fires Pin on the game thread unless the action was destroyed or cancelled. */
+	static void Deliver(const FStreamStateRef& State, FPin Pin, TArray<FDreamSMTCPlaylistEntry>&& Entries,
+	                    int32 FirstIndex, FString&& Error, bool bFinal);
+
+	FString FilePath;
+	int32 BatchSize = 256;
+	TSharedPtr<FStreamState, ESPMode::ThreadSafe> State;
+};
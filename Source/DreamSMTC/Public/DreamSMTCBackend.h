@@ -0,0 +1,62 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DreamSMTCTypes.h"
+#include "DreamSMTCSessionState.h"
+
+/** Encoded image already copied into a backend stream. Only the backend that prepared it can set it. */
+struct FDreamSMTCPreparedThumbnail
+{
+	virtual ~FDreamSMTCPreparedThumbnail() = default;
+};
+
+/** Change request handlers. Called on a backend thread; a registration may be called from several threads at once. */
+struct FDreamSMTCBackendHandlers
+{
+	TFunction<void(EDreamSMTCButtonEvent)> ButtonPressed;
+	TFunction<void(FTimespan)> PlaybackPositionChangeRequested;
+	TFunction<void(double)> PlaybackRateChangeRequested;
+	TFunction<void(bool)> ShuffleEnabledChangeRequested;
+	TFunction<void(EDreamSMTCAutoRepeatMode)> AutoRepeatModeChangeRequested;
+};
+
+/**
+ * Media transport controls backend
+ * One per process, shared by all subsystem instances (see UDreamSMTCSubsystem::GetBackend).
+ * Writes are blocking and may be called from any thread; display writes become visible on Update().
+ */
+class DREAMSMTC_API IDreamSMTCBackend
+{
+public:
+	virtual ~IDreamSMTCBackend() = default;
+
+	virtual const TCHAR* GetName() const = 0;
+	virtual bool IsSimulated() const { return false; }
+	/** The backend doing the work, when this one only wraps it (see FDreamSMTCTimedBackend). */
+	virtual IDreamSMTCBackend& GetImplementation() { return *this; }
+
+	/** Writes the given fields of State. ButtonMask limits which button states are written. */
+	virtual bool WriteSession(const FDreamSMTCSessionState& State, EDreamSMTCSessionField Fields, uint32 ButtonMask,
+	                          FString& OutError) = 0;
+	virtual bool WriteTimeline(const FDreamSMTCTimelineProperties& Timeline, FString& OutError) = 0;
+	virtual bool Update(FString& OutError) = 0;
+	virtual bool ClearAll(FString& OutError) = 0;
+
+	/** Sets the thumbnail from an image file. FullPath is absolute. */
+	virtual bool SetThumbnailFromFile(const FString& FullPath, FString& OutError) = 0;
+	virtual TSharedPtr<FDreamSMTCPreparedThumbnail, ESPMode::ThreadSafe> PrepareThumbnail(
+		const TArray64<uint8>& Encoded, FString& OutError) = 0;
+	/** Sets a prepared image without blocking. The caller commits it with Update(). */
+	virtual bool SetPreparedThumbnail(const FDreamSMTCPreparedThumbnail& Prepared, FString& OutError) = 0;
+
+	virtual EDreamSMTCMediaSoundLevel GetSoundLevel() const = 0;
+
+	/** Returns an id for RemoveHandlers. Handlers already running when removed are not waited for. */
+	virtual uint64 AddHandlers(FDreamSMTCBackendHandlers&& Handlers) = 0;
+	virtual void RemoveHandlers(uint64 HandlersId) = 0;
+
+	/** Clears and disables the controls. Blocking, the backend is not used afterwards. */
+	virtual bool Release(FString& OutError) = 0;
+};
@@ -0,0 +1,65 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DreamSMTCButtons.h"
+
+#include <atomic>
+
+/** Thread a native button listener is invoked on. */
+enum class EDreamSMTCListenerThread : uint8
+{
+	// Invoked from the game thread task that also broadcasts ButtonPressed
+	GameThread,
+	// Invoked directly on the OS callback thread, no game thread hop
+	CallbackThread,
+};
+
+DECLARE_DELEGATE_OneParam(FDreamSMTCNativeButtonDelegate, EDreamSMTCButtonEvent);
+
+/**
+ * Native (non-dynamic) button listener registry
+ * Dispatch only holds the lock long enough to copy a pointer to an immutable snapshot of the list,
+ * so listeners never run under the lock and may add or remove listeners from inside a callback.
+ * A listener removed while a dispatch is in flight can still receive that one event.
+ */
+class DREAMSMTC_API FDreamSMTCButtonListenerRegistry
+{
+public:
+	FDelegateHandle Add(FDreamSMTCNativeButtonDelegate&& Delegate, uint32 ButtonMask, EDreamSMTCListenerThread Thread);
+
+	bool Remove(FDelegateHandle Handle);
+
+	void RemoveAll(const void* UserObject);
+
+	void Reset();
+
+	/** Invokes the listeners registered for Thread that are interested in Button. Call it from that thread. */
+	void Dispatch(EDreamSMTCButtonEvent Button, EDreamSMTCListenerThread Thread) const;
+
+	/** Cheap pre-check so callers can skip dispatch (and the game thread hop) entirely. */
+	bool HasListeners(EDreamSMTCButtonEvent Button, EDreamSMTCListenerThread Thread) const;
+
+private:
+	struct FListener
+	{
+		FDelegateHandle Handle;
+		FDreamSMTCNativeButtonDelegate Delegate;
+		uint32 ButtonMask = 0;
+		EDreamSMTCListenerThread Thread = EDreamSMTCListenerThread::GameThread;
+	};
+
+	using FListenerList = TArray<FListener>;
+	using FListenerListPtr = TSharedPtr<const FListenerList, ESPMode::ThreadSafe>;
+
+	FListenerListPtr GetSnapshot() const;
+	void Publish(FListenerList&& NewList);
+
+private:
+	mutable FCriticalSection Mutex;
+	FListenerListPtr Listeners;
+
+	std::atomic<uint32> GameThreadMask{0};
+	std::atomic<uint32> CallbackThreadMask{0};
+};
@@ -0,0 +1,65 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DreamSMTCTypes.h"
+
+/**
+ * Button descriptor table
+ * Single source for everything generated per button: the enum bit, display name and the
+ * SystemMediaTransportControls::Is<Name>Enabled property written by the backend.
+ * Entries must stay in EDreamSMTCButtonEvent order.
+ */
+#define DREAMSMTC_BUTTONS(X) \
+	X(Play) \
+	X(Pause) \
+	X(Stop) \
+	X(Record) \
+	X(FastForward) \
+	X(Rewind) \
+	X(Next) \
+	X(Previous) \
+	X(ChannelUp) \
+	X(ChannelDown)
+
+constexpr uint32 DreamSMTCButtonBit(EDreamSMTCButtonEvent Button)
+{
+	return 1u << static_cast<uint8>(Button);
+}
+
+constexpr uint32 DreamSMTCAllButtons = 0xFFFFFFFFu;
+
+#define DREAMSMTC_BUTTON_COUNT(Name) + 1
+constexpr int32 DreamSMTCButtonCount = 0 DREAMSMTC_BUTTONS(DREAMSMTC_BUTTON_COUNT);
+#undef DREAMSMTC_BUTTON_COUNT
+
+#define DREAMSMTC_BUTTON_MASK(Name) | DreamSMTCButtonBit(EDreamSMTCButtonEvent::Name)
+/** Every bit that maps to a button. */
+constexpr uint32 DreamSMTCValidButtons = 0u DREAMSMTC_BUTTONS(DREAMSMTC_BUTTON_MASK);
+#undef DREAMSMTC_BUTTON_MASK
+
+#define DREAMSMTC_BUTTON_NAME(Name) TEXT(#Name),
+inline constexpr const TCHAR* DreamSMTCButtonNames[] = {DREAMSMTC_BUTTONS(DREAMSMTC_BUTTON_NAME)};
+#undef DREAMSMTC_BUTTON_NAME
+
+namespace DreamSMTCButtons
+{
+#define DREAMSMTC_BUTTON_VALUE(Name) EDreamSMTCButtonEvent::Name,
+	inline constexpr EDreamSMTCButtonEvent Values[] = {DREAMSMTC_BUTTONS(DREAMSMTC_BUTTON_VALUE)};
+#undef DREAMSMTC_BUTTON_VALUE
+
+	constexpr bool IsInEnumOrder()
+	{
+		for (int32 Index = 0; Index < DreamSMTCButtonCount; ++Index)
+		{
+			if (static_cast<int32>(Values[Index]) != Index)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+static_assert(DreamSMTCButtons::IsInEnumOrder(), "DREAMSMTC_BUTTONS is out of sync with EDreamSMTCButtonEvent");
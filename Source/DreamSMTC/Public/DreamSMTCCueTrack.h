@@ -0,0 +1,50 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DreamSMTCTypes.h"
+
+/**
+ * Position indexed cue track (chapters, synced lyrics)
+ * Cue start times are kept in their own sorted array so lookups only touch contiguous int64 ticks.
+ * The cursor steps forward in O(1) during normal playback and falls back to a binary search on seek.
+ */
+class DREAMSMTC_API FDreamSMTCCueTrack
+{
+public:
+	/** Parses LRC lyrics. Supports multiple time tags per line and the [offset:] tag. */
+	bool LoadLrc(const FString& Text);
+
+	/** Parses one chapter per line: "[hh:]mm:ss[.fff] Title[ - Subtitle]". A tab after the time takes precedence. */
+	bool LoadChapters(const FString& Text);
+
+	void SetCues(TArray<FDreamSMTCCue> InCues);
+
+	void Reset();
+
+	/** Moves the cursor to the cue active at Position. Returns true when the active cue changed. */
+	bool Seek(FTimespan Position);
+
+	int32 GetActiveIndex() const { return Cursor; }
+
+	const FDreamSMTCCue* GetActiveCue() const { return Cues.IsValidIndex(Cursor) ? &Cues[Cursor] : nullptr; }
+
+	const TArray<FDreamSMTCCue>& GetCues() const { return Cues; }
+
+	int32 Num() const { return Cues.Num(); }
+
+	bool IsEmpty() const { return Cues.Num() == 0; }
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	void Build(TArray<FDreamSMTCCue>&& InCues);
+
+	static bool ParseTimestamp(FStringView Text, FTimespan& OutTime);
+
+private:
+	TArray<int64> CueTicks;
+	TArray<FDreamSMTCCue> Cues;
+	int32 Cursor = INDEX_NONE;
+};
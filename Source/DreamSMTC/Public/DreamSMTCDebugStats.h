@@ -0,0 +1,119 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/OutputDevice.h"
+#include "DreamSMTCSeqLock.h"
+#include "DreamSMTCSessionState.h"
+#include "DreamSMTCUpdateScheduler.h"
+
+#include <atomic>
+
+/** Log2 histogram of durations, recorded lock-free from any thread. */
+class DREAMSMTC_API FDreamSMTCLatencyHistogram
+{
+public:
+	FDreamSMTCLatencyHistogram();
+
+	void Record(double Seconds);
+
+	/** Upper bound in seconds of the bucket holding the given fraction (0..1) of the samples, 0 without samples. */
+	double GetPercentile(double Fraction) const;
+
+	int64 Num() const;
+
+	void Reset();
+
+private:
+	// 第 N 个桶记录 [2^(N-1), 2^N) 微秒，最后一个桶收纳更长的耗时
+	static constexpr int32 NumBuckets = 32;
+	std::atomic<int64> Buckets[NumBuckets];
+};
+
+struct FDreamSMTCErrorRecord
+{
+	double Time = 0.0;
+	ELogVerbosity::Type Verbosity = ELogVerbosity::Error;
+	TCHAR Message[192] = {};
+};
+
+/**
+ * Process-wide debug counters
+ * Written from any thread without locks or allocations and read by the debug panel (DreamSMTC.Debug).
+ * Also captures LogDreamSMTC warnings and errors into a small ring; other log categories are rejected
+ * with one comparison.
+ */
+class DREAMSMTC_API FDreamSMTCDebugStats : public FOutputDevice
+{
+public:
+	static FDreamSMTCDebugStats& Get();
+
+	/** Starts capturing LogDreamSMTC warnings and errors. Called when the module starts. */
+	void Start();
+	void Stop();
+
+	/** Called by FDreamSMTCTimedBackend for every backend call. */
+	void RecordBackendCall(bool bSuccess)
+	{
+		BackendCalls.fetch_add(1, std::memory_order_relaxed);
+		if (!bSuccess)
+		{
+			BackendFailures.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	void RecordPlaceholderLookup(bool bHit)
+	{
+		(bHit ? PlaceholderHits : PlaceholderMisses).fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/** From the OS callback to the game thread dispatch of a button press. */
+	void RecordButtonLatency(double Seconds) { ButtonLatency.Record(Seconds); }
+
+	int64 GetBackendCalls() const { return BackendCalls.load(std::memory_order_relaxed); }
+	int64 GetBackendFailures() const { return BackendFailures.load(std::memory_order_relaxed); }
+	int64 GetPlaceholderHits() const { return PlaceholderHits.load(std::memory_order_relaxed); }
+	int64 GetPlaceholderMisses() const { return PlaceholderMisses.load(std::memory_order_relaxed); }
+	const FDreamSMTCLatencyHistogram& GetButtonLatency() const { return ButtonLatency; }
+
+	/** Copies up to MaxErrors of the most recent captured messages, newest first. */
+	void GetRecentErrors(TArray<FDreamSMTCErrorRecord>& OutErrors, int32 MaxErrors = MaxRecentErrors) const;
+
+	void Reset();
+
+	//~ FOutputDevice
+	virtual void Serialize(const TCHAR* V, ELogVerbosity::Type Verbosity, const FName& Category) override;
+	virtual bool CanBeUsedOnAnyThread() const override { return true; }
+	virtual bool CanBeUsedOnMultipleThreads() const override { return true; }
+
+public:
+	static constexpr int32 MaxRecentErrors = 16;
+
+private:
+	std::atomic<int64> BackendCalls{0};
+	std::atomic<int64> BackendFailures{0};
+	std::atomic<int64> PlaceholderHits{0};
+	std::atomic<int64> PlaceholderMisses{0};
+	FDreamSMTCLatencyHistogram ButtonLatency;
+
+	// 写入者各自占用一个槽位，读取时不加锁
+	TDreamSMTCSeqLock<FDreamSMTCErrorRecord> Errors[MaxRecentErrors];
+	std::atomic<uint64> NextError{0};
+	bool bStarted = false;
+};
+
+/** Game thread state of one subsystem, copied for the debug panel. */
+struct FDreamSMTCDebugSnapshot
+{
+	FDreamSMTCSessionState Session;
+	EDreamSMTCPendingWrite PendingWrites = EDreamSMTCPendingWrite::None;
+	bool bTimelineDeferred = false;
+	bool bSessionDirty = false;
+	bool bOwner = false;
+	bool bIdle = false;
+	int32 StagedSwitches = 0;
+	FDreamSMTCUpdateSchedulerStats Scheduler;
+	int64 SeekRequests = 0;
+	int64 CoalescedSeekRequests = 0;
+};
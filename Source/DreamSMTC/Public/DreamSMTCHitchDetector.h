@@ -0,0 +1,122 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DreamSMTCBackend.h"
+#include "DreamSMTCSeqLock.h"
+#include "DreamSMTCUpdateScheduler.h"
+
+#include <atomic>
+
+/** One timed backend call. Arguments are kept raw and only formatted when a report is written. */
+struct FDreamSMTCOperationRecord
+{
+	double StartTime = 0.0;
+	double Seconds = 0.0;
+	// WriteSession: fields and button mask; WriteTimeline: position and end in ticks; thumbnails: byte count;
+	// RemoveHandlers: registration id
+	int64 ArgA = 0;
+	int64 ArgB = 0;
+	uint32 ThreadId = 0;
+	EDreamSMTCBackendOperation Operation = EDreamSMTCBackendOperation::Update;
+	bool bSuccess = false;
+};
+
+/** Queue depths of the session that owns the OS controls, published once per tick. */
+struct FDreamSMTCQueueDepths
+{
+	double Time = 0.0;
+	EDreamSMTCPendingWrite PendingWrites = EDreamSMTCPendingWrite::None;
+	bool bTimelineDeferred = false;
+	bool bSeekPending = false;
+	int32 QueuedChangeSets = 0;
+	int32 StagedSwitches = 0;
+};
+
+/**
+ * Backend hitch capture
+ * Every backend operation is timed into a ring of the last MaxRecords operations. When one takes longer than
+ * DreamSMTC.HitchThresholdMs, the operation, its arguments, thread, queue depths and the ring are copied and a
+ * report is written to Saved/DreamSMTCHitches on the thread pool. Reports are rate limited and only the newest
+ * MaxReports are kept. Recording is lock-free from any thread.
+ */
+class DREAMSMTC_API FDreamSMTCHitchDetector
+{
+public:
+	static FDreamSMTCHitchDetector& Get();
+
+	/** Records a finished operation and captures a report if it breached the threshold. */
+	void Record(const FDreamSMTCOperationRecord& Record, const TCHAR* BackendName);
+
+	void PublishQueueDepths(const FDreamSMTCQueueDepths& Depths) { QueueDepths.Write(Depths); }
+
+	/** 0 when hitch capture is disabled. */
+	static double GetThresholdSeconds();
+
+	/** Copies up to MaxRecords of the most recent operations, oldest first. */
+	void GetRecentOperations(TArray<FDreamSMTCOperationRecord>& OutRecords) const;
+
+	static FString GetReportDirectory();
+
+	/** Operations over the threshold, including those that did not get a report. */
+	int64 GetHitchCount() const { return Hitches.load(std::memory_order_relaxed); }
+
+	/** Blocks until the reports being written have finished. Called before the module unloads. */
+	void WaitForReports();
+
+public:
+	static constexpr int32 MaxRecords = 64;
+	static constexpr int32 MaxReports = 16;
+	// 连续卡顿时只写一份报告
+	static constexpr double MinReportInterval = 10.0;
+
+private:
+	void Capture(const FDreamSMTCOperationRecord& Hitch, const TCHAR* BackendName);
+
+private:
+	TDreamSMTCSeqLock<FDreamSMTCOperationRecord> Records[MaxRecords];
+	std::atomic<uint64> NextRecord{0};
+
+	TDreamSMTCSeqLock<FDreamSMTCQueueDepths> QueueDepths;
+
+	std::atomic<double> LastReportTime{-MinReportInterval};
+	std::atomic<int64> Hitches{0};
+
+	FCriticalSection ReportLock;
+	TArray<TFuture<void>> ReportTasks;
+};
+
+/**
+ * Times every call of another backend for FDreamSMTCHitchDetector
+ * Installed by UDreamSMTCSubsystem::GetBackend around the platform or simulated backend.
+ */
+class DREAMSMTC_API FDreamSMTCTimedBackend : public IDreamSMTCBackend
+{
+public:
+	explicit FDreamSMTCTimedBackend(const TSharedRef<IDreamSMTCBackend, ESPMode::ThreadSafe>& InInner);
+
+	virtual const TCHAR* GetName() const override { return Inner->GetName(); }
+	virtual bool IsSimulated() const override { return Inner->IsSimulated(); }
+	virtual IDreamSMTCBackend& GetImplementation() override { return Inner->GetImplementation(); }
+
+	virtual bool WriteSession(const FDreamSMTCSessionState& State, EDreamSMTCSessionField Fields, uint32 ButtonMask,
+	                          FString& OutError) override;
+	virtual bool WriteTimeline(const FDreamSMTCTimelineProperties& Timeline, FString& OutError) override;
+	virtual bool Update(FString& OutError) override;
+	virtual bool ClearAll(FString& OutError) override;
+
+	virtual bool SetThumbnailFromFile(const FString& FullPath, FString& OutError) override;
+	virtual TSharedPtr<FDreamSMTCPreparedThumbnail, ESPMode::ThreadSafe> PrepareThumbnail(
+		const TArray64<uint8>& Encoded, FString& OutError) override;
+	virtual bool SetPreparedThumbnail(const FDreamSMTCPreparedThumbnail& Prepared, FString& OutError) override;
+
+	virtual EDreamSMTCMediaSoundLevel GetSoundLevel() const override;
+
+	virtual uint64 AddHandlers(FDreamSMTCBackendHandlers&& Handlers) override;
+	virtual void RemoveHandlers(uint64 HandlersId) override;
+	virtual bool Release(FString& OutError) override;
+
+private:
+	TSharedRef<IDreamSMTCBackend, ESPMode::ThreadSafe> Inner;
+};
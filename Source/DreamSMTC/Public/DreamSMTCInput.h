@@ -0,0 +1,49 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "InputCoreTypes.h"
+#include "DreamSMTCButtons.h"
+
+#include <atomic>
+
+class UGameInstance;
+class UInputMappingContext;
+
+/**
+ * Media keys for Enhanced Input
+ * Each EDreamSMTCButtonEvent has a key (DreamSMTC_Play, DreamSMTC_Next, ...) that input mapping contexts bind like
+ * any other key, so rebinding, triggers and context priorities apply. Presses are counted per button without
+ * locks or allocations from any thread and injected into the first local player on the game thread, one press of
+ * each button per Dispatch so repeated presses trigger their actions repeatedly.
+ */
+class DREAMSMTC_API FDreamSMTCInput
+{
+public:
+	/** Adds the media keys to EKeys. Called when the module starts. */
+	static void RegisterKeys();
+	static void UnregisterKeys();
+
+	static const FKey& GetKey(EDreamSMTCButtonEvent Button);
+
+	/** Queues a press. Up to MaxQueuedPresses of each button are kept, further presses are dropped. Any thread. */
+	void Enqueue(EDreamSMTCButtonEvent Button);
+
+	bool HasPending() const;
+
+	/**
+	 * Injects one queued press of each button as a press and release of its key. Called from the subsystem tick,
+	 * which runs before the player controllers process input, so the actions trigger in the same frame; further
+	 * presses follow on the next ticks. MappingContext is added to the player first if it is not applied yet.
+	 * Presses stay queued while there is no player controller, e.g. during loading.
+	 */
+	void Dispatch(const UGameInstance* GameInstance, const UInputMappingContext* MappingContext, int32 Priority);
+
+public:
+	static constexpr uint32 MaxQueuedPresses = 8;
+
+private:
+	// 按钮之间不保序，同一按钮的多次按下逐帧注入
+	std::atomic<uint32> PendingPresses[DreamSMTCButtonCount] = {};
+};
@@ -0,0 +1,132 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "DreamSMTCTypes.h"
+
+#include <atomic>
+
+class FRunnableThread;
+class FEvent;
+class IFileHandle;
+
+enum class EDreamSMTCHistoryEvent : uint8
+{
+	TrackStarted,
+	// Position is where the previous track was left
+	TrackEnded,
+	// Value is EDreamSMTCMediaPlaybackStatus
+	PlaybackStatus,
+	Seek,
+	// Value is EDreamSMTCButtonEvent
+	Button,
+};
+
+/** Fixed-size history record; Artist and Title are only set on TrackStarted. */
+struct FDreamSMTCHistoryRecord
+{
+	int64 UtcTicks = 0;
+	int64 PositionMs = 0;
+	int64 DurationMs = 0;
+	uint32 TrackId = 0;
+	EDreamSMTCHistoryEvent Event = EDreamSMTCHistoryEvent::TrackStarted;
+	uint8 Value = 0;
+	// 原样截断复制，标签在写入线程上格式化与转码；以零结尾
+	TCHAR Artist[24] = {};
+	TCHAR Title[40] = {};
+
+	/** "Artist - Title", or only the title. */
+	FString GetLabel() const;
+};
+
+/**
+ * Listening history
+ * Session events are recorded into a ring of Capacity records allocated once, so recording never
+ * allocates. A background writer appends them to Saved/DreamSMTCCache/History/ListeningHistory.csv,
+ * rotating the file at MaxFileSize and keeping MaxFiles old ones. Summaries are computed from the ring,
+ * never from the files.
+ *
+ * Record* and Summarize are game thread only. If the writer falls a whole ring behind, the oldest
+ * records are lost from the file (counted by GetDroppedRecords).
+ */
+class DREAMSMTC_API FDreamSMTCListeningHistory : public FRunnable
+{
+public:
+	/** InstanceIndex selects the export directory, so PIE clients do not write into the same file. */
+	FDreamSMTCListeningHistory(int32 InCapacity, int64 InMaxFileSize, int32 InMaxFiles, int32 InstanceIndex = 0);
+	virtual ~FDreamSMTCListeningHistory() override;
+
+	/** Starts the file writer. Without it the history is kept in memory only. */
+	bool StartExport();
+
+	/** Writes everything recorded so far and stops the writer. */
+	void Shutdown();
+
+	/** Ends the current track at PreviousTimeline's position and starts a new one if Music names another track. */
+	void RecordTrackChange(const FDreamSMTCMusicDisplayProperties& Music, const FDreamSMTCTimelineProperties& PreviousTimeline);
+
+	void RecordSeek(const FDreamSMTCTimelineProperties& Timeline);
+
+	void RecordPlaybackStatus(EDreamSMTCMediaPlaybackStatus Status, const FDreamSMTCTimelineProperties& Timeline);
+
+	void RecordButton(EDreamSMTCButtonEvent Button);
+
+	/** Aggregates the records of the last Window that are still in the ring. */
+	FDreamSMTCListeningSummary Summarize(FTimespan Window) const;
+
+	int64 GetDroppedRecords() const { return DroppedRecords.load(std::memory_order_relaxed); }
+
+	/** The ring; the writer's buffers are not counted. */
+	SIZE_T GetAllocatedSize() const { return static_cast<SIZE_T>(Capacity) * RecordWords * sizeof(uint64); }
+
+	static FString GetExportDirectory(int32 InstanceIndex = 0);
+
+protected:
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	FDreamSMTCHistoryRecord& BeginRecord(EDreamSMTCHistoryEvent Event);
+	void CommitRecord();
+
+	// 槽位按原子字读写，与 TDreamSMTCSeqLock 相同，Head 充当序号
+	void LoadRecord(uint64 Index, FDreamSMTCHistoryRecord& OutRecord) const;
+	void StoreRecord(uint64 Index, const FDreamSMTCHistoryRecord& Record);
+
+	void WritePending();
+	bool RotateIfNeeded(int64 IncomingBytes);
+	bool OpenFile();
+	FString GetFilePath(int32 Index) const;
+
+	static uint32 MakeTrackId(const FDreamSMTCMusicDisplayProperties& Music);
+	static int64 ToMilliseconds(FTimespan Time) { return Time.GetTicks() / ETimespan::TicksPerMillisecond; }
+
+private:
+	// 2 的幂
+	int32 Capacity;
+	int64 MaxFileSize;
+	int32 MaxFiles;
+	FString ExportDirectory;
+
+	static constexpr int32 RecordWords = (sizeof(FDreamSMTCHistoryRecord) + sizeof(uint64) - 1) / sizeof(uint64);
+	TUniquePtr<std::atomic<uint64>[]> Ring;
+	// 游戏线程写入记录后发布，写入线程读取
+	std::atomic<uint64> Head{0};
+	std::atomic<uint64> WriterCursor{0};
+	std::atomic<int64> DroppedRecords{0};
+
+	// 游戏线程状态
+	FDreamSMTCHistoryRecord Staged;
+	uint32 CurrentTrack = 0;
+	EDreamSMTCMediaPlaybackStatus LastStatus = EDreamSMTCMediaPlaybackStatus::Closed;
+
+	// 写入线程状态
+	FRunnableThread* Thread = nullptr;
+	FEvent* WakeEvent = nullptr;
+	std::atomic<bool> bStopping{false};
+	TArray<FDreamSMTCHistoryRecord> WriteChunk;
+	TArray<ANSICHAR> WriteBuffer;
+	TUniquePtr<IFileHandle> File;
+};
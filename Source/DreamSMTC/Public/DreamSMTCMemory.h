@@ -0,0 +1,70 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+
+// 插件的全部分配都记在这个 LLM 标签下
+LLM_DECLARE_TAG_API(DreamSMTC, DREAMSMTC_API);
+
+#define DSMTC_LLM_SCOPE() LLM_SCOPE_BYTAG(DreamSMTC)
+
+enum class EDreamSMTCMemoryCategory : uint8
+{
+	// Encoded thumbnails held by sessions, placeholders and staged switches
+	Thumbnails,
+	// Session strings, cue tracks and staged session states
+	Metadata,
+	// History ring, state sink queues and timers
+	Queues,
+	// Files under Saved/DreamSMTCCache, only measured by the report
+	Caches,
+	Num
+};
+
+struct FDreamSMTCMemoryUsage
+{
+	int64 Bytes[static_cast<int32>(EDreamSMTCMemoryCategory::Num)] = {};
+
+	int64& operator[](EDreamSMTCMemoryCategory Category) { return Bytes[static_cast<int32>(Category)]; }
+	int64 operator[](EDreamSMTCMemoryCategory Category) const { return Bytes[static_cast<int32>(Category)]; }
+};
+
+/**
+ * Memory budget tracking
+ * Sessions are sampled about once a second while a subsystem ticks and on every DreamSMTC.MemReport.
+ * Keeps a high-water mark per category and logs a warning each time a category goes over its budget
+ * (see the Memory settings). Game thread only.
+ */
+class DREAMSMTC_API FDreamSMTCMemoryTracker
+{
+public:
+	static FDreamSMTCMemoryTracker& Get();
+
+	/** Samples all sessions if the last sample is older than SampleInterval. */
+	void Tick(double Now);
+
+	/** Samples all sessions now. With bMeasureCaches the cache directory is scanned as well. */
+	FDreamSMTCMemoryUsage Sample(bool bMeasureCaches);
+
+	void Report(FOutputDevice& Ar);
+
+	int64 GetHighWater(EDreamSMTCMemoryCategory Category) const { return HighWater[Category]; }
+
+	/** Budget in bytes, 0 when unlimited. */
+	static int64 GetBudget(EDreamSMTCMemoryCategory Category);
+
+	static const TCHAR* GetCategoryName(EDreamSMTCMemoryCategory Category);
+
+private:
+	void Record(const FDreamSMTCMemoryUsage& Usage, bool bCachesMeasured);
+
+private:
+	static constexpr double SampleInterval = 1.0;
+
+	FDreamSMTCMemoryUsage HighWater;
+	FDreamSMTCMemoryUsage Last;
+	bool bOverBudget[static_cast<int32>(EDreamSMTCMemoryCategory::Num)] = {};
+	double LastSampleTime = 0.0;
+};
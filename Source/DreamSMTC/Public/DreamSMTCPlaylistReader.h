@@ -0,0 +1,74 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DreamSMTCTypes.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+enum class EDreamSMTCPlaylistFormat : uint8
+{
+	Unknown,
+	// M3U / M3U8, optionally extended (#EXTINF)
+	M3U,
+	PLS,
+	XSPF,
+};
+
+/**
+ * Streaming playlist reader
+ * Memory-maps the file and parses one entry per Next() call straight from the mapping, so the first
+ * entry is available as soon as its line is read and memory use does not grow with the playlist.
+ * Text is read as UTF-8; a leading BOM is skipped.
+ */
+class DREAMSMTC_API FDreamSMTCPlaylistReader
+{
+public:
+	FDreamSMTCPlaylistReader();
+	~FDreamSMTCPlaylistReader();
+
+	/** Maps the file and detects its format from the extension, falling back to the content. */
+	bool Open(const FString& Path);
+
+	void Close();
+
+	/** Parses the next entry. Returns false at the end of the playlist. */
+	bool Next(FDreamSMTCPlaylistEntry& OutEntry);
+
+	EDreamSMTCPlaylistFormat GetFormat() const { return Format; }
+
+	int32 GetEntriesRead() const { return EntriesRead; }
+
+	/** Fraction of the file consumed so far. */
+	float GetProgress() const { return Size > 0 ? static_cast<float>(static_cast<double>(Cursor) / Size) : 1.0f; }
+
+	static EDreamSMTCPlaylistFormat DetectFormat(const FString& Path, FAnsiStringView Head);
+
+private:
+	bool NextM3U(FDreamSMTCPlaylistEntry& OutEntry);
+	bool NextPLS(FDreamSMTCPlaylistEntry& OutEntry);
+	bool NextXSPF(FDreamSMTCPlaylistEntry& OutEntry);
+
+	bool ReadLine(FAnsiStringView& OutLine);
+	FString ResolveLocation(FAnsiStringView Location) const;
+
+	static FString ToString(FAnsiStringView Text);
+	static FString DecodeXml(FAnsiStringView Text);
+	static FAnsiStringView FindElement(FAnsiStringView Track, FAnsiStringView Name);
+
+private:
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	// 平台不支持内存映射时的后备数据
+	TArray<uint8> FallbackData;
+
+	const ANSICHAR* Data = nullptr;
+	int64 Size = 0;
+	int64 Cursor = 0;
+
+	EDreamSMTCPlaylistFormat Format = EDreamSMTCPlaylistFormat::Unknown;
+	FString BaseDirectory;
+	int32 EntriesRead = 0;
+};
@@ -0,0 +1,140 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "Containers/Queue.h"
+#include "DreamSMTCSessionState.h"
+#include "DreamSMTCStateSink.h"
+
+#include <atomic>
+
+class FSocket;
+class FRunnableThread;
+class FEvent;
+
+struct FDreamSMTCRemoteServerStats
+{
+	int32 Clients = 0;
+	int64 PublishedFrames = 0;
+	int64 DroppedFrames = 0;
+	int64 ReceivedCommands = 0;
+};
+
+/**
+ * Loopback remote control server
+ * Serves the session state to companion tools over WebSocket (ws://127.0.0.1:<Port>/) and plain HTTP
+ * (GET /state), and accepts button commands (WebSocket text "Play", {"button":"Play"} or POST /button/Play).
+ *
+ * Web pages in the player's browser can reach the loopback port too, so requests are only served when the Host is
+ * the loopback address and the Origin (if any) is in AllowedOrigins. Every request, GET /state included, must carry
+ * the session token, as "Authorization: Bearer <Token>" or "?token=<Token>" (browsers cannot set WebSocket headers).
+ * Without a configured token one is generated per run and written to GetTokenFilePath() while the server runs.
+ *
+ * Every published state is serialized and framed once, then shared by reference with all clients.
+ * A slow client never holds up the others: when its queue exceeds MaxQueuedFrames the stale
+ * snapshots in the middle are dropped, since only the newest one matters.
+ * Registered as a worker state sink, so serialization happens off the game thread.
+ */
+class DREAMSMTC_API FDreamSMTCRemoteServer : public FRunnable, public IDreamSMTCStateSink
+{
+public:
+	using FCommandHandler = TFunction<void(EDreamSMTCButtonEvent Button)>;
+
+	FDreamSMTCRemoteServer(int32 InPort, int32 InMaxQueuedFrames, const FString& InToken,
+	                       const TArray<FString>& InAllowedOrigins);
+	virtual ~FDreamSMTCRemoteServer() override;
+
+	bool Start();
+	void Shutdown();
+
+	/** Serializes once and queues the frame for every client. Call from one thread at a time. */
+	void Publish(const FDreamSMTCSessionState& State);
+
+	virtual void OnStateChanged(const FDreamSMTCChangeSetRef& ChangeSet) override;
+
+	/** Game thread. Returns the button commands received since the last call. */
+	void DrainCommands(TArray<EDreamSMTCButtonEvent>& OutCommands);
+
+	/** Called on the server thread as soon as a command is parsed. */
+	void SetCommandHandler(FCommandHandler&& Handler) { ServerThreadCommandHandler = MoveTemp(Handler); }
+
+	FDreamSMTCRemoteServerStats GetStats() const;
+
+	int32 GetPort() const { return Port; }
+
+	const FString& GetToken() const { return Token; }
+
+	static FString GetTokenFilePath(int32 InPort);
+
+	static FString SerializeState(const FDreamSMTCSessionState& State);
+
+	static bool ParseButton(FStringView Name, EDreamSMTCButtonEvent& OutButton);
+
+protected:
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	using FFrame = TSharedRef<const TArray<uint8>, ESPMode::ThreadSafe>;
+
+	struct FClient
+	{
+		FSocket* Socket = nullptr;
+		bool bWebSocket = false;
+		bool bCloseAfterSend = false;
+		bool bClosed = false;
+		TArray<uint8> ReceiveBuffer;
+		TArray<FFrame> SendQueue;
+		int32 SendOffset = 0;
+		// Frames at the front of SendQueue that must never be dropped (the handshake)
+		int32 PinnedFrames = 0;
+	};
+
+	void AcceptClients();
+	void ReceiveFrom(FClient& Client);
+	void SendTo(FClient& Client);
+	void Enqueue(FClient& Client, const FFrame& Frame);
+	void CloseClient(FClient& Client);
+
+	void HandleHttpRequest(FClient& Client);
+	bool IsHostAllowed(const FString& Host) const;
+	bool IsOriginAllowed(const FString& Origin) const;
+	bool IsTokenValid(const FString& Presented) const;
+	void HandleWebSocketFrames(FClient& Client);
+	void HandleCommand(FStringView Text);
+
+	static FFrame MakeWebSocketFrame(uint8 Opcode, const uint8* Payload, int32 Size);
+	static FFrame MakeHttpResponse(int32 StatusCode, const FString& ContentType, const FString& Body);
+
+private:
+	int32 Port;
+	int32 MaxQueuedFrames;
+	FString Token;
+	bool bGeneratedToken = false;
+	// 不带 Origin 的请求来自本机工具，总是允许
+	TArray<FString> AllowedOrigins;
+
+	FSocket* ListenSocket = nullptr;
+	FRunnableThread* Thread = nullptr;
+	FEvent* WakeEvent = nullptr;
+	std::atomic<bool> bStopping{false};
+
+	TArray<FClient> Clients;
+
+	// 状态接收线程写入，服务线程读取
+	TQueue<TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe>, EQueueMode::Spsc> PendingFrames;
+	mutable FCriticalSection LatestLock;
+	TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe> LatestFrame;
+	FString LatestJson;
+
+	// 服务线程写入，游戏线程读取
+	TQueue<EDreamSMTCButtonEvent, EQueueMode::Spsc> Commands;
+	FCommandHandler ServerThreadCommandHandler;
+
+	std::atomic<int32> ClientCount{0};
+	std::atomic<int64> PublishedFrames{0};
+	std::atomic<int64> DroppedFrames{0};
+	std::atomic<int64> ReceivedCommands{0};
+};
@@ -0,0 +1,139 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/PlatformProcess.h"
+
+#include <atomic>
+#include <type_traits>
+
+/**
+ * Sequence lock over a small trivially copyable value
+ * Readers never block and never write shared memory; they retry when a write overlapped their copy.
+ * Writers from any thread claim the sequence with a CAS, so a writer only ever waits for another writer.
+ * The value is stored as atomic words, so a torn read is detected instead of being undefined behaviour.
+ */
+template <typename T>
+class TDreamSMTCSeqLock
+{
+	static_assert(std::is_trivially_copyable_v<T>, "TDreamSMTCSeqLock requires a trivially copyable type");
+
+public:
+	TDreamSMTCSeqLock()
+	{
+		Store(T());
+	}
+
+	/** Returns a consistent copy. */
+	T Read() const
+	{
+		T Value;
+		Read(Value);
+		return Value;
+	}
+
+	/** Copies a consistent value into OutValue and returns the sequence it was read at. */
+	uint64 Read(T& OutValue) const
+	{
+		for (;;)
+		{
+			const uint64 Begin = Sequence.load(std::memory_order_acquire);
+			if ((Begin & 1) == 0)
+			{
+				uint64 Copy[NumWords];
+				for (int32 Index = 0; Index < NumWords; ++Index)
+				{
+					Copy[Index] = Words[Index].load(std::memory_order_relaxed);
+				}
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (Sequence.load(std::memory_order_relaxed) == Begin)
+				{
+					FMemory::Memcpy(&OutValue, Copy, sizeof(T));
+					return Begin;
+				}
+			}
+			ReadRetries.fetch_add(1, std::memory_order_relaxed);
+			FPlatformProcess::Yield();
+		}
+	}
+
+	/** Replaces the value. Returns the sequence of the new value. */
+	uint64 Write(const T& Value)
+	{
+		return Modify([&Value](T& Current) { Current = Value; });
+	}
+
+	/** Read-modify-write under the write side of the lock. Returns the sequence of the new value. */
+	template <typename FunctorType>
+	uint64 Modify(FunctorType&& Functor)
+	{
+		const uint64 Begin = Acquire();
+
+		T Value;
+		Load(Value);
+		Functor(Value);
+		Store(Value);
+
+		Sequence.store(Begin + 2, std::memory_order_release);
+		return Begin + 2;
+	}
+
+	/** Sequence of the last completed write. Changes whenever the value may have changed. */
+	uint64 GetSequence() const
+	{
+		return Sequence.load(std::memory_order_acquire) & ~uint64(1);
+	}
+
+	int64 GetReadRetries() const { return ReadRetries.load(std::memory_order_relaxed); }
+	int64 GetWriteRetries() const { return WriteRetries.load(std::memory_order_relaxed); }
+
+private:
+	static constexpr int32 NumWords = (sizeof(T) + sizeof(uint64) - 1) / sizeof(uint64);
+
+	uint64 Acquire()
+	{
+		uint64 Begin = Sequence.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			if ((Begin & 1) == 0 &&
+				Sequence.compare_exchange_weak(Begin, Begin + 1, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				// 序号变为奇数后再写数据，读者据此发现重叠
+				std::atomic_thread_fence(std::memory_order_release);
+				return Begin;
+			}
+			WriteRetries.fetch_add(1, std::memory_order_relaxed);
+			FPlatformProcess::Yield();
+			Begin = Sequence.load(std::memory_order_relaxed);
+		}
+	}
+
+	void Load(T& OutValue) const
+	{
+		uint64 Copy[NumWords];
+		for (int32 Index = 0; Index < NumWords; ++Index)
+		{
+			Copy[Index] = Words[Index].load(std::memory_order_relaxed);
+		}
+		FMemory::Memcpy(&OutValue, Copy, sizeof(T));
+	}
+
+	void Store(const T& Value)
+	{
+		uint64 Copy[NumWords] = {};
+		FMemory::Memcpy(Copy, &Value, sizeof(T));
+		for (int32 Index = 0; Index < NumWords; ++Index)
+		{
+			Words[Index].store(Copy[Index], std::memory_order_relaxed);
+		}
+	}
+
+private:
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> Sequence{0};
+	std::atomic<uint64> Words[NumWords];
+
+	// 统计争用，单独放一行避免与数据伪共享
+	alignas(PLATFORM_CACHE_LINE_SIZE) mutable std::atomic<int64> ReadRetries{0};
+	std::atomic<int64> WriteRetries{0};
+};
@@ -0,0 +1,98 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "DreamSMTCTypes.h"
+#include "Engine/EngineBaseTypes.h"
+#include "DreamSMTCSequenceBinding.generated.h"
+
+class UDreamSMTCSubsystem;
+class ULevelSequencePlayer;
+class UMovieSceneSequencePlayer;
+class UWorld;
+
+/**
+ * Drives the session from a level sequence player
+ * Title (the sequence name unless Display sets one), duration and position follow the cinematic; Play, Pause,
+ * Stop, seek and rate requests from the OS control the player. The timeline is not polled: it is pushed on play,
+ * pause and stop, when the world pauses or its time dilation changes, and from the player's update event only
+ * when the position leaves what the OS extrapolates from the last push (jumps, loops, hitches).
+ * Created by UDreamSMTCSubsystem::BindSequencePlayer. Game thread only.
+ */
+UCLASS(BlueprintType)
+class DREAMSMTC_API UDreamSMTCSequenceBinding : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	void Bind(UDreamSMTCSubsystem* InSubsystem, ULevelSequencePlayer* InPlayer,
+	          const FDreamSMTCVideoDisplayProperties& Display);
+
+	/** Stops following the player and restores the buttons, type, display, status and timeline from before Bind. */
+	void Unbind();
+
+	UFUNCTION(BlueprintPure, Category = "DreamSMTC|Sequence")
+	ULevelSequencePlayer* GetPlayer() const;
+
+	UFUNCTION(BlueprintPure, Category = "DreamSMTC|Sequence")
+	bool IsBound() const { return Player.IsValid(); }
+
+private:
+	UFUNCTION()
+	void OnPlay();
+
+	UFUNCTION()
+	void OnPause();
+
+	UFUNCTION()
+	void OnStop();
+
+	UFUNCTION()
+	void OnPositionChangeRequested(FTimespan Position);
+
+	UFUNCTION()
+	void OnRateChangeRequested(double Rate);
+
+	void OnSequenceUpdated(const UMovieSceneSequencePlayer& InPlayer, FFrameTime CurrentTime, FFrameTime PreviousTime);
+	void OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void OnButton(EDreamSMTCButtonEvent Button);
+
+	void SetStatus(EDreamSMTCMediaPlaybackStatus Status);
+	void PushTimeline();
+	FTimespan GetPosition() const;
+	EDreamSMTCMediaPlaybackStatus GetPlayerStatus() const;
+	float GetTimeDilation() const;
+
+	/** Position change per real second, which is what the OS extrapolates with. */
+	double GetEffectiveRate() const;
+
+private:
+	// 与系统推算的进度相差超过该值时视为不连续
+	static constexpr double DiscontinuityTolerance = 0.25;
+	// 时间膨胀渐变时不逐帧推送
+	static constexpr double RateTolerance = 0.01;
+
+	TWeakObjectPtr<UDreamSMTCSubsystem> Subsystem;
+	TWeakObjectPtr<ULevelSequencePlayer> Player;
+
+	FDelegateHandle UpdateHandle;
+	FDelegateHandle WorldTickHandle;
+	FDelegateHandle ButtonHandle;
+
+	// Bind 之前的会话内容，Unbind 时恢复
+	int32 PreviousButtons = 0;
+	bool bPreviousEnabled = false;
+	EDreamSMTCMediaPlaybackType PreviousType = EDreamSMTCMediaPlaybackType::Unknown;
+	FDreamSMTCVideoDisplayProperties PreviousVideo;
+	EDreamSMTCMediaPlaybackStatus PreviousStatus = EDreamSMTCMediaPlaybackStatus::Closed;
+	double PreviousRate = 1.0;
+	FDreamSMTCTimelineProperties PreviousTimeline;
+
+	// 最后一次推送的状态与进度，之后系统按 PushedRate 以真实时间推算
+	EDreamSMTCMediaPlaybackStatus PushedStatus = EDreamSMTCMediaPlaybackStatus::Closed;
+	FTimespan PushedPosition;
+	double PushedTime = 0.0;
+	double PushedRate = 0.0;
+};
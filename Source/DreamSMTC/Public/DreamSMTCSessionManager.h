@@ -0,0 +1,59 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UDreamSMTCSubsystem;
+class SWidget;
+class FWidgetPath;
+class FWeakWidgetPath;
+struct FFocusEvent;
+
+/**
+ * Process-wide arbitration between subsystem instances (PIE clients, several game instances)
+ * The OS has one set of transport controls per process. Each subsystem keeps its own logical session;
+ * only the owner writes to the backend and receives button and change requests. The owner is the session
+ * with the highest priority, then the one whose window was focused last, then the one registered last.
+ * Game thread only.
+ */
+class DREAMSMTC_API FDreamSMTCSessionManager
+{
+public:
+	static FDreamSMTCSessionManager& Get();
+
+	void Register(UDreamSMTCSubsystem* Subsystem, int32 Priority);
+	void Unregister(UDreamSMTCSubsystem* Subsystem);
+
+	void SetPriority(UDreamSMTCSubsystem* Subsystem, int32 Priority);
+
+	/** Makes the session the most recently focused one, e.g. when its window gains focus. */
+	void NotifyFocused(UDreamSMTCSubsystem* Subsystem);
+
+	UDreamSMTCSubsystem* GetOwner() const { return Owner.Get(); }
+	int32 Num() const { return Entries.Num(); }
+
+	void ForEachSession(TFunctionRef<void(UDreamSMTCSubsystem&)> Function) const;
+
+private:
+	struct FEntry
+	{
+		TWeakObjectPtr<UDreamSMTCSubsystem> Subsystem;
+		int32 Priority = 0;
+		// 越大表示越近获得焦点
+		uint64 FocusSerial = 0;
+	};
+
+	FEntry* Find(const UDreamSMTCSubsystem* Subsystem);
+	void Arbitrate();
+
+	void OnFocusChanging(const FFocusEvent& FocusEvent, const FWeakWidgetPath& OldFocusedWidgetPath,
+	                     const TSharedPtr<SWidget>& OldFocusedWidget, const FWidgetPath& NewFocusedWidgetPath,
+	                     const TSharedPtr<SWidget>& NewFocusedWidget);
+
+private:
+	TArray<FEntry> Entries;
+	TWeakObjectPtr<UDreamSMTCSubsystem> Owner;
+	uint64 NextFocusSerial = 0;
+	FDelegateHandle FocusChangingHandle;
+};
@@ -0,0 +1,108 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DreamSMTCTypes.h"
+
+/** Groups of session state, each written to the backend as a unit. */
+enum class EDreamSMTCSessionField : uint32
+{
+	None = 0,
+	Enabled = 1 << 0,
+	Buttons = 1 << 1,
+	PlaybackStatus = 1 << 2,
+	PlaybackRate = 1 << 3,
+	Shuffle = 1 << 4,
+	AutoRepeat = 1 << 5,
+	Type = 1 << 6,
+	AppMediaId = 1 << 7,
+	Music = 1 << 8,
+	Video = 1 << 9,
+	Image = 1 << 10,
+	Timeline = 1 << 11,
+	Thumbnail = 1 << 12,
+
+	Display = Type | AppMediaId | Music | Video | Image,
+	All = (1 << 13) - 1,
+};
+
+ENUM_CLASS_FLAGS(EDreamSMTCSessionField);
+
+/**
+ * Mirrored session state
+ * Everything the subsystem has sent to the OS, so it can be read back without a WinRT round-trip,
+ * saved between launches and replayed in a single commit.
+ */
+struct DREAMSMTC_API FDreamSMTCSessionState
+{
+	using FEncodedImage = TArray64<uint8>;
+
+	bool bEnabled = false;
+	// DreamSMTCButtonBit(EDreamSMTCButtonEvent)
+	uint32 EnabledButtons = 0;
+	EDreamSMTCMediaPlaybackStatus PlaybackStatus = EDreamSMTCMediaPlaybackStatus::Closed;
+	double PlaybackRate = 1.0;
+	bool bShuffleEnabled = false;
+	EDreamSMTCAutoRepeatMode AutoRepeatMode = EDreamSMTCAutoRepeatMode::None;
+
+	EDreamSMTCMediaPlaybackType Type = EDreamSMTCMediaPlaybackType::Unknown;
+	FString AppMediaId;
+	FDreamSMTCMusicDisplayProperties Music;
+	FDreamSMTCVideoDisplayProperties Video;
+	FDreamSMTCImageDisplayProperties Image;
+	FDreamSMTCTimelineProperties Timeline;
+
+	// Encoded thumbnail, shared with worker threads without copying
+	TSharedPtr<const FEncodedImage, ESPMode::ThreadSafe> Thumbnail;
+
+	void ClearDisplay();
+
+	/** Copies the given fields of From. Thumbnail is copied as a shared reference. */
+	void CopyFields(const FDreamSMTCSessionState& From, EDreamSMTCSessionField Fields);
+
+	/** Fields that differ between From and To. Thumbnails are compared by identity. */
+	static EDreamSMTCSessionField Diff(const FDreamSMTCSessionState& From, const FDreamSMTCSessionState& To,
+	                                   uint32* OutChangedButtons = nullptr);
+
+	/** Heap memory held by the strings, not counting the shared thumbnail. */
+	SIZE_T GetAllocatedSize() const;
+
+	friend FArchive& operator<<(FArchive& Ar, FDreamSMTCSessionState& State);
+};
+
+/**
+ * Timeline and playback state published from any thread through TDreamSMTCSeqLock
+ * ChangedFields holds the EDreamSMTCSessionField bits written since the game thread last consumed it.
+ */
+struct FDreamSMTCPlaybackSnapshot
+{
+	FDreamSMTCTimelineProperties Timeline;
+	// FPlatformTime::Seconds() at which Timeline.Position was sampled
+	double TimelineTime = 0.0;
+	double PlaybackRate = 1.0;
+	EDreamSMTCMediaPlaybackStatus PlaybackStatus = EDreamSMTCMediaPlaybackStatus::Closed;
+	EDreamSMTCSessionField ChangedFields = EDreamSMTCSessionField::None;
+};
+
+/**
+ * Versioned binary snapshot of FDreamSMTCSessionState stored under Saved/DreamSMTCCache
+ * Each game instance has its own file, so PIE clients do not overwrite each other's session.
+ */
+class DREAMSMTC_API FDreamSMTCSessionSnapshot
+{
+public:
+	static constexpr uint32 Magic = 0x544D5344; // "DSMT"
+	static constexpr uint32 Version = 1;
+
+	/** InstanceIndex is 0 outside of multi-client PIE, see UDreamSMTCSubsystem::GetInstanceIndex. */
+	static FString GetSnapshotPath(int32 InstanceIndex = 0);
+
+	/** Serializes and atomically replaces the snapshot file. Blocking, call from a worker thread. */
+	static bool Save(const FDreamSMTCSessionState& State, int32 InstanceIndex = 0);
+
+	/** Memory-maps the snapshot file and deserializes it. Returns false if missing or of another version. */
+	static bool Load(FDreamSMTCSessionState& OutState, int32 InstanceIndex = 0);
+
+	static void Delete(int32 InstanceIndex = 0);
+};
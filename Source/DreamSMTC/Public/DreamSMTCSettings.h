@@ -0,0 +1,182 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DeveloperSettings.h"
+#include "DreamSMTCTypes.h"
+#include "DreamSMTCSettings.generated.h"
+
+class UInputMappingContext;
+
+/**
+ * Dream SMTC Settings
+ * Values are loaded from Config/DefaultDreamSMTC.ini
+ */
+UCLASS(Config = DreamSMTC, DefaultConfig, meta = (DisplayName = "Dream SMTC"))
+class DREAMSMTC_API UDreamSMTCSettings : public UDeveloperSettings
+{
+	GENERATED_BODY()
+
+public:
+	virtual FName GetCategoryName() const override;
+
+	static const UDreamSMTCSettings* Get();
+
+public:
+	/** Backend call budget. Calls above this rate are deferred to later frames. */
+	UPROPERTY(Config, EditAnywhere, Category = "Scheduler", meta = (ClampMin = "1"))
+	float MaxBackendCallsPerSecond = 20.0f;
+
+	/** Longest time a low priority write (timeline position) waits for a high priority commit to merge into. */
+	UPROPERTY(Config, EditAnywhere, Category = "Scheduler", meta = (ClampMin = "0", Units = "s"))
+	float LowPriorityFlushDelay = 1.0f;
+
+	/** Calls kept in the budget for high priority writes. Low priority writes never spend them. */
+	UPROPERTY(Config, EditAnywhere, Category = "Scheduler", meta = (ClampMin = "0"))
+	float HighPriorityReserve = 2.0f;
+
+	/** Position jumps larger than this are treated as seeks and sent with high priority. */
+	UPROPERTY(Config, EditAnywhere, Category = "Scheduler", meta = (ClampMin = "0", Units = "s"))
+	float TimelineSeekThreshold = 2.0f;
+
+	/**
+	 * Also idles while playing when the application window loses focus. The system extrapolates the
+	 * position from the last timeline and playback rate, so pushes are not needed in the background.
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Idle")
+	bool bIdleWhenUnfocused = true;
+
+	/**
+	 * Injects OS media buttons and remote commands as the DreamSMTC media keys (DreamSMTC_Play, ...) into the first
+	 * local player, in the frame after they arrive at the latest. The ButtonPressed event is broadcast as before.
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Enhanced Input")
+	bool bInjectMediaKeys = false;
+
+	/** Maps the media keys to input actions. Added to the player when set; contexts of your own can bind them too. */
+	UPROPERTY(Config, EditAnywhere, Category = "Enhanced Input", meta = (EditCondition = "bInjectMediaKeys"))
+	TSoftObjectPtr<UInputMappingContext> MediaKeyMappingContext;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Enhanced Input", meta = (EditCondition = "bInjectMediaKeys"))
+	int32 MediaKeyMappingPriority = 0;
+
+	/** Saves the last committed session (display, timeline, buttons, thumbnail) under Saved/DreamSMTCCache. */
+	UPROPERTY(Config, EditAnywhere, Category = "Persistence")
+	bool bPersistSession = true;
+
+	/** Applies the saved session in a single commit when the subsystem starts. */
+	UPROPERTY(Config, EditAnywhere, Category = "Persistence")
+	bool bRestoreSessionOnStartup = true;
+
+	/** Quiet time after the last change before the snapshot is written. Position updates do not restart it. */
+	UPROPERTY(Config, EditAnywhere, Category = "Persistence", meta = (ClampMin = "0", Units = "s"))
+	float SessionSaveDebounce = 2.0f;
+
+	/** Longest time a change stays unsaved, e.g. the position while playing or a stream of display changes. */
+	UPROPERTY(Config, EditAnywhere, Category = "Persistence", meta = (ClampMin = "0", Units = "s"))
+	float SessionSaveMaxDelay = 10.0f;
+
+	/** Publishes a small placeholder as soon as a new thumbnail is read back, then swaps in the full image. */
+	UPROPERTY(Config, EditAnywhere, Category = "Thumbnail")
+	bool bProgressiveThumbnail = true;
+
+	/** Largest side of the placeholder image. */
+	UPROPERTY(Config, EditAnywhere, Category = "Thumbnail", meta = (ClampMin = "1", ClampMax = "256", EditCondition = "bProgressiveThumbnail"))
+	int32 ThumbnailPlaceholderSize = 32;
+
+	/** Records track changes, playback status, seeks and button presses for GetListeningSummary. */
+	UPROPERTY(Config, EditAnywhere, Category = "Listening History")
+	bool bRecordListeningHistory = true;
+
+	/** Records kept in memory. Summaries only reach back this far. Rounded up to a power of two. */
+	UPROPERTY(Config, EditAnywhere, Category = "Listening History", meta = (ClampMin = "64", EditCondition = "bRecordListeningHistory"))
+	int32 ListeningHistoryCapacity = 4096;
+
+	/** Appends the history to Saved/DreamSMTCCache/History/ListeningHistory.csv from a background thread. */
+	UPROPERTY(Config, EditAnywhere, Category = "Listening History", meta = (EditCondition = "bRecordListeningHistory"))
+	bool bExportListeningHistory = true;
+
+	/** Size at which the export file is rotated. */
+	UPROPERTY(Config, EditAnywhere, Category = "Listening History", meta = (ClampMin = "4", Units = "KB", EditCondition = "bExportListeningHistory"))
+	int32 ListeningHistoryMaxFileSize = 1024;
+
+	/** Rotated files kept besides the current one. */
+	UPROPERTY(Config, EditAnywhere, Category = "Listening History", meta = (ClampMin = "0", EditCondition = "bExportListeningHistory"))
+	int32 ListeningHistoryMaxFiles = 4;
+
+	/**
+	 * Longest time Deinitialize waits for the final backend writes and session save.
+	 * Work still running after that finishes in the background and is waited for when the module unloads.
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Shutdown", meta = (ClampMin = "0", Units = "s"))
+	float ShutdownTimeout = 0.5f;
+
+	/** Encoded thumbnails held in memory. DreamSMTC.MemReport shows usage against the budgets; 0 disables a budget. */
+	UPROPERTY(Config, EditAnywhere, Category = "Memory", meta = (ClampMin = "0", Units = "KB"))
+	int32 ThumbnailMemoryBudget = 2048;
+
+	/** Session strings, cue tracks and staged switches. */
+	UPROPERTY(Config, EditAnywhere, Category = "Memory", meta = (ClampMin = "0", Units = "KB"))
+	int32 MetadataMemoryBudget = 256;
+
+	/** Listening history ring, state sink queues and timers. */
+	UPROPERTY(Config, EditAnywhere, Category = "Memory", meta = (ClampMin = "0", Units = "KB"))
+	int32 QueueMemoryBudget = 1024;
+
+	/** Files under Saved/DreamSMTCCache (thumbnail cache, session snapshot, history exports). */
+	UPROPERTY(Config, EditAnywhere, Category = "Memory", meta = (ClampMin = "0", Units = "KB"))
+	int32 CacheDiskBudget = 8192;
+
+	/**
+	 * Replaces the OS media controls with an in-process backend that delays, fails and injects events as
+	 * configured below. Always used on platforms without SMTC. Read when the backend is first created.
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Simulated Backend")
+	bool bUseSimulatedBackend = false;
+
+	/** Seed of the latency, jitter and failure draws. The same seed gives each operation the same results. */
+	UPROPERTY(Config, EditAnywhere, Category = "Simulated Backend")
+	int32 SimulatedBackendSeed = 1;
+
+	/** Profile of operations without an entry in SimulatedOperationProfiles. */
+	UPROPERTY(Config, EditAnywhere, Category = "Simulated Backend")
+	FDreamSMTCSimulatedOperationProfile SimulatedDefaultProfile;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Simulated Backend")
+	TMap<EDreamSMTCBackendOperation, FDreamSMTCSimulatedOperationProfile> SimulatedOperationProfiles;
+
+	/** Writes every committed state change to LogDreamSMTC as one line of JSON, from a worker thread. */
+	UPROPERTY(Config, EditAnywhere, Category = "Debug")
+	bool bLogStateChanges = false;
+
+	/** How often the DreamSMTC.Debug panel redraws. The panel does no work between refreshes. */
+	UPROPERTY(Config, EditAnywhere, Category = "Debug", meta = (ClampMin = "1", ClampMax = "30", Units = "Hz"))
+	float DebugPanelRefreshRate = 4.0f;
+
+	/** Serves the session state and accepts button commands on 127.0.0.1 for companion tools. */
+	UPROPERTY(Config, EditAnywhere, Category = "Remote Control")
+	bool bEnableRemoteControl = false;
+
+	/**
+	 * Loopback port of the remote control server (ws://127.0.0.1:<Port>/, GET /state, POST /button/<Name>).
+	 * PIE client N listens on Port + N.
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Remote Control", meta = (ClampMin = "1024", ClampMax = "65535"))
+	int32 RemoteControlPort = 7311;
+
+	/** Frames a client may fall behind by before stale state updates are dropped for it. */
+	UPROPERTY(Config, EditAnywhere, Category = "Remote Control", meta = (ClampMin = "2"))
+	int32 RemoteControlMaxQueuedFrames = 8;
+
+	/**
+	 * Required on every request: WebSocket upgrades, GET /state and POST. When empty, a token is generated per run
+	 * and written to Saved/DreamSMTCRemote/Token-<Port>.txt for companion tools to read.
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "Remote Control")
+	FString RemoteControlToken;
+
+	/** Browser origins allowed to connect, e.g. "http://localhost:5173". Requests without an Origin are always allowed. */
+	UPROPERTY(Config, EditAnywhere, Category = "Remote Control")
+	TArray<FString> RemoteControlAllowedOrigins;
+};
@@ -0,0 +1,93 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DreamSMTCTypes.h"
+
+/**
+ * Shuffle / repeat play order over a queue of NumTracks entries
+ * The shuffled order is a keyed bijection (Feistel network with cycle walking) evaluated on demand,
+ * so no permutation array is ever built: memory is constant, toggling shuffle is O(1) and every
+ * lap of a repeating list gets a fresh order. Previous walks back exactly through what was played,
+ * across shuffle toggles, for the last MaxSegments toggles.
+ */
+class DREAMSMTC_API FDreamSMTCShuffleSequencer
+{
+public:
+	static constexpr int32 MaxSegments = 32;
+
+	/** Starts a new queue at StartTrack. Clears the history. */
+	void Reset(int32 InNumTracks, int32 StartTrack = 0, uint32 InSeed = 0);
+
+	void SetShuffleEnabled(bool bEnable);
+
+	void SetRepeatMode(EDreamSMTCAutoRepeatMode InRepeatMode) { RepeatMode = InRepeatMode; }
+
+	/** User skip. Repeat Track does not hold the user on the same track. Returns false at the end of the queue. */
+	bool Next();
+
+	/** Steps back through the play history. Returns false at its start. */
+	bool Previous();
+
+	/** Automatic advance when a track ends; honours Repeat Track. Returns false at the end of the queue. */
+	bool OnTrackFinished();
+
+	/** Jumps to a track chosen by the user; the shuffled order continues from it. */
+	void JumpTo(int32 Track);
+
+	int32 GetCurrentTrack() const { return CurrentTrack; }
+
+	/** Track Next() would move to without moving, or INDEX_NONE. */
+	int32 PeekNext() const;
+
+	int32 Num() const { return NumTracks; }
+
+	bool IsShuffleEnabled() const { return bShuffle; }
+
+	EDreamSMTCAutoRepeatMode GetRepeatMode() const { return RepeatMode; }
+
+private:
+	/**
+	 * Run of steps played under one ordering. Step is counted from the start of the segment:
+	 * linear segments play Step + Offset, shuffled segments play Permute((Step + Offset) % N, lap key).
+	 */
+	struct FSegment
+	{
+		bool bShuffle = false;
+		uint32 Seed = 0;
+		int64 Offset = 0;
+		int64 LastStep = 0;
+	};
+
+	int32 TrackAt(const FSegment& Segment, int64 Step) const;
+	bool IsStepInQueue(const FSegment& Segment, int64 Step) const;
+	bool StepForward();
+	void BeginSegment(bool bInShuffle);
+
+	uint64 Permute(uint64 Index, uint32 Key) const;
+	uint64 InversePermute(uint64 Index, uint32 Key) const;
+	uint64 Encrypt(uint64 Value, uint32 Key) const;
+	uint64 Decrypt(uint64 Value, uint32 Key) const;
+	uint32 Round(uint64 Half, uint32 Key, int32 RoundIndex) const;
+
+	static uint32 LapKey(uint32 Seed, int64 Lap);
+
+private:
+	int32 NumTracks = 0;
+	int32 CurrentTrack = INDEX_NONE;
+	bool bShuffle = false;
+	EDreamSMTCAutoRepeatMode RepeatMode = EDreamSMTCAutoRepeatMode::None;
+	uint32 BaseSeed = 0;
+
+	// Feistel domain is 2^(2 * HalfBits) >= NumTracks
+	int32 HalfBits = 0;
+	uint64 HalfMask = 0;
+
+	// Ring of segments, the newest is the current one
+	FSegment Segments[MaxSegments];
+	int32 SegmentHead = 0;
+	int32 SegmentCount = 0;
+	uint32 SegmentSerial = 0;
+	int64 Step = 0;
+};
@@ -0,0 +1,106 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DreamSMTCBackend.h"
+#include "Math/RandomStream.h"
+
+/**
+ * In-process backend for testing the async paths without the OS media service
+ * Every call blocks the calling thread for a latency drawn from its operation profile and may fail, so hitch
+ * budgets and back-pressure can be measured. The Nth call of an operation draws from a stream seeded with
+ * (seed, operation, N), so each operation sees the same delays and failures for the same seed however its
+ * calls interleave with other operations and threads. Button and seek bursts are fired from a worker thread like
+ * OS callbacks. Used when bUseSimulatedBackend is set and on platforms without SMTC; see DreamSMTC.Sim.*.
+ */
+class DREAMSMTC_API FDreamSMTCSimulatedBackend : public IDreamSMTCBackend,
+                                                 public TSharedFromThis<FDreamSMTCSimulatedBackend, ESPMode::ThreadSafe>
+{
+public:
+	// 注册、查询音量与释放不注入延迟
+	static constexpr int32 NumOperations = static_cast<int32>(EDreamSMTCBackendOperation::PrepareThumbnail) + 1;
+
+	struct FOperationStats
+	{
+		int64 Calls = 0;
+		int64 Failures = 0;
+		int64 Spikes = 0;
+		double TotalSeconds = 0.0;
+		double MaxSeconds = 0.0;
+	};
+
+	FDreamSMTCSimulatedBackend(int32 InSeed, const FDreamSMTCSimulatedOperationProfile& InDefaultProfile,
+	                           const TMap<EDreamSMTCBackendOperation, FDreamSMTCSimulatedOperationProfile>& InProfiles);
+
+	/** Uses the Simulated Backend settings. */
+	static TSharedRef<FDreamSMTCSimulatedBackend, ESPMode::ThreadSafe> CreateFromSettings();
+
+	virtual const TCHAR* GetName() const override { return TEXT("Simulated"); }
+	virtual bool IsSimulated() const override { return true; }
+
+	virtual bool WriteSession(const FDreamSMTCSessionState& State, EDreamSMTCSessionField Fields, uint32 ButtonMask,
+	                          FString& OutError) override;
+	virtual bool WriteTimeline(const FDreamSMTCTimelineProperties& Timeline, FString& OutError) override;
+	virtual bool Update(FString& OutError) override;
+	virtual bool ClearAll(FString& OutError) override;
+
+	virtual bool SetThumbnailFromFile(const FString& FullPath, FString& OutError) override;
+	virtual TSharedPtr<FDreamSMTCPreparedThumbnail, ESPMode::ThreadSafe> PrepareThumbnail(
+		const TArray64<uint8>& Encoded, FString& OutError) override;
+	virtual bool SetPreparedThumbnail(const FDreamSMTCPreparedThumbnail& Prepared, FString& OutError) override;
+
+	virtual EDreamSMTCMediaSoundLevel GetSoundLevel() const override { return EDreamSMTCMediaSoundLevel::Full; }
+
+	virtual uint64 AddHandlers(FDreamSMTCBackendHandlers&& Handlers) override;
+	virtual void RemoveHandlers(uint64 HandlersId) override;
+
+	virtual bool Release(FString& OutError) override;
+
+	void SetProfile(EDreamSMTCBackendOperation Operation, const FDreamSMTCSimulatedOperationProfile& Profile);
+	FDreamSMTCSimulatedOperationProfile GetProfile(EDreamSMTCBackendOperation Operation) const;
+
+	/** Restarts the draws of every operation so a run can be repeated. */
+	void Reseed(int32 InSeed);
+
+	/** Presses Button Count times, IntervalMs apart, from a worker thread. */
+	void InjectButtonBurst(EDreamSMTCButtonEvent Button, int32 Count, float IntervalMs);
+
+	/** Sends Count seek requests spread evenly from From to To, IntervalMs apart, from a worker thread. */
+	void InjectSeekBurst(FTimespan From, FTimespan To, int32 Count, float IntervalMs);
+
+	/** What the OS would show: display fields and the thumbnail as of the last Update(), the rest as written. */
+	FDreamSMTCSessionState GetDisplayedState() const;
+
+	FOperationStats GetStats(EDreamSMTCBackendOperation Operation) const;
+	void ResetStats();
+
+	void Report(FOutputDevice& Ar) const;
+
+private:
+	using FHandlersRef = TSharedRef<const FDreamSMTCBackendHandlers, ESPMode::ThreadSafe>;
+
+	/** Blocks for the drawn latency and records the call. Returns false for a simulated failure. */
+	bool Simulate(EDreamSMTCBackendOperation Operation, FString& OutError);
+
+	TArray<FHandlersRef> GetHandlers() const;
+
+	void InjectBurst(int32 Count, float IntervalMs, TFunction<void(const FDreamSMTCBackendHandlers&, int32)>&& Fire);
+
+private:
+	mutable FCriticalSection Lock;
+
+	// 每个操作按自己的调用序号取随机数，与其它操作的调用顺序无关
+	int32 Seed = 0;
+	uint32 Draws[NumOperations] = {};
+	FDreamSMTCSimulatedOperationProfile DefaultProfile;
+	TMap<EDreamSMTCBackendOperation, FDreamSMTCSimulatedOperationProfile> Profiles;
+	FOperationStats Stats[NumOperations];
+
+	// 显示字段和封面在 Update 之前只写入 Pending
+	FDreamSMTCSessionState Pending;
+	FDreamSMTCSessionState Displayed;
+
+	TMap<uint64, FHandlersRef> Registrations;
+	uint64 NextHandlersId = 1;
+};
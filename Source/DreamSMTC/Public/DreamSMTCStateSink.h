@@ -0,0 +1,111 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "DreamSMTCSessionState.h"
+
+#include <atomic>
+
+/**
+ * One committed state change
+ * Built once per frame with changes and shared read-only by every sink, so it is never copied per sink.
+ */
+struct FDreamSMTCChangeSet
+{
+	// Session state after the change
+	FDreamSMTCSessionState State;
+	EDreamSMTCSessionField ChangedFields = EDreamSMTCSessionField::None;
+	// DreamSMTCButtonBit() values whose enable state flipped
+	uint32 ChangedButtons = 0;
+	// Increases by one per change set; the first one a sink receives holds the full state
+	uint64 Sequence = 0;
+	double Time = 0.0;
+};
+
+using FDreamSMTCChangeSetRef = TSharedRef<const FDreamSMTCChangeSet, ESPMode::ThreadSafe>;
+
+/** Thread a state sink is invoked on. */
+enum class EDreamSMTCSinkThread : uint8
+{
+	// Invoked inline from the game thread tick; keep it cheap
+	GameThread,
+	// Invoked on the thread pool from the sink's own queue, in order and one change set at a time
+	Worker,
+};
+
+/**
+ * Consumer of committed session state (OS controls, logs, analytics, overlays...)
+ */
+class IDreamSMTCStateSink
+{
+public:
+	virtual ~IDreamSMTCStateSink() = default;
+
+	virtual void OnStateChanged(const FDreamSMTCChangeSetRef& ChangeSet) = 0;
+};
+
+using FDreamSMTCStateSinkRef = TSharedRef<IDreamSMTCStateSink, ESPMode::ThreadSafe>;
+
+/**
+ * State sink registry
+ * Add, Remove and Dispatch are game thread only. Worker sinks are kept alive by their queue until it
+ * drains, and a sink removed while a change set is in flight can still receive that one change set.
+ */
+class DREAMSMTC_API FDreamSMTCStateSinkRegistry
+{
+public:
+	~FDreamSMTCStateSinkRegistry();
+
+	/** Registers Sink and delivers InitialState to it alone. */
+	void Add(const FDreamSMTCStateSinkRef& Sink, EDreamSMTCSinkThread Thread, const FDreamSMTCChangeSetRef& InitialState);
+
+	bool Remove(const FDreamSMTCStateSinkRef& Sink);
+
+	void Reset();
+
+	/** Hands ChangeSet to every sink. Never waits for a worker sink. */
+	void Dispatch(const FDreamSMTCChangeSetRef& ChangeSet);
+
+	bool HasSinks() const { return Entries.Num() > 0; }
+
+	/** Change sets queued for worker sinks and not yet consumed. */
+	int32 GetQueuedChangeSets() const;
+
+private:
+	struct FEntry
+	{
+		FEntry(const FDreamSMTCStateSinkRef& InSink, EDreamSMTCSinkThread InThread)
+			: Sink(InSink), Thread(InThread)
+		{
+		}
+
+		FDreamSMTCStateSinkRef Sink;
+		EDreamSMTCSinkThread Thread;
+
+		// 游戏线程写入，同一时刻只有一个工作线程任务读取
+		TQueue<TSharedPtr<const FDreamSMTCChangeSet, ESPMode::ThreadSafe>, EQueueMode::Spsc> Queue;
+		std::atomic<int32> Queued{0};
+		std::atomic<bool> bScheduled{false};
+		std::atomic<bool> bRemoved{false};
+	};
+
+	using FEntryRef = TSharedRef<FEntry, ESPMode::ThreadSafe>;
+
+	static void Deliver(const FEntryRef& Entry, const FDreamSMTCChangeSetRef& ChangeSet);
+	static void Drain(const FEntryRef& Entry);
+
+private:
+	TArray<FEntryRef> Entries;
+};
+
+/** Worker sink writing every change set to LogDreamSMTC as one line of JSON. */
+class DREAMSMTC_API FDreamSMTCLogStateSink : public IDreamSMTCStateSink
+{
+public:
+	virtual void OnStateChanged(const FDreamSMTCChangeSetRef& ChangeSet) override;
+};
+
+/** Comma separated names of the set fields, e.g. "PlaybackStatus,Timeline". */
+DREAMSMTC_API FString LexToString(EDreamSMTCSessionField Fields);
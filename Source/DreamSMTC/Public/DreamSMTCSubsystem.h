@@ -5,25 +5,45 @@
 #include "CoreMinimal.h"
 #include "Engine/Engine.h"
 #include "Subsystems/GameInstanceSubsystem.h"
+#include "Containers/Ticker.h"
+#include "Async/Future.h"
+
+#include <atomic>
 
-#include "DreamSMTCWindowsRuntimeInclude.h"
 #include "DreamSMTCLog.h"
+#include "DreamSMTCUpdateScheduler.h"
+#include "DreamSMTCCueTrack.h"
+#include "DreamSMTCButtonListeners.h"
+#include "DreamSMTCSessionState.h"
+#include "DreamSMTCRemoteServer.h"
+#include "DreamSMTCStateSink.h"
+#include "DreamSMTCListeningHistory.h"
+#include "DreamSMTCTimerWheel.h"
+#include "DreamSMTCSeqLock.h"
+#include "DreamSMTCShuffleSequencer.h"
+#include "DreamSMTCInput.h"
 #include "DreamSMTCSubsystem.generated.h"
 
 class UTexture2D;
+class UInputMappingContext;
+class ULevelSequencePlayer;
+class UDreamSMTCSequenceBinding;
 
 enum class EDreamSMTCMediaPlaybackType : uint8;
 enum class EDreamSMTCMediaSoundLevel : uint8;
 enum class EDreamSMTCButtonEvent : uint8;
+enum class EDreamSMTCAutoRepeatMode : uint8;
 
 struct FDreamSMTCTimelineProperties;
 struct FDreamSMTCMusicDisplayProperties;
 struct FDreamSMTCImageDisplayProperties;
 struct FDreamSMTCVideoDisplayProperties;
-
-
-using namespace winrt::Windows::Foundation;
-using namespace winrt::Windows::ApplicationModel::Core;
+struct FDreamSMTCCue;
+struct FDreamSMTCAsyncTiming;
+struct FDreamSMTCPreparedThumbnail;
+struct FDreamSMTCMemoryUsage;
+struct FDreamSMTCDebugSnapshot;
+class IDreamSMTCBackend;
 
 /**
  * System Media Transport Controls (SMTC) Subsystem
@@ -38,15 +58,40 @@ class DREAMSMTC_API UDreamSMTCSubsystem : public UGameInstanceSubsystem
 	GENERATED_BODY()
 
 public:
-	UDreamSMTCSubsystem();
-	virtual ~UDreamSMTCSubsystem() override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/**
+	 * The process-wide backend, created on first use: SMTC on Windows, FDreamSMTCSimulatedBackend when
+	 * bUseSimulatedBackend is set or SMTC is not available. Thread-safe. Null after the last session released it,
+	 * until the next session initializes, so late worker tasks cannot recreate it.
+	 */
+	static TSharedPtr<IDreamSMTCBackend, ESPMode::ThreadSafe> GetBackend();
 
-	static winrt::Windows::Media::SystemMediaTransportControls GetSystemMediaTransportControls();
-	static winrt::Windows::Media::SystemMediaTransportControlsDisplayUpdater
-	GetSystemMediaTransportControlsDisplayUpdater();
+	/** Waits for shutdown work that outlived ShutdownTimeout. Called when the module unloads. */
+	static void WaitForDetachedShutdownWork();
+
+	/** Adds the memory held by this session to Usage. Disk caches are measured by FDreamSMTCMemoryTracker. */
+	void GetMemoryUsage(FDreamSMTCMemoryUsage& Usage) const;
+
+	/** Copies the session mirror, pending writes and scheduler counters for the debug panel. */
+	void GetDebugSnapshot(FDreamSMTCDebugSnapshot& OutSnapshot) const;
 
 public:
 	DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FButtonPressed, EDreamSMTCButtonEvent, ButtonEvent);
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FPlaybackPositionChangeRequested, FTimespan, Position);
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FPlaybackRateChangeRequested, double, PlaybackRate);
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FShuffleEnabledChangeRequested, bool, bShuffleEnabled);
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FAutoRepeatModeChangeRequested, EDreamSMTCAutoRepeatMode, AutoRepeatMode);
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FCueChanged, int32, CueIndex, const FDreamSMTCCue&, Cue);
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FQueueTrackChanged, int32, TrackIndex);
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FIdleStateChanged, bool, bIdle);
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FSessionSwitchCommitted, int32, SwitchId, float, LateMilliseconds);
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FSessionSwitchFailed, int32, SwitchId, const FString&, Error);
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FSessionOwnershipChanged, bool, bOwner);
+
+	/** Called on the game thread once the OS accepted (or rejected) an async request; fails if the session shut down. */
+	using FAsyncCallback = TFunction<void(bool bSuccess, const FDreamSMTCAsyncTiming& Timing, const FString& Error)>;
 
 public:
 	UFUNCTION(BlueprintCallable, Category = "DreamSMTC")
@@ -55,6 +100,13 @@ public:
 	UFUNCTION(BlueprintPure, Category = "DreamSMTC")
 	bool GetAutoRepeatMode() const;
 
+	/** Sets None, Track or List repeat. Also drives the play queue. */
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC")
+	void SetAutoRepeat(EDreamSMTCAutoRepeatMode Mode);
+
+	UFUNCTION(BlueprintPure, Category = "DreamSMTC")
+	EDreamSMTCAutoRepeatMode GetAutoRepeat() const;
+
 	UFUNCTION(BlueprintCallable, Category = "DreamSMTC")
 	void SetIsChannelDownEnabled(bool bEnable);
 
@@ -68,7 +120,7 @@ public:
 	bool GetIsChannelUpEnabled() const;
 
 	UFUNCTION(BlueprintCallable, Category = "DreamSMTC")
-	void SetEnabled(bool bEnable) const;
+	void SetEnabled(bool bEnable);
 
 	UFUNCTION(BlueprintPure, Category = "DreamSMTC")
 	bool IsEnabled() const;
@@ -121,6 +173,17 @@ public:
 	UFUNCTION(BlueprintPure, Category = "DreamSMTC")
 	bool GetStopEnabled() const;
 
+	/**
+	 * Enables exactly the buttons in ButtonMask (bit N = EDreamSMTCButtonEvent value N) in one batch.
+	 * Only the buttons whose state changed are written to the OS.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC")
+	void SetEnabledButtons(
+		UPARAM(meta = (Bitmask, BitmaskEnum = "/Script/DreamSMTC.EDreamSMTCButtonEvent")) int32 ButtonMask);
+
+	UFUNCTION(BlueprintPure, Category = "DreamSMTC")
+	UPARAM(meta = (Bitmask, BitmaskEnum = "/Script/DreamSMTC.EDreamSMTCButtonEvent")) int32 GetEnabledButtons() const;
+
 	UFUNCTION(BlueprintCallable, Category = "DreamSMTC")
 	void SetPlaybackRate(double Rate);
 
@@ -185,6 +248,10 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|DisplayUpdater")
 	void Update();
 
+	/** Commits every pending write now, ignoring the call budget. */
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|DisplayUpdater")
+	void FlushPendingUpdates();
+
 public:
 	// UFUNCTION(BlueprintCallable, Category = "DreamSMTC|DisplayUpdater")
 	// void UpdateSMTC(FString Title);
@@ -193,33 +260,487 @@ public:
 	UPROPERTY(BlueprintAssignable, Category = "DreamSMTC|Event")
 	FButtonPressed ButtonPressed;
 
+	// Doc : https://learn.microsoft.com/zh-cn/uwp/api/windows.media.systemmediatransportcontrols.playbackpositionchangerequested?view=winrt-26100
+	// Scrubbing is coalesced: only the latest requested position of each frame is broadcast.
+	UPROPERTY(BlueprintAssignable, Category = "DreamSMTC|Event")
+	FPlaybackPositionChangeRequested PlaybackPositionChangeRequested;
+
+	// Doc : https://learn.microsoft.com/zh-cn/uwp/api/windows.media.systemmediatransportcontrols.playbackratechangerequested?view=winrt-26100
+	UPROPERTY(BlueprintAssignable, Category = "DreamSMTC|Event")
+	FPlaybackRateChangeRequested PlaybackRateChangeRequested;
+
+	// Doc : https://learn.microsoft.com/zh-cn/uwp/api/windows.media.systemmediatransportcontrols.shuffleenabledchangerequested?view=winrt-26100
+	UPROPERTY(BlueprintAssignable, Category = "DreamSMTC|Event")
+	FShuffleEnabledChangeRequested ShuffleEnabledChangeRequested;
+
+	// Doc : https://learn.microsoft.com/zh-cn/uwp/api/windows.media.systemmediatransportcontrols.autorepeatmodechangerequested?view=winrt-26100
+	UPROPERTY(BlueprintAssignable, Category = "DreamSMTC|Event")
+	FAutoRepeatModeChangeRequested AutoRepeatModeChangeRequested;
+
+	/**
+	 * Registers a native C++ button listener, bypassing UFunction reflection.
+	 * ButtonMask is a combination of DreamSMTCButtonBit() values. CallbackThread listeners run on the OS
+	 * callback thread in the same call that received the event and must be thread-safe.
+	 */
+	FDelegateHandle AddNativeButtonListener(FDreamSMTCNativeButtonDelegate&& Delegate,
+	                                        uint32 ButtonMask = DreamSMTCAllButtons,
+	                                        EDreamSMTCListenerThread Thread = EDreamSMTCListenerThread::GameThread);
+
+	bool RemoveNativeButtonListener(FDelegateHandle Handle);
+
+	void RemoveNativeButtonListeners(const void* UserObject);
+
+	/** Number of seek requests replaced by a newer one before they reached the game thread. */
+	UFUNCTION(BlueprintPure, Category = "DreamSMTC|Event")
+	int64 GetCoalescedSeekRequestCount() const;
+
+	/**
+	 * Stages a track switch (music properties, timeline and thumbnail) to be committed later in one step.
+	 * The thumbnail is read back, encoded and copied into an OS stream right away, so the commit only
+	 * hands prepared objects to the OS. Returns the switch id.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Schedule")
+	int32 StageMusicSwitch(FDreamSMTCMusicDisplayProperties Music, FDreamSMTCTimelineProperties Timeline,
+	                       UTexture2D* InThumbnail);
+
+	/** Stages any subset of the session. Only Fields of State are committed; the thumbnail comes from InThumbnail. */
+	int32 StageSessionSwitch(const FDreamSMTCSessionState& State, EDreamSMTCSessionField Fields,
+	                         UTexture2D* InThumbnail = nullptr);
+
+	/**
+	 * Commits a staged switch when the current track reaches Position, extrapolated from the last timeline
+	 * and playback rate. Follows seeks, pauses and rate changes until it fires.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Schedule")
+	bool ScheduleSwitchAtPosition(int32 SwitchId, FTimespan Position);
+
+	/** Commits a staged switch at AudioTime on the caller's audio clock, which reads CurrentAudioTime now. Call again to correct drift. */
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Schedule")
+	bool ScheduleSwitchAtAudioTime(int32 SwitchId, double AudioTime, double CurrentAudioTime);
+
+	/** Returns false if the switch is unknown or its commit is already under way. */
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Schedule")
+	bool CancelSwitch(int32 SwitchId);
+
+	/** Broadcast after a scheduled switch reached the OS. LateMilliseconds is measured against its deadline. */
+	UPROPERTY(BlueprintAssignable, Category = "DreamSMTC|Event")
+	FSessionSwitchCommitted SessionSwitchCommitted;
+
+	/** Broadcast when the OS rejected a scheduled switch. The switch is dropped and the session keeps its fields. */
+	UPROPERTY(BlueprintAssignable, Category = "DreamSMTC|Event")
+	FSessionSwitchFailed SessionSwitchFailed;
+
+	/** Play time, skips and button usage over the last WithinSeconds, from the in-memory listening history. */
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|History")
+	FDreamSMTCListeningSummary GetListeningSummary(float WithinSeconds = 3600.0f) const;
+
+	/**
+	 * True while playback is paused, stopped or closed (or the window is unfocused, see bIdleWhenUnfocused).
+	 * The subsystem then runs no ticker and defers timeline pushes until playback resumes; it wakes
+	 * only for OS callbacks and explicit calls. Callers can stop their own periodic updates as well.
+	 */
+	UFUNCTION(BlueprintPure, Category = "DreamSMTC|Idle")
+	bool IsIdle() const { return Callbacks->bIdle.load(std::memory_order_relaxed); }
+
+	UPROPERTY(BlueprintAssignable, Category = "DreamSMTC|Event")
+	FIdleStateChanged IdleStateChanged;
+
+	/**
+	 * With several game instances in one process (PIE clients), only one owns the OS controls.
+	 * The others keep their state locally and receive no buttons until they become the owner, which
+	 * goes to the highest priority, then to the instance whose window was focused last.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Session")
+	void SetSessionPriority(int32 Priority);
+
+	UFUNCTION(BlueprintPure, Category = "DreamSMTC|Session")
+	int32 GetSessionPriority() const { return SessionPriority; }
+
+	UFUNCTION(BlueprintPure, Category = "DreamSMTC|Session")
+	bool IsSessionOwner() const { return IsBackendOwner(); }
+
+	/**
+	 * The PIE instance of this game instance, 0 in a packaged game. Keys the session snapshot, the listening
+	 * history and the remote control port, so PIE clients do not share files or fight over one port.
+	 */
+	UFUNCTION(BlueprintPure, Category = "DreamSMTC|Session")
+	int32 GetInstanceIndex() const { return InstanceIndex; }
+
+	UPROPERTY(BlueprintAssignable, Category = "DreamSMTC|Event")
+	FSessionOwnershipChanged SessionOwnershipChanged;
+
+	/**
+	 * Shows a cinematic as video (Display) and follows Player: play, pause, stop, jumps and loops update the
+	 * timeline, and Play, Pause, Stop, seek and rate requests control the player. Replaces any previous binding.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Sequence")
+	UDreamSMTCSequenceBinding* BindSequencePlayer(ULevelSequencePlayer* Player, FDreamSMTCVideoDisplayProperties Display);
+
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Sequence")
+	void UnbindSequencePlayer();
+
 	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Time")
 	void SetUpdateTimelineProperties(FDreamSMTCTimelineProperties TimelineProperties);
 
 	UFUNCTION(BlueprintPure, Category = "DreamSMTC|Time")
 	FDreamSMTCTimelineProperties GetTimelineProperties() const;
-	
+
+	/**
+	 * Thread-safe and lock-free. Publishes the timeline from any thread (e.g. the audio render thread);
+	 * the game thread applies the latest value on its next tick. Calling SetUpdateTimelineProperties
+	 * off the game thread does the same.
+	 */
+	void PublishTimelineProperties(const FDreamSMTCTimelineProperties& TimelineProperties);
+
+	/** Thread-safe and lock-free counterpart of SetPlaybackStatus and SetPlaybackRate. */
+	void PublishPlaybackState(EDreamSMTCMediaPlaybackStatus Status, double Rate);
+
+	/** Latest timeline and playback state, readable from any thread without tearing. */
+	const TDreamSMTCSeqLock<FDreamSMTCPlaybackSnapshot>& GetPlaybackPublication() const { return PlaybackPublication; }
+
+	const FDreamSMTCUpdateScheduler& GetUpdateScheduler() const { return UpdateScheduler; }
+
+	/**
+	 * Registers a consumer of the committed session state. Each frame with changes produces one immutable
+	 * FDreamSMTCChangeSet that is shared by every sink; a new sink first receives the full state.
+	 * Worker sinks run on the thread pool from their own queue and never block the game thread.
+	 */
+	void AddStateSink(const FDreamSMTCStateSinkRef& Sink, EDreamSMTCSinkThread Thread = EDreamSMTCSinkThread::Worker);
+
+	bool RemoveStateSink(const FDreamSMTCStateSinkRef& Sink);
+
+	const FDreamSMTCStateSinkRegistry& GetStateSinks() const { return StateSinks; }
+
+	/** Mirror of everything this subsystem sent to the OS. */
+	const FDreamSMTCSessionState& GetSessionState() const { return Session; }
+
+	/** Reads back, encodes and publishes the thumbnail without blocking the game thread. */
+	void SetThumbnailAsync(UTexture2D* InThumbnail, FAsyncCallback&& OnDone = nullptr);
+
+	/** Commits every pending write on a worker thread. Fails when another session owns the OS media controls. */
+	void CommitAsync(FAsyncCallback&& OnDone = nullptr);
+
+public:
+	/** Loads LRC lyrics. The active line follows the position passed to SetUpdateTimelineProperties. */
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|CueTrack")
+	bool LoadCueTrackFromLrc(const FString& Lrc);
+
+	/** Loads a chapter list, one "[hh:]mm:ss Title[ - Subtitle]" entry per line. */
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|CueTrack")
+	bool LoadCueTrackFromChapters(const FString& Chapters);
+
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|CueTrack")
+	void SetCueTrack(const TArray<FDreamSMTCCue>& Cues);
+
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|CueTrack")
+	void ClearCueTrack();
+
+	UFUNCTION(BlueprintPure, Category = "DreamSMTC|CueTrack")
+	int32 GetActiveCueIndex() const;
+
+	UFUNCTION(BlueprintPure, Category = "DreamSMTC|CueTrack")
+	bool GetActiveCue(FDreamSMTCCue& OutCue) const;
+
+	/** Fired only when the active cue changes. CueIndex is INDEX_NONE before the first cue. */
+	UPROPERTY(BlueprintAssignable, Category = "DreamSMTC|Event")
+	FCueChanged CueChanged;
+
+	/**
+	 * When set, the active cue replaces the title and subtitle (artist for music) shown by the OS.
+	 * The fields set before the track was loaded come back between cues and when the track is cleared.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DreamSMTC|CueTrack")
+	bool bCueTrackUpdatesDisplay = true;
+
+public:
+	/**
+	 * Starts a play queue of NumTracks entries at StartTrack. While the queue is set, Next and Previous
+	 * button presses move through it in shuffle/repeat order before ButtonPressed is broadcast.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Queue")
+	void SetPlayQueue(int32 NumTracks, int32 StartTrack = 0);
+
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Queue")
+	void ClearPlayQueue();
+
+	/** Current track index in the play queue, INDEX_NONE without a queue. */
+	UFUNCTION(BlueprintPure, Category = "DreamSMTC|Queue")
+	int32 GetQueueTrack() const;
+
+	/** Track the next skip moves to, INDEX_NONE at the end of the queue. */
+	UFUNCTION(BlueprintPure, Category = "DreamSMTC|Queue")
+	int32 PeekNextQueueTrack() const;
+
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Queue")
+	bool SkipToNextTrack();
+
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Queue")
+	bool SkipToPreviousTrack();
+
+	/** Call when the current track ends on its own; honours Track repeat. */
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Queue")
+	bool NotifyTrackFinished();
+
+	UFUNCTION(BlueprintCallable, Category = "DreamSMTC|Queue")
+	void JumpToQueueTrack(int32 TrackIndex);
+
+	/** Fired whenever the play queue moves to another track. */
+	UPROPERTY(BlueprintAssignable, Category = "DreamSMTC|Event")
+	FQueueTrackChanged QueueTrackChanged;
+
+	/** When set, Next and Previous button presses move the play queue. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "DreamSMTC|Queue")
+	bool bQueueHandlesNextPrevious = true;
+
 private:
-	TObjectPtr<UTexture2D> Thumbnail = nullptr;
+	void BroadcastQueueTrack(bool bMoved);
+
+	void BeginCueTrack();
+	void AdvanceCueTrack(FTimespan Position);
+	void ApplyActiveCue();
+
+	void RegisterChangeRequestHandlers();
+	void UnregisterChangeRequestHandlers(double Deadline);
+	void DispatchCoalescedSeekRequest();
+
+private:
+	friend class FDreamSMTCSessionManager;
+
+	/** Called by the session manager. Gaining ownership pushes the whole local session to the OS. */
+	void SetBackendOwner(bool bOwner);
+	bool IsBackendOwner() const { return ThumbnailJobs->bBackendOwner.load(); }
+	void PushSessionToBackend();
+
+	bool Tick(float DeltaTime);
+	/** Hands the queue depths to FDreamSMTCHitchDetector for hitch reports. */
+	void PublishQueueDepths(double Now) const;
+
+	bool ShouldIdle() const;
+	bool HasPendingWork() const;
+	void UpdateIdleState();
+	/** Thread-safe. Re-evaluates the idle state on the game thread. */
+	void RequestWake() { Callbacks->RequestWake(); }
+	void OnApplicationActivationChanged(bool bActive);
+
+	void EnqueueWrite(EDreamSMTCPendingWrite Writes, EDreamSMTCUpdatePriority Priority);
+
+	/** Releases the backend on a worker thread once the last session is gone. */
+	TFuture<bool> ReleaseBackendAsync();
+
+	void ApplyTimelineProperties(const FDreamSMTCTimelineProperties& TimelineProperties, double SampleTime);
+	void ConsumePlaybackPublication();
+	void CommitPendingWrites(EDreamSMTCPendingWrite Writes);
+
+	static bool CommitToBackend(EDreamSMTCPendingWrite Writes, const FDreamSMTCTimelineProperties& Timeline,
+	                            FString& OutError);
+
+	void WriteSessionFields(EDreamSMTCSessionField Fields, uint32 ButtonMask = DreamSMTCAllButtons);
+
+	void SetButtonEnabled(EDreamSMTCButtonEvent Button, bool bEnable);
+	bool IsButtonEnabled(EDreamSMTCButtonEvent Button) const;
+
+	/** Position-only changes mark the session dirty without restarting the save debounce. */
+	void MarkSessionChanged(bool bPositionOnly = false);
+	void TickSessionPersistence(double Now);
+	void RestoreSession();
 
-	FTimespan WinRTToUnrealTimespan(const winrt::Windows::Foundation::TimeSpan& WinRTTime)
+	void DispatchStateChanges();
+	FDreamSMTCChangeSetRef MakeChangeSet(EDreamSMTCSessionField Fields, uint32 ChangedButtons);
+
+	void StartRemoteServer();
+	void TickRemoteServer();
+	void DispatchButtonOnGameThread(EDreamSMTCButtonEvent Button);
+
+	/**
+	 * State the OS callbacks and the remote server touch on their own threads
+	 * They capture this block instead of the subsystem, so a callback that is still running after Deinitialize only
+	 * reaches memory it keeps alive itself. The subsystem is only reached through Owner on the game thread.
+	 */
+	struct FCallbackState
+	{
+		// Initialize 中设置，只在游戏线程解引用
+		TWeakObjectPtr<UDreamSMTCSubsystem> Owner;
+
+		std::atomic<bool> bAcceptingRequests{false};
+		// 正在调用本地监听者的回调，注销后等待它们结束
+		std::atomic<int32> HandlersInFlight{0};
+
+		// 拖动进度条时系统会连续发送请求，只保留最新值，每帧最多派发一次
+		std::atomic<int64> PendingSeekTicks{0};
+		std::atomic<bool> bSeekPending{false};
+		std::atomic<int64> CoalescedSeekRequests{0};
+
+		// 空闲时移除 Ticker，有待处理的工作或恢复播放时再添加；只有游戏线程写入
+		std::atomic<bool> bIdle{false};
+		std::atomic<bool> bWakeRequested{false};
+
+		FDreamSMTCButtonListenerRegistry NativeButtonListeners;
+
+		// 按钮与远程命令写入，Tick 开始时注入玩家输入；bInjectMediaKeys 在注册回调前设置
+		FDreamSMTCInput MediaKeys;
+		bool bInjectMediaKeys = false;
+
+		/** Thread-safe. Re-evaluates the owner's idle state on the game thread. */
+		void RequestWake();
+
+		/** Thread-safe. Queues the press for injection and wakes the owner if it is idle. */
+		void EnqueueMediaKey(EDreamSMTCButtonEvent Button);
+	};
+
+	struct FThumbnailJobs
 	{
-		// 获取 WinRT 的 100 纳秒单位值
-		int64_t WinRTTicks = WinRTTime.count();
-		// 转换为微秒：除以 10
-		int64_t UnrealTicks = WinRTTicks / 10;
-		// 构造 Unreal 的 FTimespan
-		return FTimespan(UnrealTicks);
-	}
-
-	winrt::Windows::Foundation::TimeSpan UnrealToWinRTTimespan(const FTimespan& UnrealTime)
+		// 每次 SetThumbnail 递增，旧任务据此放弃
+		std::atomic<uint64> Generation{0};
+		// 检查代数与提交图片在同一把锁内，旧任务不会覆盖新图片
+		FCriticalSection ApplyLock;
+		// 只有持有系统控件的会话写入后端，在 ApplyLock 内修改；放在这里是因为工作线程与定时器线程也要检查
+		std::atomic<bool> bBackendOwner{false};
+		// 已提交完整图片的代数，在 ApplyLock 内读写；之后到达的同代占位图不再覆盖它
+		uint64 FullAppliedGeneration = 0;
+		// Initialize 时设置，工作线程只复制它，交回游戏线程后再解析
+		TWeakObjectPtr<UDreamSMTCSubsystem> Owner;
+
+		/** Supersedes every job in flight. The bump happens under ApplyLock so no job sets its image afterwards. */
+		uint64 Invalidate()
+		{
+			FScopeLock Lock(&ApplyLock);
+			return ++Generation;
+		}
+	};
+
+	/**
+	 * A placeholder is skipped, and reported as applied, once the full image of its generation is shown.
+	 * The image is staged on the backend here; the commit itself goes through the update scheduler.
+	 */
+	static bool ApplyThumbnailIfCurrent(FThumbnailJobs& Jobs, uint64 Generation,
+	                                    const FDreamSMTCSessionState::FEncodedImage& Encoded, bool bPlaceholder,
+	                                    FString& OutError);
+
+	struct FStagedSwitch
+	{
+		int32 Id = INDEX_NONE;
+		// 暂存后不再修改，定时器线程直接读取
+		FDreamSMTCSessionState State;
+		EDreamSMTCSessionField Fields = EDreamSMTCSessionField::None;
+		TWeakObjectPtr<UTexture2D> Texture;
+
+		// 工作线程写入，定时器线程与游戏线程读取
+		FCriticalSection ThumbnailLock;
+		TSharedPtr<FDreamSMTCPreparedThumbnail, ESPMode::ThreadSafe> PreparedThumbnail;
+		TSharedPtr<const FDreamSMTCSessionState::FEncodedImage, ESPMode::ThreadSafe> EncodedThumbnail;
+
+		// 定时器线程在提交时写入，结果回到游戏线程后读取；封面晚于提交才解码完成时保持为空
+		TSharedPtr<const FDreamSMTCSessionState::FEncodedImage, ESPMode::ThreadSafe> CommittedThumbnail;
+
+		// 游戏线程
+		uint64 TimerId = 0;
+		TOptional<FTimespan> Position;
+		double Deadline = 0.0;
+	};
+
+	using FStagedSwitchRef = TSharedRef<FStagedSwitch, ESPMode::ThreadSafe>;
+
+	void ArmSwitch(const FStagedSwitchRef& Switch, double Deadline);
+	void RearmPositionSwitches();
+	TOptional<double> GetPositionDeadline(FTimespan Position) const;
+	void OnSwitchCommitted(const FStagedSwitchRef& Switch, double CommitTime, bool bSuccess, const FString& Error);
+	static bool CommitSwitchToBackend(FStagedSwitch& Switch, FThumbnailJobs& Jobs, FString& OutError);
+
+	static void FinishAsync(TWeakObjectPtr<UDreamSMTCSubsystem> WeakThis, FAsyncCallback&& OnDone, bool bSuccess,
+	                        double RequestTime, double WorkStartTime, double WorkEndTime, FString&& Error);
+
+private:
+	TObjectPtr<UTexture2D> Thumbnail = nullptr;
+
+	TSharedRef<FThumbnailJobs, ESPMode::ThreadSafe> ThumbnailJobs = MakeShared<FThumbnailJobs, ESPMode::ThreadSafe>();
+
+	// 最近用过的封面的占位图，切回这些封面时无需等待回读
+	static constexpr int32 MaxCachedPlaceholders = 16;
+	TArray<TPair<TWeakObjectPtr<UTexture2D>, TSharedPtr<const FDreamSMTCSessionState::FEncodedImage, ESPMode::ThreadSafe>>>
+	PlaceholderCache;
+
+	FDreamSMTCSessionState Session;
+	bool bSessionDirty = false;
+	double LastSessionChangeTime = 0.0;
+	// 第一次未保存的变更，超过 SessionSaveMaxDelay 时不再等待防抖
+	double FirstUnsavedChangeTime = 0.0;
+	// 自上次保存以来有进度之外的变更
+	bool bSessionFieldsChanged = false;
+	TFuture<bool> SessionSaveTask;
+
+	FDreamSMTCUpdateScheduler UpdateScheduler;
+	FTSTicker::FDelegateHandle TickerHandle;
+
+	TSharedRef<FCallbackState, ESPMode::ThreadSafe> Callbacks = MakeShared<FCallbackState, ESPMode::ThreadSafe>();
+
+	// 只在 Initialize 与 Deinitialize 之间添加 Ticker
+	bool bInitialized = false;
+	bool bApplicationActive = true;
+	// 空闲期间的进度刷新只记录在 Session 中，恢复时一次性推送
+	bool bTimelineDeferred = false;
+	FDelegateHandle ApplicationActivationHandle;
+
+	// 任意线程写入，游戏线程在 Tick 中消费
+	TDreamSMTCSeqLock<FDreamSMTCPlaybackSnapshot> PlaybackPublication;
+	uint64 ConsumedPlaybackSequence = 0;
+
+	FDreamSMTCCueTrack CueTrack;
+	// 设置轨道时的标题与副标题，没有活动的提示或清除轨道时恢复；类型为 Unknown 表示未保存
+	FDreamSMTCCue CueBaseDisplay;
+	EDreamSMTCMediaPlaybackType CueBaseType = EDreamSMTCMediaPlaybackType::Unknown;
+	bool bApplyingCue = false;
+
+	FDreamSMTCShuffleSequencer PlayQueue;
+
+	UPROPERTY()
+	TObjectPtr<UInputMappingContext> MediaKeyMappingContext = nullptr;
+
+	UPROPERTY()
+	TObjectPtr<UDreamSMTCSequenceBinding> SequenceBinding = nullptr;
+
+	FDreamSMTCStateSinkRegistry StateSinks;
+	// 接收者最后一次收到的状态，每帧只与它做一次比较
+	FDreamSMTCSessionState SinkBaseline;
+	uint64 ChangeSetSequence = 0;
+	bool bSinkStateDirty = false;
+	TSharedPtr<FDreamSMTCLogStateSink, ESPMode::ThreadSafe> LogSink;
+
+	TSharedPtr<FDreamSMTCRemoteServer, ESPMode::ThreadSafe> RemoteServer;
+
+	TUniquePtr<FDreamSMTCListeningHistory> ListeningHistory;
+
+	TSharedRef<FDreamSMTCTimerWheel, ESPMode::ThreadSafe> SwitchTimers =
+		MakeShared<FDreamSMTCTimerWheel, ESPMode::ThreadSafe>();
+	TMap<int32, FStagedSwitchRef> StagedSwitches;
+	int32 NextSwitchId = 0;
+	// 由最后一次进度、播放状态与速率推算当前进度，单位为秒
+	struct FTimelineClock
 	{
-		// 获取 Unreal 的微秒值
-		int64_t UnrealTicks = UnrealTime.GetTicks();
-		// 转换为 100 纳秒单位：乘以 10
-		int64_t WinRTTicks = UnrealTicks * 10;
-		// 构造 WinRT 的 TimeSpan
-		winrt::Windows::Foundation::TimeSpan WinRTTime(WinRTTicks);
-		return WinRTTime;
-	}
+		double Position = 0.0;
+		double Time = 0.0;
+		// 未在播放时为 0
+		double Rate = 0.0;
+
+		double Sample(double Now) const { return Position + (Now - Time) * Rate; }
+
+		void SetRate(double InRate, double Now)
+		{
+			Position = Sample(Now);
+			Time = Now;
+			Rate = InRate;
+		}
+	};
+
+	FTimelineClock TimelineClock;
+
+	TSharedPtr<IDreamSMTCBackend, ESPMode::ThreadSafe> HandlersBackend;
+	uint64 HandlersId = 0;
+
+	int32 SessionPriority = 0;
+	int32 InstanceIndex = 0;
+	// 超过 ShutdownTimeout 仍未完成的关闭任务，游戏线程
+	static TArray<TFuture<bool>> DetachedShutdownWork;
+
+	// 游戏线程
+	int64 DispatchedSeekRequests = 0;
 };
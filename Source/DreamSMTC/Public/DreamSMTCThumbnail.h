@@ -0,0 +1,46 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UTexture2D;
+
+/** Encoded image already copied into a backend stream, see DreamSMTCBackend.h. */
+struct FDreamSMTCPreparedThumbnail;
+
+/**
+ * Thumbnail pipeline helpers
+ * Readback runs on the render thread, encoding and the backend hand-off run on worker threads,
+ * so none of these steps block the game thread.
+ */
+class DREAMSMTC_API FDreamSMTCThumbnail
+{
+public:
+	using FOnPixelsReady = TFunction<void(TArray<FColor>&& Pixels, FIntPoint Size)>;
+
+	/**
+	 * Reads the top resident mip back from the GPU. OnReady is called on the render thread.
+	 * Block-compressed textures (DXT/BC) are first drawn into a temporary uncompressed render target.
+	 */
+	static bool ReadPixelsAsync(UTexture2D* Texture, FOnPixelsReady&& OnReady);
+
+	/** Encodes BGRA pixels as JPEG. Safe to call from any thread once the ImageWrapper module is loaded. */
+	static bool Encode(const TArray<FColor>& Pixels, FIntPoint Size, int32 Quality, TArray64<uint8>& OutEncoded);
+
+	/**
+	 * Box-filters the image down so neither side exceeds MaxSize, keeping its aspect ratio, e.g. for a placeholder.
+	 * Accumulates whole pixels in SIMD registers. Safe to call from any thread.
+	 */
+	static void Downsample(const TArray<FColor>& Pixels, FIntPoint Size, int32 MaxSize, TArray<FColor>& OutPixels,
+	                       FIntPoint& OutSize);
+
+	/** Copies the encoded image into an in-memory OS stream ahead of time. Blocking, call from a worker thread. */
+	static TSharedPtr<FDreamSMTCPreparedThumbnail, ESPMode::ThreadSafe> Prepare(const TArray64<uint8>& Encoded,
+	                                                                           FString& OutError);
+
+	/** Sets a prepared image on the display updater without blocking. The caller commits it with Update(). */
+	static bool SetPrepared(const FDreamSMTCPreparedThumbnail& Prepared, FString& OutError);
+
+	static FString GetCacheDirectory();
+};
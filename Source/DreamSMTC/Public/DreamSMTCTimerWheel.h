@@ -0,0 +1,88 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "HAL/Runnable.h"
+
+#include <atomic>
+
+class FRunnableThread;
+class FEvent;
+
+/**
+ * Hashed timer wheel with 1 ms slots, serviced by its own thread
+ * The thread sleeps until shortly before the next deadline and yields through the last SpinSeconds,
+ * so callbacks run within about a millisecond of their deadline regardless of the game frame rate.
+ * The thread is only started when the first timer is scheduled. Callbacks run on the wheel thread,
+ * in deadline order, outside the lock; they may schedule or cancel timers.
+ * Must be owned by a thread-safe shared reference: a thread stuck in a callback at shutdown keeps it alive.
+ */
+class DREAMSMTC_API FDreamSMTCTimerWheel : public FRunnable,
+                                           public TSharedFromThis<FDreamSMTCTimerWheel, ESPMode::ThreadSafe>
+{
+public:
+	/** FiredTime is the FPlatformTime::Seconds() the callback was invoked at. */
+	using FTimerCallback = TFunction<void(double FiredTime)>;
+
+	static constexpr int32 NumSlots = 256;
+	static constexpr double SlotSeconds = 0.001;
+	static constexpr double SpinSeconds = 0.002;
+
+	FDreamSMTCTimerWheel() = default;
+	virtual ~FDreamSMTCTimerWheel() override;
+
+	/** Thread-safe. Deadline is in FPlatformTime::Seconds(); past deadlines fire immediately. Returns the timer id. */
+	uint64 Schedule(double Deadline, FTimerCallback&& Callback);
+
+	/** Thread-safe. Returns false if the timer already fired or was cancelled. */
+	bool Reschedule(uint64 TimerId, double Deadline);
+
+	/** Thread-safe. Returns false if the timer already fired or was cancelled. */
+	bool Cancel(uint64 TimerId);
+
+	/**
+	 * Stops the thread and drops pending timers, waiting at most Timeout seconds for a callback in progress.
+	 * When the callback outlives it, the returned future completes once the thread exited; otherwise it is invalid.
+	 */
+	TFuture<bool> Shutdown(double Timeout);
+
+	int32 Num() const;
+
+	SIZE_T GetAllocatedSize() const;
+
+protected:
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	struct FTimer
+	{
+		uint64 Id = 0;
+		double Deadline = 0.0;
+		FTimerCallback Callback;
+	};
+
+	static int64 ToTick(double Seconds) { return static_cast<int64>(Seconds / SlotSeconds); }
+
+	void Insert(FTimer&& Timer);
+	bool Extract(uint64 TimerId, FTimer& OutTimer);
+	double GetNextDeadline() const;
+	void CollectDue(double Now, TArray<FTimer>& OutDue);
+	void ReleaseThread();
+
+private:
+	mutable FCriticalSection Lock;
+	TArray<FTimer> Slots[NumSlots];
+	// 定时器所在的槽位，用于取消与重新调度
+	TMap<uint64, int32> SlotOfTimer;
+	int64 CurrentTick = 0;
+	uint64 NextTimerId = 1;
+
+	FRunnableThread* Thread = nullptr;
+	FEvent* WakeEvent = nullptr;
+	// Run 返回前触发，关闭时据此有限等待
+	FEvent* ExitedEvent = nullptr;
+	std::atomic<bool> bStopping{false};
+};
@@ -70,7 +70,7 @@ public:
 	FString AlbumTitle;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	int32 AlbumTrackCount;
+	int32 AlbumTrackCount = 0;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	FString Artist;
@@ -82,7 +82,7 @@ public:
 	FString Title;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	int32 TrackNumber;
+	int32 TrackNumber = 0;
 };
 
 USTRUCT(BlueprintType)
@@ -121,6 +121,14 @@ enum class EDreamSMTCMediaPlaybackType : uint8
 };
 
 UENUM(BlueprintType)
+enum class EDreamSMTCAutoRepeatMode : uint8
+{
+	None = 0,
+	Track = 1,
+	List = 2,
+};
+
+UENUM(BlueprintType, meta = (Bitflags))
 enum class EDreamSMTCButtonEvent : uint8
 {
 	Play = 0,
@@ -150,6 +158,17 @@ public:
 		  MinSeekTime(InMinSeekTime)
 	{
 	}
+
+	bool operator==(const FDreamSMTCTimelineProperties& Other) const
+	{
+		return StartTime == Other.StartTime && EndTime == Other.EndTime && Position == Other.Position &&
+			MaxSeekTime == Other.MaxSeekTime && MinSeekTime == Other.MinSeekTime;
+	}
+
+	bool operator!=(const FDreamSMTCTimelineProperties& Other) const
+	{
+		return !(*this == Other);
+	}
 public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	FTimespan StartTime;
@@ -166,3 +185,160 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	FTimespan MinSeekTime;
 };
+
+USTRUCT(BlueprintType)
+struct FDreamSMTCCue
+{
+	GENERATED_BODY()
+public:
+	FDreamSMTCCue()
+	{
+	}
+
+	FDreamSMTCCue(FTimespan InTime, FString InTitle, FString InSubtitle)
+		: Time(InTime), Title(InTitle), Subtitle(InSubtitle)
+	{
+	}
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FTimespan Time;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FString Title;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FString Subtitle;
+};
+
+USTRUCT(BlueprintType)
+struct FDreamSMTCPlaylistEntry
+{
+	GENERATED_BODY()
+public:
+	/** File path (resolved against the playlist directory) or URL. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FString Location;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FString Title;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FString Artist;
+
+	/** Zero when the playlist does not specify it. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FTimespan Duration;
+};
+
+USTRUCT(BlueprintType)
+struct FDreamSMTCTrackListeningStats
+{
+	GENERATED_BODY()
+public:
+	/** "Artist - Title" as recorded, truncated to the history record size. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FString Label;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float PlaySeconds = 0.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 Plays = 0;
+
+	/** Plays left before 90% of a known duration. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 Skips = 0;
+};
+
+USTRUCT(BlueprintType)
+struct FDreamSMTCListeningSummary
+{
+	GENERATED_BODY()
+public:
+	/** Sorted by play time, longest first. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	TArray<FDreamSMTCTrackListeningStats> Tracks;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float TotalPlaySeconds = 0.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 Plays = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 Skips = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float SkipRate = 0.0f;
+
+	/** Presses per button, indexed by EDreamSMTCButtonEvent. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	TArray<int32> ButtonPresses;
+
+	/** Start of the summarized range. Later than requested when the in-memory history does not reach back that far. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FDateTime From;
+};
+
+USTRUCT(BlueprintType)
+struct FDreamSMTCAsyncTiming
+{
+	GENERATED_BODY()
+public:
+	/** Time between the request and the worker picking it up. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float QueueMilliseconds = 0.0f;
+
+	/** Time spent on the worker, including the OS call. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float WorkMilliseconds = 0.0f;
+
+	/** Time between the request and the result reaching the game thread. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float TotalMilliseconds = 0.0f;
+};
+
+/**
+ * Backend calls timed by the hitch detector. Those up to PrepareThumbnail can be given their own simulated
+ * latency and failure rate.
+ */
+UENUM(BlueprintType)
+enum class EDreamSMTCBackendOperation : uint8
+{
+	WriteSession,
+	WriteTimeline,
+	Update,
+	ClearAll,
+	SetThumbnail,
+	PrepareThumbnail,
+	// 以下只计时，不模拟
+	GetSoundLevel,
+	AddHandlers,
+	RemoveHandlers,
+	Release,
+};
+
+USTRUCT(BlueprintType)
+struct FDreamSMTCSimulatedOperationProfile
+{
+	GENERATED_BODY()
+public:
+	/** Time the call blocks the calling thread for. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", Units = "ms"))
+	float LatencyMs = 0.0f;
+
+	/** Uniform jitter added to or removed from the latency. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", Units = "ms"))
+	float JitterMs = 0.0f;
+
+	/** Probability of a call taking SpikeMs longer, e.g. when the media service is busy. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", ClampMax = "1"))
+	float SpikeRate = 0.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", Units = "ms"))
+	float SpikeMs = 0.0f;
+
+	/** Probability of a call failing after its latency. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", ClampMax = "1"))
+	float FailureRate = 0.0f;
+};
@@ -0,0 +1,84 @@
+﻿// Copyright Dream Moon.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Backend writes the scheduler can hold back. Each flag costs one backend call when committed. */
+enum class EDreamSMTCPendingWrite : uint8
+{
+	None = 0,
+	// DisplayUpdater.Update()
+	Display = 1 << 0,
+	// SystemMediaTransportControls.UpdateTimelineProperties()
+	Timeline = 1 << 1,
+};
+
+ENUM_CLASS_FLAGS(EDreamSMTCPendingWrite);
+
+enum class EDreamSMTCUpdatePriority : uint8
+{
+	// Merged into the next high priority commit, or sent alone once the flush delay expires
+	Low,
+	// Sent as soon as the call budget allows
+	High,
+};
+
+struct FDreamSMTCUpdateSchedulerStats
+{
+	int64 Commits = 0;
+	int64 BackendCalls = 0;
+	int64 MergedLowPriorityWrites = 0;
+	int64 ThrottledCommits = 0;
+};
+
+/**
+ * Priority-aware update scheduler
+ * Holds pending backend writes and decides when they may be committed, using a token bucket
+ * refilled at MaxBackendCallsPerSecond. High priority writes go out immediately while the
+ * budget allows, low priority writes ride along with them or wait for LowPriorityFlushDelay.
+ */
+class DREAMSMTC_API FDreamSMTCUpdateScheduler
+{
+public:
+	void Configure(float InMaxCallsPerSecond, float InLowPriorityFlushDelay, float InHighPriorityReserve);
+
+	void Enqueue(EDreamSMTCPendingWrite Writes, EDreamSMTCUpdatePriority Priority, double Now);
+
+	/** Returns the writes that may be committed now and removes them from the pending set. */
+	EDreamSMTCPendingWrite Poll(double Now);
+
+	/** Returns every pending write regardless of the budget. */
+	EDreamSMTCPendingWrite Flush(double Now);
+
+	void Reset();
+
+	bool HasPendingWrites() const
+	{
+		return PendingHigh != EDreamSMTCPendingWrite::None || PendingLow != EDreamSMTCPendingWrite::None;
+	}
+
+	EDreamSMTCPendingWrite GetPendingWrites() const { return PendingHigh | PendingLow; }
+
+	const FDreamSMTCUpdateSchedulerStats& GetStats() const { return Stats; }
+
+private:
+	void Refill(double Now);
+	EDreamSMTCPendingWrite Take(EDreamSMTCPendingWrite Writes);
+
+	static int32 CountCalls(EDreamSMTCPendingWrite Writes);
+
+private:
+	float MaxCallsPerSecond = 20.0f;
+	float LowPriorityFlushDelay = 1.0f;
+	float HighPriorityReserve = 2.0f;
+
+	EDreamSMTCPendingWrite PendingHigh = EDreamSMTCPendingWrite::None;
+	EDreamSMTCPendingWrite PendingLow = EDreamSMTCPendingWrite::None;
+	double LowPriorityQueuedTime = 0.0;
+
+	double Tokens = 20.0;
+	double LastRefillTime = -1.0;
+
+	FDreamSMTCUpdateSchedulerStats Stats;
+};
@@ -17,6 +17,8 @@
 #include <winrt/windows.media.control.h>
 #include <winrt/windows.media.playback.h>
 #include <winrt/windows.applicationmodel.core.h>
+#include <winrt/Windows.Storage.h>
+#include <winrt/Windows.Storage.Streams.h>
 
 #include "Windows/PostWindowsApi.h"
 #include "Windows/HideWindowsPlatformAtomics.h"